@@ -1,52 +1,22 @@
 #include "zfs.h"
+#include "bcache.h"
 #include "string.h"
 
-// ATA硬盘控制器端口
-#define ATA_PRIMARY_DATA        0x1F0
-#define ATA_PRIMARY_ERROR       0x1F1
-#define ATA_PRIMARY_SECTOR_CNT  0x1F2
-#define ATA_PRIMARY_SECTOR_LOW  0x1F3
-#define ATA_PRIMARY_SECTOR_MID  0x1F4
-#define ATA_PRIMARY_SECTOR_HIGH 0x1F5
-#define ATA_PRIMARY_DRIVE_HEAD  0x1F6
-#define ATA_PRIMARY_STATUS      0x1F7
-#define ATA_PRIMARY_COMMAND     0x1F7
-#define ATA_PRIMARY_CTRL        0x3F6
-
-// 使用 Primary ATA 控制器
-#define ATA_DATA        ATA_PRIMARY_DATA
-#define ATA_ERROR       ATA_PRIMARY_ERROR
-#define ATA_SECTOR_CNT  ATA_PRIMARY_SECTOR_CNT
-#define ATA_SECTOR_LOW  ATA_PRIMARY_SECTOR_LOW
-#define ATA_SECTOR_MID  ATA_PRIMARY_SECTOR_MID
-#define ATA_SECTOR_HIGH ATA_PRIMARY_SECTOR_HIGH
-#define ATA_DRIVE_HEAD  ATA_PRIMARY_DRIVE_HEAD
-#define ATA_STATUS      ATA_PRIMARY_STATUS
-#define ATA_COMMAND     ATA_PRIMARY_COMMAND
-#define ATA_CTRL        ATA_PRIMARY_CTRL
-
-// ATA命令
-#define ATA_CMD_READ    0x20
-#define ATA_CMD_WRITE   0x30
-#define ATA_CMD_FLUSH   0xE7
-
-// ATA状态
-#define ATA_STATUS_BSY  0x80
-#define ATA_STATUS_DRDY 0x40
-#define ATA_STATUS_DRQ  0x08
-#define ATA_STATUS_ERR  0x01
+// ZFS默认使用主IDE通道上的磁盘
+#define ZFS_DEFAULT_DEVICE "hda"
 
 // 全局变量
 static zfs_fs_t zfs_fs;
 static uint8_t disk_buffer[512];
 static uint8_t bitmap_cache[8192]; // 支持最大64K个块的位图缓存
+static uint8_t sb_buffer[512];     // 分配和释放块时写超级块用，不能占用disk_buffer
 static zfs_inode_t inode_cache;
+static blkdev_t* zfs_dev = 0;
 
 // 从外部导入的函数
-extern unsigned char inb(unsigned short port);
-extern void outb(unsigned short port, unsigned char data);
 extern void print_string(const char* str);
 extern void print_int(int num);
+extern void print_char(char c);
 extern void print_newline(void);
 extern unsigned int get_tick(void);
 
@@ -55,99 +25,37 @@ zfs_fs_t* get_zfs_fs(void) {
     return &zfs_fs;
 }
 
-// 读取一个扇区
-static int ata_read_sector(uint32_t lba, uint8_t* buffer) {
-    // 复位ATA控制器
-    outb(ATA_CTRL, 0x04);
-    outb(ATA_CTRL, 0x00);
-    
-    // 等待驱动器就绪
-    while (inb(ATA_STATUS) & ATA_STATUS_BSY);
-    
-    // 选择驱动器并设置LBA模式
-    outb(ATA_DRIVE_HEAD, 0xE0 | ((lba >> 24) & 0x0F));
-    
-    // 等待驱动器就绪
-    while (inb(ATA_STATUS) & ATA_STATUS_BSY);
-    
-    // 设置参数
-    outb(ATA_SECTOR_CNT, 1); // 读取1个扇区
-    outb(ATA_SECTOR_LOW, lba & 0xFF);
-    outb(ATA_SECTOR_MID, (lba >> 8) & 0xFF);
-    outb(ATA_SECTOR_HIGH, (lba >> 16) & 0xFF);
-    
-    // 发送读取命令
-    outb(ATA_COMMAND, ATA_CMD_READ);
-    
-    // 等待数据准备就绪
-    while (!(inb(ATA_STATUS) & ATA_STATUS_DRQ));
-    
-    // 从数据端口读取扇区数据 (512字节)
-    for (int i = 0; i < 512; i += 2) {
-        // 读取16位数据
-        uint16_t data = inb(ATA_DATA) | (inb(ATA_DATA) << 8);
-        buffer[i] = data & 0xFF;
-        buffer[i+1] = (data >> 8) & 0xFF;
+// 指定ZFS所在的块设备
+void zfs_set_device(blkdev_t* dev) {
+    zfs_dev = dev;
+}
+
+// 获取ZFS所在的块设备，未指定时使用默认设备
+blkdev_t* zfs_get_device(void) {
+    if (!zfs_dev) {
+        zfs_dev = blkdev_find(ZFS_DEFAULT_DEVICE);
     }
-    
-    // 检查错误
-    uint8_t status = inb(ATA_STATUS);
-    if (status & ATA_STATUS_ERR) {
+    return zfs_dev;
+}
+
+// 读取连续扇区 (经缓冲区缓存)
+static int zfs_read_sectors(uint32_t lba, uint32_t count, uint8_t* buffer) {
+    if (!bcache_read(zfs_get_device(), lba, count, buffer)) {
         return ZFS_ERROR;
     }
-    
     return ZFS_OK;
 }
 
-// 写入一个扇区
-static int ata_write_sector(uint32_t lba, const uint8_t* buffer) {
-    // 复位ATA控制器
-    outb(ATA_CTRL, 0x04);
-    outb(ATA_CTRL, 0x00);
-    
-    // 等待驱动器就绪
-    while (inb(ATA_STATUS) & ATA_STATUS_BSY);
-    
-    // 选择驱动器并设置LBA模式
-    outb(ATA_DRIVE_HEAD, 0xE0 | ((lba >> 24) & 0x0F));
-    
-    // 等待驱动器就绪
-    while (inb(ATA_STATUS) & ATA_STATUS_BSY);
-    
-    // 设置参数
-    outb(ATA_SECTOR_CNT, 1); // 写入1个扇区
-    outb(ATA_SECTOR_LOW, lba & 0xFF);
-    outb(ATA_SECTOR_MID, (lba >> 8) & 0xFF);
-    outb(ATA_SECTOR_HIGH, (lba >> 16) & 0xFF);
-    
-    // 发送写入命令
-    outb(ATA_COMMAND, ATA_CMD_WRITE);
-    
-    // 等待驱动器准备好接收数据
-    while (!(inb(ATA_STATUS) & ATA_STATUS_DRQ));
-    
-    // 向数据端口写入扇区数据 (512字节)
-    for (int i = 0; i < 512; i += 2) {
-        uint16_t data = buffer[i] | (buffer[i+1] << 8);
-        // 使用16位数据传输
-        outb(ATA_DATA, data & 0xFF);
-        outb(ATA_DATA, (data >> 8) & 0xFF);
-    }
-    
-    // 等待操作完成
-    while (inb(ATA_STATUS) & ATA_STATUS_BSY);
-    
-    // 检查错误
-    uint8_t status = inb(ATA_STATUS);
-    if (status & ATA_STATUS_ERR) {
+// 写入连续扇区 (写进缓冲区缓存，到期后由后台写回，同步或卸载时立即写回)
+static int zfs_write_sectors(uint32_t lba, uint32_t count, const uint8_t* buffer) {
+    if (!bcache_write(zfs_get_device(), lba, count, buffer)) {
         return ZFS_ERROR;
     }
-    
     return ZFS_OK;
 }
 
 // 读取一个块
-static int read_block(zfs_fs_t* fs, uint32_t block_num, uint8_t* buffer) {
+int read_block(zfs_fs_t* fs, uint32_t block_num, uint8_t* buffer) {
     if (!fs->mounted) {
         return ZFS_ERR_NOT_MOUNTED;
     }
@@ -157,11 +65,11 @@ static int read_block(zfs_fs_t* fs, uint32_t block_num, uint8_t* buffer) {
     }
     
     uint32_t lba = fs->disk_sector + block_num;
-    return ata_read_sector(lba, buffer);
+    return zfs_read_sectors(lba, 1, buffer);
 }
 
 // 写入一个块
-static int write_block(zfs_fs_t* fs, uint32_t block_num, const uint8_t* buffer) {
+int write_block(zfs_fs_t* fs, uint32_t block_num, const uint8_t* buffer) {
     if (!fs->mounted) {
         return ZFS_ERR_NOT_MOUNTED;
     }
@@ -171,11 +79,55 @@ static int write_block(zfs_fs_t* fs, uint32_t block_num, const uint8_t* buffer)
     }
     
     uint32_t lba = fs->disk_sector + block_num;
-    return ata_write_sector(lba, buffer);
+    return zfs_write_sectors(lba, 1, buffer);
+}
+
+// 读取一个元数据块 (inode表、目录、位图)，未命中时在块设备队列中先于文件数据派发
+int read_meta_block(zfs_fs_t* fs, uint32_t block_num, uint8_t* buffer) {
+    if (!fs->mounted) {
+        return ZFS_ERR_NOT_MOUNTED;
+    }
+    
+    if (block_num >= fs->superblock.total_blocks) {
+        return ZFS_ERROR;
+    }
+    
+    if (!bcache_read_meta(zfs_get_device(), fs->disk_sector + block_num, 1, buffer)) {
+        return ZFS_ERROR;
+    }
+    return ZFS_OK;
+}
+
+// 写入一个元数据块
+int write_meta_block(zfs_fs_t* fs, uint32_t block_num, const uint8_t* buffer) {
+    if (!fs->mounted) {
+        return ZFS_ERR_NOT_MOUNTED;
+    }
+    
+    if (block_num >= fs->superblock.total_blocks) {
+        return ZFS_ERROR;
+    }
+    
+    if (!bcache_write_meta(zfs_get_device(), fs->disk_sector + block_num, 1, buffer)) {
+        return ZFS_ERROR;
+    }
+    return ZFS_OK;
+}
+
+// 位图变化后把所在的位图块和超级块写进缓冲区缓存，由后台写回按时落盘
+// 写不进缓存时标记为脏，留到同步或卸载时再写
+static void stage_bitmap(zfs_fs_t* fs, uint32_t bitmap_index) {
+    uint32_t i = bitmap_index / ZFS_BLOCK_SIZE;
+
+    memcpy(sb_buffer, &fs->superblock, sizeof(zfs_superblock_t));
+    if (write_meta_block(fs, fs->superblock.bitmap_block + i, fs->bitmap + i * ZFS_BLOCK_SIZE) != ZFS_OK ||
+        write_meta_block(fs, 0, sb_buffer) != ZFS_OK) {
+        fs->cache_dirty = 1;
+    }
 }
 
 // 分配一个块
-static int allocate_block(zfs_fs_t* fs) {
+int allocate_block(zfs_fs_t* fs) {
     if (!fs->mounted || !fs->bitmap) {
         return ZFS_ERR_NOT_MOUNTED;
     }
@@ -197,8 +149,7 @@ static int allocate_block(zfs_fs_t* fs) {
                 // 计算块号
                 uint32_t block_num = i * 8 + j + fs->superblock.data_block;
                 
-                // 标记位图为脏
-                fs->cache_dirty = 1;
+                stage_bitmap(fs, i);
                 
                 return block_num;
             }
@@ -210,7 +161,7 @@ static int allocate_block(zfs_fs_t* fs) {
 }
 
 // 释放一个块
-static int free_block(zfs_fs_t* fs, uint32_t block_num) {
+int free_block(zfs_fs_t* fs, uint32_t block_num) {
     if (!fs->mounted || !fs->bitmap) {
         return ZFS_ERR_NOT_MOUNTED;
     }
@@ -234,14 +185,16 @@ static int free_block(zfs_fs_t* fs, uint32_t block_num) {
     fs->bitmap[bitmap_index] &= ~mask;
     fs->superblock.free_blocks++;
     
-    // 标记位图为脏
-    fs->cache_dirty = 1;
+    stage_bitmap(fs, bitmap_index);
+    
+    // 块设备层把丢弃留到位图写回并刷新之后
+    bcache_discard(zfs_get_device(), fs->disk_sector + block_num, 1);
     
     return ZFS_OK;
 }
 
-// 读取inode
-static int read_inode(zfs_fs_t* fs, uint32_t inode_num, zfs_inode_t* inode) {
+// 读取inode槽位的原始内容，不检查是否在用
+static int read_inode_slot(zfs_fs_t* fs, uint32_t inode_num, zfs_inode_t* inode) {
     if (!fs->mounted) {
         return ZFS_ERR_NOT_MOUNTED;
     }
@@ -256,12 +209,21 @@ static int read_inode(zfs_fs_t* fs, uint32_t inode_num, zfs_inode_t* inode) {
     uint32_t offset = (inode_num % inodes_per_block) * sizeof(zfs_inode_t);
     
     // 读取块
-    if (read_block(fs, block_num, disk_buffer) != ZFS_OK) {
+    if (read_meta_block(fs, block_num, disk_buffer) != ZFS_OK) {
         return ZFS_ERROR;
     }
     
     // 复制inode
     memcpy(inode, disk_buffer + offset, sizeof(zfs_inode_t));
+    return ZFS_OK;
+}
+
+// 读取inode
+int read_inode(zfs_fs_t* fs, uint32_t inode_num, zfs_inode_t* inode) {
+    int ret = read_inode_slot(fs, inode_num, inode);
+    if (ret != ZFS_OK) {
+        return ret;
+    }
     
     // 验证inode是否有效
     if (inode->inode_num != inode_num) {
@@ -271,13 +233,12 @@ static int read_inode(zfs_fs_t* fs, uint32_t inode_num, zfs_inode_t* inode) {
     return ZFS_OK;
 }
 
-// 写入inode
-static int write_inode(zfs_fs_t* fs, const zfs_inode_t* inode) {
+// 把inode写入第inode_num个槽位
+static int write_inode_slot(zfs_fs_t* fs, uint32_t inode_num, const zfs_inode_t* inode) {
     if (!fs->mounted) {
         return ZFS_ERR_NOT_MOUNTED;
     }
     
-    uint32_t inode_num = inode->inode_num;
     if (inode_num >= ZFS_MAX_FILES) {
         return ZFS_ERROR;
     }
@@ -288,7 +249,7 @@ static int write_inode(zfs_fs_t* fs, const zfs_inode_t* inode) {
     uint32_t offset = (inode_num % inodes_per_block) * sizeof(zfs_inode_t);
     
     // 读取块
-    if (read_block(fs, block_num, disk_buffer) != ZFS_OK) {
+    if (read_meta_block(fs, block_num, disk_buffer) != ZFS_OK) {
         return ZFS_ERROR;
     }
     
@@ -296,15 +257,20 @@ static int write_inode(zfs_fs_t* fs, const zfs_inode_t* inode) {
     memcpy(disk_buffer + offset, inode, sizeof(zfs_inode_t));
     
     // 写回块
-    if (write_block(fs, block_num, disk_buffer) != ZFS_OK) {
+    if (write_meta_block(fs, block_num, disk_buffer) != ZFS_OK) {
         return ZFS_ERROR;
     }
     
     return ZFS_OK;
 }
 
+// 写入inode
+int write_inode(zfs_fs_t* fs, const zfs_inode_t* inode) {
+    return write_inode_slot(fs, inode->inode_num, inode);
+}
+
 // 分配一个inode
-static int allocate_inode(zfs_fs_t* fs) {
+int allocate_inode(zfs_fs_t* fs) {
     if (!fs->mounted) {
         return ZFS_ERR_NOT_MOUNTED;
     }
@@ -314,8 +280,9 @@ static int allocate_inode(zfs_fs_t* fs) {
     }
     
     // 遍历inode表寻找空闲inode
+    // 空闲槽位的inode_num为ZFS_INVALID_BLOCK，read_inode会把它当作无效inode拒绝
     for (uint32_t i = 0; i < ZFS_MAX_FILES; i++) {
-        if (read_inode(fs, i, &inode_cache) != ZFS_OK) {
+        if (read_inode_slot(fs, i, &inode_cache) != ZFS_OK) {
             continue;
         }
         
@@ -330,7 +297,7 @@ static int allocate_inode(zfs_fs_t* fs) {
 }
 
 // 释放一个inode
-static int free_inode(zfs_fs_t* fs, uint32_t inode_num) {
+int free_inode(zfs_fs_t* fs, uint32_t inode_num) {
     if (!fs->mounted) {
         return ZFS_ERR_NOT_MOUNTED;
     }
@@ -354,12 +321,12 @@ static int free_inode(zfs_fs_t* fs, uint32_t inode_num) {
     
     // 处理间接块 (简化版只实现直接块)
     
-    // 标记inode为未使用
+    // 标记inode为未使用 (inode_num已无效，按槽位写回)
     inode_cache.inode_num = ZFS_INVALID_BLOCK;
     inode_cache.size = 0;
     
     // 写回inode
-    if (write_inode(fs, &inode_cache) != ZFS_OK) {
+    if (write_inode_slot(fs, inode_num, &inode_cache) != ZFS_OK) {
         return ZFS_ERROR;
     }
     
@@ -372,7 +339,7 @@ static int free_inode(zfs_fs_t* fs, uint32_t inode_num) {
 // 初始化ZFS文件系统
 int zfs_init(zfs_fs_t* fs, uint32_t disk_sector) {
     // 读取超级块
-    if (ata_read_sector(disk_sector, disk_buffer) != ZFS_OK) {
+    if (zfs_read_sectors(disk_sector, 1, disk_buffer) != ZFS_OK) {
         return ZFS_ERROR;
     }
     
@@ -403,7 +370,15 @@ int zfs_format(uint32_t disk_sector, uint32_t size) {
     // 计算参数
     uint32_t total_blocks = size / ZFS_BLOCK_SIZE;
     uint32_t bitmap_blocks = (total_blocks + 4095) / 4096; // 每块可索引4096个块
-    uint32_t inode_blocks = (ZFS_MAX_FILES * sizeof(zfs_inode_t) + ZFS_BLOCK_SIZE - 1) / ZFS_BLOCK_SIZE;
+    // inode不跨块存放，按每块能放下的个数计算
+    uint32_t inodes_per_block = ZFS_BLOCK_SIZE / sizeof(zfs_inode_t);
+    uint32_t inode_blocks = (ZFS_MAX_FILES + inodes_per_block - 1) / inodes_per_block;
+    
+    // 空闲位图和inode表的大部分块绕过缓存直接写设备，先作废设备上旧的缓存
+    if (!bcache_flush(zfs_get_device())) {
+        return ZFS_ERROR;
+    }
+    bcache_invalidate(zfs_get_device());
     
     // 构建超级块
     zfs_superblock_t sb;
@@ -427,7 +402,7 @@ int zfs_format(uint32_t disk_sector, uint32_t size) {
     
     // 写入超级块
     memcpy(disk_buffer, &sb, sizeof(sb));
-    if (ata_write_sector(disk_sector, disk_buffer) != ZFS_OK) {
+    if (zfs_write_sectors(disk_sector, 1, disk_buffer) != ZFS_OK) {
         return ZFS_ERROR;
     }
     
@@ -443,20 +418,20 @@ int zfs_format(uint32_t disk_sector, uint32_t size) {
     }
     
     // 写入位图
-    for (uint32_t i = 0; i < bitmap_blocks; i++) {
-        uint32_t lba = disk_sector + sb.bitmap_block + i;
-        if (i == 0) {
-            if (ata_write_sector(lba, disk_buffer) != ZFS_OK) {
-                return ZFS_ERROR;
-            }
-        } else {
-            // 后续位图块全部初始化为0 (空闲)
-            memset(disk_buffer, 0, ZFS_BLOCK_SIZE);
-            if (ata_write_sector(lba, disk_buffer) != ZFS_OK) {
-                return ZFS_ERROR;
-            }
+    if (zfs_write_sectors(disk_sector + sb.bitmap_block, 1, disk_buffer) != ZFS_OK) {
+        return ZFS_ERROR;
+    }
+    
+    // 后续位图块全部初始化为0 (空闲)，异步提交后由请求队列合并
+    memset(disk_buffer, 0, ZFS_BLOCK_SIZE);
+    for (uint32_t i = 1; i < bitmap_blocks; i++) {
+        if (!blkdev_write_async(zfs_get_device(), disk_sector + sb.bitmap_block + i, 1, disk_buffer)) {
+            return ZFS_ERROR;
         }
     }
+    if (!blkdev_drain(zfs_get_device())) {
+        return ZFS_ERROR;
+    }
     
     // 初始化inode表
     memset(disk_buffer, 0, ZFS_BLOCK_SIZE);
@@ -471,6 +446,12 @@ int zfs_format(uint32_t disk_sector, uint32_t size) {
     root_inode->modify_time = root_inode->create_time;
     root_inode->access_time = root_inode->create_time;
     
+    // 根目录还没有数据块 (块0是超级块，不能当作有效块号)
+    for (int j = 0; j < 10; j++) {
+        root_inode->direct_blocks[j] = ZFS_INVALID_BLOCK;
+    }
+    root_inode->indirect_block = ZFS_INVALID_BLOCK;
+    
     // 所有其他的inode标记为无效
     for (uint32_t i = 1; i < ZFS_BLOCK_SIZE / sizeof(zfs_inode_t); i++) {
         zfs_inode_t* inode = (zfs_inode_t*)(disk_buffer + i * sizeof(zfs_inode_t));
@@ -483,7 +464,7 @@ int zfs_format(uint32_t disk_sector, uint32_t size) {
     
     // 写入inode表
     uint32_t lba = disk_sector + sb.inode_table_block;
-    if (ata_write_sector(lba, disk_buffer) != ZFS_OK) {
+    if (zfs_write_sectors(lba, 1, disk_buffer) != ZFS_OK) {
         return ZFS_ERROR;
     }
     
@@ -491,10 +472,18 @@ int zfs_format(uint32_t disk_sector, uint32_t size) {
     memset(disk_buffer, 0xFF, ZFS_BLOCK_SIZE);
     for (uint32_t i = 1; i < inode_blocks; i++) {
         lba = disk_sector + sb.inode_table_block + i;
-        if (ata_write_sector(lba, disk_buffer) != ZFS_OK) {
+        if (!blkdev_write_async(zfs_get_device(), lba, 1, disk_buffer)) {
             return ZFS_ERROR;
         }
     }
+    if (!blkdev_drain(zfs_get_device())) {
+        return ZFS_ERROR;
+    }
+    
+    // 写回缓存中的超级块、第一个位图块和根目录inode
+    if (!bcache_flush(zfs_get_device())) {
+        return ZFS_ERROR;
+    }
     
     print_string("ZFS 文件系统格式化成功, 总块数: ");
     print_int(total_blocks);
@@ -511,13 +500,14 @@ int zfs_mount(zfs_fs_t* fs) {
         return ZFS_OK; // 已经挂载
     }
     
-    // 加载位图
-    for (uint32_t i = 0; i < fs->superblock.bitmap_blocks && i < 16; i++) {
-        // 最多加载16个位图块 (支持64K个块)
-        if (read_block(fs, fs->superblock.bitmap_block + i,
-                      fs->bitmap + i * ZFS_BLOCK_SIZE) != ZFS_OK) {
-            return ZFS_ERROR;
-        }
+    // 加载位图，最多16个位图块 (支持64K个块)，一条命令读完
+    uint32_t bitmap_blocks = fs->superblock.bitmap_blocks;
+    if (bitmap_blocks > 16) {
+        bitmap_blocks = 16;
+    }
+    if (zfs_read_sectors(fs->disk_sector + fs->superblock.bitmap_block,
+                         bitmap_blocks, fs->bitmap) != ZFS_OK) {
+        return ZFS_ERROR;
     }
     
     // 标记为已挂载
@@ -542,7 +532,7 @@ int zfs_unmount(zfs_fs_t* fs) {
     if (fs->cache_dirty) {
         // 写回位图
         for (uint32_t i = 0; i < fs->superblock.bitmap_blocks && i < 16; i++) {
-            if (write_block(fs, fs->superblock.bitmap_block + i,
+            if (write_meta_block(fs, fs->superblock.bitmap_block + i,
                            fs->bitmap + i * ZFS_BLOCK_SIZE) != ZFS_OK) {
                 return ZFS_ERROR;
             }
@@ -550,13 +540,18 @@ int zfs_unmount(zfs_fs_t* fs) {
         
         // 写回超级块
         memcpy(disk_buffer, &fs->superblock, sizeof(zfs_superblock_t));
-        if (write_block(fs, 0, disk_buffer) != ZFS_OK) {
+        if (write_meta_block(fs, 0, disk_buffer) != ZFS_OK) {
             return ZFS_ERROR;
         }
         
         fs->cache_dirty = 0;
     }
     
+    // 写回缓存中的脏块，确保元数据落盘；失败时保持挂载，可以重试
+    if (!bcache_flush(zfs_get_device())) {
+        return ZFS_ERROR;
+    }
+    
     // 标记为已卸载
     fs->mounted = 0;
     
@@ -576,7 +571,7 @@ int zfs_sync(zfs_fs_t* fs) {
     if (fs->cache_dirty) {
         // 写回位图
         for (uint32_t i = 0; i < fs->superblock.bitmap_blocks && i < 16; i++) {
-            if (write_block(fs, fs->superblock.bitmap_block + i,
+            if (write_meta_block(fs, fs->superblock.bitmap_block + i,
                            fs->bitmap + i * ZFS_BLOCK_SIZE) != ZFS_OK) {
                 return ZFS_ERROR;
             }
@@ -584,18 +579,23 @@ int zfs_sync(zfs_fs_t* fs) {
         
         // 写回超级块
         memcpy(disk_buffer, &fs->superblock, sizeof(zfs_superblock_t));
-        if (write_block(fs, 0, disk_buffer) != ZFS_OK) {
+        if (write_meta_block(fs, 0, disk_buffer) != ZFS_OK) {
             return ZFS_ERROR;
         }
         
         fs->cache_dirty = 0;
     }
     
+    // 同步点: 写回缓存中的脏块，让设备写缓存落盘
+    if (!bcache_flush(zfs_get_device())) {
+        return ZFS_ERROR;
+    }
+    
     return ZFS_OK;
 }
 
 // 根据路径找到inode
-static int find_inode_by_path(zfs_fs_t* fs, const char* path, zfs_inode_t* inode) {
+int find_inode_by_path(zfs_fs_t* fs, const char* path, zfs_inode_t* inode) {
     if (!fs->mounted) {
         return ZFS_ERR_NOT_MOUNTED;
     }
@@ -627,7 +627,7 @@ static int find_inode_by_path(zfs_fs_t* fs, const char* path, zfs_inode_t* inode
         }
         
         // 读取目录块
-        if (read_block(fs, block_num, disk_buffer) != ZFS_OK) {
+        if (read_meta_block(fs, block_num, disk_buffer) != ZFS_OK) {
             continue;
         }
         
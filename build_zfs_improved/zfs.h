@@ -2,6 +2,7 @@
 #define ZFS_H
 
 #include <stdint.h>
+#include "blkdev.h"
 
 // ZFS 文件系统常量定义
 #define ZFS_MAGIC              0x5A465300  // "ZFS\0"
@@ -94,6 +95,12 @@ typedef struct {
 // 获取ZFS文件系统实例
 zfs_fs_t* get_zfs_fs(void);
 
+// 指定ZFS所在的块设备 (默认 "hda")
+void zfs_set_device(blkdev_t* dev);
+
+// 获取ZFS所在的块设备
+blkdev_t* zfs_get_device(void);
+
 // 初始化ZFS文件系统
 int zfs_init(zfs_fs_t* fs, uint32_t disk_sector);
 
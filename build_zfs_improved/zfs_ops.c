@@ -1,4 +1,5 @@
 #include "zfs.h"
+#include "bcache.h"
 #include "string.h"
 
 // 外部函数声明
@@ -8,17 +9,18 @@ extern void print_newline(void);
 extern unsigned int get_tick(void);
 extern zfs_fs_t* get_zfs_fs(void);
 
-// 需要从zfs.c导入的内部函数，这些在实际实现中应该放在同一个文件
-// 这里简单重新声明
-static int read_block(zfs_fs_t* fs, uint32_t block_num, uint8_t* buffer);
-static int write_block(zfs_fs_t* fs, uint32_t block_num, const uint8_t* buffer);
-static int allocate_block(zfs_fs_t* fs);
-static int free_block(zfs_fs_t* fs, uint32_t block_num);
-static int read_inode(zfs_fs_t* fs, uint32_t inode_num, zfs_inode_t* inode);
-static int write_inode(zfs_fs_t* fs, const zfs_inode_t* inode);
-static int allocate_inode(zfs_fs_t* fs);
-static int free_inode(zfs_fs_t* fs, uint32_t inode_num);
-static int find_inode_by_path(zfs_fs_t* fs, const char* path, zfs_inode_t* inode);
+// zfs.c中的内部函数 (块、inode和路径查找)
+int read_block(zfs_fs_t* fs, uint32_t block_num, uint8_t* buffer);
+int write_block(zfs_fs_t* fs, uint32_t block_num, const uint8_t* buffer);
+int read_meta_block(zfs_fs_t* fs, uint32_t block_num, uint8_t* buffer);
+int write_meta_block(zfs_fs_t* fs, uint32_t block_num, const uint8_t* buffer);
+int allocate_block(zfs_fs_t* fs);
+int free_block(zfs_fs_t* fs, uint32_t block_num);
+int read_inode(zfs_fs_t* fs, uint32_t inode_num, zfs_inode_t* inode);
+int write_inode(zfs_fs_t* fs, const zfs_inode_t* inode);
+int allocate_inode(zfs_fs_t* fs);
+int free_inode(zfs_fs_t* fs, uint32_t inode_num);
+int find_inode_by_path(zfs_fs_t* fs, const char* path, zfs_inode_t* inode);
 
 // 缓冲区
 static uint8_t disk_buffer[512];
@@ -74,6 +76,11 @@ int zfs_create(zfs_fs_t* fs, const char* path, uint8_t attributes) {
         return ZFS_ERROR;
     }
     
+    // 目录项不跨块: 最后一块放不下时从下一块开头写
+    if (inode_cache.size % ZFS_BLOCK_SIZE > ZFS_BLOCK_SIZE - sizeof(zfs_direntry_t)) {
+        inode_cache.size += ZFS_BLOCK_SIZE - inode_cache.size % ZFS_BLOCK_SIZE;
+    }
+    
     // 找到根目录的最后一个块，或分配一个新块
     uint32_t block_num = ZFS_INVALID_BLOCK;
     uint32_t block_index = inode_cache.size / ZFS_BLOCK_SIZE;
@@ -95,7 +102,7 @@ int zfs_create(zfs_fs_t* fs, const char* path, uint8_t attributes) {
             block_num = inode_cache.direct_blocks[block_index];
             
             // 读取现有块
-            if (read_block(fs, block_num, disk_buffer) != ZFS_OK) {
+            if (read_meta_block(fs, block_num, disk_buffer) != ZFS_OK) {
                 return ZFS_ERROR;
             }
         }
@@ -114,7 +121,7 @@ int zfs_create(zfs_fs_t* fs, const char* path, uint8_t attributes) {
     inode_cache.modify_time = get_tick();
     
     // 写回块
-    if (write_block(fs, block_num, disk_buffer) != ZFS_OK) {
+    if (write_meta_block(fs, block_num, disk_buffer) != ZFS_OK) {
         return ZFS_ERROR;
     }
     
@@ -166,7 +173,7 @@ int zfs_delete(zfs_fs_t* fs, const char* path) {
         }
         
         // 读取目录块
-        if (read_block(fs, block_num, disk_buffer) != ZFS_OK) {
+        if (read_meta_block(fs, block_num, disk_buffer) != ZFS_OK) {
             continue;
         }
         
@@ -194,7 +201,7 @@ int zfs_delete(zfs_fs_t* fs, const char* path) {
     }
     
     // 读取包含目录项的块
-    if (read_block(fs, found_block, disk_buffer) != ZFS_OK) {
+    if (read_meta_block(fs, found_block, disk_buffer) != ZFS_OK) {
         return ZFS_ERROR;
     }
     
@@ -203,7 +210,7 @@ int zfs_delete(zfs_fs_t* fs, const char* path) {
     entry->inode_num = ZFS_INVALID_BLOCK;
     
     // 写回块
-    if (write_block(fs, found_block, disk_buffer) != ZFS_OK) {
+    if (write_meta_block(fs, found_block, disk_buffer) != ZFS_OK) {
         return ZFS_ERROR;
     }
     
@@ -277,9 +284,13 @@ int zfs_read(zfs_fs_t* fs, zfs_file_t* file, void* buffer, uint32_t size) {
     }
     
     // 读取数据
+    // 整块直接读进调用者的缓冲区 (缓存中有的直接复制)，暂缓派发让相邻块合并成一条向量命令，
+    // 只有首尾不满一块的部分经过disk_buffer
     uint32_t bytes_read = 0;
     uint8_t* buf = (uint8_t*)buffer;
+    blkdev_t* dev = zfs_get_device();
     
+    blkdev_plug(dev);
     while (bytes_read < size) {
         uint32_t block_index = file->position / ZFS_BLOCK_SIZE;
         uint32_t offset = file->position % ZFS_BLOCK_SIZE;
@@ -295,13 +306,22 @@ int zfs_read(zfs_fs_t* fs, zfs_file_t* file, void* buffer, uint32_t size) {
                 break; // 块不存在，读取结束
             }
             
-            // 读取块
-            if (read_block(fs, block_num, disk_buffer) != ZFS_OK) {
-                return ZFS_ERROR;
+            if (offset == 0 && bytes_to_read == ZFS_BLOCK_SIZE) {
+                if (block_num >= fs->superblock.total_blocks ||
+                    !bcache_read_async(dev, fs->disk_sector + block_num, 1, buf + bytes_read)) {
+                    blkdev_drain(dev);
+                    return ZFS_ERROR;
+                }
+            } else {
+                // 读取块
+                if (read_block(fs, block_num, disk_buffer) != ZFS_OK) {
+                    blkdev_drain(dev);
+                    return ZFS_ERROR;
+                }
+                
+                // 复制数据
+                memcpy(buf + bytes_read, disk_buffer + offset, bytes_to_read);
             }
-            
-            // 复制数据
-            memcpy(buf + bytes_read, disk_buffer + offset, bytes_to_read);
         } else {
             // 间接块暂不实现
             break;
@@ -311,6 +331,10 @@ int zfs_read(zfs_fs_t* fs, zfs_file_t* file, void* buffer, uint32_t size) {
         file->position += bytes_to_read;
     }
     
+    if (!blkdev_drain(dev)) {
+        return ZFS_ERROR;
+    }
+    
     // 更新访问时间
     inode_cache.access_time = get_tick();
     if (write_inode(fs, &inode_cache) != ZFS_OK) {
@@ -475,7 +499,7 @@ int zfs_list_directory(zfs_fs_t* fs, const char* path, zfs_direntry_t* entries,
         }
         
         // 读取目录块
-        if (read_block(fs, block_num, disk_buffer) != ZFS_OK) {
+        if (read_meta_block(fs, block_num, disk_buffer) != ZFS_OK) {
             continue;
         }
         
@@ -549,7 +573,7 @@ int zfs_rename(zfs_fs_t* fs, const char* old_path, const char* new_path) {
         }
         
         // 读取目录块
-        if (read_block(fs, block_num, disk_buffer) != ZFS_OK) {
+        if (read_meta_block(fs, block_num, disk_buffer) != ZFS_OK) {
             continue;
         }
         
@@ -577,7 +601,7 @@ int zfs_rename(zfs_fs_t* fs, const char* old_path, const char* new_path) {
     }
     
     // 读取包含目录项的块
-    if (read_block(fs, found_block, disk_buffer) != ZFS_OK) {
+    if (read_meta_block(fs, found_block, disk_buffer) != ZFS_OK) {
         return ZFS_ERROR;
     }
     
@@ -586,7 +610,7 @@ int zfs_rename(zfs_fs_t* fs, const char* old_path, const char* new_path) {
     strncpy((char*)entry->filename, new_filename, ZFS_NAME_LENGTH - 1);
     
     // 写回块
-    if (write_block(fs, found_block, disk_buffer) != ZFS_OK) {
+    if (write_meta_block(fs, found_block, disk_buffer) != ZFS_OK) {
         return ZFS_ERROR;
     }
     
@@ -1,181 +1,46 @@
 #include "ntfs.h"
 #include "string.h"
 
-// ATA硬盘控制器端口
-#define ATA_PRIMARY_DATA        0x1F0
-#define ATA_PRIMARY_ERROR       0x1F1
-#define ATA_PRIMARY_SECTOR_CNT  0x1F2
-#define ATA_PRIMARY_SECTOR_LOW  0x1F3
-#define ATA_PRIMARY_SECTOR_MID  0x1F4
-#define ATA_PRIMARY_SECTOR_HIGH 0x1F5
-#define ATA_PRIMARY_DRIVE_HEAD  0x1F6
-#define ATA_PRIMARY_STATUS      0x1F7
-#define ATA_PRIMARY_COMMAND     0x1F7
-#define ATA_PRIMARY_CTRL        0x3F6
-
-// 使用 Primary ATA 控制器
-#define ATA_DATA        ATA_PRIMARY_DATA
-#define ATA_ERROR       ATA_PRIMARY_ERROR
-#define ATA_SECTOR_CNT  ATA_PRIMARY_SECTOR_CNT
-#define ATA_SECTOR_LOW  ATA_PRIMARY_SECTOR_LOW
-#define ATA_SECTOR_MID  ATA_PRIMARY_SECTOR_MID
-#define ATA_SECTOR_HIGH ATA_PRIMARY_SECTOR_HIGH
-#define ATA_DRIVE_HEAD  ATA_PRIMARY_DRIVE_HEAD
-#define ATA_STATUS      ATA_PRIMARY_STATUS
-#define ATA_COMMAND     ATA_PRIMARY_COMMAND
-#define ATA_CTRL        ATA_PRIMARY_CTRL
-
-// ATA命令
-#define ATA_CMD_READ    0x20
-#define ATA_CMD_WRITE   0x30
-#define ATA_CMD_FLUSH   0xE7
-
-// ATA状态
-#define ATA_STATUS_BSY  0x80
-#define ATA_STATUS_DRDY 0x40
-#define ATA_STATUS_DRQ  0x08
-#define ATA_STATUS_ERR  0x01
+// NTFS默认使用主IDE通道上的磁盘
+#define NTFS_DEFAULT_DEVICE "hda"
 
 // 全局变量
 static ntfs_fs_t ntfs_fs;
 static uint8_t disk_buffer[512];
+static blkdev_t* ntfs_dev = 0;
 
 // 获取NTFS文件系统实例的函数
 ntfs_fs_t* get_ntfs_fs(void) {
     return &ntfs_fs;
 }
 
-// 从外部导入的函数
-extern unsigned char inb(unsigned short port);
-extern void outb(unsigned short port, unsigned char data);
-
-// 辅助函数
-static void insl(unsigned short port, void* addr, unsigned int count) {
-    // 从ATA控制器端口读取数据
-    unsigned int* buffer = (unsigned int*)addr;
-    for (unsigned int i = 0; i < count; i++) {
-        // 每次读取32位数据
-        buffer[i] = inb(port) | (inb(port) << 8) | (inb(port) << 16) | (inb(port) << 24);
-    }
+// 指定NTFS所在的块设备
+void ntfs_set_device(blkdev_t* dev) {
+    ntfs_dev = dev;
 }
 
-static void outsl(unsigned short port, const void* addr, unsigned int count) {
-    // 向ATA控制器端口写入数据
-    const unsigned int* buffer = (const unsigned int*)addr;
-    for (unsigned int i = 0; i < count; i++) {
-        // 每次写入32位数据
-        outb(port, buffer[i] & 0xFF);
-        outb(port, (buffer[i] >> 8) & 0xFF);
-        outb(port, (buffer[i] >> 16) & 0xFF);
-        outb(port, (buffer[i] >> 24) & 0xFF);
+// 获取NTFS所在的块设备，未指定时使用默认设备
+static blkdev_t* ntfs_get_device(void) {
+    if (!ntfs_dev) {
+        ntfs_dev = blkdev_find(NTFS_DEFAULT_DEVICE);
     }
+    return ntfs_dev;
 }
 
-// 读取一个扇区 - 简化版
-static int ata_read_sector(uint32_t lba, uint8_t* buffer) {
-    int i;
-    
-    // 复位ATA控制器
-    outb(ATA_CTRL, 0x04);
-    outb(ATA_CTRL, 0x00);
-    
-    // 等待驱动器就绪
-    while (inb(ATA_STATUS) & ATA_STATUS_BSY);
-    
-    // 选择驱动器并设置LBA模式
-    outb(ATA_DRIVE_HEAD, 0xE0 | ((lba >> 24) & 0x0F));
-    
-    // 等待驱动器就绪
-    while (inb(ATA_STATUS) & ATA_STATUS_BSY);
-    
-    // 设置参数
-    outb(ATA_SECTOR_CNT, 1); // 读取1个扇区
-    outb(ATA_SECTOR_LOW, lba & 0xFF);
-    outb(ATA_SECTOR_MID, (lba >> 8) & 0xFF);
-    outb(ATA_SECTOR_HIGH, (lba >> 16) & 0xFF);
-    
-    // 发送读取命令
-    outb(ATA_COMMAND, ATA_CMD_READ);
-    
-    // 等待数据准备就绪
-    while (!(inb(ATA_STATUS) & ATA_STATUS_DRQ));
-    
-    // 从数据端口读取扇区数据 (512字节)
-    for (i = 0; i < 512; i += 2) {
-        // 读取16位数据
-        uint8_t low = inb(ATA_DATA);
-        uint8_t high = inb(ATA_DATA);
-        
-        buffer[i] = low;
-        buffer[i+1] = high;
-    }
-    
-    // 等待操作完成
-    while (inb(ATA_STATUS) & ATA_STATUS_BSY);
-    
-    // 检查错误
-    uint8_t status = inb(ATA_STATUS);
-    if (status & ATA_STATUS_ERR) {
-        return -1;
-    }
-    
-    return 0;
+// 读取连续扇区
+static int ntfs_read_sectors(uint32_t lba, uint32_t count, void* buffer) {
+    return blkdev_read(ntfs_get_device(), lba, count, buffer) ? 0 : -1;
 }
 
-// 写入一个扇区 - 简化版
-static int ata_write_sector(uint32_t lba, const uint8_t* buffer) {
-    int i;
-    
-    // 复位ATA控制器
-    outb(ATA_CTRL, 0x04);
-    outb(ATA_CTRL, 0x00);
-    
-    // 等待驱动器就绪
-    while (inb(ATA_STATUS) & ATA_STATUS_BSY);
-    
-    // 选择驱动器并设置LBA模式
-    outb(ATA_DRIVE_HEAD, 0xE0 | ((lba >> 24) & 0x0F));
-    
-    // 等待驱动器就绪
-    while (inb(ATA_STATUS) & ATA_STATUS_BSY);
-    
-    // 设置参数
-    outb(ATA_SECTOR_CNT, 1); // 写入1个扇区
-    outb(ATA_SECTOR_LOW, lba & 0xFF);
-    outb(ATA_SECTOR_MID, (lba >> 8) & 0xFF);
-    outb(ATA_SECTOR_HIGH, (lba >> 16) & 0xFF);
-    
-    // 发送写入命令
-    outb(ATA_COMMAND, ATA_CMD_WRITE);
-    
-    // 等待驱动器准备好接收数据
-    while (!(inb(ATA_STATUS) & ATA_STATUS_DRQ));
-    
-    // 向数据端口写入扇区数据 (512字节)
-    for (i = 0; i < 512; i += 2) {
-        uint16_t data = buffer[i] | (buffer[i+1] << 8);
-        
-        // 使用16位数据传输，适用于QEMU的ATA模拟
-        outb(ATA_DATA, data & 0xFF);
-        outb(ATA_DATA, (data >> 8) & 0xFF);
-    }
-    
-    // 等待操作完成
-    while ((inb(ATA_STATUS) & (ATA_STATUS_BSY | ATA_STATUS_DRQ)));
-    
-    // 检查错误
-    uint8_t status = inb(ATA_STATUS);
-    if (status & ATA_STATUS_ERR) {
-        return -1;
-    }
-    
-    return 0;
+// 写入连续扇区
+static int ntfs_write_sectors(uint32_t lba, uint32_t count, const void* buffer) {
+    return blkdev_write(ntfs_get_device(), lba, count, buffer) ? 0 : -1;
 }
 
 // 初始化NTFS文件系统
 int ntfs_init(ntfs_fs_t* fs, uint32_t disk_sector) {
     // 读取引导扇区
-    if (ata_read_sector(disk_sector, disk_buffer) != 0) {
+    if (ntfs_read_sectors(disk_sector, 1, disk_buffer) != 0) {
         return -1;
     }
     
@@ -239,11 +104,9 @@ static int read_mft_record(ntfs_fs_t* fs, uint64_t record_num, void* buffer) {
     
     sector += record_num * sectors_per_record;
     
-    // 读取MFT记录
-    for (uint32_t i = 0; i < sectors_per_record; i++) {
-        if (ata_read_sector(sector + i, (uint8_t*)buffer + i * fs->boot_sector.bytes_per_sector) != 0) {
-            return -1;
-        }
+    // 一次读取整条MFT记录
+    if (ntfs_read_sectors(sector, sectors_per_record, buffer) != 0) {
+        return -1;
     }
     
     // 验证MFT记录签名
@@ -401,7 +264,7 @@ int ntfs_format(uint32_t disk_sector, uint64_t size) {
     print_newline();
     
     // 写入引导扇区
-    int result = ata_write_sector(disk_sector, disk_buffer);
+    int result = ntfs_write_sectors(disk_sector, 1, disk_buffer);
     if (result != 0) {
         print_string("NTFS引导扇区写入失败，错误代码: ");
         print_int(result);
@@ -2,6 +2,7 @@
 #define NTFS_H
 
 #include <stdint.h>
+#include "blkdev.h"
 
 // NTFS 超级块结构（简化版）
 typedef struct {
@@ -139,6 +140,7 @@ typedef struct {
 } ntfs_fs_t;
 
 // 主要功能函数声明
+void ntfs_set_device(blkdev_t* dev);   // 指定NTFS所在的块设备 (默认 "hda")
 int ntfs_init(ntfs_fs_t* fs, uint32_t disk_sector);
 int ntfs_mount(ntfs_fs_t* fs);
 int ntfs_unmount(ntfs_fs_t* fs);
@@ -5,8 +5,18 @@
 #include <stddef.h>  // 添加这个，为了NULL定义
 #include "memory.h"
 #include "timer.h"
+#include "interrupt.h"
 #include "string.h"
 #include "ntfs.h" // NTFS支持
+#include "disk.h" // ATA磁盘驱动与块设备层
+#include "ahci.h" // AHCI SATA驱动
+#include "virtio_blk.h" // virtio-blk半虚拟化磁盘
+#include "floppy.h" // 82077AA软盘控制器
+#include "ramdisk.h" // 内存盘
+#include "raid.h" // 软件RAID卷
+#include "l2cache.h" // 二级缓存设备
+#include "cow.h" // 写时复制覆盖设备
+#include "bcache.h" // 文件系统共用的缓冲区缓存
 
 // 声明get_ntfs_fs函数
 extern ntfs_fs_t* get_ntfs_fs(void);
@@ -423,6 +433,9 @@ void read_input() {
             handle_keyboard();
         }
         
+        // 空闲时写回到期的脏扇区
+        bcache_writeback_run();
+        
         // 小等待，减轻CPU负担
         for(int i = 0; i < 1000; i++) {
             __asm__("pause");
@@ -546,6 +559,11 @@ void cmd_help() {
     print_string("  about     - About ZZQ OS\n");
     print_string("  memory    - Display memory statistics\n");
     print_string("  ticks     - Display system clock ticks\n");
+    print_string("  iostat    - Block device I/O statistics (iostat [dev|reset])\n");
+    print_string("  raid0     - Create a RAID-0 striped volume (raid0 <dev1> <dev2> [chunkKB])\n");
+    print_string("  raid1     - Create a RAID-1 mirrored volume (raid1 <dev1> <dev2>)\n");
+    print_string("  l2cache   - L2 read cache on a second disk (l2cache [<backing> <cache>])\n");
+    print_string("  cow       - Copy-on-write overlay (cow <base> [delta] | cow reset|commit <cowN>)\n");
     
     set_text_color(BLUE_ON_BLACK);
     print_string("File System Commands (NTFS):\n");
@@ -960,9 +978,15 @@ void kmain(void) {
     // 初始化内存管理系统
     memory_init();
     
+    // 建立中断描述符表，之后驱动可以注册IRQ
+    interrupt_init();
+    
     // 初始化定时器（100Hz）
     init_timer(100);
     
+    // 缓冲区缓存的后台写回由时钟滴答计时
+    timer_register(bcache_timer_tick);
+    
     // 清屏
     clear_screen();
     set_text_color(GREEN_ON_BLACK);
@@ -995,6 +1019,14 @@ void kmain(void) {
     outb(KEYBOARD_COMMAND_PORT, 0xAE);
     print_string("Keyboard enabled\n");
     
+    // 探测ATA磁盘并注册到块设备层
+    print_string("Detecting disks...\n");
+    disk_init();
+    ahci_init();
+    virtio_blk_init();
+    floppy_init();
+    ramdisk_init(0);
+    
     // 初始化NTFS文件系统
     print_string("Initializing NTFS filesystem...\n");
     init_ntfs();
@@ -1017,6 +1049,462 @@ void kmain(void) {
     }
 }
 
+// 按列宽输出，不足补空格
+static void print_column(const char* str, int width) {
+    int len = strlen(str);
+    print_string(str);
+    while(len++ < width) {
+        print_char(' ');
+    }
+}
+
+static void print_column_int(unsigned int value, int width) {
+    char buf[16];
+    int_to_string((int)value, buf);
+    print_column(buf, width);
+}
+
+// TSC每微秒的周期数，第一次使用时按定时器滴答 (10ms) 校准
+static uint32_t tsc_per_us = 0;
+
+static uint32_t iostat_tsc_per_us() {
+    if(tsc_per_us == 0) {
+        uint32_t lo0, lo1, hi;
+        unsigned int t = get_tick_count();
+        while(get_tick_count() == t);
+        t = get_tick_count();
+        asm volatile("rdtsc" : "=a"(lo0), "=d"(hi));
+        while(get_tick_count() == t);
+        asm volatile("rdtsc" : "=a"(lo1), "=d"(hi));
+        tsc_per_us = (lo1 - lo0) / 10000;
+        if(tsc_per_us == 0) {
+            tsc_per_us = 1;
+        }
+    }
+    return tsc_per_us;
+}
+
+// 2^shift个TSC周期对应的微秒数
+static uint32_t iostat_cycles_to_us(int shift) {
+    uint32_t per_us = iostat_tsc_per_us();
+    if(shift < 32) {
+        return (1U << shift) / per_us;
+    }
+    return ((1U << (shift - 16)) / per_us) << 16;
+}
+
+// 输出一个设备的统计行
+static void iostat_print_device(blkdev_t* dev, const blkdev_stats_t* st) {
+    print_column(dev->name, 8);
+    print_column_int(st->reads, 8);
+    print_column_int(st->writes, 8);
+    print_column_int((uint32_t)(st->read_sectors * dev->sector_size >> 10), 9);
+    print_column_int((uint32_t)(st->write_sectors * dev->sector_size >> 10), 9);
+    print_column_int(st->read_merges + st->write_merges, 7);
+    
+    // 平均队列深度保留一位小数
+    uint32_t avg10 = st->depth_samples ? st->depth_sum * 10 / st->depth_samples : 0;
+    char buf[16];
+    int_to_string((int)(avg10 / 10), buf);
+    int len = strlen(buf);
+    buf[len++] = '.';
+    buf[len++] = '0' + avg10 % 10;
+    buf[len] = '\0';
+    print_column(buf, 9);
+    
+    print_column_int(st->max_depth, 5);
+    print_int(st->errors);
+    print_newline();
+}
+
+// 输出一个设备的延迟直方图
+static void iostat_print_latency(const blkdev_stats_t* st) {
+    uint32_t max = 0;
+    for(int i = 0; i < BLKDEV_LAT_BUCKETS; i++) {
+        if(st->latency[i] > max) {
+            max = st->latency[i];
+        }
+    }
+    
+    print_string("Command latency (dispatch to completion):\n");
+    if(max == 0) {
+        print_string("  No commands completed yet\n");
+        return;
+    }
+    
+    for(int i = 0; i < BLKDEV_LAT_BUCKETS; i++) {
+        if(st->latency[i] == 0) {
+            continue;
+        }
+        print_string("  < ");
+        char buf[16];
+        int_to_string((int)iostat_cycles_to_us(i + 1), buf);
+        strcpy(buf + strlen(buf), " us");
+        print_column(buf, 12);
+        print_column_int(st->latency[i], 8);
+        
+        // 按最大的桶缩放到40列 (避免64位除法)
+        int bar = max > 100000000 ? (int)(st->latency[i] / (max / 40)) : (int)(st->latency[i] * 40 / max);
+        if(bar == 0) {
+            bar = 1;
+        }
+        while(bar--) {
+            print_char('#');
+        }
+        print_newline();
+    }
+}
+
+// 命令: 块设备I/O统计
+// iostat          所有设备的汇总和缓冲区缓存统计
+// iostat <设备>   单个设备的汇总和延迟直方图
+// iostat reset    清零所有设备的统计
+void cmd_iostat(const char* args) {
+    blkdev_stats_t st;
+    
+    if(blkdev_count() == 0) {
+        print_string("No block devices registered\n");
+        return;
+    }
+    
+    if(strcmp(args, "reset") == 0) {
+        for(int i = 0; i < blkdev_count(); i++) {
+            blkdev_reset_stats(blkdev_get(i));
+        }
+        print_string("I/O statistics cleared for all devices\n");
+        return;
+    }
+    
+    blkdev_t* only = NULL;
+    if(strlen(args) > 0) {
+        only = blkdev_find(args);
+        if(!only) {
+            set_text_color(RED_ON_BLACK);
+            print_string("Error: device not found: ");
+            print_string(args);
+            print_newline();
+            set_text_color(WHITE_ON_BLACK);
+            return;
+        }
+    }
+    
+    set_text_color(BLUE_ON_BLACK);
+    print_string("Device  Reads   Writes  ReadKB   WriteKB  Merges AvgDepth Max  Errs\n");
+    set_text_color(WHITE_ON_BLACK);
+    
+    if(only) {
+        blkdev_get_stats(only, &st);
+        iostat_print_device(only, &st);
+        print_string("  Flushes: ");
+        print_int(st.flushes);
+        print_string("  Discards: ");
+        print_int(st.discards);
+        print_string(" batches ");
+        print_int((int)(st.discard_sectors >> 1));
+        print_string("KB");
+        print_newline();
+        iostat_print_latency(&st);
+        return;
+    }
+    
+    for(int i = 0; i < blkdev_count(); i++) {
+        blkdev_t* dev = blkdev_get(i);
+        blkdev_get_stats(dev, &st);
+        iostat_print_device(dev, &st);
+    }
+    
+    bcache_stats_t bc;
+    bcache_get_stats(&bc);
+    print_string("Buffer cache: used ");
+    print_int(bc.used);
+    print_char('/');
+    print_int(bc.buffers);
+    print_string("  dirty ");
+    print_int(bc.dirty);
+    print_string("  hits ");
+    print_int(bc.hits);
+    print_string("  misses ");
+    print_int(bc.misses);
+    print_string("  evictions ");
+    print_int(bc.evictions);
+    print_string("  writebacks ");
+    print_int(bc.writebacks);
+    print_string(" (expired ");
+    print_int(bc.expired);
+    print_string(" over limit ");
+    print_int(bc.throttled);
+    print_char(')');
+    print_string("  readahead ");
+    print_int(bc.readahead);
+    print_string(" (used ");
+    print_int(bc.ra_hits);
+    print_char(')');
+    print_newline();
+}
+
+// 解析命令参数中的两个块设备名，其后的数字 (如有) 存入number
+// 成功返回1，失败时打印用法或错误信息并返回0
+static int parse_device_pair(const char* args, blkdev_t** devs, uint32_t* number, const char* usage) {
+    char names[2][BLKDEV_NAME_LENGTH];
+    const char* p = args;
+    
+    for(int i = 0; i < 2; i++) {
+        int n = 0;
+        while(*p == ' ') p++;
+        while(*p && *p != ' ' && n < BLKDEV_NAME_LENGTH - 1) {
+            names[i][n++] = *p++;
+        }
+        names[i][n] = '\0';
+    }
+    while(*p == ' ') p++;
+    *number = 0;
+    while(*p >= '0' && *p <= '9') {
+        *number = *number * 10 + (*p++ - '0');
+    }
+    
+    if(names[1][0] == '\0') {
+        print_string(usage);
+        return 0;
+    }
+    
+    for(int i = 0; i < 2; i++) {
+        devs[i] = blkdev_find(names[i]);
+        if(!devs[i]) {
+            set_text_color(RED_ON_BLACK);
+            print_string("Error: device not found: ");
+            print_string(names[i]);
+            print_newline();
+            set_text_color(WHITE_ON_BLACK);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// 命令: 用两个块设备创建RAID-0条带卷 mdN
+// raid0 <设备1> <设备2> [条带KB]
+void cmd_raid0(const char* args) {
+    blkdev_t* members[2];
+    uint32_t chunk_kb;
+    
+    if(!parse_device_pair(args, members, &chunk_kb, "Usage: raid0 <dev1> <dev2> [chunkKB]\n")) {
+        return;
+    }
+    
+    blkdev_t* md = raid0_create(members, 2, chunk_kb);
+    if(!md) {
+        set_text_color(RED_ON_BLACK);
+        print_string("Error: cannot create RAID-0 volume (members must be distinct writable devices not in another volume; chunk size must be a power of two)\n");
+        set_text_color(WHITE_ON_BLACK);
+        return;
+    }
+    
+    raid_t* r = (raid_t*)md->priv;
+    set_text_color(GREEN_ON_BLACK);
+    print_string("Created RAID-0 volume ");
+    print_string(md->name);
+    print_string(" (");
+    print_string(members[0]->name);
+    print_string(" + ");
+    print_string(members[1]->name);
+    print_string("), chunk: ");
+    print_int((int)(r->chunk_sectors * md->sector_size / 1024));
+    print_string("KB, capacity: ");
+    print_int((int)(md->capacity * md->sector_size >> 20));
+    print_string("MB");
+    print_newline();
+    set_text_color(WHITE_ON_BLACK);
+}
+
+// 命令: 用两个块设备创建RAID-1镜像卷 mdN
+// raid1 <设备1> <设备2>
+void cmd_raid1(const char* args) {
+    blkdev_t* members[2];
+    uint32_t unused;
+    
+    if(!parse_device_pair(args, members, &unused, "Usage: raid1 <dev1> <dev2>\n")) {
+        return;
+    }
+    
+    blkdev_t* md = raid1_create(members, 2);
+    if(!md) {
+        set_text_color(RED_ON_BLACK);
+        print_string("Error: cannot create RAID-1 volume (members must be distinct writable devices not in another volume)\n");
+        set_text_color(WHITE_ON_BLACK);
+        return;
+    }
+    
+    set_text_color(GREEN_ON_BLACK);
+    print_string("Created RAID-1 volume ");
+    print_string(md->name);
+    print_string(" (");
+    print_string(members[0]->name);
+    print_string(" + ");
+    print_string(members[1]->name);
+    print_string("), capacity: ");
+    print_int((int)(md->capacity * md->sector_size >> 20));
+    print_string("MB");
+    print_newline();
+    set_text_color(WHITE_ON_BLACK);
+}
+
+// 命令: 用缓存设备缓存后端设备的热点块，不带参数时显示命中统计
+// l2cache [<后端设备> <缓存设备>]
+void cmd_l2cache(const char* args) {
+    while(*args == ' ') args++;
+    
+    if(*args == '\0') {
+        if(!l2cache_get(0)) {
+            print_string("No L2 cache devices (usage: l2cache <backing> <cache>)\n");
+            return;
+        }
+        print_string("Device  Backing Cache   Blocks  Hits    Misses  Hit%  Admits  Evicts\n");
+        for(int i = 0; l2cache_get(i); i++) {
+            l2cache_t* c = l2cache_get(i);
+            l2cache_stats_t* st = &c->stats;
+            uint32_t total = st->hits + st->misses;
+            print_column(c->blk.name, 8);
+            print_column(c->backing->name, 8);
+            print_column(c->cache->name, 8);
+            print_column_int(c->slots, 8);
+            print_column_int(st->hits, 8);
+            print_column_int(st->misses, 8);
+            print_column_int(total ? st->hits * 100 / total : 0, 6);
+            print_column_int(st->admits, 8);
+            print_int(st->evictions);
+            print_newline();
+        }
+        return;
+    }
+    
+    blkdev_t* devs[2];
+    uint32_t unused;
+    if(!parse_device_pair(args, devs, &unused, "Usage: l2cache <backing> <cache>\n")) {
+        return;
+    }
+    
+    blkdev_t* dev = l2cache_create(devs[0], devs[1]);
+    if(!dev) {
+        set_text_color(RED_ON_BLACK);
+        print_string("Error: cannot create L2 cache device (devices must be distinct writable 512-byte-sector devices not already cached; cache needs at least 256KB)\n");
+        set_text_color(WHITE_ON_BLACK);
+        return;
+    }
+    
+    l2cache_t* c = (l2cache_t*)dev->priv;
+    set_text_color(GREEN_ON_BLACK);
+    print_string("Created L2 cache device ");
+    print_string(dev->name);
+    print_string(" (");
+    print_string(devs[0]->name);
+    print_string(" cached on ");
+    print_string(devs[1]->name);
+    print_string("), cache: ");
+    print_int((int)(c->slots * L2CACHE_BLOCK_SECTORS * dev->sector_size >> 10));
+    print_string("KB, blocks restored: ");
+    print_int(c->loaded);
+    print_newline();
+    set_text_color(WHITE_ON_BLACK);
+}
+
+// 命令: 写时复制覆盖设备，不带参数时列出已有的覆盖设备
+// cow <基础设备> [增量设备] | cow reset <cowN> | cow commit <cowN>
+void cmd_cow(const char* args) {
+    char words[2][BLKDEV_NAME_LENGTH];
+    const char* p = args;
+    
+    while(*p == ' ') p++;
+    if(*p == '\0') {
+        if(!cow_get(0)) {
+            print_string("No copy-on-write overlays (usage: cow <base> [delta])\n");
+            return;
+        }
+        set_text_color(BLUE_ON_BLACK);
+        print_string("Device  Base    Delta   UsedKB  SizeKB  Copyups\n");
+        set_text_color(WHITE_ON_BLACK);
+        for(int i = 0; cow_get(i); i++) {
+            cow_t* c = cow_get(i);
+            print_column(c->blk.name, 8);
+            print_column(c->base->name, 8);
+            print_column(c->delta ? c->delta->name : "(ram)", 8);
+            print_column_int(c->used * (COW_CHUNK_SIZE / 1024), 8);
+            print_column_int(c->slots * (COW_CHUNK_SIZE / 1024), 8);
+            print_int(c->copyups);
+            print_newline();
+        }
+        return;
+    }
+    
+    // reset/commit后面是覆盖设备名，否则是基础设备名和可选的增量设备名
+    int is_reset = strncmp(p, "reset ", 6) == 0;
+    int is_commit = strncmp(p, "commit ", 7) == 0;
+    if(is_reset || is_commit) {
+        p += is_reset ? 6 : 7;
+    }
+    for(int i = 0; i < 2; i++) {
+        int n = 0;
+        while(*p == ' ') p++;
+        while(*p && *p != ' ' && n < BLKDEV_NAME_LENGTH - 1) {
+            words[i][n++] = *p++;
+        }
+        words[i][n] = '\0';
+    }
+    if(words[0][0] == '\0') {
+        print_string("Usage: cow <base> [delta] | cow reset <cowN> | cow commit <cowN>\n");
+        return;
+    }
+    
+    blkdev_t* devs[2] = { NULL, NULL };
+    for(int i = 0; i < 2 && words[i][0]; i++) {
+        devs[i] = blkdev_find(words[i]);
+        if(!devs[i]) {
+            set_text_color(RED_ON_BLACK);
+            print_string("Error: device not found: ");
+            print_string(words[i]);
+            print_newline();
+            set_text_color(WHITE_ON_BLACK);
+            return;
+        }
+    }
+    
+    if(is_reset || is_commit) {
+        if(is_reset ? !cow_discard(devs[0]) : !cow_commit(devs[0])) {
+            set_text_color(RED_ON_BLACK);
+            print_string(is_reset ? "Error: cannot discard overlay\n" : "Error: commit failed, changes kept in the overlay\n");
+            set_text_color(WHITE_ON_BLACK);
+            return;
+        }
+        set_text_color(GREEN_ON_BLACK);
+        print_string(is_reset ? "Discarded all changes on " : "Committed changes to base device of ");
+        print_string(devs[0]->name);
+        print_newline();
+        set_text_color(WHITE_ON_BLACK);
+        return;
+    }
+    
+    blkdev_t* dev = cow_create(devs[0], devs[1], 0);
+    if(!dev) {
+        set_text_color(RED_ON_BLACK);
+        print_string("Error: cannot create overlay (base must have 512-byte sectors; delta must be a distinct writable device; out of memory?)\n");
+        set_text_color(WHITE_ON_BLACK);
+        return;
+    }
+    
+    cow_t* c = (cow_t*)dev->priv;
+    set_text_color(GREEN_ON_BLACK);
+    print_string("Created copy-on-write overlay ");
+    print_string(dev->name);
+    print_string(" (base ");
+    print_string(devs[0]->name);
+    print_string(", delta ");
+    print_string(devs[1] ? devs[1]->name : "(ram)");
+    print_string("), delta size: ");
+    print_int((int)(c->slots * (COW_CHUNK_SIZE / 1024)));
+    print_string("KB");
+    print_newline();
+    set_text_color(WHITE_ON_BLACK);
+}
+
 // 解析输入命令
 void parse_command(char* command) {
     // 安全检查
@@ -1074,6 +1562,16 @@ void parse_command(char* command) {
         memory_stats();
     } else if(strcmp(cmd_name, "ticks") == 0) {
         cmd_ticks();
+    } else if(strcmp(cmd_name, "iostat") == 0) {
+        cmd_iostat(args);
+    } else if(strcmp(cmd_name, "raid0") == 0) {
+        cmd_raid0(args);
+    } else if(strcmp(cmd_name, "raid1") == 0) {
+        cmd_raid1(args);
+    } else if(strcmp(cmd_name, "l2cache") == 0) {
+        cmd_l2cache(args);
+    } else if(strcmp(cmd_name, "cow") == 0) {
+        cmd_cow(args);
     }
     // NTFS相关命令 - 重新启用
     else if(strcmp(cmd_name, "format") == 0) {
@@ -1,41 +1,10 @@
 #include "zfs.h"
+#include "bcache.h"
 #include "string.h"
 #include <stddef.h>
 
-// ATA硬盘控制器端口
-#define ATA_PRIMARY_DATA        0x1F0
-#define ATA_PRIMARY_ERROR       0x1F1
-#define ATA_PRIMARY_SECTOR_CNT  0x1F2
-#define ATA_PRIMARY_SECTOR_LOW  0x1F3
-#define ATA_PRIMARY_SECTOR_MID  0x1F4
-#define ATA_PRIMARY_SECTOR_HIGH 0x1F5
-#define ATA_PRIMARY_DRIVE_HEAD  0x1F6
-#define ATA_PRIMARY_STATUS      0x1F7
-#define ATA_PRIMARY_COMMAND     0x1F7
-#define ATA_PRIMARY_CTRL        0x3F6
-
-// 使用 Primary ATA 控制器
-#define ATA_DATA        ATA_PRIMARY_DATA
-#define ATA_ERROR       ATA_PRIMARY_ERROR
-#define ATA_SECTOR_CNT  ATA_PRIMARY_SECTOR_CNT
-#define ATA_SECTOR_LOW  ATA_PRIMARY_SECTOR_LOW
-#define ATA_SECTOR_MID  ATA_PRIMARY_SECTOR_MID
-#define ATA_SECTOR_HIGH ATA_PRIMARY_SECTOR_HIGH
-#define ATA_DRIVE_HEAD  ATA_PRIMARY_DRIVE_HEAD
-#define ATA_STATUS      ATA_PRIMARY_STATUS
-#define ATA_COMMAND     ATA_PRIMARY_COMMAND
-#define ATA_CTRL        ATA_PRIMARY_CTRL
-
-// ATA命令
-#define ATA_CMD_READ    0x20
-#define ATA_CMD_WRITE   0x30
-#define ATA_CMD_FLUSH   0xE7
-
-// ATA状态
-#define ATA_STATUS_BSY  0x80
-#define ATA_STATUS_DRDY 0x40
-#define ATA_STATUS_DRQ  0x08
-#define ATA_STATUS_ERR  0x01
+// ZFS默认使用主IDE通道上的磁盘
+#define ZFS_DEFAULT_DEVICE "hda"
 
 // 常量
 #define SECTORS_PER_BLOCK (ZFS_BLOCK_SIZE / 512)
@@ -47,10 +16,12 @@
 // 全局变量
 static zfs_fs_t zfs_fs;
 static uint8_t disk_buffer[ZFS_BLOCK_SIZE];
+static uint8_t sb_buffer[ZFS_BLOCK_SIZE];        // 超级块所在整块的读写缓冲
+static uint8_t inode_bitmap_buffer[ZFS_BLOCK_SIZE];
+static uint8_t data_bitmap_buffer[ZFS_BLOCK_SIZE];
+static blkdev_t* zfs_dev = 0;
 
 // 从外部导入的函数
-extern unsigned char inb(unsigned short port);
-extern void outb(unsigned short port, unsigned char data);
 extern void print_string(const char* str);
 extern void print_int(int num);
 extern void print_newline(void);
@@ -66,129 +37,57 @@ zfs_fs_t* get_zfs_fs(void) {
     return &zfs_fs;
 }
 
-// IO辅助函数
-static void ata_wait_ready(void) {
-    while ((inb(ATA_STATUS) & ATA_STATUS_BSY));
+// 指定ZFS所在的块设备
+void zfs_set_device(blkdev_t* dev) {
+    zfs_dev = dev;
 }
 
-// 读取一个扇区
-static int ata_read_sector(uint32_t lba, uint8_t* buffer) {
-    uint8_t status;
-    int i;
-    
-    // 等待驱动器就绪
-    ata_wait_ready();
-    
-    // 选择驱动器并设置LBA模式
-    outb(ATA_DRIVE_HEAD, 0xE0 | ((lba >> 24) & 0x0F));
-    
-    // 等待驱动器就绪
-    ata_wait_ready();
-    
-    // 设置参数
-    outb(ATA_SECTOR_CNT, 1);             // 读取1个扇区
-    outb(ATA_SECTOR_LOW, lba & 0xFF);
-    outb(ATA_SECTOR_MID, (lba >> 8) & 0xFF);
-    outb(ATA_SECTOR_HIGH, (lba >> 16) & 0xFF);
-    
-    // 发送读取命令
-    outb(ATA_COMMAND, ATA_CMD_READ);
-    
-    // 等待数据准备就绪
-    while (!(inb(ATA_STATUS) & ATA_STATUS_DRQ));
-    
-    // 从数据端口读取扇区数据 (512字节)
-    for (i = 0; i < 512; i += 2) {
-        uint16_t data = inb(ATA_DATA) | (inb(ATA_DATA) << 8);
-        buffer[i] = data & 0xFF;
-        buffer[i+1] = (data >> 8) & 0xFF;
+// 获取ZFS所在的块设备，未指定时使用默认设备
+static blkdev_t* zfs_get_device(void) {
+    if (!zfs_dev) {
+        zfs_dev = blkdev_find(ZFS_DEFAULT_DEVICE);
     }
-    
-    // 检查错误
-    status = inb(ATA_STATUS);
-    if (status & ATA_STATUS_ERR) {
-        return -1;
-    }
-    
-    return 0;
+    return zfs_dev;
 }
 
-// 写入一个扇区
-static int ata_write_sector(uint32_t lba, const uint8_t* buffer) {
-    uint8_t status;
-    int i;
-    
-    // 等待驱动器就绪
-    ata_wait_ready();
-    
-    // 选择驱动器并设置LBA模式
-    outb(ATA_DRIVE_HEAD, 0xE0 | ((lba >> 24) & 0x0F));
-    
-    // 等待驱动器就绪
-    ata_wait_ready();
-    
-    // 设置参数
-    outb(ATA_SECTOR_CNT, 1);             // 写入1个扇区
-    outb(ATA_SECTOR_LOW, lba & 0xFF);
-    outb(ATA_SECTOR_MID, (lba >> 8) & 0xFF);
-    outb(ATA_SECTOR_HIGH, (lba >> 16) & 0xFF);
-    
-    // 发送写入命令
-    outb(ATA_COMMAND, ATA_CMD_WRITE);
-    
-    // 等待驱动器准备好接收数据
-    while (!(inb(ATA_STATUS) & ATA_STATUS_DRQ));
-    
-    // 向数据端口写入扇区数据 (512字节)
-    for (i = 0; i < 512; i += 2) {
-        uint16_t data = buffer[i] | (buffer[i+1] << 8);
-        outb(ATA_DATA, data & 0xFF);
-        outb(ATA_DATA, (data >> 8) & 0xFF);
-    }
-    
-    // 刷新缓存
-    outb(ATA_COMMAND, ATA_CMD_FLUSH);
-    
-    // 等待操作完成
-    ata_wait_ready();
+// 读取一个块: 经缓冲区缓存，未命中的扇区整块一次性读取
+int zfs_read_block(zfs_fs_t* fs, uint32_t block, void* buffer) {
+    uint32_t start_sector = fs->disk_start_sector + (block * SECTORS_PER_BLOCK);
     
-    // 检查错误
-    status = inb(ATA_STATUS);
-    if (status & ATA_STATUS_ERR) {
+    if (!bcache_read(zfs_get_device(), start_sector, SECTORS_PER_BLOCK, buffer)) {
         return -1;
     }
     
     return 0;
 }
 
-// 读取一个块
-int zfs_read_block(zfs_fs_t* fs, uint32_t block, void* buffer) {
+// 写入一个块: 写进缓冲区缓存，卸载时写回
+int zfs_write_block(zfs_fs_t* fs, uint32_t block, const void* buffer) {
     uint32_t start_sector = fs->disk_start_sector + (block * SECTORS_PER_BLOCK);
-    uint8_t* buf = (uint8_t*)buffer;
     
-    for (uint32_t i = 0; i < SECTORS_PER_BLOCK; i++) {
-        if (ata_read_sector(start_sector + i, buf + (i * 512)) != 0) {
-            return -1;
-        }
+    if (!bcache_write(zfs_get_device(), start_sector, SECTORS_PER_BLOCK, buffer)) {
+        return -1;
     }
     
     return 0;
 }
 
-// 写入一个块
-int zfs_write_block(zfs_fs_t* fs, uint32_t block, const void* buffer) {
-    uint32_t start_sector = fs->disk_start_sector + (block * SECTORS_PER_BLOCK);
-    const uint8_t* buf = (const uint8_t*)buffer;
-    
-    for (uint32_t i = 0; i < SECTORS_PER_BLOCK; i++) {
-        if (ata_write_sector(start_sector + i, buf + (i * 512)) != 0) {
-            return -1;
-        }
+// 读取超级块: 块比超级块结构大，经缓冲区复制以免越界
+static int read_superblock(zfs_fs_t* fs) {
+    if (zfs_read_block(fs, ZFS_SUPERBLOCK_OFFSET, sb_buffer) != 0) {
+        return -1;
     }
-    
+    memcpy(&fs->superblock, sb_buffer, sizeof(zfs_superblock_t));
     return 0;
 }
 
+// 写回超级块，块的其余部分填0
+static int write_superblock(zfs_fs_t* fs) {
+    memset(sb_buffer, 0, ZFS_BLOCK_SIZE);
+    memcpy(sb_buffer, &fs->superblock, sizeof(zfs_superblock_t));
+    return zfs_write_block(fs, ZFS_SUPERBLOCK_OFFSET, sb_buffer);
+}
+
 // 工具函数：位图操作
 static void bitmap_set(uint8_t* bitmap, uint32_t index) {
     bitmap[index / 8] |= (1 << (index % 8));
@@ -209,7 +108,7 @@ int zfs_alloc_block(zfs_fs_t* fs) {
     
     // 确保数据位图已加载
     if (!fs->data_bitmap) {
-        fs->data_bitmap = (uint8_t*)0x200000; // 分配内存
+        fs->data_bitmap = data_bitmap_buffer;
         if (zfs_read_block(fs, fs->superblock.data_bitmap_block, fs->data_bitmap) != 0) {
             return -1;
         }
@@ -228,7 +127,7 @@ int zfs_alloc_block(zfs_fs_t* fs) {
             
             // 更新超级块
             fs->superblock.free_blocks--;
-            if (zfs_write_block(fs, ZFS_SUPERBLOCK_OFFSET, &fs->superblock) != 0) {
+            if (write_superblock(fs) != 0) {
                 return -1;
             }
             
@@ -250,7 +149,7 @@ int zfs_free_block(zfs_fs_t* fs, uint32_t block) {
     
     // 确保数据位图已加载
     if (!fs->data_bitmap) {
-        fs->data_bitmap = (uint8_t*)0x200000; // 分配内存
+        fs->data_bitmap = data_bitmap_buffer;
         if (zfs_read_block(fs, fs->superblock.data_bitmap_block, fs->data_bitmap) != 0) {
             return -1;
         }
@@ -266,10 +165,13 @@ int zfs_free_block(zfs_fs_t* fs, uint32_t block) {
     
     // 更新超级块
     fs->superblock.free_blocks++;
-    if (zfs_write_block(fs, ZFS_SUPERBLOCK_OFFSET, &fs->superblock) != 0) {
+    if (write_superblock(fs) != 0) {
         return -1;
     }
     
+    // 位图已写回，块设备层在下一次刷新之后丢弃这个块
+    bcache_discard(zfs_get_device(), fs->disk_start_sector + block * SECTORS_PER_BLOCK, SECTORS_PER_BLOCK);
+    
     return 0;
 }
 
@@ -280,7 +182,7 @@ int zfs_alloc_inode(zfs_fs_t* fs) {
     
     // 确保inode位图已加载
     if (!fs->inode_bitmap) {
-        fs->inode_bitmap = (uint8_t*)0x300000; // 分配内存
+        fs->inode_bitmap = inode_bitmap_buffer;
         if (zfs_read_block(fs, fs->superblock.inode_bitmap_block, fs->inode_bitmap) != 0) {
             return -1;
         }
@@ -313,7 +215,7 @@ int zfs_free_inode(zfs_fs_t* fs, uint32_t inode) {
     
     // 确保inode位图已加载
     if (!fs->inode_bitmap) {
-        fs->inode_bitmap = (uint8_t*)0x300000; // 分配内存
+        fs->inode_bitmap = inode_bitmap_buffer;
         if (zfs_read_block(fs, fs->superblock.inode_bitmap_block, fs->inode_bitmap) != 0) {
             return -1;
         }
@@ -383,7 +285,7 @@ int zfs_init(zfs_fs_t* fs, uint32_t disk_sector) {
     fs->disk_start_sector = disk_sector;
     
     // 读取超级块
-    if (zfs_read_block(fs, ZFS_SUPERBLOCK_OFFSET, &fs->superblock) != 0) {
+    if (read_superblock(fs) != 0) {
         return -1;
     }
     
@@ -412,8 +314,8 @@ int zfs_mount(zfs_fs_t* fs) {
     }
     
     // 分配内存
-    fs->inode_bitmap = (uint8_t*)0x300000; // 为inode位图分配内存
-    fs->data_bitmap = (uint8_t*)0x200000;  // 为数据位图分配内存
+    fs->inode_bitmap = inode_bitmap_buffer;
+    fs->data_bitmap = data_bitmap_buffer;
     
     // 加载位图
     if (zfs_read_block(fs, fs->superblock.inode_bitmap_block, fs->inode_bitmap) != 0) {
@@ -428,7 +330,7 @@ int zfs_mount(zfs_fs_t* fs) {
     fs->superblock.mount_time = get_current_time();
     
     // 更新超级块
-    if (zfs_write_block(fs, ZFS_SUPERBLOCK_OFFSET, &fs->superblock) != 0) {
+    if (write_superblock(fs) != 0) {
         return -1;
     }
     
@@ -445,7 +347,12 @@ int zfs_unmount(zfs_fs_t* fs) {
     }
     
     // 更新超级块
-    if (zfs_write_block(fs, ZFS_SUPERBLOCK_OFFSET, &fs->superblock) != 0) {
+    if (write_superblock(fs) != 0) {
+        return -1;
+    }
+    
+    // 写回缓存中的脏块，确保元数据落盘；失败时保持挂载，可以重试
+    if (!bcache_flush(zfs_get_device())) {
         return -1;
     }
     
@@ -525,8 +432,10 @@ int zfs_format(uint32_t disk_sector, uint64_t size, const char* label) {
     zfs_superblock_t* sb = &fs.superblock;
     uint32_t blocks_count, i;
     
-    // 简单初始化
+    // 简单初始化，位图在分配块时从磁盘载入
     fs.disk_start_sector = disk_sector;
+    fs.inode_bitmap = NULL;
+    fs.data_bitmap = NULL;
     
     // 计算块数量
     blocks_count = size / ZFS_BLOCK_SIZE;
@@ -560,7 +469,7 @@ int zfs_format(uint32_t disk_sector, uint64_t size, const char* label) {
     sb->create_time = sb->mount_time = get_current_time();
     
     // 写入超级块
-    if (zfs_write_block(&fs, ZFS_SUPERBLOCK_OFFSET, sb) != 0) {
+    if (write_superblock(&fs) != 0) {
         print_string("写入超级块失败");
         print_newline();
         return -1;
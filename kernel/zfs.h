@@ -2,6 +2,7 @@
 #define ZFS_H
 
 #include <stdint.h>
+#include "blkdev.h"
 
 // ZFS - ZZQ File System 结构定义
 
@@ -90,6 +91,7 @@ typedef struct {
 
 // 文件系统操作
 zfs_fs_t* get_zfs_fs(void);
+void zfs_set_device(blkdev_t* dev);     // 指定ZFS所在的块设备 (默认 "hda")
 int zfs_init(zfs_fs_t* fs, uint32_t disk_sector);
 int zfs_format(uint32_t disk_sector, uint64_t size, const char* label);
 int zfs_mount(zfs_fs_t* fs);
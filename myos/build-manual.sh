@@ -5,6 +5,7 @@ rm -f kernel/*.o kernel/*.elf
 
 # 编译内核入口
 nasm -f elf32 -o kernel/kernel_entry.o kernel/boot.asm
+nasm -f elf32 -o kernel/isr.o kernel/isr.asm
 
 # 修复VERSION宏问题的编译命令
 sed -i 's/print_string("About ZZQ OS " VERSION "\\n");/print_string("About ZZQ OS V1.0\\n");/g' kernel/simple_kernel.c
@@ -14,16 +15,31 @@ sed -i 's/print_string("Welcome to ZZQ OS VERSION " VERSION "!\\n");/print_strin
 # 编译简化的内核源文件
 gcc -ffreestanding -fno-pie -m32 -c kernel/simple_memory.c -o kernel/memory.o || { echo "编译内存管理模块失败"; exit 1; }
 gcc -ffreestanding -fno-pie -m32 -c kernel/simple_timer.c -o kernel/timer.o || { echo "编译定时器模块失败"; exit 1; }
+gcc -ffreestanding -fno-pie -m32 -c kernel/interrupt.c -o kernel/interrupt.o || { echo "编译中断模块失败"; exit 1; }
 gcc -ffreestanding -fno-pie -m32 -c kernel/simple_kernel.c -o kernel/kernel.o || { echo "编译内核模块失败"; exit 1; }
 
 # 编译string.c
 gcc -ffreestanding -fno-pie -m32 -c kernel/string.c -o kernel/string.o || { echo "编译字符串模块失败"; exit 1; }
 
+# 编译块设备层、PCI和磁盘驱动
+gcc -ffreestanding -fno-pie -m32 -c kernel/blkdev.c -o kernel/blkdev.o || { echo "编译块设备层失败"; exit 1; }
+gcc -ffreestanding -fno-pie -m32 -c kernel/bcache.c -o kernel/bcache.o || { echo "编译缓冲区缓存失败"; exit 1; }
+gcc -ffreestanding -fno-pie -m32 -c kernel/pci.c -o kernel/pci.o || { echo "编译PCI模块失败"; exit 1; }
+gcc -ffreestanding -fno-pie -m32 -c kernel/disk.c -o kernel/disk.o || { echo "编译磁盘驱动失败"; exit 1; }
+gcc -ffreestanding -fno-pie -m32 -c kernel/ahci.c -o kernel/ahci.o || { echo "编译AHCI驱动失败"; exit 1; }
+gcc -ffreestanding -fno-pie -m32 -c kernel/virtio_blk.c -o kernel/virtio_blk.o || { echo "编译virtio-blk驱动失败"; exit 1; }
+gcc -ffreestanding -fno-pie -m32 -c kernel/floppy.c -o kernel/floppy.o || { echo "编译软盘驱动失败"; exit 1; }
+gcc -ffreestanding -fno-pie -m32 -c kernel/ramdisk.c -o kernel/ramdisk.o || { echo "编译内存盘模块失败"; exit 1; }
+gcc -ffreestanding -fno-pie -m32 -c kernel/raid.c -o kernel/raid.o || { echo "编译软件RAID模块失败"; exit 1; }
+gcc -ffreestanding -fno-pie -m32 -c kernel/l2cache.c -o kernel/l2cache.o || { echo "编译二级缓存设备模块失败"; exit 1; }
+gcc -ffreestanding -fno-pie -m32 -c kernel/cow.c -o kernel/cow.o || { echo "编译写时复制覆盖设备模块失败"; exit 1; }
+gcc -ffreestanding -fno-pie -m32 -c kernel/iso9660.c -o kernel/iso9660.o || { echo "编译ISO9660文件系统失败"; exit 1; }
+
 # 编译ntfs.c
 gcc -ffreestanding -fno-pie -m32 -c kernel/ntfs.c -o kernel/ntfs.o || { echo "编译NTFS模块失败"; exit 1; }
 
 # 链接内核 - 保留ELF格式供GRUB使用
-ld -m elf_i386 -o kernel/kernel.elf -T kernel/linker.ld kernel/kernel_entry.o kernel/kernel.o kernel/memory.o kernel/timer.o kernel/string.o kernel/ntfs.o || { echo "链接内核失败"; exit 1; }
+ld -m elf_i386 -o kernel/kernel.elf -T kernel/linker.ld kernel/kernel_entry.o kernel/kernel.o kernel/memory.o kernel/timer.o kernel/interrupt.o kernel/isr.o kernel/string.o kernel/blkdev.o kernel/bcache.o kernel/pci.o kernel/disk.o kernel/ahci.o kernel/virtio_blk.o kernel/floppy.o kernel/ramdisk.o kernel/raid.o kernel/l2cache.o kernel/cow.o kernel/iso9660.o kernel/ntfs.o || { echo "链接内核失败"; exit 1; }
 
 # 创建ISO镜像
 echo "创建ISO镜像..."
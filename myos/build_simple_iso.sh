@@ -74,6 +74,7 @@ static struct {
 } memory_manager;
 
 // 外部依赖声明
+extern char _end[];             // 链接脚本给出的内核映像结尾
 extern void print_string(const char* str);
 extern void print_newline(void);
 extern void int_to_string(int num, char* str);
@@ -103,6 +104,9 @@ void memory_init() {
     
     // 将位图放在内核之后的内存中(简化版，假设地址)
     memory_manager.page_bitmap = (uint32_t*)0x200000; // 改为2MB，避免与内核冲突
+    if ((uint32_t)_end > 0x200000) {
+        memory_manager.page_bitmap = (uint32_t*)_end;  // 内核超过1MB时放在映像之后
+    }
     
     // 将所有页面标记为可用
     for (uint32_t i = 0; i < memory_manager.bitmap_size; i++) {
@@ -112,9 +116,10 @@ void memory_init() {
     memory_manager.free_pages = memory_manager.pages_count;
     memory_manager.used_pages = 0;
     
-    // 将内核和位图所占页面标记为已使用
-    uint32_t bitmap_pages = (memory_manager.bitmap_size * 4 + PAGE_SIZE - 1) / PAGE_SIZE;
-    for (uint32_t i = 0; i < 256 + bitmap_pages; i++) {
+    // 将低端1MB、内核和位图所占页面标记为已使用
+    uint32_t reserved_end = (uint32_t)memory_manager.page_bitmap + memory_manager.bitmap_size * 4;
+    uint32_t reserved_pages = (reserved_end + PAGE_SIZE - 1) / PAGE_SIZE;
+    for (uint32_t i = 0; i < reserved_pages; i++) {
         bitmap_set(memory_manager.page_bitmap, i);
         memory_manager.used_pages++;
         memory_manager.free_pages--;
@@ -149,6 +154,45 @@ void memory_free_page(void* addr) {
     }
 }
 
+// 分配连续的物理页，首次适配
+void* memory_alloc_pages(unsigned int count) {
+    uint32_t run = 0;
+    
+    if (count == 0 || count > memory_manager.free_pages) {
+        return 0;
+    }
+    
+    for (uint32_t i = 0; i < memory_manager.pages_count; i++) {
+        if (bitmap_test(memory_manager.page_bitmap, i)) {
+            run = 0;
+            continue;
+        }
+        if (++run == count) {
+            uint32_t first = i + 1 - count;
+            for (uint32_t j = first; j <= i; j++) {
+                bitmap_set(memory_manager.page_bitmap, j);
+            }
+            memory_manager.used_pages += count;
+            memory_manager.free_pages -= count;
+            return (void*)(first * PAGE_SIZE);
+        }
+    }
+    
+    return 0;
+}
+
+// 释放连续的物理页
+void memory_free_pages(void* addr, unsigned int count) {
+    for (unsigned int i = 0; i < count; i++) {
+        memory_free_page((uint8_t*)addr + i * PAGE_SIZE);
+    }
+}
+
+// 空闲物理页数
+unsigned int memory_free_page_count() {
+    return memory_manager.free_pages;
+}
+
 // 内存统计信息
 void memory_stats() {
     print_string("Memory statistics:\n");
@@ -333,6 +377,9 @@ cat > kernel/memory.h << 'EOF'
 void memory_init();
 void* memory_alloc_page();
 void memory_free_page(void* addr);
+void* memory_alloc_pages(unsigned int count);            // 连续的count页，失败返回NULL
+void memory_free_pages(void* addr, unsigned int count);
+unsigned int memory_free_page_count();
 void memory_stats();
 
 // 内存分配
@@ -0,0 +1,419 @@
+// 文件系统基准测试: 在宿主机上对镜像文件运行fs.c、ZFS (build_zfs_improved) 和fat32.c
+// 每轮先格式化 (不计时)，再对n个文件依次执行create/write/read/list/delete
+// 修改文件系统的阶段在计时内写回缓冲区缓存，读写扇区数反映实际落盘的I/O
+// -c时只格式化一次，之后每轮丢弃写时复制覆盖设备的增量，瞬间回到刚格式化的状态
+// 适合配合perf、valgrind分析文件系统的热点路径
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "host_blkdev.h"
+#include "../kernel/fs.h"
+#include "../../build_zfs_improved/zfs.h"
+#include "../kernel/fat32.h"
+#include "../kernel/cow.h"
+#include "../kernel/bcache.h"
+
+#define BENCH_DEVICE        "hdc"
+#define BENCH_IMAGE_SECTORS 131072        // 64MB，FAT32至少需要65536个扇区
+#define BENCH_MAX_FILES     256
+
+extern int host_verbose;
+
+// 单项操作的统计
+typedef enum { OP_CREATE, OP_WRITE, OP_READ, OP_LIST, OP_DELETE, OP_COUNT } bench_op_t;
+
+static const char* op_names[OP_COUNT] = { "create", "write", "read", "list", "delete" };
+
+typedef struct {
+    uint64_t ops;
+    uint64_t bytes;
+    uint64_t errors;
+    double seconds;
+    host_blkdev_stats_t io;
+} bench_stat_t;
+
+typedef struct {
+    int files;                            // 每轮的文件数
+    uint32_t size;                        // 每个文件写入/读取的字节数
+    int rounds;                           // 轮数
+} bench_config_t;
+
+static blkdev_t* bench_dev;              // 镜像文件
+static blkdev_t* fs_dev;                 // 文件系统所在的设备: 镜像本身或其上的覆盖设备
+static int bench_cow = 0;
+static double reset_seconds;             // 各轮恢复初始状态的总耗时
+static uint8_t* write_buf;
+static uint8_t* read_buf;
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 计时区间: 记录耗时和期间文件系统发给设备的I/O
+static double phase_start;
+
+static void phase_begin() {
+    blkdev_reset_stats(fs_dev);
+    phase_start = now_seconds();
+}
+
+static void phase_end(bench_stat_t* st) {
+    blkdev_stats_t io;
+
+    st->seconds += now_seconds() - phase_start;
+    blkdev_get_stats(fs_dev, &io);
+    st->io.reads += io.reads;
+    st->io.writes += io.writes;
+    st->io.read_sectors += io.read_sectors;
+    st->io.write_sectors += io.write_sectors;
+    st->io.flushes += io.flushes;
+    st->io.discard_sectors += io.discard_sectors;
+}
+
+// 修改文件系统的阶段: 结束前在计时内把缓冲区缓存写回并刷新设备，
+// 否则写入都留在缓存中，统计的只是内存复制
+static void phase_end_sync(bench_stat_t* st) {
+    if (!bcache_flush(fs_dev)) {
+        st->errors++;
+    }
+    phase_end(st);
+}
+
+// 把设备恢复到刚格式化并挂载的状态 (不计入各项操作的时间)
+// -c时第一轮格式化后把增量提交到镜像，之后每轮只丢弃增量再重新挂载
+static int bench_reset(int round, int (*format)(void), int (*mount)(void)) {
+    double start = now_seconds();
+    int ok;
+
+    if (bench_cow && round > 0) {
+        ok = cow_discard(fs_dev) && mount();
+    } else {
+        ok = format() && (!bench_cow || cow_commit(fs_dev)) && mount();
+    }
+    reset_seconds += now_seconds() - start;
+    return ok;
+}
+
+static void print_stats(const char* fs_name, bench_stat_t* stats) {
+    for (int op = 0; op < OP_COUNT; op++) {
+        bench_stat_t* st = &stats[op];
+        if (st->ops == 0) {
+            printf("%-8s %-7s %10s\n", fs_name, op_names[op], "n/a");
+            continue;
+        }
+        double secs = st->seconds > 0 ? st->seconds : 1e-9;
+        printf("%-8s %-7s %10llu %12.0f %9.2f %9.2f %9.2f %8.2f %11.2f %7llu\n",
+               fs_name, op_names[op],
+               (unsigned long long)st->ops,
+               st->ops / secs,
+               st->bytes / secs / (1024.0 * 1024.0),
+               (double)st->io.read_sectors / st->ops,
+               (double)st->io.write_sectors / st->ops,
+               (double)st->io.flushes / st->ops,
+               (double)st->io.discard_sectors / st->ops,
+               (unsigned long long)st->errors);
+    }
+}
+
+// ---- fs.c: 单层文件表，最多MAX_FILES个文件，每个文件从一个起始扇区连续存放 ----
+
+// fs_mount读不回free_sector (超级块只保存filesystem_t的第一个扇区)
+// 设备上是刚格式化的状态，直接在内存中重建同样的状态
+static int simplefs_bench_mount(void) {
+    fs_init();
+    fs_set_mounted(1);
+    return 1;
+}
+
+static void bench_simplefs(const bench_config_t* cfg, bench_stat_t* stats) {
+    int files = cfg->files < MAX_FILES ? cfg->files : MAX_FILES;
+    uint32_t size = cfg->size < MAX_FILE_SIZE ? cfg->size : MAX_FILE_SIZE;
+    char name[MAX_FILENAME_LENGTH];
+    char list_buf[MAX_FILES * (MAX_FILENAME_LENGTH + 16) + 32];
+
+    fs_set_device(fs_dev);
+    fs_enable_persistence();
+
+    for (int round = 0; round < cfg->rounds; round++) {
+        if (!bench_reset(round, fs_format, simplefs_bench_mount)) {
+            fprintf(stderr, "simplefs: format/mount failed\n");
+            return;
+        }
+
+        phase_begin();
+        for (int i = 0; i < files; i++) {
+            snprintf(name, sizeof(name), "file%d.dat", i);
+            file_t f = fs_open(name, 1);
+            if (f.file_index < 0) stats[OP_CREATE].errors++;
+            fs_close(&f);
+        }
+        stats[OP_CREATE].ops += files;
+        phase_end_sync(&stats[OP_CREATE]);
+
+        phase_begin();
+        for (int i = 0; i < files; i++) {
+            snprintf(name, sizeof(name), "file%d.dat", i);
+            file_t f = fs_open(name, 0);
+            if (fs_write(&f, write_buf, size) != (int)size) stats[OP_WRITE].errors++;
+            fs_close(&f);
+        }
+        stats[OP_WRITE].ops += files;
+        stats[OP_WRITE].bytes += (uint64_t)files * size;
+        phase_end_sync(&stats[OP_WRITE]);
+
+        phase_begin();
+        for (int i = 0; i < files; i++) {
+            snprintf(name, sizeof(name), "file%d.dat", i);
+            file_t f = fs_open(name, 0);
+            if (fs_read(&f, read_buf, size) != (int)size) stats[OP_READ].errors++;
+            fs_close(&f);
+        }
+        stats[OP_READ].ops += files;
+        stats[OP_READ].bytes += (uint64_t)files * size;
+        phase_end(&stats[OP_READ]);
+
+        phase_begin();
+        for (int i = 0; i < files; i++) {
+            if (!fs_list_files(list_buf, sizeof(list_buf))) stats[OP_LIST].errors++;
+        }
+        stats[OP_LIST].ops += files;
+        phase_end(&stats[OP_LIST]);
+
+        phase_begin();
+        for (int i = 0; i < files; i++) {
+            snprintf(name, sizeof(name), "file%d.dat", i);
+            if (!fs_delete(name)) stats[OP_DELETE].errors++;
+        }
+        stats[OP_DELETE].ops += files;
+        phase_end_sync(&stats[OP_DELETE]);
+    }
+}
+
+// ---- ZFS (build_zfs_improved/zfs.c + zfs_ops.c): 根目录下的平坦文件，每个文件最多10个直接块 ----
+
+#define BENCH_ZFS_BYTES     (16 * 1024 * 1024)
+
+static int zfs_bench_format(void) {
+    return zfs_format(0, BENCH_ZFS_BYTES) == ZFS_OK;
+}
+
+static int zfs_bench_mount(void) {
+    return zfs_init(get_zfs_fs(), 0) == ZFS_OK && zfs_mount(get_zfs_fs()) == ZFS_OK;
+}
+
+static void bench_zfs(const bench_config_t* cfg, bench_stat_t* stats) {
+    static zfs_direntry_t entries[ZFS_MAX_FILES];
+    zfs_fs_t* fs = get_zfs_fs();
+    int files = cfg->files < ZFS_MAX_FILES - 1 ? cfg->files : ZFS_MAX_FILES - 1;
+    uint32_t size = cfg->size < 10 * ZFS_BLOCK_SIZE ? cfg->size : 10 * ZFS_BLOCK_SIZE;
+    char path[ZFS_NAME_LENGTH];
+    zfs_file_t file;
+
+    zfs_set_device(fs_dev);
+
+    for (int round = 0; round < cfg->rounds; round++) {
+        zfs_unmount(fs);
+        if (!bench_reset(round, zfs_bench_format, zfs_bench_mount)) {
+            fprintf(stderr, "zfs: format/mount failed\n");
+            return;
+        }
+
+        phase_begin();
+        for (int i = 0; i < files; i++) {
+            snprintf(path, sizeof(path), "/file%d", i);
+            if (zfs_create(fs, path, 0) != ZFS_OK) stats[OP_CREATE].errors++;
+        }
+        stats[OP_CREATE].ops += files;
+        phase_end_sync(&stats[OP_CREATE]);
+
+        phase_begin();
+        for (int i = 0; i < files; i++) {
+            snprintf(path, sizeof(path), "/file%d", i);
+            if (zfs_open(fs, path, 0x02, &file) != ZFS_OK ||
+                zfs_write(fs, &file, write_buf, size) != (int)size) {
+                stats[OP_WRITE].errors++;
+            }
+            zfs_close(fs, &file);
+        }
+        stats[OP_WRITE].ops += files;
+        stats[OP_WRITE].bytes += (uint64_t)files * size;
+        phase_end_sync(&stats[OP_WRITE]);
+
+        phase_begin();
+        for (int i = 0; i < files; i++) {
+            snprintf(path, sizeof(path), "/file%d", i);
+            if (zfs_open(fs, path, 0x01, &file) != ZFS_OK ||
+                zfs_read(fs, &file, read_buf, size) != (int)size ||
+                memcmp(read_buf, write_buf, size) != 0) {
+                stats[OP_READ].errors++;
+            }
+            zfs_close(fs, &file);
+        }
+        stats[OP_READ].ops += files;
+        stats[OP_READ].bytes += (uint64_t)files * size;
+        phase_end(&stats[OP_READ]);
+
+        phase_begin();
+        for (int i = 0; i < files; i++) {
+            uint32_t count = ZFS_MAX_FILES;
+            if (zfs_list_directory(fs, "/", entries, &count) != ZFS_OK || count != (uint32_t)files) {
+                stats[OP_LIST].errors++;
+            }
+        }
+        stats[OP_LIST].ops += files;
+        phase_end(&stats[OP_LIST]);
+
+        phase_begin();
+        for (int i = 0; i < files; i++) {
+            snprintf(path, sizeof(path), "/file%d", i);
+            if (zfs_delete(fs, path) != ZFS_OK) stats[OP_DELETE].errors++;
+        }
+        stats[OP_DELETE].ops += files;
+        phase_end_sync(&stats[OP_DELETE]);
+    }
+    zfs_unmount(fs);
+}
+
+// ---- fat32.c: fat32_io.c不在源码树中，只有打开/创建/关闭 ----
+// create = 以"w"打开新文件，read = 以"r"打开 (目录查找)
+
+static fat32_t bench_fat;
+
+static int fat32_bench_format(void) {
+    return fat32_format(fs_dev, 0, (uint32_t)fs_dev->capacity, "BENCH");
+}
+
+static int fat32_bench_mount(void) {
+    return fat32_init(&bench_fat, fs_dev, 0);
+}
+
+static void bench_fat32(const bench_config_t* cfg, bench_stat_t* stats) {
+    fat32_t* fat = &bench_fat;
+    char name[16];
+    int files = cfg->files;
+
+    for (int round = 0; round < cfg->rounds; round++) {
+        if (!bench_reset(round, fat32_bench_format, fat32_bench_mount)) {
+            fprintf(stderr, "fat32: format/mount failed\n");
+            return;
+        }
+
+        phase_begin();
+        for (int i = 0; i < files; i++) {
+            snprintf(name, sizeof(name), "F%d.DAT", i);
+            fat32_file_t* f = fat32_fopen(fat, name, "w");
+            if (!f || !fat32_fclose(f)) stats[OP_CREATE].errors++;
+        }
+        stats[OP_CREATE].ops += files;
+        phase_end(&stats[OP_CREATE]);
+
+        phase_begin();
+        for (int i = 0; i < files; i++) {
+            snprintf(name, sizeof(name), "F%d.DAT", i);
+            fat32_file_t* f = fat32_fopen(fat, name, "r");
+            if (!f || !fat32_fclose(f)) stats[OP_READ].errors++;
+        }
+        stats[OP_READ].ops += files;
+        phase_end(&stats[OP_READ]);
+    }
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "usage: %s [-n files] [-s bytes] [-r rounds] [-f simplefs|zfs|fat32] [-c] [-S] [-v] [image]\n"
+            "  -n  files per round (default 16, max %d)\n"
+            "  -s  bytes written/read per file (default 512)\n"
+            "  -r  rounds, the image is reformatted before each (default 200)\n"
+            "  -f  run only this filesystem (default: all)\n"
+            "  -c  reset the image by discarding a copy-on-write overlay instead of reformatting\n"
+            "  -S  fdatasync the image on every flush\n"
+            "  -v  show filesystem messages\n",
+            prog, BENCH_MAX_FILES);
+}
+
+int main(int argc, char** argv) {
+    bench_config_t cfg = { 16, 512, 200 };
+    const char* only = NULL;
+    const char* image = "fsbench.img";
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:s:r:f:cSvh")) != -1) {
+        switch (opt) {
+        case 'n': cfg.files = atoi(optarg); break;
+        case 's': cfg.size = (uint32_t)atoi(optarg); break;
+        case 'r': cfg.rounds = atoi(optarg); break;
+        case 'f': only = optarg; break;
+        case 'c': bench_cow = 1; break;
+        case 'S': host_blkdev_set_sync(1); break;
+        case 'v': host_verbose = 1; break;
+        default: usage(argv[0]); return 2;
+        }
+    }
+    if (optind < argc) {
+        image = argv[optind];
+    }
+    if (cfg.files <= 0 || cfg.files > BENCH_MAX_FILES || cfg.size == 0 || cfg.rounds <= 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    bench_dev = host_blkdev_open(BENCH_DEVICE, image, BENCH_IMAGE_SECTORS);
+    if (!bench_dev) {
+        return 1;
+    }
+
+    // 内存增量覆盖整个镜像，不会写满
+    fs_dev = bench_cow ? cow_create(bench_dev, NULL, BENCH_IMAGE_SECTORS / COW_CHUNK_SECTORS) : bench_dev;
+    if (!fs_dev) {
+        fprintf(stderr, "cannot create copy-on-write overlay\n");
+        return 1;
+    }
+
+    uint32_t buf_size = cfg.size;
+    write_buf = malloc(buf_size);
+    read_buf = malloc(buf_size);
+    for (uint32_t i = 0; i < buf_size; i++) {
+        write_buf[i] = (uint8_t)(i * 7 + 1);
+    }
+
+    printf("image %s, %d files x %u bytes, %d rounds\n", image, cfg.files, cfg.size, cfg.rounds);
+    printf("%-8s %-7s %10s %12s %9s %9s %9s %8s %11s %7s\n",
+           "fs", "op", "ops", "ops/s", "MB/s", "rd sec/op", "wr sec/op", "flush/op", "trim sec/op", "errors");
+
+    static const struct {
+        const char* name;
+        void (*run)(const bench_config_t*, bench_stat_t*);
+    } suites[] = {
+        { "simplefs", bench_simplefs },
+        { "zfs", bench_zfs },
+        { "fat32", bench_fat32 },
+    };
+
+    int status = 0;
+    for (unsigned int i = 0; i < sizeof(suites) / sizeof(suites[0]); i++) {
+        if (only && strcmp(only, suites[i].name) != 0) {
+            continue;
+        }
+        bench_stat_t stats[OP_COUNT];
+        memset(stats, 0, sizeof(stats));
+        reset_seconds = 0;
+        suites[i].run(&cfg, stats);
+        print_stats(suites[i].name, stats);
+        printf("%-8s %-7s %10d %12s %9.3f s (%s)\n", suites[i].name, "reset", cfg.rounds, "",
+               reset_seconds, bench_cow ? "overlay discard" : "reformat");
+        for (int op = 0; op < OP_COUNT; op++) {
+            if (stats[op].errors) status = 1;
+        }
+    }
+
+    free(write_buf);
+    free(read_buf);
+    host_blkdev_close(bench_dev);
+    return status;
+}
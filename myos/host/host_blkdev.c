@@ -0,0 +1,483 @@
+#define _GNU_SOURCE                    // fallocate
+
+#include "host_blkdev.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// 镜像文件
+typedef struct {
+    int fd;
+    host_blkdev_stats_t stats;
+    blkdev_t blk;
+} host_disk_t;
+
+// 已注册的块设备
+static blkdev_t* blkdev_table[BLKDEV_MAX];
+static int blkdev_num = 0;
+
+static int host_sync = 0;
+
+// 完整读写count个字节，处理pread/pwrite的部分完成
+static int host_pio(int fd, int write, uint8_t* buf, size_t count, off_t offset) {
+    while (count > 0) {
+        ssize_t n = write ? pwrite(fd, buf, count, offset) : pread(fd, buf, count, offset);
+        if (n <= 0) {
+            return 0;
+        }
+        buf += n;
+        count -= n;
+        offset += n;
+    }
+    return 1;
+}
+
+static int host_disk_read(blkdev_t* dev, uint64_t lba, uint32_t count, void* buffer) {
+    host_disk_t* disk = (host_disk_t*)dev->priv;
+
+    disk->stats.reads++;
+    disk->stats.read_sectors += count;
+    return host_pio(disk->fd, 0, buffer, (size_t)count * dev->sector_size, (off_t)(lba * dev->sector_size));
+}
+
+static int host_disk_write(blkdev_t* dev, uint64_t lba, uint32_t count, const void* buffer) {
+    host_disk_t* disk = (host_disk_t*)dev->priv;
+
+    disk->stats.writes++;
+    disk->stats.write_sectors += count;
+    return host_pio(disk->fd, 1, (uint8_t*)buffer, (size_t)count * dev->sector_size, (off_t)(lba * dev->sector_size));
+}
+
+static int host_disk_flush(blkdev_t* dev) {
+    host_disk_t* disk = (host_disk_t*)dev->priv;
+
+    disk->stats.flushes++;
+    if (host_sync && fdatasync(disk->fd) != 0) {
+        return 0;
+    }
+    return 1;
+}
+
+// 丢弃的扇区在镜像文件中打洞，文件系统不支持打洞时只计数
+static int host_disk_discard(blkdev_t* dev, const blk_range_t* ranges, int count) {
+    host_disk_t* disk = (host_disk_t*)dev->priv;
+
+    for (int i = 0; i < count; i++) {
+        disk->stats.discards++;
+        disk->stats.discard_sectors += ranges[i].count;
+        fallocate(disk->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                  (off_t)(ranges[i].lba * dev->sector_size), (off_t)ranges[i].count * dev->sector_size);
+    }
+    return 1;
+}
+
+static const blkdev_ops_t host_disk_ops = {
+    host_disk_read,
+    host_disk_write,
+    host_disk_flush,
+    0,
+    0,
+    0,
+    host_disk_discard
+};
+
+blkdev_t* host_blkdev_open(const char* name, const char* path, uint64_t sectors) {
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        perror(path);
+        return NULL;
+    }
+
+    if (sectors) {
+        if (ftruncate(fd, (off_t)(sectors * BLKDEV_SECTOR_SIZE)) != 0) {
+            perror(path);
+            close(fd);
+            return NULL;
+        }
+    } else {
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            perror(path);
+            close(fd);
+            return NULL;
+        }
+        sectors = (uint64_t)st.st_size / BLKDEV_SECTOR_SIZE;
+    }
+
+    host_disk_t* disk = calloc(1, sizeof(host_disk_t));
+    if (!disk) {
+        close(fd);
+        return NULL;
+    }
+
+    disk->fd = fd;
+    snprintf(disk->blk.name, BLKDEV_NAME_LENGTH, "%s", name);
+    disk->blk.sector_size = BLKDEV_SECTOR_SIZE;
+    disk->blk.capacity = sectors;
+    disk->blk.ops = &host_disk_ops;
+    disk->blk.priv = disk;
+    disk->blk.max_discard = BLKDEV_DISCARD_RANGES;
+
+    if (!blkdev_register(&disk->blk)) {
+        fprintf(stderr, "%s: cannot register block device %s\n", path, name);
+        close(fd);
+        free(disk);
+        return NULL;
+    }
+    return &disk->blk;
+}
+
+void host_blkdev_close(blkdev_t* dev) {
+    host_disk_t* disk = (host_disk_t*)dev->priv;
+
+    for (int i = 0; i < blkdev_num; i++) {
+        if (blkdev_table[i] == dev) {
+            blkdev_table[i] = blkdev_table[--blkdev_num];
+            break;
+        }
+    }
+    close(disk->fd);
+    free(disk);
+}
+
+void host_blkdev_set_sync(int sync) {
+    host_sync = sync;
+}
+
+void host_blkdev_get_stats(blkdev_t* dev, host_blkdev_stats_t* stats) {
+    *stats = ((host_disk_t*)dev->priv)->stats;
+}
+
+void host_blkdev_reset_stats(blkdev_t* dev) {
+    memset(&((host_disk_t*)dev->priv)->stats, 0, sizeof(host_blkdev_stats_t));
+}
+
+// ---- kernel/blkdev.h 接口 ----
+// 请求在提交时直接完成: 没有队列、合并和中断，文件系统看到的语义不变
+
+static int blkdev_range_ok(blkdev_t* dev, uint64_t lba, uint32_t count) {
+    if (count == 0) return 0;
+    if (lba >= dev->capacity) return 0;
+    if (count > dev->capacity - lba) return 0;
+    return 1;
+}
+
+int blkdev_register(blkdev_t* dev) {
+    if (!dev || !dev->ops || !dev->ops->read || blkdev_num >= BLKDEV_MAX) {
+        return 0;
+    }
+    for (int i = 0; i < blkdev_num; i++) {
+        if (blkdev_table[i] == dev || strcmp(blkdev_table[i]->name, dev->name) == 0) {
+            return 0;
+        }
+    }
+    if (dev->sector_size == 0) {
+        dev->sector_size = BLKDEV_SECTOR_SIZE;
+    }
+    dev->depth = 1;
+    if (!dev->ops->discard || dev->max_discard < 0) {
+        dev->max_discard = 0;
+    } else if (dev->max_discard > BLKDEV_DISCARD_RANGES) {
+        dev->max_discard = BLKDEV_DISCARD_RANGES;
+    }
+    dev->discard_count = 0;
+    dev->queue = 0;
+    dev->queue_len = 0;
+    dev->async_error = 0;
+    dev->busy = 0;
+    memset(&dev->stats, 0, sizeof(blkdev_stats_t));
+    blkdev_table[blkdev_num++] = dev;
+    return 1;
+}
+
+blkdev_t* blkdev_get(int index) {
+    if (index < 0 || index >= blkdev_num) {
+        return 0;
+    }
+    return blkdev_table[index];
+}
+
+blkdev_t* blkdev_find(const char* name) {
+    for (int i = 0; i < blkdev_num; i++) {
+        if (strcmp(blkdev_table[i]->name, name) == 0) {
+            return blkdev_table[i];
+        }
+    }
+    return 0;
+}
+
+int blkdev_count() {
+    return blkdev_num;
+}
+
+// 写入的扇区移出待丢弃范围，否则之后下发的丢弃会抹掉新数据
+// 范围被从中间截断而数组已满时舍弃后半段，丢弃只是提示
+static void blkdev_discard_cancel(blkdev_t* dev, uint64_t lba, uint32_t count) {
+    uint64_t end = lba + count;
+    int i = 0;
+
+    while (i < dev->discard_count) {
+        blk_range_t* r = &dev->discards[i];
+        uint64_t r_end = r->lba + r->count;
+
+        if (r_end <= lba || r->lba >= end) {
+            i++;
+            continue;
+        }
+
+        if (r->lba >= lba && r_end <= end) {
+            *r = dev->discards[--dev->discard_count];
+            continue;
+        }
+
+        if (r->lba < lba) {
+            r->count = (uint32_t)(lba - r->lba);
+            if (r_end > end && dev->discard_count < BLKDEV_DISCARD_RANGES) {
+                blk_range_t* tail = &dev->discards[dev->discard_count++];
+                tail->lba = end;
+                tail->count = (uint32_t)(r_end - end);
+            }
+        } else {
+            r->lba = end;
+            r->count = (uint32_t)(r_end - end);
+        }
+        i++;
+    }
+}
+
+// 每个请求就是一条命令: 没有合并，队列深度恒为1，延迟不计
+static int blkdev_account(blkdev_t* dev, int write, uint32_t count, int ok) {
+    blkdev_stats_t* st = &dev->stats;
+
+    if (!ok) {
+        st->errors++;
+    } else if (write) {
+        st->writes++;
+        st->write_sectors += count;
+    } else {
+        st->reads++;
+        st->read_sectors += count;
+    }
+    st->depth_sum++;
+    st->depth_samples++;
+    st->max_depth = 1;
+    return ok;
+}
+
+int blkdev_read(blkdev_t* dev, uint64_t lba, uint32_t count, void* buffer) {
+    if (!dev || !buffer || !blkdev_range_ok(dev, lba, count)) {
+        return 0;
+    }
+    return blkdev_account(dev, 0, count, dev->ops->read(dev, lba, count, buffer));
+}
+
+int blkdev_write(blkdev_t* dev, uint64_t lba, uint32_t count, const void* buffer) {
+    if (!dev || !buffer || !dev->ops->write || !blkdev_range_ok(dev, lba, count)) {
+        return 0;
+    }
+    if (dev->discard_count) {
+        blkdev_discard_cancel(dev, lba, count);
+    }
+    return blkdev_account(dev, 1, count, dev->ops->write(dev, lba, count, buffer));
+}
+
+// 宿主机上没有队列，元数据读写与普通读写相同
+int blkdev_read_meta(blkdev_t* dev, uint64_t lba, uint32_t count, void* buffer) {
+    return blkdev_read(dev, lba, count, buffer);
+}
+
+int blkdev_write_meta(blkdev_t* dev, uint64_t lba, uint32_t count, const void* buffer) {
+    return blkdev_write(dev, lba, count, buffer);
+}
+
+int blkdev_write_fua(blkdev_t* dev, uint64_t lba, uint32_t count, const void* buffer) {
+    if (!blkdev_write(dev, lba, count, buffer)) {
+        return 0;
+    }
+    return blkdev_flush(dev);
+}
+
+static int blkdev_rw_vec(blkdev_t* dev, uint64_t lba, const blk_iovec_t* iov, int iovcnt, int write) {
+    for (int i = 0; i < iovcnt; i++) {
+        uint32_t count = iov[i].len / dev->sector_size;
+        int ok = write ? blkdev_write(dev, lba, count, iov[i].base)
+                       : blkdev_read(dev, lba, count, iov[i].base);
+        if (!ok) {
+            return 0;
+        }
+        lba += count;
+    }
+    return 1;
+}
+
+int blkdev_readv(blkdev_t* dev, uint64_t lba, const blk_iovec_t* iov, int iovcnt) {
+    return blkdev_rw_vec(dev, lba, iov, iovcnt, 0);
+}
+
+int blkdev_writev(blkdev_t* dev, uint64_t lba, const blk_iovec_t* iov, int iovcnt) {
+    return blkdev_rw_vec(dev, lba, iov, iovcnt, 1);
+}
+
+// 下发积攒的丢弃范围，按驱动一次能接受的范围数分批
+// 丢弃失败不影响数据，只计入错误数
+static void blkdev_discard_issue(blkdev_t* dev) {
+    int total = dev->discard_count;
+
+    dev->discard_count = 0;
+    for (int i = 0; i < total; i += dev->max_discard) {
+        int n = total - i < dev->max_discard ? total - i : dev->max_discard;
+        uint64_t sectors = 0;
+
+        for (int j = 0; j < n; j++) {
+            sectors += dev->discards[i + j].count;
+        }
+        dev->stats.discards++;
+        dev->stats.discard_sectors += sectors;
+        if (!dev->ops->discard(dev, &dev->discards[i], n)) {
+            dev->stats.errors++;
+        }
+    }
+}
+
+// 与内核相同: 刷新成功后才下发丢弃，此时释放这些扇区的元数据已经落盘
+int blkdev_flush(blkdev_t* dev) {
+    if (!dev) {
+        return 0;
+    }
+
+    int ok = 1;
+    if (dev->ops->flush) {
+        dev->stats.flushes++;
+        ok = dev->ops->flush(dev);
+    }
+
+    if (ok && dev->discard_count) {
+        blkdev_discard_issue(dev);
+    }
+    return ok;
+}
+
+// 积攒丢弃范围，与内核相同: 写入虽然已经完成，释放扇区的元数据可能还在写缓存中，
+// 提前打洞的话崩溃后旧元数据会指向已被抹掉的数据
+int blkdev_discard(blkdev_t* dev, uint64_t lba, uint32_t count) {
+    if (!dev || !blkdev_range_ok(dev, lba, count)) {
+        return 0;
+    }
+    if (dev->max_discard == 0) {
+        return 1;
+    }
+
+    uint64_t end = lba + count;
+    int i = 0;
+    while (i < dev->discard_count) {
+        blk_range_t* r = &dev->discards[i];
+        uint64_t r_end = r->lba + r->count;
+        uint64_t lo = r->lba < lba ? r->lba : lba;
+        uint64_t hi = r_end > end ? r_end : end;
+
+        if (r->lba > end || r_end < lba || hi - lo > 0xFFFFFFFF) {
+            i++;
+            continue;
+        }
+
+        lba = lo;
+        end = hi;
+        *r = dev->discards[--dev->discard_count];
+        i = 0;
+    }
+
+    // 攒满一批后刷新一次，刷新会把已有的范围下发
+    if (dev->discard_count >= BLKDEV_DISCARD_RANGES && !blkdev_flush(dev)) {
+        return 1;
+    }
+    if (dev->discard_count < BLKDEV_DISCARD_RANGES) {
+        blk_range_t* r = &dev->discards[dev->discard_count++];
+        r->lba = lba;
+        r->count = (uint32_t)(end - lba);
+    }
+    return 1;
+}
+
+void blkdev_submit(blk_request_t* req) {
+    int ok = req->write ? blkdev_write(req->dev, req->lba, req->count, req->buffer)
+                        : blkdev_read(req->dev, req->lba, req->count, req->buffer);
+    if (!ok) {
+        req->dev->async_error = 1;
+    }
+    req->status = ok ? BLK_REQ_DONE : BLK_REQ_ERROR;
+    if (req->end_io) {
+        req->end_io(req);
+    }
+}
+
+void blkdev_kick(blkdev_t* dev) {
+    (void)dev;
+}
+
+void blkdev_plug(blkdev_t* dev) {
+    (void)dev;
+}
+
+void blkdev_unplug(blkdev_t* dev) {
+    (void)dev;
+}
+
+void blkdev_run_queue(blkdev_t* dev) {
+    (void)dev;
+}
+
+void blkdev_end_tag(blkdev_t* dev, int tag, int ok) {
+    (void)dev;
+    (void)tag;
+    (void)ok;
+}
+
+void blkdev_end_request(blkdev_t* dev, int ok) {
+    (void)dev;
+    (void)ok;
+}
+
+int blkdev_wait(blk_request_t* req) {
+    return req->status == BLK_REQ_DONE;
+}
+
+int blkdev_read_async(blkdev_t* dev, uint64_t lba, uint32_t count, void* buffer) {
+    if (!blkdev_read(dev, lba, count, buffer)) {
+        if (dev) dev->async_error = 1;
+        return 0;
+    }
+    return 1;
+}
+
+int blkdev_write_async(blkdev_t* dev, uint64_t lba, uint32_t count, const void* buffer) {
+    if (!blkdev_write(dev, lba, count, buffer)) {
+        if (dev) dev->async_error = 1;
+        return 0;
+    }
+    return 1;
+}
+
+int blkdev_drain(blkdev_t* dev) {
+    if (!dev) {
+        return 0;
+    }
+    int ok = !dev->async_error;
+    dev->async_error = 0;
+    return ok;
+}
+
+void blkdev_get_stats(blkdev_t* dev, blkdev_stats_t* stats) {
+    if (dev && stats) {
+        *stats = dev->stats;
+    }
+}
+
+void blkdev_reset_stats(blkdev_t* dev) {
+    if (dev) {
+        memset(&dev->stats, 0, sizeof(blkdev_stats_t));
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef HOST_BLKDEV_H
+#define HOST_BLKDEV_H
+
+#include <stdint.h>
+#include "../kernel/blkdev.h"
+
+// 宿主机上的块设备层: 用镜像文件的pread/pwrite代替磁盘驱动和请求队列
+// 接口与kernel/blkdev.h相同，文件系统源码不经修改即可链接
+
+// 设备上的I/O计数
+typedef struct {
+    uint64_t reads;                    // 读命令数
+    uint64_t writes;                   // 写命令数
+    uint64_t read_sectors;             // 读扇区数
+    uint64_t write_sectors;            // 写扇区数
+    uint64_t flushes;                  // 刷新次数
+    uint64_t discards;                 // 丢弃命令数
+    uint64_t discard_sectors;          // 丢弃扇区数
+} host_blkdev_stats_t;
+
+// 打开 (必要时创建) 镜像文件并注册为名为name的块设备
+// sectors为0时使用文件现有大小，否则把文件扩展到该大小，失败返回NULL
+blkdev_t* host_blkdev_open(const char* name, const char* path, uint64_t sectors);
+
+// 关闭镜像文件，设备不再可用
+void host_blkdev_close(blkdev_t* dev);
+
+// 刷新时是否调用fdatasync (默认只计数，测量的是文件系统本身的开销)
+void host_blkdev_set_sync(int sync);
+
+// 读取/清零I/O计数
+void host_blkdev_get_stats(blkdev_t* dev, host_blkdev_stats_t* stats);
+void host_blkdev_reset_stats(blkdev_t* dev);
+
+#endif // HOST_BLKDEV_H
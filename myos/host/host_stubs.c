@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "../kernel/disk.h"
+#include "../kernel/fat32.h"
+
+// 宿主机上代替内核其余部分的函数，文件系统源码通过extern声明引用它们
+
+// 文件系统的提示信息默认丢弃，避免终端输出影响计时
+int host_verbose = 0;
+
+void print_string(const char* str) {
+    if (host_verbose) fputs(str, stdout);
+}
+
+void print_char(char c) {
+    if (host_verbose) fputc(c, stdout);
+}
+
+void print_newline(void) {
+    if (host_verbose) fputc('\n', stdout);
+}
+
+void print_int(int num) {
+    if (host_verbose) printf("%d", num);
+}
+
+void int_to_string(int num, char* str) {
+    sprintf(str, "%d", num);
+}
+
+// 定时器: 按内核的100Hz滴答换算单调时钟
+unsigned int get_tick_count() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned int)(ts.tv_sec * 100 + ts.tv_nsec / 10000000);
+}
+
+unsigned int get_tick() {
+    return get_tick_count();
+}
+
+// 页分配器: 覆盖设备的内存增量和哈希表按页分配
+void* memory_alloc_pages(unsigned int count) {
+    return calloc(count, 4096);
+}
+
+void memory_free_pages(void* addr, unsigned int count) {
+    (void)count;
+    free(addr);
+}
+
+// 宿主机上没有分区表，fat32_mount不可用，直接用fat32_init挂载镜像
+blkdev_t* disk_get_blkdev(disk_t* disk) {
+    (void)disk;
+    return 0;
+}
+
+int disk_get_partition_info(int partition_index, disk_t** disk, uint32_t* start_lba) {
+    (void)partition_index;
+    (void)disk;
+    (void)start_lba;
+    return 0;
+}
+
+// fat32_io.c不在源码树中，fat32_fopen的追加模式无法定位
+int fat32_fseek(fat32_file_t* file, int32_t offset, int whence) {
+    (void)file;
+    (void)offset;
+    (void)whence;
+    return -1;
+}
@@ -0,0 +1,674 @@
+#include "ahci.h"
+#include "disk.h"
+#include "pci.h"
+#include "interrupt.h"
+#include "timer.h"
+#include "string.h"
+
+// 外部函数声明
+extern void print_string(const char* str);
+extern void print_newline(void);
+extern void int_to_string(int num, char* str);
+
+// HBA寄存器 (内核未开分页，ABAR物理地址可以直接访问)
+static ahci_hba_t* ahci_hba;
+
+// 已发现的SATA磁盘
+static ahci_port_t ahci_ports[AHCI_MAX_PORTS];
+static int ahci_port_num = 0;
+
+// 命令列表要求1KB对齐，FIS接收区256字节对齐，命令表128字节对齐
+// 命令表大小是128的整数倍，数组中每一项都满足对齐
+static ahci_cmd_header_t ahci_cmd_lists[AHCI_MAX_PORTS][AHCI_MAX_SLOTS] __attribute__((aligned(1024)));
+static uint8_t ahci_fis_areas[AHCI_MAX_PORTS][256] __attribute__((aligned(256)));
+static ahci_cmd_table_t ahci_tables[AHCI_MAX_PORTS][AHCI_MAX_SLOTS] __attribute__((aligned(128)));
+
+// TRIM范围表，各端口轮流使用 (丢弃是同步执行的)
+static uint64_t ahci_trim_table[ATA_TRIM_ENTRIES] __attribute__((aligned(512)));
+
+// 关中断并返回原来的标志
+static inline uint32_t irq_save() {
+    uint32_t flags;
+    asm volatile("pushf; pop %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+static inline void irq_restore(uint32_t flags) {
+    if (flags & 0x200) {
+        asm volatile("sti" : : : "memory");
+    }
+}
+
+// 停止端口的命令引擎和FIS接收，超时返回0
+// 清除ST会同时清空CI和SACT
+static int ahci_port_stop(ahci_port_regs_t* regs) {
+    int timeout = AHCI_POLL_TIMEOUT;
+
+    regs->cmd &= ~AHCI_PCMD_ST;
+    while (regs->cmd & AHCI_PCMD_CR) {
+        if (--timeout == 0) return 0;
+    }
+
+    timeout = AHCI_POLL_TIMEOUT;
+    regs->cmd &= ~AHCI_PCMD_FRE;
+    while (regs->cmd & AHCI_PCMD_FR) {
+        if (--timeout == 0) return 0;
+    }
+
+    return 1;
+}
+
+// 打开FIS接收并启动命令引擎
+static void ahci_port_start(ahci_port_regs_t* regs) {
+    int timeout = AHCI_POLL_TIMEOUT;
+
+    while ((regs->cmd & AHCI_PCMD_CR) && --timeout);
+
+    regs->cmd |= AHCI_PCMD_FRE | AHCI_PCMD_POD | AHCI_PCMD_SUD;
+    regs->cmd |= AHCI_PCMD_ST;
+}
+
+// 出错或超时后重新启动端口，设备仍然忙时先发COMRESET
+static void ahci_port_recover(ahci_port_t* port) {
+    ahci_port_regs_t* regs = port->regs;
+
+    ahci_port_stop(regs);
+    regs->serr = 0xFFFFFFFF;
+    regs->is = 0xFFFFFFFF;
+
+    if (regs->tfd & (AHCI_TFD_BSY | AHCI_TFD_DRQ)) {
+        // DET=1保持至少1毫秒，再放开等待重新建立通信
+        regs->sctl = (regs->sctl & ~0x0F) | 1;
+        for (int i = 0; i < 10000; i++) (void)regs->ssts;
+        regs->sctl &= ~0x0F;
+
+        int timeout = AHCI_POLL_TIMEOUT;
+        while (AHCI_SSTS_DET(regs->ssts) != AHCI_DET_PRESENT && --timeout);
+        regs->serr = 0xFFFFFFFF;
+    }
+
+    ahci_port_start(regs);
+}
+
+// 设置端口的命令列表、FIS接收区和各槽的命令表，然后启动端口
+static int ahci_port_setup(ahci_port_t* port, int n) {
+    ahci_port_regs_t* regs = port->regs;
+
+    if (!ahci_port_stop(regs)) {
+        return 0;
+    }
+
+    port->cmd_list = ahci_cmd_lists[n];
+    port->fis = ahci_fis_areas[n];
+    port->tables = ahci_tables[n];
+    memset(port->cmd_list, 0, sizeof(ahci_cmd_lists[n]));
+    memset(port->fis, 0, sizeof(ahci_fis_areas[n]));
+
+    for (int slot = 0; slot < AHCI_MAX_SLOTS; slot++) {
+        port->cmd_list[slot].ctba = (uint32_t)&port->tables[slot];
+        port->cmd_list[slot].ctbau = 0;
+    }
+
+    regs->clb = (uint32_t)port->cmd_list;
+    regs->clbu = 0;
+    regs->fb = (uint32_t)port->fis;
+    regs->fbu = 0;
+
+    // 清除复位留下的错误和中断状态
+    regs->serr = 0xFFFFFFFF;
+    regs->is = 0xFFFFFFFF;
+    regs->ie = 0;
+
+    ahci_port_start(regs);
+    return 1;
+}
+
+// 填写寄存器FIS，LBA模式
+static void ahci_fis_init(fis_reg_h2d_t* fis, uint8_t command, uint64_t lba, uint32_t count) {
+    memset(fis, 0, sizeof(fis_reg_h2d_t));
+
+    fis->type = FIS_TYPE_REG_H2D;
+    fis->flags = FIS_H2D_COMMAND;
+    fis->command = command;
+    fis->device = 0x40;
+    fis->lba0 = lba & 0xFF;
+    fis->lba1 = (lba >> 8) & 0xFF;
+    fis->lba2 = (lba >> 16) & 0xFF;
+    fis->lba3 = (lba >> 24) & 0xFF;
+    fis->lba4 = (lba >> 32) & 0xFF;
+    fis->lba5 = (lba >> 40) & 0xFF;
+    fis->count_low = count & 0xFF;
+    fis->count_high = (count >> 8) & 0xFF;
+}
+
+// 为读写命令填写FIS，tag小于0表示同步执行 (不排队)，flags为BLK_RW_*
+// NCQ命令的扇区数放在特征寄存器，tag放在扇区数寄存器的位3-7，FUA是设备寄存器位7
+static void ahci_rw_fis(ahci_port_t* port, fis_reg_h2d_t* fis, int tag, uint64_t lba, uint32_t count, int flags) {
+    int write = flags & BLK_RW_WRITE;
+    int fua = write && (flags & BLK_RW_FUA);
+
+    if (port->ncq && tag >= 0) {
+        ahci_fis_init(fis, write ? ATA_CMD_WRITE_FPDMA_QUEUED : ATA_CMD_READ_FPDMA_QUEUED, lba, 0);
+        fis->feature_low = count & 0xFF;
+        fis->feature_high = (count >> 8) & 0xFF;
+        fis->count_low = (uint8_t)(tag << 3);
+        if (fua) fis->device |= 0x80;
+    } else if (port->lba48) {
+        uint8_t command = ATA_CMD_READ_DMA_EXT;
+        if (fua && port->fua) {
+            command = ATA_CMD_WRITE_DMA_FUA_EXT;
+        } else if (write) {
+            command = ATA_CMD_WRITE_DMA_EXT;
+        }
+        ahci_fis_init(fis, command, lba, count);
+    } else {
+        // 28位命令的LBA位24-27在设备寄存器中
+        ahci_fis_init(fis, write ? ATA_CMD_WRITE_DMA : ATA_CMD_READ_DMA, lba, count);
+        fis->device |= (lba >> 24) & 0x0F;
+    }
+}
+
+// 在槽位slot上准备一条命令: 复制命令FIS并为每段缓冲区填一个PRD项，成功返回1
+static int ahci_build(ahci_port_t* port, int slot, const fis_reg_h2d_t* fis, const blk_iovec_t* iov, int iovcnt, int write) {
+    ahci_cmd_header_t* header = &port->cmd_list[slot];
+    ahci_cmd_table_t* table = &port->tables[slot];
+
+    if (iovcnt < 0 || iovcnt > AHCI_PRDT_MAX) {
+        return 0;
+    }
+
+    for (int i = 0; i < iovcnt; i++) {
+        uint32_t addr = (uint32_t)iov[i].base;   // 内核未开分页，虚拟地址即物理地址
+        uint32_t bytes = iov[i].len;
+
+        // PRD要求字对齐且长度为偶数
+        if ((addr & 1) || bytes == 0 || (bytes & 1) || bytes > AHCI_PRD_MAX_BYTES) {
+            return 0;
+        }
+
+        table->prdt[i].dba = addr;
+        table->prdt[i].dbau = 0;
+        table->prdt[i].reserved = 0;
+        table->prdt[i].dbc = bytes - 1;
+    }
+
+    memcpy(table->cfis, fis, sizeof(fis_reg_h2d_t));
+
+    header->flags = (sizeof(fis_reg_h2d_t) / 4) | (write ? AHCI_CMDH_WRITE : 0);
+    header->prdtl = (uint16_t)iovcnt;
+    header->prdbc = 0;
+    return 1;
+}
+
+// 发出槽位上已准备好的命令，调用时已关中断
+// 排队命令要先置SACT再置CI
+static void ahci_issue(ahci_port_t* port, int slot, int queued) {
+    uint32_t bit = 1u << slot;
+
+    // 命令表必须在写CI之前全部写入内存
+    asm volatile("" : : : "memory");
+
+    port->cmd_tick[slot] = get_tick_count();
+    port->active |= bit;
+    if (queued) {
+        port->regs->sact = bit;
+    }
+    port->regs->ci = bit;
+}
+
+// 在槽0上同步执行一条非排队命令并轮询完成，调用时端口上不能有异步命令在途
+static int ahci_exec(ahci_port_t* port, const fis_reg_h2d_t* fis, const blk_iovec_t* iov, int iovcnt, int write) {
+    ahci_port_regs_t* regs = port->regs;
+    int timeout = AHCI_POLL_TIMEOUT;
+
+    if (!ahci_build(port, 0, fis, iov, iovcnt, write)) {
+        return 0;
+    }
+
+    // 等待设备空闲
+    while (regs->tfd & (AHCI_TFD_BSY | AHCI_TFD_DRQ)) {
+        if (--timeout == 0) {
+            ahci_port_recover(port);
+            return 0;
+        }
+    }
+
+    asm volatile("" : : : "memory");
+    regs->ci = 1;
+
+    // 出错时HBA停止处理命令，CI不会清除
+    timeout = AHCI_POLL_TIMEOUT;
+    while (regs->ci & 1) {
+        if ((regs->tfd & AHCI_TFD_ERR) || --timeout == 0) {
+            ahci_port_recover(port);
+            return 0;
+        }
+    }
+
+    if (regs->tfd & (AHCI_TFD_ERR | AHCI_TFD_DF)) {
+        return 0;
+    }
+
+    return 1;
+}
+
+// 单条命令最多可传输的扇区数
+static uint32_t ahci_max_sectors(ahci_port_t* port) {
+    return port->lba48 ? ATA_MAX_SECTORS_LBA48 : ATA_MAX_SECTORS_LBA28;
+}
+
+// 端口出错: 重新启动端口并以失败结束所有在途命令
+// NCQ命令出错时设备会放弃所有排队的命令
+static void ahci_port_error(ahci_port_t* port) {
+    uint32_t failed = port->active;
+
+    port->active = 0;
+    port->flush_pending = 0;
+    ahci_port_recover(port);
+
+    for (int slot = 0; slot < AHCI_MAX_SLOTS; slot++) {
+        if (failed & (1u << slot)) {
+            blkdev_end_tag(&port->blk, slot, 0);
+        }
+    }
+}
+
+// 在同一槽位上接着发出缓存刷新，用于驱动器不支持FUA的写
+static void ahci_start_flush(ahci_port_t* port, int slot) {
+    fis_reg_h2d_t fis;
+
+    ahci_fis_init(&fis, port->lba48 ? ATA_CMD_CACHE_FLUSH_EXT : ATA_CMD_CACHE_FLUSH, 0, 0);
+    ahci_build(port, slot, &fis, 0, 0, 0);
+    ahci_issue(port, slot, 0);
+}
+
+// 找出端口上已完成的命令交还块设备层，调用时已关中断
+// CI和SACT中都已清除的在途槽位即为完成
+static void ahci_port_complete(ahci_port_t* port) {
+    ahci_port_regs_t* regs = port->regs;
+    uint32_t is = regs->is;
+
+    regs->is = is;
+
+    // 没有异步命令时的中断来自同步命令，由ahci_exec自己检查
+    if (!port->active) {
+        return;
+    }
+
+    if (is & AHCI_PIS_ERROR) {
+        ahci_port_error(port);
+        return;
+    }
+
+    uint32_t done = port->active & ~(regs->ci | regs->sact);
+
+    for (int slot = 0; done; slot++) {
+        uint32_t bit = 1u << slot;
+        if (!(done & bit)) continue;
+
+        done &= ~bit;
+        port->active &= ~bit;
+
+        if (port->flush_pending & bit) {
+            port->flush_pending &= ~bit;
+            ahci_start_flush(port, slot);
+            continue;
+        }
+
+        // 可能在这里派发下一条命令并重新占用该槽位
+        blkdev_end_tag(&port->blk, slot, 1);
+    }
+}
+
+// HBA中断: 依次处理有中断挂起的端口，先清端口状态再清全局状态
+static void ahci_irq_handler(int irq) {
+    uint32_t pending = ahci_hba->is;
+
+    for (int i = 0; i < ahci_port_num; i++) {
+        if (pending & (1u << ahci_ports[i].index)) {
+            ahci_port_complete(&ahci_ports[i]);
+        }
+    }
+
+    ahci_hba->is = pending;
+}
+
+// 等待在途命令: 检查完成和超时，有中断时hlt直到下一次中断
+static void ahci_blk_poll(blkdev_t* dev) {
+    ahci_port_t* port = (ahci_port_t*)dev->priv;
+
+    asm volatile("cli");
+
+    // 没有中断时在这里发现完成，有中断时也顺带补上
+    ahci_port_complete(port);
+    if (!port->active) {
+        asm volatile("sti");
+        return;
+    }
+
+    uint32_t now = get_tick_count();
+    for (int slot = 0; slot < AHCI_MAX_SLOTS; slot++) {
+        if ((port->active & (1u << slot)) && now - port->cmd_tick[slot] > AHCI_CMD_TIMEOUT) {
+            ahci_port_error(port);
+            asm volatile("sti");
+            return;
+        }
+    }
+
+    if (port->use_irq) {
+        asm volatile("sti; hlt");
+    } else {
+        asm volatile("sti");
+    }
+}
+
+// 等待端口上的异步命令全部完成
+static void ahci_drain(ahci_port_t* port) {
+    while (port->active) {
+        ahci_blk_poll(&port->blk);
+    }
+}
+
+// 块设备层异步操作: 在tag对应的槽位上发出命令后立即返回
+// 支持NCQ时同时可有depth条命令在途，由驱动器自行安排执行顺序
+static int ahci_blk_start(blkdev_t* dev, int tag, uint64_t lba, const blk_iovec_t* iov, int iovcnt, int flags) {
+    ahci_port_t* port = (ahci_port_t*)dev->priv;
+    int write = flags & BLK_RW_WRITE;
+    uint32_t count = 0;
+    fis_reg_h2d_t fis;
+
+    for (int i = 0; i < iovcnt; i++) {
+        count += iov[i].len / 512;
+    }
+    if (count == 0 || count > ahci_max_sectors(port)) {
+        return 0;
+    }
+
+    ahci_rw_fis(port, &fis, tag, lba, count, flags);
+    if (!ahci_build(port, tag, &fis, iov, iovcnt, write)) {
+        return 0;
+    }
+
+    uint32_t eflags = irq_save();
+    if (write && (flags & BLK_RW_FUA) && !port->ncq && !port->fua) {
+        port->flush_pending |= 1u << tag;
+    }
+    ahci_issue(port, tag, port->ncq);
+    irq_restore(eflags);
+
+    return 1;
+}
+
+// 同步读写，按单条命令的上限拆分
+static int ahci_blk_rw(blkdev_t* dev, uint64_t lba, uint32_t count, void* buffer, int write) {
+    ahci_port_t* port = (ahci_port_t*)dev->priv;
+    uint8_t* buf = (uint8_t*)buffer;
+    uint32_t max = port->lba48 ? AHCI_MAX_SECTORS : ATA_MAX_SECTORS_LBA28;
+
+    ahci_drain(port);
+
+    while (count > 0) {
+        uint32_t n = count > max ? max : count;
+        blk_iovec_t iov;
+        fis_reg_h2d_t fis;
+
+        iov.base = buf;
+        iov.len = n * 512;
+        ahci_rw_fis(port, &fis, -1, lba, n, write ? BLK_RW_WRITE : 0);
+        if (!ahci_exec(port, &fis, &iov, 1, write)) {
+            return 0;
+        }
+
+        lba += n;
+        count -= n;
+        buf += n * 512;
+    }
+
+    return 1;
+}
+
+// 块设备层读操作
+static int ahci_blk_read(blkdev_t* dev, uint64_t lba, uint32_t count, void* buffer) {
+    return ahci_blk_rw(dev, lba, count, buffer, 0);
+}
+
+// 块设备层写操作
+static int ahci_blk_write(blkdev_t* dev, uint64_t lba, uint32_t count, const void* buffer) {
+    return ahci_blk_rw(dev, lba, count, (void*)buffer, 1);
+}
+
+// 块设备层刷新操作，缓存刷新不能与NCQ命令同时执行
+static int ahci_blk_flush(blkdev_t* dev) {
+    ahci_port_t* port = (ahci_port_t*)dev->priv;
+    fis_reg_h2d_t fis;
+
+    ahci_drain(port);
+    ahci_fis_init(&fis, port->lba48 ? ATA_CMD_CACHE_FLUSH_EXT : ATA_CMD_CACHE_FLUSH, 0, 0);
+    return ahci_exec(port, &fis, 0, 0, 0);
+}
+
+// 块设备层丢弃操作，DSM是非排队命令，同样要等NCQ命令做完
+static int ahci_blk_discard(blkdev_t* dev, const blk_range_t* ranges, int count) {
+    ahci_port_t* port = (ahci_port_t*)dev->priv;
+    blk_iovec_t iov;
+    fis_reg_h2d_t fis;
+    int index = 0;
+    uint32_t done = 0;
+
+    ahci_drain(port);
+    iov.base = ahci_trim_table;
+    iov.len = sizeof(ahci_trim_table);
+    while (index < count) {
+        ata_trim_encode(ahci_trim_table, ranges, count, &index, &done);
+        ahci_fis_init(&fis, ATA_CMD_DSM, 0, 1);
+        fis.feature_low = ATA_DSM_TRIM;
+        if (!ahci_exec(port, &fis, &iov, 1, 1)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static const blkdev_ops_t ahci_blk_ops = {
+    ahci_blk_read,
+    ahci_blk_write,
+    ahci_blk_flush,
+    ahci_blk_start,
+    ahci_blk_poll,
+    0,
+    ahci_blk_discard
+};
+
+// 获取磁盘信息，并按HBA和驱动器的能力决定是否使用NCQ及队列深度
+static int ahci_identify(ahci_port_t* port, uint32_t cap) {
+    uint16_t buffer[256];
+    blk_iovec_t iov;
+    fis_reg_h2d_t fis;
+
+    iov.base = buffer;
+    iov.len = sizeof(buffer);
+    ahci_fis_init(&fis, ATA_CMD_IDENTIFY, 0, 0);
+    fis.device = 0;
+
+    if (!ahci_exec(port, &fis, &iov, 1, 0)) {
+        return 0;
+    }
+
+    // 字83位10表示支持48位LBA，字100-103是完整的64位扇区数
+    port->lba48 = 0;
+    if (buffer[83] & (1 << 10)) {
+        port->size = ((uint64_t)buffer[103] << 48) | ((uint64_t)buffer[102] << 32) |
+                     ((uint64_t)buffer[101] << 16) | buffer[100];
+        port->lba48 = port->size ? 1 : 0;
+    }
+    if (!port->lba48) {
+        port->size = ((uint32_t)buffer[61] << 16) | buffer[60];
+    }
+
+    // 字84位6表示支持WRITE DMA FUA EXT
+    port->fua = (port->lba48 && (buffer[84] & (1 << 6))) ? 1 : 0;
+
+    // 字169位0表示支持DSM TRIM
+    port->trim = (port->lba48 && (buffer[169] & 1)) ? 1 : 0;
+
+    // 字76位8表示支持NCQ，字75位0-4是驱动器的队列深度减1
+    // 队列深度同时受HBA命令槽数和块设备层tag数限制
+    port->ncq = 0;
+    port->depth = 1;
+    if ((cap & AHCI_CAP_SNCQ) && port->lba48 && (buffer[76] & (1 << 8))) {
+        int depth = (buffer[75] & 0x1F) + 1;
+        if (depth > (int)AHCI_CAP_NCS(cap)) depth = AHCI_CAP_NCS(cap);
+        if (depth > BLKQ_MAX_TAGS) depth = BLKQ_MAX_TAGS;
+        port->ncq = 1;
+        port->depth = depth;
+    }
+
+    // 提取型号名称
+    char* model = (char*)&port->model;
+    for (int i = 0; i < 40; i += 2) {
+        model[i] = (char)(buffer[27 + i/2] >> 8);
+        model[i+1] = (char)buffer[27 + i/2];
+    }
+    model[40] = 0;
+
+    // 移除尾部空格
+    int len = 40;
+    while (len > 0 && model[len-1] == ' ') {
+        model[--len] = 0;
+    }
+
+    return 1;
+}
+
+// 将SATA磁盘注册到块设备层，设备表已满时返回0
+static int ahci_register_blkdev(ahci_port_t* port, int n) {
+    blkdev_t* blk = &port->blk;
+
+    strcpy(blk->name, "sda");
+    blk->name[2] = 'a' + n;
+    blk->sector_size = 512;
+    blk->capacity = port->size;
+    blk->ops = &ahci_blk_ops;
+    blk->priv = port;
+    blk->depth = port->depth;
+    blk->max_discard = port->trim ? BLKDEV_DISCARD_RANGES : 0;
+
+    return blkdev_register(blk);
+}
+
+// 查找AHCI控制器，打开内存空间访问和总线主控，返回ABAR
+static ahci_hba_t* ahci_probe(pci_device_t* pdev) {
+    if (!pci_find_class(PCI_CLASS_STORAGE, PCI_SUBCLASS_SATA, pdev)) {
+        return 0;
+    }
+
+    if (pci_read8(pdev, PCI_PROG_IF) != AHCI_PROG_IF) {
+        return 0;
+    }
+
+    // BAR5是内存空间的ABAR
+    uint32_t bar5 = pci_read32(pdev, PCI_BAR5);
+    if (bar5 & 1) {
+        return 0;
+    }
+
+    uint16_t cmd = pci_read16(pdev, PCI_COMMAND);
+    pci_write16(pdev, PCI_COMMAND, cmd | PCI_CMD_MEMORY | PCI_CMD_BUS_MASTER);
+    return (ahci_hba_t*)(bar5 & 0xFFFFFFF0);
+}
+
+// 中断可用时由HBA中断通知命令完成，否则在poll中轮询
+// 传统IDE的IRQ14/15已由disk.c使用，不与之共用
+static void ahci_enable_irq(pci_device_t* pdev) {
+    uint8_t line = pci_read8(pdev, PCI_INTERRUPT_LINE);
+
+    if (line >= IRQ_COUNT || line == IRQ_ATA_PRIMARY || line == IRQ_ATA_SECONDARY) {
+        return;
+    }
+    if (!irq_register(line, ahci_irq_handler)) {
+        return;
+    }
+
+    for (int i = 0; i < ahci_port_num; i++) {
+        ahci_port_t* port = &ahci_ports[i];
+        port->use_irq = 1;
+        port->regs->is = 0xFFFFFFFF;
+        port->regs->ie = AHCI_PIS_DHRS | AHCI_PIS_SDBS | AHCI_PIS_ERROR;
+    }
+
+    ahci_hba->is = 0xFFFFFFFF;
+    ahci_hba->ghc |= AHCI_GHC_IE;
+}
+
+// 初始化AHCI驱动
+void ahci_init() {
+    pci_device_t pdev;
+
+    ahci_port_num = 0;
+    ahci_hba = ahci_probe(&pdev);
+    if (!ahci_hba) {
+        return;
+    }
+
+    // 切换到AHCI模式
+    ahci_hba->ghc |= AHCI_GHC_AE;
+
+    uint32_t cap = ahci_hba->cap;
+    uint32_t implemented = ahci_hba->pi;
+
+    print_string("正在检测SATA磁盘...");
+    print_newline();
+
+    for (int i = 0; i < 32 && ahci_port_num < AHCI_MAX_PORTS; i++) {
+        if (!(implemented & (1u << i))) continue;
+
+        ahci_port_regs_t* regs = &ahci_hba->ports[i];
+        uint32_t ssts = regs->ssts;
+
+        // 只驱动已连接的ATA磁盘 (ATAPI等设备的签名不同)
+        if (AHCI_SSTS_DET(ssts) != AHCI_DET_PRESENT || AHCI_SSTS_IPM(ssts) != AHCI_IPM_ACTIVE) continue;
+        if (regs->sig != AHCI_SIG_ATA) continue;
+
+        ahci_port_t* port = &ahci_ports[ahci_port_num];
+        memset(port, 0, sizeof(ahci_port_t));
+        port->regs = regs;
+        port->index = i;
+
+        if (!ahci_port_setup(port, ahci_port_num)) continue;
+        if (!ahci_identify(port, cap) || !ahci_register_blkdev(port, ahci_port_num)) {
+            ahci_port_stop(regs);
+            continue;
+        }
+
+        char size_str[16];
+        char depth_str[16];
+        int_to_string((int)(port->size >> 11), size_str); // 显示MB
+        int_to_string(port->depth, depth_str);
+        print_string("发现SATA磁盘: ");
+        print_string((char*)port->model);
+        print_string(", 容量: ");
+        print_string(size_str);
+        print_string("MB, 队列深度: ");
+        print_string(depth_str);
+        print_newline();
+
+        ahci_port_num++;
+    }
+
+    if (ahci_port_num > 0) {
+        ahci_enable_irq(&pdev);
+    }
+}
+
+// 已发现的SATA磁盘数量
+int ahci_count() {
+    return ahci_port_num;
+}
+
+// 按发现顺序获取SATA磁盘对应的块设备
+blkdev_t* ahci_get_blkdev(int index) {
+    if (index < 0 || index >= ahci_port_num) {
+        return 0;
+    }
+    return &ahci_ports[index].blk;
+}
@@ -0,0 +1,190 @@
+#ifndef AHCI_H
+#define AHCI_H
+
+#include <stdint.h>
+#include "blkdev.h"
+
+// AHCI SATA控制器驱动定义
+#define AHCI_MAX_PORTS       4          // 最多驱动的SATA磁盘数
+#define AHCI_MAX_SLOTS       32         // 每个端口的命令槽数上限
+#define AHCI_PRDT_MAX        BLKQ_MAX_IOV // 每个命令表的PRD项数，一段缓冲区一项
+#define AHCI_PRD_MAX_BYTES   0x400000   // 单个PRD项最多描述4MB
+#define AHCI_MAX_SECTORS     8192       // 同步读写时单条命令的扇区数 (一个PRD项)
+
+// 超时
+#define AHCI_POLL_TIMEOUT    1000000    // 轮询等待的最大循环次数
+#define AHCI_CMD_TIMEOUT     500        // 异步命令的最大滴答数 (100Hz下约5秒)
+
+// PCI编程接口: AHCI 1.0
+#define AHCI_PROG_IF         0x01
+
+// HBA能力寄存器 (CAP)
+#define AHCI_CAP_SNCQ        (1u << 30) // 支持NCQ
+#define AHCI_CAP_SSS         (1u << 27) // 支持交错启动
+#define AHCI_CAP_NCS(cap)    ((((cap) >> 8) & 0x1F) + 1) // 每端口命令槽数
+
+// 全局控制寄存器 (GHC)
+#define AHCI_GHC_IE          (1u << 1)  // 全局中断允许
+#define AHCI_GHC_AE          (1u << 31) // AHCI模式
+
+// 端口命令寄存器 (PxCMD)
+#define AHCI_PCMD_ST         0x0001     // 开始处理命令列表
+#define AHCI_PCMD_SUD        0x0002     // 启动设备
+#define AHCI_PCMD_POD        0x0004     // 给设备上电
+#define AHCI_PCMD_FRE        0x0010     // 允许接收FIS
+#define AHCI_PCMD_FR         0x4000     // FIS接收正在运行
+#define AHCI_PCMD_CR         0x8000     // 命令列表正在运行
+
+// 端口中断状态/允许 (PxIS/PxIE)
+#define AHCI_PIS_DHRS        (1u << 0)  // 收到D2H寄存器FIS
+#define AHCI_PIS_PSS         (1u << 1)  // 收到PIO Setup FIS
+#define AHCI_PIS_DSS         (1u << 2)  // 收到DMA Setup FIS
+#define AHCI_PIS_SDBS        (1u << 3)  // 收到Set Device Bits FIS (NCQ完成)
+#define AHCI_PIS_IFS         (1u << 27) // 接口致命错误
+#define AHCI_PIS_HBDS        (1u << 28) // 主机总线数据错误
+#define AHCI_PIS_HBFS        (1u << 29) // 主机总线致命错误
+#define AHCI_PIS_TFES        (1u << 30) // 任务文件错误
+#define AHCI_PIS_ERROR       (AHCI_PIS_IFS | AHCI_PIS_HBDS | AHCI_PIS_HBFS | AHCI_PIS_TFES)
+
+// 端口任务文件 (PxTFD) 中的ATA状态
+#define AHCI_TFD_ERR         0x01
+#define AHCI_TFD_DRQ         0x08
+#define AHCI_TFD_DF          0x20
+#define AHCI_TFD_BSY         0x80
+
+// 端口SATA状态 (PxSSTS)
+#define AHCI_SSTS_DET(s)     ((s) & 0x0F)
+#define AHCI_SSTS_IPM(s)     (((s) >> 8) & 0x0F)
+#define AHCI_DET_PRESENT     3          // 设备存在且已建立通信
+#define AHCI_IPM_ACTIVE      1          // 接口处于活动状态
+
+// 端口签名 (PxSIG)
+#define AHCI_SIG_ATA         0x00000101
+
+// FIS类型
+#define FIS_TYPE_REG_H2D     0x27
+#define FIS_TYPE_REG_D2H     0x34
+#define FIS_H2D_COMMAND      0x80       // C位: 本FIS携带命令
+
+// 命令头标志
+#define AHCI_CMDH_WRITE      (1 << 6)   // 数据方向: 内存写到设备
+
+// 端口寄存器，每个端口0x80字节
+typedef volatile struct {
+    uint32_t clb;              // 命令列表基址 (1KB对齐)
+    uint32_t clbu;
+    uint32_t fb;               // FIS接收区基址 (256字节对齐)
+    uint32_t fbu;
+    uint32_t is;               // 中断状态 (写1清除)
+    uint32_t ie;               // 中断允许
+    uint32_t cmd;              // 命令与状态
+    uint32_t reserved0;
+    uint32_t tfd;              // 任务文件数据
+    uint32_t sig;              // 设备签名
+    uint32_t ssts;             // SATA状态
+    uint32_t sctl;             // SATA控制
+    uint32_t serr;             // SATA错误 (写1清除)
+    uint32_t sact;             // NCQ在途命令
+    uint32_t ci;               // 命令发出
+    uint32_t sntf;
+    uint32_t fbs;
+    uint32_t reserved1[11];
+    uint32_t vendor[4];
+} ahci_port_regs_t;
+
+// HBA内存寄存器 (PCI BAR5, ABAR)
+typedef volatile struct {
+    uint32_t cap;              // 能力
+    uint32_t ghc;              // 全局控制
+    uint32_t is;               // 各端口的中断挂起位 (写1清除)
+    uint32_t pi;               // 实现的端口
+    uint32_t vs;               // 版本
+    uint32_t ccc_ctl;
+    uint32_t ccc_ports;
+    uint32_t em_loc;
+    uint32_t em_ctl;
+    uint32_t cap2;
+    uint32_t bohc;
+    uint8_t reserved[0xA0 - 0x2C];
+    uint8_t vendor[0x100 - 0xA0];
+    ahci_port_regs_t ports[32];
+} ahci_hba_t;
+
+// 命令头，命令列表中每个槽一项
+typedef struct {
+    uint16_t flags;            // 位0-4为命令FIS的双字数，位6为写
+    uint16_t prdtl;            // PRD项数
+    volatile uint32_t prdbc;   // 已传输的字节数
+    uint32_t ctba;             // 命令表物理地址 (128字节对齐)
+    uint32_t ctbau;
+    uint32_t reserved[4];
+} __attribute__((packed)) ahci_cmd_header_t;
+
+// 物理区域描述符
+typedef struct {
+    uint32_t dba;              // 数据物理地址 (字对齐)
+    uint32_t dbau;
+    uint32_t reserved;
+    uint32_t dbc;              // 位0-21为字节数减1，位31为完成时中断
+} __attribute__((packed)) ahci_prd_t;
+
+// 命令表: 命令FIS后接PRD表
+typedef struct {
+    uint8_t cfis[64];          // 命令FIS
+    uint8_t acmd[16];          // ATAPI命令
+    uint8_t reserved[48];
+    ahci_prd_t prdt[AHCI_PRDT_MAX];
+} __attribute__((packed)) ahci_cmd_table_t;
+
+// 主机到设备的寄存器FIS
+typedef struct {
+    uint8_t type;              // FIS_TYPE_REG_H2D
+    uint8_t flags;             // FIS_H2D_COMMAND
+    uint8_t command;
+    uint8_t feature_low;
+    uint8_t lba0;
+    uint8_t lba1;
+    uint8_t lba2;
+    uint8_t device;
+    uint8_t lba3;
+    uint8_t lba4;
+    uint8_t lba5;
+    uint8_t feature_high;
+    uint8_t count_low;
+    uint8_t count_high;
+    uint8_t icc;
+    uint8_t control;
+    uint8_t reserved[4];
+} __attribute__((packed)) fis_reg_h2d_t;
+
+// SATA磁盘 (AHCI端口)
+typedef struct {
+    ahci_port_regs_t* regs;    // 端口寄存器
+    int index;                 // HBA上的端口号
+    uint64_t size;             // 扇区数量
+    uint8_t lba48;             // 是否支持48位LBA
+    uint8_t ncq;               // 是否使用NCQ (READ/WRITE FPDMA QUEUED)
+    uint8_t fua;               // 非NCQ时是否支持WRITE DMA FUA EXT
+    uint8_t trim;              // 是否支持DATA SET MANAGEMENT TRIM
+    uint8_t use_irq;           // 是否由中断通知命令完成
+    int depth;                 // 可同时在途的命令数
+    ahci_cmd_header_t* cmd_list;     // 命令列表
+    uint8_t* fis;                    // FIS接收区
+    ahci_cmd_table_t* tables;        // 每个槽的命令表
+    volatile uint32_t active;        // 在途命令的槽位掩码
+    uint32_t flush_pending;          // 数据完成后还要刷新缓存的槽位 (驱动器不支持的FUA写)
+    uint32_t cmd_tick[AHCI_MAX_SLOTS]; // 各槽命令开始的滴答，用于超时
+    uint8_t model[41];         // 型号字符串
+    blkdev_t blk;              // 注册到块设备层的设备
+} ahci_port_t;
+
+// 探测AHCI控制器并把其上的SATA磁盘注册为块设备 "sda"、"sdb"...
+void ahci_init();
+
+// 已发现的SATA磁盘数量
+int ahci_count();
+
+// 按发现顺序获取SATA磁盘对应的块设备
+blkdev_t* ahci_get_blkdev(int index);
+
+#endif // AHCI_H
@@ -0,0 +1,740 @@
+#include "bcache.h"
+#include "string.h"
+
+static bcache_buf_t bcache_bufs[BCACHE_BUFFERS];
+static uint8_t bcache_data[BCACHE_BUFFERS][BLKDEV_SECTOR_SIZE];
+static bcache_buf_t* bcache_hash[1 << BCACHE_HASH_BITS];
+static bcache_buf_t* bcache_lru_head = 0;
+static bcache_buf_t* bcache_lru_tail = 0;
+static bcache_buf_t* bcache_dirty_head = 0;     // 最早变脏的
+static bcache_buf_t* bcache_dirty_tail = 0;
+static bcache_buf_t* bcache_ra_head = 0;        // 预读在途的缓冲区
+static bcache_stream_t bcache_streams[BCACHE_RA_STREAMS];
+static uint32_t bcache_stream_clock = 0;
+static bcache_stats_t bcache_stats;
+static bcache_buf_t* bcache_wb_list[BCACHE_BUFFERS];    // 本次要写回的缓冲区
+static volatile uint32_t bcache_ticks = 0;      // 由时钟中断推进
+static volatile int bcache_wb_due = 0;          // 到了检查到期脏扇区的时间
+static uint32_t bcache_dirty_expire = BCACHE_DIRTY_EXPIRE;
+static uint32_t bcache_dirty_limit = BCACHE_DIRTY_LIMIT;
+static int bcache_ready = 0;
+
+// 从LRU链表中摘除
+static void bcache_lru_unlink(bcache_buf_t* b) {
+    if (b->lru_prev) b->lru_prev->lru_next = b->lru_next;
+    else bcache_lru_head = b->lru_next;
+    if (b->lru_next) b->lru_next->lru_prev = b->lru_prev;
+    else bcache_lru_tail = b->lru_prev;
+    b->lru_prev = b->lru_next = 0;
+}
+
+// 放到表头 (最近使用)
+static void bcache_lru_push_front(bcache_buf_t* b) {
+    b->lru_prev = 0;
+    b->lru_next = bcache_lru_head;
+    if (bcache_lru_head) bcache_lru_head->lru_prev = b;
+    else bcache_lru_tail = b;
+    bcache_lru_head = b;
+}
+
+// 放到表尾，空闲缓冲区最先被重新使用
+static void bcache_lru_push_back(bcache_buf_t* b) {
+    b->lru_next = 0;
+    b->lru_prev = bcache_lru_tail;
+    if (bcache_lru_tail) bcache_lru_tail->lru_next = b;
+    else bcache_lru_head = b;
+    bcache_lru_tail = b;
+}
+
+// 第一次使用时把所有缓冲区串成空闲的LRU链表
+static void bcache_init() {
+    memset(bcache_hash, 0, sizeof(bcache_hash));
+    memset(&bcache_stats, 0, sizeof(bcache_stats_t));
+    bcache_lru_head = bcache_lru_tail = 0;
+    bcache_dirty_head = bcache_dirty_tail = 0;
+    bcache_ra_head = 0;
+    memset(bcache_streams, 0, sizeof(bcache_streams));
+    for (int i = 0; i < BCACHE_BUFFERS; i++) {
+        bcache_buf_t* b = &bcache_bufs[i];
+        memset(b, 0, sizeof(bcache_buf_t));
+        b->data = bcache_data[i];
+        bcache_lru_push_back(b);
+    }
+    bcache_stats.buffers = BCACHE_BUFFERS;
+    bcache_ready = 1;
+}
+
+// 设备能否使用缓存 (缓冲区按512字节扇区划分)
+static int bcache_usable(blkdev_t* dev) {
+    if (!bcache_ready) bcache_init();
+    return dev && dev->sector_size == BLKDEV_SECTOR_SIZE;
+}
+
+static uint32_t bcache_hash_of(blkdev_t* dev, uint64_t lba) {
+    uint32_t h = ((uint32_t)lba ^ (uint32_t)(lba >> 32) ^ (uint32_t)(uintptr_t)dev) * 2654435761u;
+    return h >> (32 - BCACHE_HASH_BITS);
+}
+
+// 查找缓冲区，没有时返回NULL
+static bcache_buf_t* bcache_lookup(blkdev_t* dev, uint64_t lba) {
+    for (bcache_buf_t* b = bcache_hash[bcache_hash_of(dev, lba)]; b; b = b->hash_next) {
+        if (b->dev == dev && b->lba == lba) {
+            return b;
+        }
+    }
+    return 0;
+}
+
+// 命中后移到LRU表头
+static void bcache_touch(bcache_buf_t* b) {
+    if (b != bcache_lru_head) {
+        bcache_lru_unlink(b);
+        bcache_lru_push_front(b);
+    }
+}
+
+// 记录一次命中
+static void bcache_hit(bcache_buf_t* b) {
+    bcache_touch(b);
+    bcache_stats.hits++;
+    if (b->flags & BCACHE_AHEAD) {
+        b->flags &= ~BCACHE_AHEAD;
+        bcache_stats.ra_hits++;
+    }
+}
+
+// 设置脏标志，加到脏链表末尾
+static void bcache_set_dirty(bcache_buf_t* b) {
+    if (b->flags & BCACHE_DIRTY) {
+        return;
+    }
+    b->flags |= BCACHE_DIRTY;
+    b->dirty_tick = bcache_ticks;
+    b->dirty_next = 0;
+    b->dirty_prev = bcache_dirty_tail;
+    if (bcache_dirty_tail) bcache_dirty_tail->dirty_next = b;
+    else bcache_dirty_head = b;
+    bcache_dirty_tail = b;
+    bcache_stats.dirty++;
+}
+
+// 清除脏标志，从脏链表中摘除
+static void bcache_clean(bcache_buf_t* b) {
+    if (!(b->flags & BCACHE_DIRTY)) {
+        return;
+    }
+    b->flags &= ~BCACHE_DIRTY;
+    if (b->dirty_prev) b->dirty_prev->dirty_next = b->dirty_next;
+    else bcache_dirty_head = b->dirty_next;
+    if (b->dirty_next) b->dirty_next->dirty_prev = b->dirty_prev;
+    else bcache_dirty_tail = b->dirty_prev;
+    b->dirty_prev = b->dirty_next = 0;
+    bcache_stats.dirty--;
+}
+
+// 从哈希表中摘除并放回空闲位置，内容直接作废
+static void bcache_free(bcache_buf_t* b) {
+    bcache_buf_t** pp = &bcache_hash[bcache_hash_of(b->dev, b->lba)];
+    while (*pp != b) pp = &(*pp)->hash_next;
+    *pp = b->hash_next;
+    b->hash_next = 0;
+
+    bcache_clean(b);
+    b->dev = 0;
+    b->flags = 0;
+    bcache_stats.used--;
+    bcache_lru_unlink(b);
+    bcache_lru_push_back(b);
+}
+
+// 预读请求结束: 从在途链表摘除并放开引用，失败时缓冲区作废，成功返回1
+// 请求还没完成时先等待
+static int bcache_settle(bcache_buf_t* b) {
+    int ok = blkdev_wait(&b->req);
+
+    bcache_buf_t** pp = &bcache_ra_head;
+    while (*pp != b) pp = &(*pp)->ra_next;
+    *pp = b->ra_next;
+    b->ra_next = 0;
+
+    b->flags &= ~BCACHE_READING;
+    b->refcount--;
+    if (!ok) {
+        bcache_free(b);
+        return 0;
+    }
+    b->flags |= BCACHE_VALID;
+    return 1;
+}
+
+// 查找内容可用的缓冲区，预读在途的等它完成，读取失败的当作不在缓存中
+static bcache_buf_t* bcache_find(blkdev_t* dev, uint64_t lba) {
+    bcache_buf_t* b = bcache_lookup(dev, lba);
+    if (b && (b->flags & BCACHE_READING) && !bcache_settle(b)) {
+        return 0;
+    }
+    return b;
+}
+
+// 按 (设备, LBA) 排序，数量不超过缓冲区数，用插入排序
+static void bcache_sort(bcache_buf_t** list, int n) {
+    for (int i = 1; i < n; i++) {
+        bcache_buf_t* b = list[i];
+        int j = i;
+        while (j > 0 && ((uintptr_t)list[j - 1]->dev > (uintptr_t)b->dev ||
+                         (list[j - 1]->dev == b->dev && list[j - 1]->lba > b->lba))) {
+            list[j] = list[j - 1];
+            j--;
+        }
+        list[j] = b;
+    }
+}
+
+// 把同一设备上按LBA排好序的脏扇区作为异步请求提交，按向量命令的段数分组暂缓派发，
+// 让相邻的扇区合并成一条命令；有一个失败就全部保留脏标志，下次再写
+static int bcache_write_list(blkdev_t* dev, bcache_buf_t** list, int n) {
+    int plugged = dev->plugged;
+    int ok = 1;
+
+    for (int i = 0; i < n; i += BLKQ_MAX_IOV) {
+        int m = n - i < BLKQ_MAX_IOV ? n - i : BLKQ_MAX_IOV;
+
+        blkdev_plug(dev);
+        for (int j = i; j < i + m; j++) {
+            if (!blkdev_write_async(dev, list[j]->lba, 1, list[j]->data)) {
+                ok = 0;
+            }
+        }
+        blkdev_unplug(dev);
+    }
+    dev->plugged = plugged;
+
+    if (!blkdev_drain(dev) || !ok) {
+        return 0;
+    }
+    for (int i = 0; i < n; i++) {
+        bcache_clean(list[i]);
+    }
+    bcache_stats.writebacks += n;
+    return 1;
+}
+
+// 写回设备的全部脏扇区
+static int bcache_writeback(blkdev_t* dev) {
+    int n = 0;
+
+    for (bcache_buf_t* b = bcache_dirty_head; b; b = b->dirty_next) {
+        if (b->dev == dev) {
+            bcache_wb_list[n++] = b;
+        }
+    }
+    if (n == 0) {
+        return 1;
+    }
+    bcache_sort(bcache_wb_list, n);
+    return bcache_write_list(dev, bcache_wb_list, n);
+}
+
+// 为扇区分配缓冲区: 从LRU表尾找一个没有持有者的，脏的先连同同一设备的其他脏扇区一起写回
+// 所有缓冲区都被持有或写回失败时返回NULL
+static bcache_buf_t* bcache_alloc(blkdev_t* dev, uint64_t lba) {
+    bcache_buf_t* b = bcache_lru_tail;
+
+    while (b && b->refcount > 0) {
+        b = b->lru_prev;
+    }
+    if (!b) {
+        return 0;
+    }
+
+    if (b->dev) {
+        if ((b->flags & BCACHE_DIRTY) && !bcache_writeback(b->dev)) {
+            return 0;
+        }
+        bcache_free(b);
+        bcache_stats.evictions++;
+    }
+
+    uint32_t h = bcache_hash_of(dev, lba);
+    b->dev = dev;
+    b->lba = lba;
+    b->flags = 0;
+    b->hash_next = bcache_hash[h];
+    bcache_hash[h] = b;
+    bcache_stats.used++;
+    bcache_touch(b);
+    return b;
+}
+
+// 作废一段扇区的缓存，被持有的缓冲区保留，预读在途的等它完成后作废
+// 范围比缓存还大时扫描全部缓冲区，否则逐个扇区查找
+static void bcache_drop(blkdev_t* dev, uint64_t lba, uint64_t count) {
+    if (count > BCACHE_BUFFERS) {
+        for (int i = 0; i < BCACHE_BUFFERS; i++) {
+            bcache_buf_t* b = &bcache_bufs[i];
+            if (b->dev != dev || b->lba < lba || b->lba - lba >= count) continue;
+            if ((b->flags & BCACHE_READING) && !bcache_settle(b)) continue;
+            if (b->refcount == 0) bcache_free(b);
+        }
+        return;
+    }
+
+    for (uint32_t i = 0; i < (uint32_t)count; i++) {
+        bcache_buf_t* b = bcache_find(dev, lba + i);
+        if (b && b->refcount == 0) {
+            bcache_free(b);
+        }
+    }
+}
+
+// 按调用者的优先级读写设备: 元数据用BLK_PRIO_META，其余用BLK_PRIO_SYNC
+static int bcache_dev_read(blkdev_t* dev, uint64_t lba, uint32_t count, void* buf, int meta) {
+    return meta ? blkdev_read_meta(dev, lba, count, buf) : blkdev_read(dev, lba, count, buf);
+}
+
+static int bcache_dev_write(blkdev_t* dev, uint64_t lba, uint32_t count, const void* buf, int meta) {
+    return meta ? blkdev_write_meta(dev, lba, count, buf) : blkdev_write(dev, lba, count, buf);
+}
+
+// 读入一段未命中的连续扇区，需要时装入缓存
+static int bcache_fill(blkdev_t* dev, uint64_t lba, uint32_t count, uint8_t* buf, int install, int async, int meta) {
+    if (async) {
+        return blkdev_read_async(dev, lba, count, buf);
+    }
+    if (!bcache_dev_read(dev, lba, count, buf, meta)) {
+        return 0;
+    }
+    if (install) {
+        for (uint32_t i = 0; i < count; i++) {
+            bcache_buf_t* b = bcache_alloc(dev, lba + i);
+            if (!b) break;
+            memcpy(b->data, buf + i * BLKDEV_SECTOR_SIZE, BLKDEV_SECTOR_SIZE);
+            b->flags = BCACHE_VALID;
+        }
+    }
+    return 1;
+}
+
+// 按命中与否把范围分段: 命中的扇区复制出来，两段命中之间未命中的扇区一次读入
+static int bcache_read_range(blkdev_t* dev, uint64_t lba, uint32_t count, uint8_t* buf, int install, int async, int meta) {
+    uint64_t miss_lba = 0;
+    uint32_t miss_count = 0;
+    uint8_t* miss_buf = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        bcache_buf_t* b = bcache_find(dev, lba + i);
+        uint8_t* p = buf + i * BLKDEV_SECTOR_SIZE;
+
+        if (!b) {
+            if (miss_count == 0) {
+                miss_lba = lba + i;
+                miss_buf = p;
+            }
+            miss_count++;
+            bcache_stats.misses++;
+            continue;
+        }
+
+        // 先复制命中的扇区，装入前面未命中的扇区时可能会把它替换掉
+        memcpy(p, b->data, BLKDEV_SECTOR_SIZE);
+        bcache_hit(b);
+        if (miss_count && !bcache_fill(dev, miss_lba, miss_count, miss_buf, install, async, meta)) {
+            return 0;
+        }
+        miss_count = 0;
+    }
+
+    if (miss_count) {
+        return bcache_fill(dev, miss_lba, miss_count, miss_buf, install, async, meta);
+    }
+    return 1;
+}
+
+// 收回已经完成的预读
+static void bcache_ra_reap() {
+    bcache_buf_t* next;
+    for (bcache_buf_t* b = bcache_ra_head; b; b = next) {
+        next = b->ra_next;
+        if (b->req.status != BLK_REQ_PENDING) {
+            bcache_settle(b);
+        }
+    }
+}
+
+// 把[lba, end)中不在缓存中的扇区异步读进缓存，每个缓冲区一个请求，
+// 按向量命令的段数分组暂缓派发，让相邻的请求合并成一条命令
+// 缓冲区不够时提前停止，返回实际预读到的位置
+static uint64_t bcache_prefetch(blkdev_t* dev, uint64_t lba, uint64_t end) {
+    bcache_buf_t* group[BLKQ_MAX_IOV];
+    int plugged = dev->plugged;
+    int full = 0;
+
+    while (lba < end && !full) {
+        // 先分配一组缓冲区: 淘汰脏缓冲区时要写回，不能在暂缓派发期间进行
+        int n = 0;
+        for (; lba < end && n < BLKQ_MAX_IOV; lba++) {
+            if (bcache_lookup(dev, lba)) {
+                continue;
+            }
+            bcache_buf_t* b = bcache_alloc(dev, lba);
+            if (!b) {
+                full = 1;
+                break;
+            }
+
+            // 在途期间持有引用，不会被淘汰
+            b->flags = BCACHE_READING | BCACHE_AHEAD;
+            b->refcount++;
+            b->ra_next = bcache_ra_head;
+            bcache_ra_head = b;
+            group[n++] = b;
+        }
+
+        blkdev_plug(dev);
+        for (int i = 0; i < n; i++) {
+            blk_request_t* req = &group[i]->req;
+            req->dev = dev;
+            req->lba = group[i]->lba;
+            req->count = 1;
+            req->buffer = group[i]->data;
+            req->write = 0;
+            req->fua = 0;
+            req->prio = BLK_PRIO_BULK;
+            req->end_io = 0;
+            req->priv = 0;
+            blkdev_submit(req);
+        }
+        blkdev_unplug(dev);
+        bcache_stats.readahead += n;
+    }
+
+    dev->plugged = plugged;
+    return lba;
+}
+
+// 读取是否用到了设备: 有未命中的扇区，或者读到了预读进来的扇区
+// 全部命中普通缓存 (如刚写过的数据) 时不需要预读
+static int bcache_cold(blkdev_t* dev, uint64_t lba, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        bcache_buf_t* b = bcache_lookup(dev, lba + i);
+        if (!b || (b->flags & BCACHE_AHEAD)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// 顺序读检测: 读取紧接着某个流上一次结束的位置时确认为顺序读，预读一个初始窗口；
+// 之后预读的部分用掉一半就把窗口加倍 (不超过BCACHE_RA_MAX) 再往前预读
+// 同步驱动 (软驱、内存盘、没有中断的ATA等) 不预读: 提交的请求不会在后台执行，
+// 只会排到下一次等待时才派发
+static void bcache_readahead(blkdev_t* dev, uint64_t lba, uint32_t count) {
+    bcache_stream_t* st = 0;
+    bcache_stream_t* victim = &bcache_streams[0];
+    uint64_t end = lba + count;
+
+    if (!dev->ops->start) {
+        return;
+    }
+
+    bcache_ra_reap();
+    for (int i = 0; i < BCACHE_RA_STREAMS; i++) {
+        bcache_stream_t* s = &bcache_streams[i];
+        if (s->dev == dev && s->next == end && lba < end) {
+            s->last_use = ++bcache_stream_clock;
+            return;     // 重读上一次读过的部分 (如逐段读取同一个扇区)，流的位置不变
+        }
+        if (s->dev == dev && s->next == lba) {
+            st = s;
+            break;
+        }
+        if (s->last_use < victim->last_use) {
+            victim = s;
+        }
+    }
+
+    if (!st) {
+        // 新的流，等下一次读取确认
+        victim->dev = dev;
+        victim->next = end;
+        victim->ahead = end;
+        victim->window = 0;
+        victim->last_use = ++bcache_stream_clock;
+        return;
+    }
+
+    st->next = end;
+    st->last_use = ++bcache_stream_clock;
+    if (st->ahead < end) {
+        st->ahead = end;
+    }
+    if (!bcache_cold(dev, lba, count)) {
+        return;
+    }
+    if (st->window == 0) {
+        st->window = BCACHE_RA_MIN;
+    } else if (st->ahead - end >= st->window / 2) {
+        return;
+    } else if (st->window < BCACHE_RA_MAX) {
+        st->window *= 2;
+    }
+
+    uint64_t stop = end + st->window;
+    if (stop > dev->capacity) {
+        stop = dev->capacity;
+    }
+    if (st->ahead < stop) {
+        st->ahead = bcache_prefetch(dev, st->ahead, stop);
+    }
+}
+
+// 读取扇区，meta为1时未命中的扇区按元数据优先级读取
+static int bcache_read_prio(blkdev_t* dev, uint64_t lba, uint32_t count, void* buffer, int meta) {
+    if (!bcache_usable(dev)) {
+        return bcache_dev_read(dev, lba, count, buffer, meta);
+    }
+    if (!buffer || count == 0 || lba >= dev->capacity || count > dev->capacity - lba) {
+        return 0;
+    }
+    if (count < BCACHE_BYPASS_SECTORS) {
+        bcache_readahead(dev, lba, count);
+    }
+    return bcache_read_range(dev, lba, count, (uint8_t*)buffer, count < BCACHE_BYPASS_SECTORS, 0, meta);
+}
+
+int bcache_read(blkdev_t* dev, uint64_t lba, uint32_t count, void* buffer) {
+    return bcache_read_prio(dev, lba, count, buffer, 0);
+}
+
+int bcache_read_meta(blkdev_t* dev, uint64_t lba, uint32_t count, void* buffer) {
+    return bcache_read_prio(dev, lba, count, buffer, 1);
+}
+
+// 异步读取，未命中的不装入缓存，顺序读同样触发预读
+int bcache_read_async(blkdev_t* dev, uint64_t lba, uint32_t count, void* buffer) {
+    if (!bcache_usable(dev)) {
+        return blkdev_read_async(dev, lba, count, buffer);
+    }
+    if (!buffer || count == 0 || lba >= dev->capacity || count > dev->capacity - lba) {
+        return 0;
+    }
+    if (count < BCACHE_BYPASS_SECTORS) {
+        bcache_readahead(dev, lba, count);
+    }
+    return bcache_read_range(dev, lba, count, (uint8_t*)buffer, 0, 1, 0);
+}
+
+// 写入扇区: 大块写入直接写设备并作废旧的副本，其余写进缓存
+// 没有可用的缓冲区时该扇区直接写设备，meta为1时按元数据优先级
+static int bcache_write_prio(blkdev_t* dev, uint64_t lba, uint32_t count, const void* buffer, int meta) {
+    const uint8_t* buf = (const uint8_t*)buffer;
+
+    if (!bcache_usable(dev)) {
+        return bcache_dev_write(dev, lba, count, buffer, meta);
+    }
+    if (!buffer || count == 0 || lba >= dev->capacity || count > dev->capacity - lba || !dev->ops->write) {
+        return 0;
+    }
+    if (count >= BCACHE_BYPASS_SECTORS) {
+        bcache_drop(dev, lba, count);
+        return bcache_dev_write(dev, lba, count, buffer, meta);
+    }
+
+    for (uint32_t i = 0; i < count; i++, buf += BLKDEV_SECTOR_SIZE) {
+        bcache_buf_t* b = bcache_find(dev, lba + i);
+        if (b) {
+            bcache_touch(b);
+        } else if (!(b = bcache_alloc(dev, lba + i))) {
+            if (!bcache_dev_write(dev, lba + i, 1, buf, meta)) return 0;
+            continue;
+        }
+
+        memcpy(b->data, buf, BLKDEV_SECTOR_SIZE);
+        b->flags |= BCACHE_VALID;
+        bcache_set_dirty(b);
+    }
+
+    // 写入者承担到期和超限的写回，一直没有空闲时落盘的延迟也有上限
+    bcache_writeback_run();
+    return 1;
+}
+
+int bcache_write(blkdev_t* dev, uint64_t lba, uint32_t count, const void* buffer) {
+    return bcache_write_prio(dev, lba, count, buffer, 0);
+}
+
+int bcache_write_meta(blkdev_t* dev, uint64_t lba, uint32_t count, const void* buffer) {
+    return bcache_write_prio(dev, lba, count, buffer, 1);
+}
+
+// FUA写入: 数据先直接写到设备，成功后缓存中的副本才更新为干净的
+// 失败时设备上的内容不确定: 干净的副本作废，脏的保留，之后照常写回
+int bcache_write_fua(blkdev_t* dev, uint64_t lba, uint32_t count, const void* buffer) {
+    const uint8_t* buf = (const uint8_t*)buffer;
+    int ok = blkdev_write_fua(dev, lba, count, buffer);
+
+    if (!bcache_usable(dev)) {
+        return ok;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        bcache_buf_t* b = bcache_find(dev, lba + i);
+        if (!b) continue;
+        if (ok) {
+            memcpy(b->data, buf + i * BLKDEV_SECTOR_SIZE, BLKDEV_SECTOR_SIZE);
+            bcache_clean(b);
+        } else if (!(b->flags & BCACHE_DIRTY) && b->refcount == 0) {
+            bcache_free(b);
+        }
+    }
+    return ok;
+}
+
+// 写回脏扇区并刷新设备写缓存
+int bcache_flush(blkdev_t* dev) {
+    if (!bcache_usable(dev)) {
+        return blkdev_flush(dev);
+    }
+
+    int ok = bcache_writeback(dev);
+    if (!blkdev_flush(dev)) {
+        ok = 0;
+    }
+    return ok;
+}
+
+// 丢弃扇区
+int bcache_discard(blkdev_t* dev, uint64_t lba, uint32_t count) {
+    if (bcache_usable(dev)) {
+        bcache_drop(dev, lba, count);
+
+        // 待发的丢弃已满时块设备层会立即下发，先把释放这些扇区的元数据写回
+        if (dev->discard_count >= BLKDEV_DISCARD_RANGES && !bcache_flush(dev)) {
+            return 0;
+        }
+    }
+    return blkdev_discard(dev, lba, count);
+}
+
+// 作废设备的全部缓存
+void bcache_invalidate(blkdev_t* dev) {
+    if (bcache_usable(dev)) {
+        bcache_drop(dev, 0, dev->capacity);
+    }
+}
+
+// 取得扇区的缓冲区
+bcache_buf_t* bcache_bread(blkdev_t* dev, uint64_t lba) {
+    if (!bcache_usable(dev) || lba >= dev->capacity) {
+        return 0;
+    }
+
+    bcache_buf_t* b = bcache_find(dev, lba);
+    if (b) {
+        bcache_hit(b);
+    } else {
+        b = bcache_alloc(dev, lba);
+        if (!b) {
+            return 0;
+        }
+        if (!blkdev_read_meta(dev, lba, 1, b->data)) {
+            bcache_free(b);
+            return 0;
+        }
+        b->flags = BCACHE_VALID;
+        bcache_stats.misses++;
+    }
+
+    b->refcount++;
+    return b;
+}
+
+// 标记缓冲区已修改
+void bcache_mark_dirty(bcache_buf_t* buf) {
+    bcache_set_dirty(buf);
+}
+
+// 释放对缓冲区的引用
+void bcache_release(bcache_buf_t* buf) {
+    if (buf && buf->refcount > 0) {
+        buf->refcount--;
+    }
+}
+
+// 设置后台写回参数
+void bcache_set_writeback(uint32_t expire, uint32_t limit) {
+    bcache_dirty_expire = expire;
+    bcache_dirty_limit = limit;
+}
+
+// 时钟中断: 推进计时，每BCACHE_WB_INTERVAL个滴答请求一次检查
+void bcache_timer_tick() {
+    bcache_ticks++;
+    if (bcache_ticks % BCACHE_WB_INTERVAL == 0) {
+        bcache_wb_due = 1;
+    }
+}
+
+// 后台写回: 脏链表按变脏的先后排列，从表头取出到期的扇区；超过上限时
+// 继续取最老的直到剩下上限的一半。写完后刷新涉及的设备，设备上有待发的
+// 丢弃时先写回它的全部脏扇区，保证释放块的元数据先于丢弃落盘
+int bcache_writeback_run() {
+    blkdev_t* devs[BLKDEV_MAX];
+    int ndevs = 0;
+    int ok = 1;
+    int n = 0;
+
+    if (!bcache_ready || !bcache_dirty_head) {
+        return 1;
+    }
+    int over = bcache_stats.dirty > bcache_dirty_limit;
+    if (!over && !bcache_wb_due) {
+        return 1;
+    }
+    bcache_wb_due = 0;
+
+    uint32_t keep = over ? bcache_dirty_limit / 2 : bcache_stats.dirty;
+    uint32_t now = bcache_ticks;
+    for (bcache_buf_t* b = bcache_dirty_head; b; b = b->dirty_next) {
+        if (bcache_stats.dirty - n > keep) {
+            bcache_stats.throttled++;
+        } else if (bcache_dirty_expire && now - b->dirty_tick >= bcache_dirty_expire) {
+            bcache_stats.expired++;
+        } else {
+            break;
+        }
+        bcache_wb_list[n++] = b;
+    }
+    if (n == 0) {
+        return 1;
+    }
+
+    // 排序后同一设备的扇区连在一起，逐个设备提交
+    bcache_sort(bcache_wb_list, n);
+    for (int i = 0; i < n;) {
+        blkdev_t* dev = bcache_wb_list[i]->dev;
+        int j = i;
+        while (j < n && bcache_wb_list[j]->dev == dev) j++;
+        if (!bcache_write_list(dev, bcache_wb_list + i, j - i)) {
+            ok = 0;
+        }
+        if (ndevs < BLKDEV_MAX) {
+            devs[ndevs++] = dev;
+        }
+        i = j;
+    }
+
+    // bcache_flush会重新使用写回列表，放在全部提交之后
+    for (int i = 0; i < ndevs; i++) {
+        if (!(devs[i]->discard_count ? bcache_flush(devs[i]) : blkdev_flush(devs[i]))) {
+            ok = 0;
+        }
+    }
+    return ok;
+}
+
+// 读取缓存统计
+void bcache_get_stats(bcache_stats_t* stats) {
+    if (!bcache_ready) bcache_init();
+    memcpy(stats, &bcache_stats, sizeof(bcache_stats_t));
+}
@@ -0,0 +1,115 @@
+#ifndef BCACHE_H
+#define BCACHE_H
+
+#include <stdint.h>
+#include "blkdev.h"
+
+// 缓冲区缓存定义: 所有文件系统共用，按 (设备, 扇区) 缓存元数据和小块数据
+#define BCACHE_BUFFERS        512        // 缓冲区数，每个一个扇区 (共256KB)
+#define BCACHE_HASH_BITS      9          // 哈希桶数为2^9
+#define BCACHE_BYPASS_SECTORS 64         // 一次读写达到这么多扇区时不装入缓存，避免冲掉元数据
+#define BCACHE_RA_STREAMS     4          // 同时跟踪的顺序读流
+#define BCACHE_RA_MIN         8          // 确认顺序读后的初始预读窗口 (扇区)
+#define BCACHE_RA_MAX         64         // 预读窗口上限 (扇区)，每次预读后加倍
+#define BCACHE_WB_INTERVAL    50         // 后台写回的检查间隔 (时钟滴答，100Hz下0.5秒)
+#define BCACHE_DIRTY_EXPIRE   300        // 脏扇区默认最多在缓存中停留的滴答数 (3秒)
+#define BCACHE_DIRTY_LIMIT    (BCACHE_BUFFERS / 4)   // 脏扇区超过这么多时立即开始写回
+
+// 缓冲区标志
+#define BCACHE_VALID          0x01       // 内容与设备一致或比设备新
+#define BCACHE_DIRTY          0x02       // 比设备上的新，淘汰或刷新前要写回
+#define BCACHE_READING        0x04       // 预读请求在途，完成前内容无效
+#define BCACHE_AHEAD          0x08       // 预读进来后还没有被读到
+
+typedef struct bcache_buf bcache_buf_t;
+
+// 一个扇区的缓冲区
+struct bcache_buf {
+    blkdev_t* dev;                       // 所属设备，NULL表示空闲
+    uint64_t lba;
+    uint8_t* data;                       // 扇区内容
+    uint32_t flags;                      // BCACHE_*
+    int refcount;                        // 持有者数，不为0时不会被淘汰
+    bcache_buf_t* hash_next;             // 同一个哈希桶中的下一个
+    bcache_buf_t* lru_prev;              // LRU链表，表头是最近使用的
+    bcache_buf_t* lru_next;
+    bcache_buf_t* dirty_prev;            // 脏链表，按变脏的先后排列
+    bcache_buf_t* dirty_next;
+    uint32_t dirty_tick;                 // 变脏时的滴答数，写回前再次修改不更新
+    bcache_buf_t* ra_next;               // 预读在途链表
+    blk_request_t req;                   // 预读请求
+};
+
+// 顺序读流: 读取紧接着上一次结束的位置时认为是同一个流
+typedef struct {
+    blkdev_t* dev;                       // NULL表示空闲
+    uint64_t next;                       // 上一次读取结束的位置
+    uint64_t ahead;                      // 已经预读到的位置
+    uint32_t window;                     // 当前预读窗口 (扇区)，0表示还没确认是顺序读
+    uint32_t last_use;                   // 最近一次命中的序号，替换最久不用的流
+} bcache_stream_t;
+
+// 缓存统计
+typedef struct {
+    uint32_t buffers;                    // 缓冲区总数
+    uint32_t used;                       // 已缓存的扇区数
+    uint32_t dirty;                      // 脏扇区数
+    uint32_t hits;                       // 从缓存读到的扇区
+    uint32_t misses;                     // 从设备读的扇区
+    uint32_t evictions;                  // 被替换出去的扇区
+    uint32_t writebacks;                 // 写回设备的脏扇区
+    uint32_t readahead;                  // 预读的扇区
+    uint32_t ra_hits;                    // 预读后被读到的扇区
+    uint32_t expired;                    // 因到期被后台写回的扇区
+    uint32_t throttled;                  // 因超过脏扇区上限被写回的扇区
+} bcache_stats_t;
+
+// 读取扇区: 命中的从缓存复制，未命中的连续扇区一次读入并装入缓存
+// 连续的顺序读会触发异步预读，把后面的扇区提前读进缓存 (只对支持异步命令的驱动)
+// 扇区大小不是512字节的设备不经过缓存
+// bcache_read按BLK_PRIO_SYNC读取文件数据，bcache_read_meta按BLK_PRIO_META读取元数据
+int bcache_read(blkdev_t* dev, uint64_t lba, uint32_t count, void* buffer);
+int bcache_read_meta(blkdev_t* dev, uint64_t lba, uint32_t count, void* buffer);
+
+// 异步读取: 命中的立即复制，未命中的直接读进buffer且不装入缓存，blkdev_drain之后完成
+// 用于文件数据的整块读取，相邻的块由请求队列合并
+int bcache_read_async(blkdev_t* dev, uint64_t lba, uint32_t count, void* buffer);
+
+// 写入扇区: 只写进缓存并标记为脏，在bcache_flush、淘汰或后台写回时才落到设备
+// 直接写设备时 (大块写入、没有可用的缓冲区) 的优先级与读取相同
+int bcache_write(blkdev_t* dev, uint64_t lba, uint32_t count, const void* buffer);
+int bcache_write_meta(blkdev_t* dev, uint64_t lba, uint32_t count, const void* buffer);
+
+// FUA写入: 数据直接写到设备并在返回时已落盘，成功后更新缓存中的副本
+int bcache_write_fua(blkdev_t* dev, uint64_t lba, uint32_t count, const void* buffer);
+
+// 写回设备的全部脏扇区，再刷新设备写缓存
+int bcache_flush(blkdev_t* dev);
+
+// 丢弃扇区: 缓存中的副本 (包括脏的) 直接作废，再交给块设备层丢弃
+int bcache_discard(blkdev_t* dev, uint64_t lba, uint32_t count);
+
+// 作废设备的全部缓存，格式化等绕过缓存直接写设备之前调用
+void bcache_invalidate(blkdev_t* dev);
+
+// 取得扇区的缓冲区并增加引用计数，必要时从设备读入，失败返回NULL
+// 修改后调用bcache_mark_dirty，用完调用bcache_release
+bcache_buf_t* bcache_bread(blkdev_t* dev, uint64_t lba);
+void bcache_mark_dirty(bcache_buf_t* buf);
+void bcache_release(bcache_buf_t* buf);
+
+// 设置后台写回参数: 脏扇区停留超过expire个滴答后写回 (0表示不按时间写回)，
+// 脏扇区超过limit个时从最老的开始写回到一半
+void bcache_set_writeback(uint32_t expire, uint32_t limit);
+
+// 时钟中断中调用，只计时并标记该检查了，实际写回在bcache_writeback_run中进行
+void bcache_timer_tick();
+
+// 后台写回: 在空闲循环中调用，写入时也会调用；没有到期的扇区且未超过上限时立即返回
+// 写回的扇区按 (设备, LBA) 排序后提交，由请求队列合并相邻的扇区，完成后刷新设备写缓存
+int bcache_writeback_run();
+
+// 读取缓存统计
+void bcache_get_stats(bcache_stats_t* stats);
+
+#endif // BCACHE_H
@@ -0,0 +1,884 @@
+#include "blkdev.h"
+#include "string.h"
+#include "timer.h"
+
+// 已注册的块设备
+static blkdev_t* blkdev_table[BLKDEV_MAX];
+static int blkdev_num = 0;
+
+// 异步读写使用的请求池
+static blk_request_t blkq_pool[BLKQ_DEPTH];
+static uint8_t blkq_pool_used[BLKQ_DEPTH];
+
+// 合并后缓冲区不连续时的中转缓冲区，每个在途命令占用一个
+static uint8_t blkq_staging[BLKQ_STAGING_NUM][BLKQ_MERGE_MAX * BLKDEV_SECTOR_SIZE];
+static uint8_t blkq_staging_used[BLKQ_STAGING_NUM];
+
+// 队列会被IRQ中的完成处理修改，访问时关中断
+static inline uint32_t blkq_lock() {
+    uint32_t flags;
+    asm volatile("pushf; pop %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+static inline void blkq_unlock(uint32_t flags) {
+    if (flags & 0x200) {
+        asm volatile("sti" : : : "memory");
+    }
+}
+
+// 读取时间戳计数器，用于统计命令延迟
+static inline uint64_t blkq_rdtsc() {
+    uint32_t lo, hi;
+    asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+// 延迟所在的直方图桶: floor(log2(cycles))
+static int blkq_lat_bucket(uint64_t cycles) {
+    int bucket = 0;
+    while (cycles > 1 && bucket < BLKDEV_LAT_BUCKETS - 1) {
+        cycles >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+// 检查访问范围是否在设备容量之内
+static int blkdev_range_ok(blkdev_t* dev, uint64_t lba, uint32_t count) {
+    if (count == 0) return 0;
+    if (lba >= dev->capacity) return 0;
+    if (count > dev->capacity - lba) return 0;
+    return 1;
+}
+
+// 注册块设备
+int blkdev_register(blkdev_t* dev) {
+    if (!dev || !dev->ops || !dev->ops->read) {
+        return 0;
+    }
+
+    if (blkdev_num >= BLKDEV_MAX) {
+        return 0;
+    }
+
+    // 不允许重名或重复注册
+    for (int i = 0; i < blkdev_num; i++) {
+        if (blkdev_table[i] == dev || strcmp(blkdev_table[i]->name, dev->name) == 0) {
+            return 0;
+        }
+    }
+
+    if (dev->sector_size == 0) {
+        dev->sector_size = BLKDEV_SECTOR_SIZE;
+    }
+    
+    // 同步驱动一次只能执行一条命令
+    if (dev->depth <= 0 || !dev->ops->start) {
+        dev->depth = 1;
+    } else if (dev->depth > BLKQ_MAX_TAGS) {
+        dev->depth = BLKQ_MAX_TAGS;
+    }
+    
+    if (!dev->ops->discard || dev->max_discard < 0) {
+        dev->max_discard = 0;
+    } else if (dev->max_discard > BLKDEV_DISCARD_RANGES) {
+        dev->max_discard = BLKDEV_DISCARD_RANGES;
+    }
+    
+    dev->queue = 0;
+    dev->queue_len = 0;
+    dev->head_pos = 0;
+    dev->async_error = 0;
+    dev->plugged = 0;
+    memset(dev->starve, 0, sizeof(dev->starve));
+    dev->waiter = 0;
+    dev->busy = 0;
+    dev->dispatching = 0;
+    dev->discard_count = 0;
+    for (int i = 0; i < BLKQ_MAX_TAGS; i++) {
+        dev->cmds[i].reqs = 0;
+    }
+    memset(&dev->stats, 0, sizeof(blkdev_stats_t));
+
+    blkdev_table[blkdev_num++] = dev;
+    return 1;
+}
+
+// 按注册顺序获取块设备
+blkdev_t* blkdev_get(int index) {
+    if (index < 0 || index >= blkdev_num) {
+        return 0;
+    }
+    return blkdev_table[index];
+}
+
+// 按名称查找块设备
+blkdev_t* blkdev_find(const char* name) {
+    if (!name) return 0;
+
+    for (int i = 0; i < blkdev_num; i++) {
+        if (strcmp(blkdev_table[i]->name, name) == 0) {
+            return blkdev_table[i];
+        }
+    }
+    return 0;
+}
+
+// 已注册的块设备数量
+int blkdev_count() {
+    return blkdev_num;
+}
+
+// 两个请求的扇区范围是否重叠
+static int blkq_overlap(blk_request_t* a, blk_request_t* b) {
+    return a->lba < b->lba + b->count && b->lba < a->lba + a->count;
+}
+
+// 写入的扇区移出待丢弃范围，否则之后下发的丢弃会抹掉新数据
+// 范围被从中间截断而数组已满时舍弃后半段，丢弃只是提示
+static void blkq_discard_cancel(blkdev_t* dev, uint64_t lba, uint32_t count) {
+    uint64_t end = lba + count;
+    int i = 0;
+    
+    while (i < dev->discard_count) {
+        blk_range_t* r = &dev->discards[i];
+        uint64_t r_end = r->lba + r->count;
+        
+        if (r_end <= lba || r->lba >= end) {
+            i++;
+            continue;
+        }
+        
+        if (r->lba >= lba && r_end <= end) {
+            *r = dev->discards[--dev->discard_count];
+            continue;
+        }
+        
+        if (r->lba < lba) {
+            r->count = (uint32_t)(lba - r->lba);
+            if (r_end > end && dev->discard_count < BLKDEV_DISCARD_RANGES) {
+                blk_range_t* tail = &dev->discards[dev->discard_count++];
+                tail->lba = end;
+                tail->count = (uint32_t)(r_end - end);
+            }
+        } else {
+            r->lba = end;
+            r->count = (uint32_t)(r_end - end);
+        }
+        i++;
+    }
+}
+
+// 从队列中摘除请求
+static void blkq_unlink(blkdev_t* dev, blk_request_t* req) {
+    blk_request_t** pp = &dev->queue;
+    
+    while (*pp) {
+        if (*pp == req) {
+            *pp = req->next;
+            req->next = 0;
+            dev->queue_len--;
+            return;
+        }
+        pp = &(*pp)->next;
+    }
+}
+
+// 选出下一个派发的请求
+// 先检查是否有请求已超过期限 (取最早到期的)，否则在优先级最高的一类请求中
+// 按C-SCAN取磁头之后LBA最小的，磁头之后没有请求时回绕到最小LBA。LBA相同时保持提交顺序
+// 较低的每一类各自计数，有请求等待期间更高优先级连续派发超过BLKQ_STARVE_MAX条命令后
+// 让这一类派发一条；几类同时超限时等得最久的先派发
+static blk_request_t* blkq_pick(blkdev_t* dev) {
+    uint32_t now = get_tick_count();
+    blk_request_t* expired = 0;
+    blk_request_t* ahead[BLK_PRIO_NUM] = { 0 };
+    blk_request_t* lowest[BLK_PRIO_NUM] = { 0 };
+    
+    for (blk_request_t* r = dev->queue; r; r = r->next) {
+        int p = r->prio;
+        if ((int32_t)(now - r->deadline) >= 0) {
+            if (!expired || (int32_t)(r->deadline - expired->deadline) < 0) {
+                expired = r;
+            }
+        }
+        if (r->lba >= dev->head_pos && (!ahead[p] || r->lba < ahead[p]->lba)) {
+            ahead[p] = r;
+        }
+        if (!lowest[p] || r->lba < lowest[p]->lba) {
+            lowest[p] = r;
+        }
+    }
+    
+    if (expired) return expired;
+    
+    // 有请求的最高优先级
+    int best = 0;
+    while (!lowest[best]) best++;
+    
+    // 没有请求的类和最高一类不计数
+    int p = best;
+    for (int q = 0; q < BLK_PRIO_NUM; q++) {
+        if (q <= best || !lowest[q]) {
+            dev->starve[q] = 0;
+        } else if (++dev->starve[q] > BLKQ_STARVE_MAX &&
+                   (p == best || dev->starve[q] > dev->starve[p])) {
+            p = q;
+        }
+    }
+    dev->starve[p] = 0;
+    return ahead[p] ? ahead[p] : lowest[p];
+}
+
+// 申请一个中转缓冲区，没有空闲时返回-1
+static int blkq_staging_alloc() {
+    for (int i = 0; i < BLKQ_STAGING_NUM; i++) {
+        if (!blkq_staging_used[i]) {
+            blkq_staging_used[i] = 1;
+            return i;
+        }
+    }
+    return -1;
+}
+
+// 找一个空闲的tag，没有时返回-1
+static int blkq_free_tag(blkdev_t* dev) {
+    for (int i = 0; i < dev->depth; i++) {
+        if (!dev->cmds[i].reqs) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// 取出下一条命令: 选出请求并把紧跟其后的同方向请求合并进来
+// 合并结果按顺序链接在dev->cmds[tag].reqs上，调用时已关中断
+// 支持向量命令的驱动直接使用各请求的缓冲区，否则不相接时经过中转缓冲区
+static void blkq_prepare(blkdev_t* dev, int tag) {
+    blk_cmd_t* cmd = &dev->cmds[tag];
+    blk_request_t* first = blkq_pick(dev);
+    blk_request_t* last = first;
+    int vector = dev->ops->start != 0;
+    
+    blkq_unlink(dev, first);
+    
+    uint64_t end = first->lba + first->count;
+    uint32_t total = first->count;
+    int staging = -1;
+    
+    cmd->iov[0].base = first->buffer;
+    cmd->iov[0].len = first->count * dev->sector_size;
+    cmd->iovcnt = 1;
+    
+    // 向后合并相邻请求，合并后的总长不超过中转缓冲区
+    for (;;) {
+        blk_request_t* r;
+        for (r = dev->queue; r; r = r->next) {
+            if (r->write == first->write && r->lba == end &&
+                (total + r->count) * dev->sector_size <= sizeof(blkq_staging[0])) {
+                break;
+            }
+        }
+        if (!r) break;
+        
+        uint8_t* prev_end = (uint8_t*)last->buffer + last->count * dev->sector_size;
+        int adjacent = (uint8_t*)r->buffer == prev_end;
+        
+        if (vector) {
+            // 缓冲区相接时延长上一段，否则新开一段
+            if (adjacent) {
+                cmd->iov[cmd->iovcnt - 1].len += r->count * dev->sector_size;
+            } else if (cmd->iovcnt < BLKQ_MAX_IOV) {
+                cmd->iov[cmd->iovcnt].base = r->buffer;
+                cmd->iov[cmd->iovcnt].len = r->count * dev->sector_size;
+                cmd->iovcnt++;
+            } else {
+                break;
+            }
+        } else if (!adjacent) {
+            // 缓冲区在内存中不相接时需要中转缓冲区，没有空闲的就不再合并
+            if (staging < 0 && (staging = blkq_staging_alloc()) < 0) {
+                break;
+            }
+        }
+        
+        blkq_unlink(dev, r);
+        if (r->write) {
+            dev->stats.write_merges++;
+        } else {
+            dev->stats.read_merges++;
+        }
+        last->next = r;
+        last = r;
+        end += r->count;
+        total += r->count;
+    }
+    
+    cmd->reqs = first;
+    cmd->count = total;
+    cmd->staging = staging;
+    cmd->start_tsc = blkq_rdtsc();
+    dev->head_pos = end;
+    dev->busy++;
+}
+
+// 结束请求
+static void blkq_complete(blk_request_t* req, int ok) {
+    req->status = ok ? BLK_REQ_DONE : BLK_REQ_ERROR;
+    if (req->end_io) {
+        req->end_io(req);
+    }
+}
+
+// 驱动在命令完成时调用 (可以在IRQ中)，结束该tag上的请求并派发下一条
+void blkdev_end_tag(blkdev_t* dev, int tag, int ok) {
+    if (tag < 0 || tag >= BLKQ_MAX_TAGS) {
+        return;
+    }
+    
+    uint32_t flags = blkq_lock();
+    blk_cmd_t* cmd = &dev->cmds[tag];
+    blk_request_t* req = cmd->reqs;
+    int staging = cmd->staging;
+    
+    if (!req) {
+        blkq_unlock(flags);
+        return;
+    }
+    
+    // 读命令的数据从中转缓冲区分发给各个请求
+    if (ok && staging >= 0 && !req->write) {
+        uint32_t off = 0;
+        for (blk_request_t* r = req; r; r = r->next) {
+            memcpy(r->buffer, blkq_staging[staging] + off, r->count * dev->sector_size);
+            off += r->count * dev->sector_size;
+        }
+    }
+    if (staging >= 0) {
+        blkq_staging_used[staging] = 0;
+    }
+    
+    // 统计整条命令
+    blkdev_stats_t* st = &dev->stats;
+    if (!ok) {
+        st->errors++;
+    } else if (req->write) {
+        st->writes++;
+        st->write_sectors += cmd->count;
+    } else {
+        st->reads++;
+        st->read_sectors += cmd->count;
+    }
+    st->latency[blkq_lat_bucket(blkq_rdtsc() - cmd->start_tsc)]++;
+    
+    cmd->reqs = 0;
+    dev->busy--;
+    
+    while (req) {
+        blk_request_t* next = req->next;
+        req->next = 0;
+        blkq_complete(req, ok);
+        req = next;
+    }
+    
+    blkq_unlock(flags);
+    
+    // 设备空闲了，继续派发 (正在派发的循环会自己接着做)
+    blkdev_kick(dev);
+}
+
+// 一次只执行一条命令的驱动使用tag 0
+void blkdev_end_request(blkdev_t* dev, int ok) {
+    blkdev_end_tag(dev, 0, ok);
+}
+
+// 把在途命令交给驱动
+static void blkq_issue(blkdev_t* dev, int tag) {
+    blk_cmd_t* cmd = &dev->cmds[tag];
+    blk_request_t* first = cmd->reqs;
+    void* buffer = first->buffer;
+    
+    // 写命令先把数据收集到中转缓冲区
+    if (cmd->staging >= 0) {
+        buffer = blkq_staging[cmd->staging];
+        if (first->write) {
+            uint32_t off = 0;
+            for (blk_request_t* r = first; r; r = r->next) {
+                memcpy((uint8_t*)buffer + off, r->buffer, r->count * dev->sector_size);
+                off += r->count * dev->sector_size;
+            }
+        }
+    }
+    
+    // 合并的请求中只要有一个要求FUA，整条命令按FUA执行
+    int fua = 0;
+    for (blk_request_t* r = first; r; r = r->next) {
+        if (r->fua) fua = 1;
+    }
+    
+    // 支持异步的驱动立即返回，完成时由驱动以同一个tag调用blkdev_end_tag
+    if (dev->ops->start) {
+        int flags = (first->write ? BLK_RW_WRITE : 0) | (first->write && fua ? BLK_RW_FUA : 0);
+        if (!dev->ops->start(dev, tag, first->lba, cmd->iov, cmd->iovcnt, flags)) {
+            blkdev_end_tag(dev, tag, 0);
+        }
+        return;
+    }
+    
+    int ok;
+    if (first->write) {
+        ok = dev->ops->write(dev, first->lba, cmd->count, buffer);
+        // 同步驱动没有FUA命令，用一次刷新代替
+        if (ok && fua && dev->ops->flush) {
+            ok = dev->ops->flush(dev);
+        }
+    } else {
+        ok = dev->ops->read(dev, first->lba, cmd->count, buffer);
+    }
+    blkdev_end_tag(dev, tag, ok);
+}
+
+// 设备有空闲tag时派发队列中的命令，直到在途命令数达到depth
+// 同步驱动会在这里把队列全部做完
+void blkdev_kick(blkdev_t* dev) {
+    if (!dev) return;
+    
+    uint32_t flags = blkq_lock();
+    if (dev->dispatching || dev->plugged) {
+        blkq_unlock(flags);
+        return;
+    }
+    
+    dev->dispatching = 1;
+    int issued = 0;
+    while (dev->busy < dev->depth && dev->queue) {
+        // 同步驱动在等待者的请求完成后就返回，剩下的请求留给之后的派发
+        if (!dev->ops->start && dev->waiter && dev->waiter->status != BLK_REQ_PENDING) {
+            break;
+        }
+        int tag = blkq_free_tag(dev);
+        if (tag < 0) break;
+        blkq_prepare(dev, tag);
+        blkq_unlock(flags);
+        blkq_issue(dev, tag);
+        issued++;
+        flags = blkq_lock();
+    }
+    dev->dispatching = 0;
+    
+    blkq_unlock(flags);
+    
+    // 本轮派发的命令一次性通知设备
+    if (issued && dev->ops->commit) {
+        dev->ops->commit(dev);
+    }
+}
+
+// 暂缓派发
+void blkdev_plug(blkdev_t* dev) {
+    if (dev) dev->plugged = 1;
+}
+
+// 恢复派发并开始执行积累的请求
+void blkdev_unplug(blkdev_t* dev) {
+    if (!dev) return;
+    
+    dev->plugged = 0;
+    blkdev_kick(dev);
+}
+
+// 等待设备推进: 异步驱动在这里处理超时并用hlt等待中断
+static void blkq_idle(blkdev_t* dev) {
+    if (dev->ops->poll) {
+        dev->ops->poll(dev);
+    }
+}
+
+// 派发设备队列中的全部请求并等待完成
+void blkdev_run_queue(blkdev_t* dev) {
+    if (!dev) return;
+    
+    blk_request_t* waiter = dev->waiter;
+    dev->waiter = 0;
+    dev->plugged = 0;
+    blkdev_kick(dev);
+    while (dev->queue || dev->busy) {
+        blkq_idle(dev);
+        blkdev_kick(dev);
+    }
+    dev->waiter = waiter;
+}
+
+// 提交异步请求
+void blkdev_submit(blk_request_t* req) {
+    blkdev_t* dev = req->dev;
+    
+    req->status = BLK_REQ_PENDING;
+    req->next = 0;
+    
+    if (!dev || !req->buffer || !blkdev_range_ok(dev, req->lba, req->count) ||
+        (req->write && !dev->ops->write)) {
+        blkq_complete(req, 0);
+        return;
+    }
+    if (req->prio < 0 || req->prio >= BLK_PRIO_NUM) {
+        req->prio = BLK_PRIO_SYNC;
+    }
+    
+    // 与未完成请求重叠时先把队列做完，保证读写顺序
+    int overlap = 0;
+    uint32_t flags = blkq_lock();
+    for (blk_request_t* r = dev->queue; r; r = r->next) {
+        if (blkq_overlap(r, req)) overlap = 1;
+    }
+    for (int i = 0; i < dev->depth; i++) {
+        for (blk_request_t* r = dev->cmds[i].reqs; r; r = r->next) {
+            if (blkq_overlap(r, req)) overlap = 1;
+        }
+    }
+    blkq_unlock(flags);
+    
+    if (overlap) {
+        blkdev_run_queue(dev);
+    }
+    
+    if (req->write && dev->discard_count) {
+        blkq_discard_cancel(dev, req->lba, req->count);
+    }
+    
+    // 队列已满时等待腾出位置，暂缓派发期间也要放行，否则没有请求能完成
+    if (dev->queue_len >= BLKQ_DEPTH) {
+        dev->plugged = 0;
+    }
+    while (dev->queue_len >= BLKQ_DEPTH) {
+        blkdev_kick(dev);
+        if (dev->queue_len >= BLKQ_DEPTH) blkq_idle(dev);
+    }
+    
+    req->deadline = get_tick_count() + (req->write ? BLKQ_WRITE_EXPIRE : BLKQ_READ_EXPIRE);
+    
+    // 追加到队尾，保持提交顺序
+    flags = blkq_lock();
+    blk_request_t** pp = &dev->queue;
+    while (*pp) pp = &(*pp)->next;
+    *pp = req;
+    dev->queue_len++;
+    
+    uint32_t depth = dev->queue_len + dev->busy;
+    dev->stats.depth_sum += depth;
+    dev->stats.depth_samples++;
+    if (depth > dev->stats.max_depth) {
+        dev->stats.max_depth = depth;
+    }
+    blkq_unlock(flags);
+    
+    // 设备空闲时立即开始，异步驱动不会在这里等待
+    if (dev->ops->start) {
+        blkdev_kick(dev);
+    }
+}
+
+// 等待请求完成
+int blkdev_wait(blk_request_t* req) {
+    blkdev_t* dev = req->dev;
+    
+    if (!dev) {
+        return req->status == BLK_REQ_DONE;
+    }
+    
+    blk_request_t* waiter = dev->waiter;
+    dev->waiter = req;
+    dev->plugged = 0;
+    blkdev_kick(dev);
+    while (req->status == BLK_REQ_PENDING) {
+        blkq_idle(dev);
+        blkdev_kick(dev);
+    }
+    dev->waiter = waiter;
+    return req->status == BLK_REQ_DONE;
+}
+
+// 同步提交一个请求
+static int blkdev_rw(blkdev_t* dev, uint64_t lba, uint32_t count, void* buffer, int write, int fua, int prio) {
+    blk_request_t req;
+    
+    req.dev = dev;
+    req.lba = lba;
+    req.count = count;
+    req.buffer = buffer;
+    req.write = write;
+    req.fua = fua;
+    req.prio = prio;
+    req.end_io = 0;
+    req.priv = 0;
+    
+    blkdev_submit(&req);
+    return blkdev_wait(&req);
+}
+
+// 读取扇区
+int blkdev_read(blkdev_t* dev, uint64_t lba, uint32_t count, void* buffer) {
+    if (!dev || !buffer || !blkdev_range_ok(dev, lba, count)) {
+        return 0;
+    }
+    return blkdev_rw(dev, lba, count, buffer, 0, 0, BLK_PRIO_SYNC);
+}
+
+// 写入扇区
+int blkdev_write(blkdev_t* dev, uint64_t lba, uint32_t count, const void* buffer) {
+    if (!dev || !buffer || !dev->ops->write || !blkdev_range_ok(dev, lba, count)) {
+        return 0;
+    }
+    return blkdev_rw(dev, lba, count, (void*)buffer, 1, 0, BLK_PRIO_SYNC);
+}
+
+// 读取元数据扇区
+int blkdev_read_meta(blkdev_t* dev, uint64_t lba, uint32_t count, void* buffer) {
+    if (!dev || !buffer || !blkdev_range_ok(dev, lba, count)) {
+        return 0;
+    }
+    return blkdev_rw(dev, lba, count, buffer, 0, 0, BLK_PRIO_META);
+}
+
+// 写入元数据扇区
+int blkdev_write_meta(blkdev_t* dev, uint64_t lba, uint32_t count, const void* buffer) {
+    if (!dev || !buffer || !dev->ops->write || !blkdev_range_ok(dev, lba, count)) {
+        return 0;
+    }
+    return blkdev_rw(dev, lba, count, (void*)buffer, 1, 0, BLK_PRIO_META);
+}
+
+// FUA写入扇区
+int blkdev_write_fua(blkdev_t* dev, uint64_t lba, uint32_t count, const void* buffer) {
+    if (!dev || !buffer || !dev->ops->write || !blkdev_range_ok(dev, lba, count)) {
+        return 0;
+    }
+    return blkdev_rw(dev, lba, count, (void*)buffer, 1, 1, BLK_PRIO_SYNC);
+}
+
+// 向量读写: 每段一个请求，暂缓派发使它们合并成一条命令
+static int blkdev_rwv(blkdev_t* dev, uint64_t lba, const blk_iovec_t* iov, int iovcnt, int write) {
+    blk_request_t reqs[BLKQ_MAX_IOV];
+    uint64_t total = 0;
+    
+    if (!dev || !iov || iovcnt <= 0 || iovcnt > BLKQ_MAX_IOV) {
+        return 0;
+    }
+    if (write && !dev->ops->write) {
+        return 0;
+    }
+    
+    for (int i = 0; i < iovcnt; i++) {
+        if (!iov[i].base || iov[i].len == 0 || iov[i].len % dev->sector_size) {
+            return 0;
+        }
+        total += iov[i].len / dev->sector_size;
+    }
+    if (total > 0xFFFFFFFF || !blkdev_range_ok(dev, lba, (uint32_t)total)) {
+        return 0;
+    }
+    
+    int plugged = dev->plugged;
+    dev->plugged = 1;
+    
+    for (int i = 0; i < iovcnt; i++) {
+        reqs[i].dev = dev;
+        reqs[i].lba = lba;
+        reqs[i].count = iov[i].len / dev->sector_size;
+        reqs[i].buffer = iov[i].base;
+        reqs[i].write = write;
+        reqs[i].fua = 0;
+        reqs[i].prio = BLK_PRIO_SYNC;
+        reqs[i].end_io = 0;
+        reqs[i].priv = 0;
+        lba += reqs[i].count;
+        
+        blkdev_submit(&reqs[i]);
+    }
+    
+    dev->plugged = plugged;
+    
+    int ok = 1;
+    for (int i = 0; i < iovcnt; i++) {
+        if (!blkdev_wait(&reqs[i])) ok = 0;
+    }
+    return ok;
+}
+
+// 向量读取
+int blkdev_readv(blkdev_t* dev, uint64_t lba, const blk_iovec_t* iov, int iovcnt) {
+    return blkdev_rwv(dev, lba, iov, iovcnt, 0);
+}
+
+// 向量写入
+int blkdev_writev(blkdev_t* dev, uint64_t lba, const blk_iovec_t* iov, int iovcnt) {
+    return blkdev_rwv(dev, lba, iov, iovcnt, 1);
+}
+
+// 下发积攒的丢弃范围，按驱动一次能接受的范围数分批；调用时队列已经做完
+// 丢弃失败不影响数据，只计入错误数
+static void blkq_discard_issue(blkdev_t* dev) {
+    int total = dev->discard_count;
+    
+    dev->discard_count = 0;
+    for (int i = 0; i < total; i += dev->max_discard) {
+        int n = total - i < dev->max_discard ? total - i : dev->max_discard;
+        uint64_t sectors = 0;
+        
+        for (int j = 0; j < n; j++) {
+            sectors += dev->discards[i + j].count;
+        }
+        dev->stats.discards++;
+        dev->stats.discard_sectors += sectors;
+        if (!dev->ops->discard(dev, &dev->discards[i], n)) {
+            dev->stats.errors++;
+        }
+    }
+}
+
+// 刷新设备写缓存
+int blkdev_flush(blkdev_t* dev) {
+    if (!dev) return 0;
+    
+    blkdev_run_queue(dev);
+    
+    // 没有写缓存的设备无需刷新
+    int ok = 1;
+    if (dev->ops->flush) {
+        dev->stats.flushes++;
+        ok = dev->ops->flush(dev);
+    }
+    
+    // 缓存刷新失败时释放空间的元数据可能没有落盘，丢弃留到下一次
+    if (ok && dev->discard_count) {
+        blkq_discard_issue(dev);
+    }
+    return ok;
+}
+
+// 积攒丢弃范围: 与已有范围重叠或相接时合并，合并后的范围可能又与其他范围相接
+int blkdev_discard(blkdev_t* dev, uint64_t lba, uint32_t count) {
+    if (!dev || !blkdev_range_ok(dev, lba, count)) {
+        return 0;
+    }
+    if (dev->max_discard == 0) {
+        return 1;
+    }
+    
+    uint64_t end = lba + count;
+    int i = 0;
+    while (i < dev->discard_count) {
+        blk_range_t* r = &dev->discards[i];
+        uint64_t r_end = r->lba + r->count;
+        uint64_t lo = r->lba < lba ? r->lba : lba;
+        uint64_t hi = r_end > end ? r_end : end;
+        
+        if (r->lba > end || r_end < lba || hi - lo > 0xFFFFFFFF) {
+            i++;
+            continue;
+        }
+        
+        lba = lo;
+        end = hi;
+        *r = dev->discards[--dev->discard_count];
+        i = 0;
+    }
+    
+    // 攒满一批后刷新一次，刷新会把已有的范围下发
+    if (dev->discard_count >= BLKDEV_DISCARD_RANGES && !blkdev_flush(dev)) {
+        return 1;
+    }
+    if (dev->discard_count < BLKDEV_DISCARD_RANGES) {
+        blk_range_t* r = &dev->discards[dev->discard_count++];
+        r->lba = lba;
+        r->count = (uint32_t)(end - lba);
+    }
+    return 1;
+}
+
+// 请求池中的请求完成: 记录错误并归还
+static void blkq_pool_end_io(blk_request_t* req) {
+    if (req->status != BLK_REQ_DONE) {
+        req->dev->async_error = 1;
+    }
+    blkq_pool_used[req - blkq_pool] = 0;
+}
+
+// 从请求池分配请求，池用完时先派发所有队列
+static blk_request_t* blkq_pool_alloc() {
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < BLKQ_DEPTH; i++) {
+            if (!blkq_pool_used[i]) {
+                blkq_pool_used[i] = 1;
+                return &blkq_pool[i];
+            }
+        }
+        for (int i = 0; i < blkdev_num; i++) {
+            blkdev_run_queue(blkdev_table[i]);
+        }
+    }
+    return 0;
+}
+
+// 使用请求池提交异步请求
+static int blkdev_rw_async(blkdev_t* dev, uint64_t lba, uint32_t count, void* buffer, int write) {
+    if (!dev || !buffer || !blkdev_range_ok(dev, lba, count)) {
+        return 0;
+    }
+    
+    blk_request_t* req = blkq_pool_alloc();
+    if (!req) return 0;
+    
+    req->dev = dev;
+    req->lba = lba;
+    req->count = count;
+    req->buffer = buffer;
+    req->write = write;
+    req->fua = 0;
+    req->prio = write ? BLK_PRIO_BULK : BLK_PRIO_SYNC;
+    req->end_io = blkq_pool_end_io;
+    req->priv = 0;
+    
+    blkdev_submit(req);
+    return 1;
+}
+
+// 异步读取扇区
+int blkdev_read_async(blkdev_t* dev, uint64_t lba, uint32_t count, void* buffer) {
+    return blkdev_rw_async(dev, lba, count, buffer, 0);
+}
+
+// 异步写入扇区
+int blkdev_write_async(blkdev_t* dev, uint64_t lba, uint32_t count, const void* buffer) {
+    return blkdev_rw_async(dev, lba, count, (void*)buffer, 1);
+}
+
+// 派发并等待全部异步请求
+int blkdev_drain(blkdev_t* dev) {
+    if (!dev) return 0;
+    
+    blkdev_run_queue(dev);
+    
+    int ok = !dev->async_error;
+    dev->async_error = 0;
+    return ok;
+}
+
+// 读取I/O统计快照，关中断保证与IRQ中的更新一致
+void blkdev_get_stats(blkdev_t* dev, blkdev_stats_t* stats) {
+    if (!dev || !stats) return;
+    
+    uint32_t flags = blkq_lock();
+    memcpy(stats, &dev->stats, sizeof(blkdev_stats_t));
+    blkq_unlock(flags);
+}
+
+// 清零I/O统计
+void blkdev_reset_stats(blkdev_t* dev) {
+    if (!dev) return;
+    
+    uint32_t flags = blkq_lock();
+    memset(&dev->stats, 0, sizeof(blkdev_stats_t));
+    blkq_unlock(flags);
+}
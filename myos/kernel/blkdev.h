@@ -0,0 +1,233 @@
+#ifndef BLKDEV_H
+#define BLKDEV_H
+
+#include <stdint.h>
+
+// 块设备层常量
+// 各驱动的上限之和: hd/cd 4, sd 4, vd 4, fd 2, ram0 1, md 4, l2c 2, cow 2
+#define BLKDEV_MAX          24         // 最多注册的块设备数量
+#define BLKDEV_NAME_LENGTH  8          // 设备名最大长度(含结束符)
+#define BLKDEV_SECTOR_SIZE  512        // 默认扇区大小
+
+// 请求队列参数
+#define BLKQ_DEPTH          32         // 异步请求池大小，也是单个队列的最大积压数
+#define BLKQ_MERGE_MAX      128        // 合并后单条命令的最大扇区数
+#define BLKQ_READ_EXPIRE    10         // 读请求期限 (滴答)，到期优先派发
+#define BLKQ_WRITE_EXPIRE   50         // 写请求期限 (滴答)
+#define BLKQ_STAGING_NUM    2          // 中转缓冲区数量，即可同时在途的合并命令数
+#define BLKQ_MAX_IOV        16         // 向量命令的最大段数
+#define BLKQ_MAX_TAGS       32         // 单个设备最多同时在途的命令数 (AHCI NCQ深度)
+#define BLKQ_STARVE_MAX     8          // 较低优先级有请求等待时，较高优先级最多连续派发的命令数
+#define BLKDEV_DISCARD_RANGES 16       // 攒够这么多段不相邻的丢弃范围后一次下发
+
+// I/O统计
+#define BLKDEV_LAT_BUCKETS  40         // 延迟直方图桶数，第i桶为[2^i, 2^(i+1))个TSC周期
+
+// 请求状态
+#define BLK_REQ_PENDING     0
+#define BLK_REQ_DONE        1
+#define BLK_REQ_ERROR       (-1)
+
+// I/O优先级，数值越小越先派发
+#define BLK_PRIO_META       0          // 文件系统元数据: 目录、inode、FAT表
+#define BLK_PRIO_SYNC       1          // 调用者正在等待的读写
+#define BLK_PRIO_BULK       2          // 异步批量写入
+#define BLK_PRIO_NUM        3
+
+// 传给驱动start的命令标志
+#define BLK_RW_WRITE        0x01       // 写命令
+#define BLK_RW_FUA          0x02       // 强制单元访问: 命令完成时数据已在介质上
+
+typedef struct blkdev blkdev_t;
+typedef struct blk_request blk_request_t;
+
+// 向量I/O的一段缓冲区，长度为扇区大小的整数倍
+typedef struct {
+    void* base;
+    uint32_t len;                      // 字节数
+} blk_iovec_t;
+
+// 一段连续扇区，用于丢弃
+typedef struct {
+    uint64_t lba;
+    uint32_t count;
+} blk_range_t;
+
+// 请求完成回调
+typedef void (*blk_end_io_t)(blk_request_t* req);
+
+// 块I/O请求，由调用者分配，完成前不能释放或修改缓冲区
+struct blk_request {
+    blkdev_t* dev;                     // 目标设备
+    uint64_t lba;                      // 起始扇区
+    uint32_t count;                    // 扇区数
+    void* buffer;                      // 数据缓冲区
+    int write;                         // 1为写，0为读
+    int fua;                           // 写请求完成时数据须已落盘，不依赖之后的刷新
+    int prio;                          // BLK_PRIO_*
+    volatile int status;               // BLK_REQ_*
+    uint32_t deadline;                 // 期限 (滴答)
+    blk_end_io_t end_io;               // 完成回调，可以为NULL
+    void* priv;                        // 回调私有数据
+    blk_request_t* next;               // 队列链表
+};
+
+// 块设备操作集，由具体驱动实现
+// 所有操作成功返回1，失败返回0 (与disk.c保持一致)
+typedef struct {
+    int (*read)(blkdev_t* dev, uint64_t lba, uint32_t count, void* buffer);
+    int (*write)(blkdev_t* dev, uint64_t lba, uint32_t count, const void* buffer);
+    int (*flush)(blkdev_t* dev);       // 可以为NULL，表示设备无写缓存
+    
+    // 以下为可选的异步接口
+    // start启动一条命令后立即返回，命令完成时驱动以同一个tag调用blkdev_end_tag
+    // tag小于设备的depth，同一tag在完成之前不会再次使用
+    // 数据在iov描述的多段缓冲区和连续扇区之间传输，合并请求时不再经过中转缓冲区
+    // flags为BLK_RW_*，驱动不支持FUA时须在命令完成前自行刷新写缓存
+    // poll在有命令在途时被等待者调用，负责超时处理和让出CPU
+    // commit在一轮派发结束后调用，驱动可以把这一轮start的命令合并成一次通知
+    int (*start)(blkdev_t* dev, int tag, uint64_t lba, const blk_iovec_t* iov, int iovcnt, int flags);
+    void (*poll)(blkdev_t* dev);
+    void (*commit)(blkdev_t* dev);
+    
+    // 丢弃: 告诉设备这些扇区不再使用 (TRIM)，之后读到的内容不确定
+    // 由块设备层在设备空闲时同步调用，count不超过设备的max_discard
+    int (*discard)(blkdev_t* dev, const blk_range_t* ranges, int count);
+} blkdev_ops_t;
+
+// 设备I/O统计，在命令完成时累计 (合并后的一条命令算一次)
+typedef struct {
+    uint32_t reads;                    // 完成的读命令数
+    uint32_t writes;                   // 完成的写命令数
+    uint64_t read_sectors;             // 读取的扇区数
+    uint64_t write_sectors;            // 写入的扇区数
+    uint32_t read_merges;              // 并入其他读命令的请求数
+    uint32_t write_merges;             // 并入其他写命令的请求数
+    uint32_t errors;                   // 失败的命令数
+    uint32_t flushes;                  // 写缓存刷新次数
+    uint32_t discards;                 // 下发的丢弃批次数
+    uint64_t discard_sectors;          // 丢弃的扇区数
+    uint32_t depth_sum;                // 每次提交时队列深度 (待派发+在途) 的累加
+    uint32_t depth_samples;            // 累加的次数，两者相除得平均队列深度
+    uint32_t max_depth;                // 队列深度峰值
+    uint32_t latency[BLKDEV_LAT_BUCKETS]; // 命令从派发到完成的延迟直方图 (log2 TSC周期)
+} blkdev_stats_t;
+
+// 已交给驱动的一条命令
+typedef struct {
+    blk_request_t* reqs;               // 命令包含的请求 (按LBA顺序链接)，NULL表示空闲
+    uint32_t count;                    // 命令的扇区数
+    uint64_t start_tsc;                // 派发时的TSC，用于统计延迟
+    int staging;                       // 使用的中转缓冲区，-1表示没有
+    blk_iovec_t iov[BLKQ_MAX_IOV];     // 向量命令的缓冲区
+    int iovcnt;                        // 向量段数
+} blk_cmd_t;
+
+// 块设备
+struct blkdev {
+    char name[BLKDEV_NAME_LENGTH];     // 设备名，如 "hda"
+    uint32_t sector_size;              // 扇区大小 (字节)
+    uint64_t capacity;                 // 容量 (扇区数)
+    const blkdev_ops_t* ops;           // 驱动操作集
+    void* priv;                        // 驱动私有数据
+    int depth;                         // 驱动可同时执行的命令数，0按1处理 (不超过BLKQ_MAX_TAGS)
+    int max_discard;                   // 一次丢弃可带的范围数，0表示不支持 (不超过BLKDEV_DISCARD_RANGES)
+    
+    // 请求队列 (由块设备层维护)
+    blk_request_t* queue;              // 待派发请求，按提交顺序链接
+    int queue_len;                     // 待派发请求数
+    uint64_t head_pos;                 // 上一条命令结束的位置，C-SCAN从这里继续
+    int async_error;                   // 异步请求是否出过错
+    int plugged;                       // 暂缓派发，让连续提交的请求先合并
+    int starve[BLK_PRIO_NUM];          // 各优先级等待期间，更高优先级已连续派发的命令数
+    blk_request_t* waiter;             // 正在同步等待的请求，同步驱动在它完成后停止派发
+    
+    // 在途命令，每个设备最多depth条，不同设备之间互不等待
+    volatile int busy;                 // 在途命令数
+    int dispatching;                   // 正在派发循环中
+    blk_cmd_t cmds[BLKQ_MAX_TAGS];     // 按tag索引的在途命令
+    
+    // 待下发的丢弃范围，互不相邻；在下一次刷新写缓存之后才下发
+    blk_range_t discards[BLKDEV_DISCARD_RANGES];
+    int discard_count;
+    
+    blkdev_stats_t stats;              // I/O统计
+};
+
+// 注册块设备，成功返回1
+int blkdev_register(blkdev_t* dev);
+
+// 按注册顺序获取块设备
+blkdev_t* blkdev_get(int index);
+
+// 按名称查找块设备
+blkdev_t* blkdev_find(const char* name);
+
+// 已注册的块设备数量
+int blkdev_count();
+
+// 读取扇区
+int blkdev_read(blkdev_t* dev, uint64_t lba, uint32_t count, void* buffer);
+
+// 写入扇区: 数据可能只停留在设备写缓存中，持久化需要在同步点调用blkdev_flush
+int blkdev_write(blkdev_t* dev, uint64_t lba, uint32_t count, const void* buffer);
+
+// 元数据读写: 与blkdev_read/blkdev_write相同，但在队列中先于普通数据派发
+// 用于目录、inode、FAT表等查找路径上的小块I/O
+int blkdev_read_meta(blkdev_t* dev, uint64_t lba, uint32_t count, void* buffer);
+int blkdev_write_meta(blkdev_t* dev, uint64_t lba, uint32_t count, const void* buffer);
+
+// FUA写入: 返回时这些扇区已落盘，用于单个块需要持久化而不必刷新整个缓存的场合
+int blkdev_write_fua(blkdev_t* dev, uint64_t lba, uint32_t count, const void* buffer);
+
+// 向量读写: 从lba开始的连续扇区依次对应iov中的各段
+// 各段作为独立请求提交，由队列合并成一条命令，成功返回1
+int blkdev_readv(blkdev_t* dev, uint64_t lba, const blk_iovec_t* iov, int iovcnt);
+int blkdev_writev(blkdev_t* dev, uint64_t lba, const blk_iovec_t* iov, int iovcnt);
+
+// 刷新设备写缓存 (先派发队列中的所有请求)，即一次写屏障
+// 之后下发积攒的丢弃范围，此时释放这些扇区的元数据已经落盘
+int blkdev_flush(blkdev_t* dev);
+
+// 丢弃扇区: 文件系统释放空间时调用，与相邻的范围合并后等到下一次blkdev_flush才下发
+// 之后写入这些扇区会把它们移出待丢弃范围；设备不支持时直接忽略，参数无效返回0
+int blkdev_discard(blkdev_t* dev, uint64_t lba, uint32_t count);
+
+// 提交异步请求，立即返回；请求在队列被派发时完成
+void blkdev_submit(blk_request_t* req);
+
+// 设备空闲时派发下一条命令
+void blkdev_kick(blkdev_t* dev);
+
+// 暂缓/恢复派发: 在一批提交前后调用，使相邻请求合并成向量命令
+// 等待请求完成时会自动恢复派发
+void blkdev_plug(blkdev_t* dev);
+void blkdev_unplug(blkdev_t* dev);
+
+// 派发设备队列中的全部请求并等待完成
+void blkdev_run_queue(blkdev_t* dev);
+
+// 驱动在异步命令完成时调用 (可以在IRQ中)
+void blkdev_end_tag(blkdev_t* dev, int tag, int ok);
+
+// 同blkdev_end_tag(dev, 0, ok)，供一次只执行一条命令的驱动使用
+void blkdev_end_request(blkdev_t* dev, int ok);
+
+// 等待请求完成，成功返回1
+int blkdev_wait(blk_request_t* req);
+
+// 使用内部请求池的异步读写，缓冲区在blkdev_drain之前必须保持不变
+// 异步写按批量优先级派发，异步读仍有调用者在等，按同步优先级派发
+int blkdev_read_async(blkdev_t* dev, uint64_t lba, uint32_t count, void* buffer);
+int blkdev_write_async(blkdev_t* dev, uint64_t lba, uint32_t count, const void* buffer);
+
+// 派发并等待全部异步请求，期间没有出错返回1
+int blkdev_drain(blkdev_t* dev);
+
+// 读取设备的I/O统计快照
+void blkdev_get_stats(blkdev_t* dev, blkdev_stats_t* stats);
+
+// 清零设备的I/O统计
+void blkdev_reset_stats(blkdev_t* dev);
+
+#endif // BLKDEV_H
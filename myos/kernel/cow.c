@@ -0,0 +1,307 @@
+#include "cow.h"
+#include "bcache.h"
+#include "memory.h"
+#include "string.h"
+
+static cow_t cow_devices[COW_MAX_DEVICES];
+static int cow_count = 0;
+
+// 部分写入时拼接整块、使用增量设备时提交用的缓冲
+static uint8_t cow_chunk[COW_CHUNK_SIZE];
+
+// 基础设备块号所在的哈希桶
+static uint32_t cow_bucket(cow_t* c, uint32_t chunk) {
+    uint32_t h = chunk * 2654435761u;
+    return (h ^ (h >> 16)) & (c->buckets - 1);
+}
+
+// 查找基础设备块对应的增量块，没有时返回-1
+static int cow_lookup(cow_t* c, uint32_t chunk) {
+    uint32_t b = cow_bucket(c, chunk);
+
+    if (c->bucket_gen[b] != c->gen) {
+        return -1;
+    }
+    for (uint32_t s = c->bucket_head[b]; s; s = c->slot_next[s - 1]) {
+        if (c->slot_chunk[s - 1] == chunk) {
+            return (int)(s - 1);
+        }
+    }
+    return -1;
+}
+
+// 把增量块加入哈希表，上一代留下的桶视为空桶
+static void cow_insert(cow_t* c, uint32_t slot, uint32_t chunk) {
+    uint32_t b = cow_bucket(c, chunk);
+
+    if (c->bucket_gen[b] != c->gen) {
+        c->bucket_gen[b] = c->gen;
+        c->bucket_head[b] = 0;
+    }
+    c->slot_chunk[slot] = chunk;
+    c->slot_next[slot] = c->bucket_head[b];
+    c->bucket_head[b] = slot + 1;
+}
+
+// 读写增量块中的扇区
+static int cow_delta_rw(cow_t* c, uint32_t slot, uint32_t offset, uint32_t count, void* buffer, int write) {
+    uint64_t lba = ((uint64_t)slot << COW_CHUNK_SHIFT) + offset;
+
+    if (c->ram) {
+        uint8_t* p = c->ram + (uint32_t)lba * BLKDEV_SECTOR_SIZE;
+        if (write) {
+            memcpy(p, buffer, count * BLKDEV_SECTOR_SIZE);
+        } else {
+            memcpy(buffer, p, count * BLKDEV_SECTOR_SIZE);
+        }
+        return 1;
+    }
+    return write ? blkdev_write(c->delta, lba, count, buffer) : blkdev_read(c->delta, lba, count, buffer);
+}
+
+// 基础设备块的有效扇区数 (最后一块可能不满)
+static uint32_t cow_chunk_sectors(cow_t* c, uint32_t chunk) {
+    uint64_t left = c->base->capacity - ((uint64_t)chunk << COW_CHUNK_SHIFT);
+    return left < COW_CHUNK_SECTORS ? (uint32_t)left : COW_CHUNK_SECTORS;
+}
+
+// 块设备接口: 有增量的块从增量读，其余连续的扇区合并成一次基础设备读取
+static int cow_blk_read(blkdev_t* dev, uint64_t lba, uint32_t count, void* buffer) {
+    cow_t* c = (cow_t*)dev->priv;
+    uint8_t* buf = (uint8_t*)buffer;
+    uint64_t end = lba + count;
+    uint64_t base_lba = 0;
+    uint8_t* base_buf = 0;
+    uint32_t base_count = 0;
+
+    while (lba < end) {
+        uint32_t chunk = (uint32_t)(lba >> COW_CHUNK_SHIFT);
+        uint32_t offset = (uint32_t)lba & (COW_CHUNK_SECTORS - 1);
+        uint32_t n = COW_CHUNK_SECTORS - offset;
+        if (n > end - lba) n = (uint32_t)(end - lba);
+
+        int slot = cow_lookup(c, chunk);
+        if (slot < 0) {
+            if (base_count == 0) {
+                base_lba = lba;
+                base_buf = buf;
+            }
+            base_count += n;
+        } else {
+            if (base_count && !blkdev_read(c->base, base_lba, base_count, base_buf)) {
+                return 0;
+            }
+            base_count = 0;
+            if (!cow_delta_rw(c, (uint32_t)slot, offset, n, buf, 0)) {
+                return 0;
+            }
+        }
+
+        lba += n;
+        buf += n * BLKDEV_SECTOR_SIZE;
+    }
+
+    if (base_count) {
+        return blkdev_read(c->base, base_lba, base_count, base_buf);
+    }
+    return 1;
+}
+
+// 写入增量: 第一次写某块时分配增量块，只写了一部分时先从基础设备复制整块
+static int cow_blk_write(blkdev_t* dev, uint64_t lba, uint32_t count, const void* buffer) {
+    cow_t* c = (cow_t*)dev->priv;
+    const uint8_t* buf = (const uint8_t*)buffer;
+    uint64_t end = lba + count;
+
+    while (lba < end) {
+        uint32_t chunk = (uint32_t)(lba >> COW_CHUNK_SHIFT);
+        uint32_t offset = (uint32_t)lba & (COW_CHUNK_SECTORS - 1);
+        uint32_t n = COW_CHUNK_SECTORS - offset;
+        if (n > end - lba) n = (uint32_t)(end - lba);
+
+        int slot = cow_lookup(c, chunk);
+        if (slot >= 0) {
+            if (!cow_delta_rw(c, (uint32_t)slot, offset, n, (void*)buf, 1)) {
+                return 0;
+            }
+        } else {
+            if (c->used >= c->slots) {
+                return 0;   // 增量已满
+            }
+            uint32_t valid = cow_chunk_sectors(c, chunk);
+            if (n < valid) {
+                if (!blkdev_read(c->base, (uint64_t)chunk << COW_CHUNK_SHIFT, valid, cow_chunk)) {
+                    return 0;
+                }
+                memcpy(cow_chunk + offset * BLKDEV_SECTOR_SIZE, buf, n * BLKDEV_SECTOR_SIZE);
+                c->copyups++;
+                if (!cow_delta_rw(c, c->used, 0, valid, cow_chunk, 1)) {
+                    return 0;
+                }
+            } else if (!cow_delta_rw(c, c->used, offset, n, (void*)buf, 1)) {
+                return 0;
+            }
+            cow_insert(c, c->used, chunk);
+            c->used++;
+        }
+
+        lba += n;
+        buf += n * BLKDEV_SECTOR_SIZE;
+    }
+    return 1;
+}
+
+// 增量不跨重启保留，没有需要刷新的写缓存；基础设备在提交时刷新
+static const blkdev_ops_t cow_blk_ops = {
+    cow_blk_read,
+    cow_blk_write,
+    0,
+    0,
+    0,
+    0,
+    0
+};
+
+// 丢弃增量: 代数加一，所有桶同时失效，缓冲区缓存中覆盖设备的扇区 (包括脏的) 一并作废
+int cow_discard(blkdev_t* dev) {
+    if (!dev || dev->ops != &cow_blk_ops) {
+        return 0;
+    }
+
+    bcache_invalidate(dev);
+    cow_t* c = (cow_t*)dev->priv;
+    if (++c->gen == 0) {
+        memset(c->bucket_gen, 0, c->buckets * sizeof(uint32_t));
+        c->gen = 1;
+    }
+    c->used = 0;
+    c->copyups = 0;
+    return 1;
+}
+
+// 提交增量: 缓冲区缓存中的脏扇区先写进增量，基础设备缓存中的脏扇区先写回，
+// 内存增量直接用异步写交给基础设备的队列排序合并，增量设备上的块逐块复制
+int cow_commit(blkdev_t* dev) {
+    if (!dev || dev->ops != &cow_blk_ops || !bcache_flush(dev)) {
+        return 0;
+    }
+
+    cow_t* c = (cow_t*)dev->priv;
+    if (!bcache_flush(c->base)) {
+        return 0;
+    }
+
+    int ok = 1;
+    for (uint32_t slot = 0; slot < c->used; slot++) {
+        uint32_t chunk = c->slot_chunk[slot];
+        uint64_t lba = (uint64_t)chunk << COW_CHUNK_SHIFT;
+        uint32_t valid = cow_chunk_sectors(c, chunk);
+
+        if (c->ram) {
+            if (!blkdev_write_async(c->base, lba, valid, c->ram + slot * COW_CHUNK_SIZE)) {
+                ok = 0;
+                break;
+            }
+        } else if (!cow_delta_rw(c, slot, 0, valid, cow_chunk, 0) ||
+                   !blkdev_write(c->base, lba, valid, cow_chunk)) {
+            return 0;
+        }
+    }
+
+    // 已提交的请求做完后再返回，增量保留
+    if (!blkdev_drain(c->base) || !ok || !blkdev_flush(c->base)) {
+        return 0;
+    }
+    bcache_invalidate(c->base);     // 基础设备的内容已改变，缓存中只剩干净的旧副本
+    return cow_discard(dev);
+}
+
+// 分配内存增量，连续页不够时减半重试
+static int cow_alloc_ram(cow_t* c, uint32_t pages) {
+    if (pages == 0) {
+        pages = COW_DEFAULT_PAGES;
+    }
+    while (pages >= COW_MIN_PAGES) {
+        c->ram = (uint8_t*)memory_alloc_pages(pages);
+        if (c->ram) {
+            c->ram_pages = pages;
+            c->slots = pages;
+            return 1;
+        }
+        pages /= 2;
+    }
+    return 0;
+}
+
+// 创建写时复制覆盖设备
+blkdev_t* cow_create(blkdev_t* base, blkdev_t* delta, uint32_t ram_pages) {
+    if (cow_count >= COW_MAX_DEVICES || !base || base == delta) {
+        return 0;
+    }
+    if (base->sector_size != BLKDEV_SECTOR_SIZE || (base->capacity >> COW_CHUNK_SHIFT) >= 0xFFFFFFFF) {
+        return 0;
+    }
+    if (delta && (!delta->ops->write || delta->sector_size != BLKDEV_SECTOR_SIZE)) {
+        return 0;
+    }
+    for (int i = 0; i < cow_count; i++) {
+        cow_t* other = &cow_devices[i];
+        if (other->delta && (other->delta == base || other->delta == delta)) return 0;
+        if (delta && (other->base == delta || &other->blk == delta)) return 0;
+    }
+
+    cow_t* c = &cow_devices[cow_count];
+    memset(c, 0, sizeof(cow_t));
+    c->base = base;
+    c->delta = delta;
+
+    if (delta) {
+        uint64_t slots = delta->capacity >> COW_CHUNK_SHIFT;
+        c->slots = slots > COW_MAX_SLOTS ? COW_MAX_SLOTS : (uint32_t)slots;
+        if (c->slots == 0) {
+            return 0;
+        }
+    } else if (!cow_alloc_ram(c, ram_pages)) {
+        return 0;
+    }
+
+    // 哈希桶数取不小于增量块数的2的幂
+    c->buckets = 1;
+    while (c->buckets < c->slots) c->buckets <<= 1;
+    c->meta_pages = ((2 * c->slots + 2 * c->buckets) * sizeof(uint32_t) + 4095) / 4096;
+    uint32_t* meta = (uint32_t*)memory_alloc_pages(c->meta_pages);
+    if (!meta) {
+        if (c->ram) memory_free_pages(c->ram, c->ram_pages);
+        return 0;
+    }
+    c->slot_chunk = meta;
+    c->slot_next = meta + c->slots;
+    c->bucket_head = meta + 2 * c->slots;
+    c->bucket_gen = meta + 2 * c->slots + c->buckets;
+    memset(c->bucket_gen, 0, c->buckets * sizeof(uint32_t));
+    c->gen = 1;
+
+    blkdev_t* blk = &c->blk;
+    strcpy(blk->name, "cow0");
+    blk->name[3] = '0' + cow_count;
+    blk->sector_size = BLKDEV_SECTOR_SIZE;
+    blk->capacity = base->capacity;
+    blk->ops = &cow_blk_ops;
+    blk->priv = c;
+    if (!blkdev_register(blk)) {
+        memory_free_pages(meta, c->meta_pages);
+        if (c->ram) memory_free_pages(c->ram, c->ram_pages);
+        return 0;
+    }
+
+    cow_count++;
+    return blk;
+}
+
+// 获取第index个覆盖设备
+cow_t* cow_get(int index) {
+    if (index < 0 || index >= cow_count) {
+        return 0;
+    }
+    return &cow_devices[index];
+}
@@ -0,0 +1,49 @@
+#ifndef COW_H
+#define COW_H
+
+#include <stdint.h>
+#include "blkdev.h"
+
+// 写时复制覆盖设备定义: 写入落到增量存储 (内存或另一块设备)，基础设备保持不变
+#define COW_MAX_DEVICES     2
+#define COW_CHUNK_SHIFT     3          // 增量按8个扇区 (4KB) 的块管理
+#define COW_CHUNK_SECTORS   (1u << COW_CHUNK_SHIFT)
+#define COW_CHUNK_SIZE      (COW_CHUNK_SECTORS * BLKDEV_SECTOR_SIZE)
+#define COW_DEFAULT_PAGES   1024       // 内存增量默认4MB
+#define COW_MIN_PAGES       16         // 内存增量至少64KB
+#define COW_MAX_SLOTS       65536      // 增量设备最多使用256MB
+
+// 写时复制覆盖设备
+typedef struct {
+    blkdev_t* base;                    // 基础设备，只在提交时写入
+    blkdev_t* delta;                   // 增量设备，使用内存增量时为NULL
+    uint8_t* ram;                      // 内存增量 (每个增量块一页)
+    uint32_t ram_pages;
+    uint32_t slots;                    // 增量块总数
+    uint32_t used;                     // 已用增量块数，按分配顺序使用
+    uint32_t buckets;                  // 哈希桶数 (2的幂)
+    uint32_t gen;                      // 当前代数，桶的代数不同即为空桶
+    uint32_t* slot_chunk;              // 增量块对应的基础设备块号
+    uint32_t* slot_next;               // 同一个桶内的下一个增量块号+1
+    uint32_t* bucket_head;             // 桶内第一个增量块号+1
+    uint32_t* bucket_gen;              // 桶最近一次使用时的代数
+    uint32_t meta_pages;               // 上面四个表占用的页数
+    uint32_t copyups;                  // 部分写入时从基础设备复制的块数
+    blkdev_t blk;                      // 注册到块设备层的设备
+} cow_t;
+
+// 在base上创建覆盖设备并注册为 "cowN"，容量与基础设备相同
+// delta为NULL时增量放在ram_pages页内存中 (0使用默认值，连续页不够时减半)
+// 增量只在内存中记录，重启后丢失；增量写满后写入失败，失败返回NULL
+blkdev_t* cow_create(blkdev_t* base, blkdev_t* delta, uint32_t ram_pages);
+
+// 丢弃全部增量，设备立即恢复为基础设备的内容 (与增量大小无关)
+int cow_discard(blkdev_t* dev);
+
+// 把增量写回基础设备并刷新，成功后清空增量；失败时增量保留，可以重试
+int cow_commit(blkdev_t* dev);
+
+// 获取第index个覆盖设备，不存在时返回NULL
+cow_t* cow_get(int index);
+
+#endif // COW_H
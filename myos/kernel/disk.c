@@ -1,4 +1,7 @@
 #include "disk.h"
+#include "pci.h"
+#include "interrupt.h"
+#include "timer.h"
 #include "string.h"
 
 // 外部函数声明
@@ -10,6 +13,13 @@ extern void int_to_string(int num, char* str);
 static disk_t primary_disk;
 static disk_t secondary_disk;
 
+// 每个通道一张PRD表，按4KB对齐保证表本身不跨64KB边界
+static ata_prd_t primary_prd[ATA_PRD_MAX] __attribute__((aligned(4096)));
+static ata_prd_t secondary_prd[ATA_PRD_MAX] __attribute__((aligned(4096)));
+
+// TRIM范围表，两个通道轮流使用 (丢弃是同步执行的)
+static uint64_t disk_trim_table[ATA_TRIM_ENTRIES] __attribute__((aligned(512)));
+
 // 读端口函数（8位、16位读）
 static inline uint8_t inb(uint16_t port) {
     uint8_t ret;
@@ -37,14 +47,41 @@ static inline void outw(uint16_t port, uint16_t val) {
     asm volatile("outw %0, %1" : : "a"(val), "Nd"(port));
 }
 
+static inline void outl(uint16_t port, uint32_t val) {
+    asm volatile("outl %0, %1" : : "a"(val), "Nd"(port));
+}
+
+// 关中断并返回原来的标志
+static inline uint32_t irq_save() {
+    uint32_t flags;
+    asm volatile("pushf; pop %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+static inline void irq_restore(uint32_t flags) {
+    if (flags & 0x200) {
+        asm volatile("sti" : : : "memory");
+    }
+}
+
 // 写多个字
 static inline void outsw(uint16_t port, const void* addr, uint32_t count) {
-    asm volatile("rep outsw" : "+S"(addr), "+c"(count) : "d"(port));
+    asm volatile("rep outsw" : "+S"(addr), "+c"(count) : "d"(port) : "memory");
 }
 
-// 等待BSY标志清除
-static void ata_wait_bsy(uint16_t base) {
-    while (inb(base + ATA_STATUS) & ATA_SR_BSY);
+static int disk_set_multiple(disk_t* disk, uint8_t sectors);
+static void disk_async_irq(disk_t* disk);
+static int atapi_identify(disk_t* disk);
+
+// 等待BSY标志清除，超时返回-1
+static int ata_wait_bsy(uint16_t base) {
+    int timeout = ATA_POLL_TIMEOUT;
+    
+    while (inb(base + ATA_STATUS) & ATA_SR_BSY) {
+        if (--timeout == 0) return -1;
+    }
+    
+    return 0;
 }
 
 // 等待DRQ标志设置
@@ -61,56 +98,747 @@ static int ata_wait_drq(uint16_t base) {
     return -1; // 超时
 }
 
+// IRQ14/15处理函数: 读状态寄存器应答设备，并记录结果供等待者检查
+static void disk_irq_handler(int irq) {
+    disk_t* disk = irq == IRQ_ATA_PRIMARY ? &primary_disk : &secondary_disk;
+    
+    if (disk->bmide) {
+        disk->irq_bm_status = inb(disk->bmide + ATA_BM_STATUS);
+        outb(disk->bmide + ATA_BM_STATUS, ATA_BM_SR_IRQ);
+    }
+    
+    disk->irq_status = inb(disk->base + ATA_STATUS);
+    
+    // 有异步命令在途时由中断推进，否则唤醒同步等待者
+    if (disk->state != ATA_STATE_IDLE) {
+        disk_async_irq(disk);
+    } else {
+        disk->irq_done = 1;
+    }
+}
+
+// 准备接收下一次中断，必须在设备可能产生中断之前调用
+static inline void disk_arm(disk_t* disk) {
+    disk->irq_done = 0;
+}
+
+// 软件复位通道，用于命令超时后的恢复
+static void disk_reset(disk_t* disk) {
+    if (disk->bmide) {
+        outb(disk->bmide + ATA_BM_CMD, 0);
+    }
+    
+    outb(disk->ctrl, ATA_CTRL_SRST | ATA_CTRL_NIEN);
+    for (int i = 0; i < 4; i++) inb(disk->ctrl);   // 至少保持5微秒
+    outb(disk->ctrl, disk->use_irq ? 0 : ATA_CTRL_NIEN);
+    
+    ata_wait_bsy(disk->base);
+    disk->irq_done = 0;
+}
+
+// 等待当前命令阶段完成，返回ATA状态，超时返回-1
+// 中断模式下用hlt让出CPU，直到IRQ处理函数标记完成
+static int disk_wait(disk_t* disk) {
+    if (!disk->use_irq) {
+        if (ata_wait_bsy(disk->base) < 0) return -1;
+        return inb(disk->base + ATA_STATUS);
+    }
+    
+    unsigned int start = get_tick_count();
+    
+    // 检查与hlt之间关中断，sti的延迟生效保证不会错过唤醒
+    asm volatile("cli");
+    while (!disk->irq_done) {
+        if (get_tick_count() - start > ATA_IRQ_TIMEOUT) {
+            asm volatile("sti");
+            return -1;
+        }
+        asm volatile("sti; hlt; cli");
+    }
+    asm volatile("sti");
+    
+    disk->irq_done = 0;
+    return disk->irq_status;
+}
+
+// 本次访问是否需要48位命令
+static int disk_need_lba48(disk_t* disk, uint64_t lba, uint32_t sectors) {
+    return disk->lba48 && (lba + sectors > ATA_LBA28_LIMIT || sectors > ATA_MAX_SECTORS_LBA28);
+}
+
+// 选择驱动器并写入LBA与扇区数，设备未就绪返回0
+// 48位模式下每个寄存器先写高字节再写低字节，扇区数0表示65536 (28位下表示256)
+static int disk_setup(disk_t* disk, uint64_t lba, uint32_t sectors, int lba48) {
+    uint16_t base = disk->base;
+    
+    if (lba48) {
+        outb(base + ATA_DEVICE, 0x40 | (disk->device & 0x10));
+    } else {
+        outb(base + ATA_DEVICE, 0xE0 | (disk->device & 0x10) | ((lba >> 24) & 0x0F));
+    }
+    
+    // 等待设备就绪
+    if (ata_wait_bsy(base) < 0) {
+        disk_reset(disk);
+        return 0;
+    }
+    
+    if (lba48) {
+        outb(base + ATA_SECTOR_COUNT, (sectors >> 8) & 0xFF);
+        outb(base + ATA_LBA_LOW, (lba >> 24) & 0xFF);
+        outb(base + ATA_LBA_MID, (lba >> 32) & 0xFF);
+        outb(base + ATA_LBA_HIGH, (lba >> 40) & 0xFF);
+    }
+    
+    outb(base + ATA_SECTOR_COUNT, sectors & 0xFF);
+    outb(base + ATA_LBA_LOW, lba & 0xFF);
+    outb(base + ATA_LBA_MID, (lba >> 8) & 0xFF);
+    outb(base + ATA_LBA_HIGH, (lba >> 16) & 0xFF);
+    
+    return 1;
+}
+
+// 查找PIIX/ICH IDE控制器并记录两个通道的总线主控寄存器
+static uint16_t disk_dma_probe() {
+    pci_device_t ide;
+    
+    if (!pci_find_class(PCI_CLASS_STORAGE, PCI_SUBCLASS_IDE, &ide)) {
+        return 0;
+    }
+    
+    // 编程接口位7表示支持总线主控
+    if (!(pci_read8(&ide, PCI_PROG_IF) & 0x80)) {
+        return 0;
+    }
+    
+    // BAR4是I/O空间的BMIDE基址
+    uint32_t bar4 = pci_read32(&ide, PCI_BAR4);
+    if (!(bar4 & 1)) {
+        return 0;
+    }
+    
+    pci_enable_bus_master(&ide);
+    return (uint16_t)(bar4 & 0xFFFC);
+}
+
+// 为分散的缓冲区构建PRD表，每项不跨64KB边界，成功返回1
+static int disk_dma_build_prd(disk_t* disk, const blk_iovec_t* iov, int iovcnt) {
+    int n = 0;
+    
+    for (int i = 0; i < iovcnt; i++) {
+        uint32_t addr = (uint32_t)iov[i].base;   // 内核未开分页，虚拟地址即物理地址
+        uint32_t bytes = iov[i].len;
+        
+        // 总线主控要求每一段都字对齐
+        if ((addr & 1) || (bytes & 1)) {
+            return 0;
+        }
+        
+        while (bytes > 0) {
+            if (n >= ATA_PRD_MAX) {
+                return 0;
+            }
+            
+            uint32_t chunk = 0x10000 - (addr & 0xFFFF);
+            if (chunk > bytes) chunk = bytes;
+            
+            disk->prd[n].addr = addr;
+            disk->prd[n].count = (uint16_t)(chunk & 0xFFFF);
+            disk->prd[n].flags = 0;
+            
+            addr += chunk;
+            bytes -= chunk;
+            n++;
+        }
+    }
+    
+    if (n == 0) {
+        return 0;
+    }
+    
+    disk->prd[n - 1].flags = ATA_PRD_EOT;
+    return 1;
+}
+
+// FUA写能否由驱动器直接完成，否则写完后要补一次缓存刷新
+// PIO方式只有WRITE MULTIPLE FUA EXT，需要多扇区模式
+static int disk_fua_native(disk_t* disk, int dma) {
+    return disk->fua && (dma || disk->multiple);
+}
+
+// 启动总线主控DMA传输，不等待完成，flags为BLK_RW_*
+// 返回1已启动，0失败，-1表示缓冲区不适合DMA(调用者改用PIO)
+static int disk_dma_start(disk_t* disk, uint64_t lba, uint32_t sectors, const blk_iovec_t* iov, int iovcnt, int flags) {
+    uint16_t base = disk->base;
+    uint16_t bm = disk->bmide;
+    int write = flags & BLK_RW_WRITE;
+    int fua = write && (flags & BLK_RW_FUA) && disk_fua_native(disk, 1);
+    uint8_t dir = write ? 0 : ATA_BM_CMD_READ;
+    int lba48 = fua || disk_need_lba48(disk, lba, sectors);
+    
+    if (!disk_dma_build_prd(disk, iov, iovcnt)) {
+        return -1;
+    }
+    
+    // 停止上一次传输，装入PRD表，清除中断与错误位
+    outb(bm + ATA_BM_CMD, 0);
+    outl(bm + ATA_BM_PRDT, (uint32_t)disk->prd);
+    outb(bm + ATA_BM_STATUS, inb(bm + ATA_BM_STATUS) | ATA_BM_SR_IRQ | ATA_BM_SR_ERR);
+    outb(bm + ATA_BM_CMD, dir);
+    
+    // 选择驱动器并设置参数
+    if (!disk_setup(disk, lba, sectors, lba48)) {
+        return 0;
+    }
+    
+    // 发送命令后启动总线主控
+    disk_arm(disk);
+    if (fua) {
+        outb(base + ATA_COMMAND, ATA_CMD_WRITE_DMA_FUA_EXT);
+    } else if (write) {
+        outb(base + ATA_COMMAND, lba48 ? ATA_CMD_WRITE_DMA_EXT : ATA_CMD_WRITE_DMA);
+    } else {
+        outb(base + ATA_COMMAND, lba48 ? ATA_CMD_READ_DMA_EXT : ATA_CMD_READ_DMA);
+    }
+    outb(bm + ATA_BM_CMD, dir | ATA_BM_CMD_START);
+    
+    return 1;
+}
+
+// 结束DMA传输: 停止总线主控并检查结果
+static int disk_dma_finish(disk_t* disk, int status, uint8_t bm_status) {
+    uint16_t bm = disk->bmide;
+    
+    // 停止总线主控并清除状态位
+    outb(bm + ATA_BM_CMD, 0);
+    outb(bm + ATA_BM_STATUS, ATA_BM_SR_IRQ | ATA_BM_SR_ERR);
+    
+    if (status < 0) {
+        disk_reset(disk);
+        return 0;
+    }
+    
+    if ((bm_status & ATA_BM_SR_ERR) || (status & (ATA_SR_ERR | ATA_SR_DF))) {
+        return 0;
+    }
+    
+    return 1;
+}
+
+// 等待总线主控完成已启动的传输并结束DMA
+static int disk_dma_wait(disk_t* disk) {
+    uint16_t bm = disk->bmide;
+    int status;
+    uint8_t bm_status;
+    
+    if (disk->use_irq) {
+        status = disk_wait(disk);
+        bm_status = disk->irq_bm_status;
+    } else {
+        int timeout = ATA_POLL_TIMEOUT;
+        do {
+            bm_status = inb(bm + ATA_BM_STATUS);
+            if (bm_status & (ATA_BM_SR_IRQ | ATA_BM_SR_ERR)) break;
+        } while ((bm_status & ATA_BM_SR_ACTIVE) && --timeout);
+        
+        // 读状态寄存器以清除设备中断
+        status = timeout ? disk_wait(disk) : -1;
+    }
+    
+    return disk_dma_finish(disk, status, bm_status);
+}
+
+// 通过总线主控DMA传输扇区并等待完成
+// 返回1成功，0失败，-1表示缓冲区不适合DMA(调用者改用PIO)
+static int disk_dma_transfer(disk_t* disk, uint64_t lba, uint32_t sectors, const blk_iovec_t* iov, int iovcnt, int flags) {
+    int ret = disk_dma_start(disk, lba, sectors, iov, iovcnt, flags);
+    if (ret <= 0) {
+        return ret;
+    }
+    
+    // 等待控制器完成整个传输
+    return disk_dma_wait(disk);
+}
+
+// 设置PIO传输的缓冲区游标，返回总扇区数 (0表示向量不合法)
+static uint32_t disk_xfer_init(disk_t* disk, const blk_iovec_t* iov, int iovcnt) {
+    uint32_t sectors = 0;
+    
+    if (iovcnt <= 0 || iovcnt > BLKQ_MAX_IOV) {
+        return 0;
+    }
+    
+    for (int i = 0; i < iovcnt; i++) {
+        if (iov[i].len == 0 || (iov[i].len % 512) != 0) {
+            return 0;
+        }
+        disk->xfer_iov[i] = iov[i];
+        sectors += iov[i].len / 512;
+    }
+    
+    disk->xfer_iovcnt = iovcnt;
+    disk->xfer_idx = 0;
+    disk->xfer_off = 0;
+    disk->xfer_left = sectors;
+    return sectors;
+}
+
+// 在数据端口和游标之间搬运n个扇区，跨段时拆成多次rep insw/outsw
+static void disk_xfer_pio(disk_t* disk, uint32_t sectors, int write) {
+    uint32_t bytes = sectors * 512;
+    
+    while (bytes > 0) {
+        blk_iovec_t* seg = &disk->xfer_iov[disk->xfer_idx];
+        uint8_t* p = (uint8_t*)seg->base + disk->xfer_off;
+        uint32_t chunk = seg->len - disk->xfer_off;
+        if (chunk > bytes) chunk = bytes;
+        
+        if (write) {
+            outsw(disk->base + ATA_DATA, p, chunk / 2);
+        } else {
+            insw(disk->base + ATA_DATA, p, chunk / 2);
+        }
+        
+        bytes -= chunk;
+        disk->xfer_off += chunk;
+        if (disk->xfer_off == seg->len) {
+            disk->xfer_idx++;
+            disk->xfer_off = 0;
+        }
+    }
+    
+    disk->xfer_left -= sectors;
+}
+
+// 块设备层读操作，按单条命令的上限拆分
+static int disk_blk_read(blkdev_t* dev, uint64_t lba, uint32_t count, void* buffer) {
+    disk_t* disk = (disk_t*)dev->priv;
+    uint8_t* buf = (uint8_t*)buffer;
+    uint32_t max = disk_max_sectors(disk);
+    
+    while (count > 0) {
+        uint32_t n = count > max ? max : count;
+        if (!disk_read(disk, lba, n, buf)) {
+            return 0;
+        }
+        lba += n;
+        count -= n;
+        buf += n * 512;
+    }
+    
+    return 1;
+}
+
+// 块设备层写操作
+static int disk_blk_write(blkdev_t* dev, uint64_t lba, uint32_t count, const void* buffer) {
+    disk_t* disk = (disk_t*)dev->priv;
+    const uint8_t* buf = (const uint8_t*)buffer;
+    uint32_t max = disk_max_sectors(disk);
+    
+    while (count > 0) {
+        uint32_t n = count > max ? max : count;
+        if (!disk_write(disk, lba, n, buf)) {
+            return 0;
+        }
+        lba += n;
+        count -= n;
+        buf += n * 512;
+    }
+    
+    return 1;
+}
+
+// 块设备层刷新操作
+static int disk_blk_flush(blkdev_t* dev) {
+    return disk_flush((disk_t*)dev->priv);
+}
+
+// 把丢弃范围编码成TRIM范围表
+int ata_trim_encode(uint64_t* entries, const blk_range_t* ranges, int count, int* index, uint32_t* done) {
+    int n = 0;
+    
+    memset(entries, 0, ATA_TRIM_ENTRIES * sizeof(uint64_t));
+    while (n < ATA_TRIM_ENTRIES && *index < count) {
+        const blk_range_t* r = &ranges[*index];
+        uint32_t left = r->count - *done;
+        uint32_t sectors = left > ATA_TRIM_MAX_SECTORS ? ATA_TRIM_MAX_SECTORS : left;
+        
+        entries[n++] = (r->lba + *done) | ((uint64_t)sectors << 48);
+        *done += sectors;
+        if (*done == r->count) {
+            (*index)++;
+            *done = 0;
+        }
+    }
+    return n;
+}
+
+// 块设备层丢弃操作: 每条DATA SET MANAGEMENT命令用DMA送出一块范围表
+static int disk_blk_discard(blkdev_t* dev, const blk_range_t* ranges, int count) {
+    disk_t* disk = (disk_t*)dev->priv;
+    uint16_t bm = disk->bmide;
+    int index = 0;
+    uint32_t done = 0;
+    
+    while (index < count) {
+        ata_trim_encode(disk_trim_table, ranges, count, &index, &done);
+        
+        disk->prd[0].addr = (uint32_t)disk_trim_table;
+        disk->prd[0].count = 512;
+        disk->prd[0].flags = ATA_PRD_EOT;
+        
+        outb(bm + ATA_BM_CMD, 0);
+        outl(bm + ATA_BM_PRDT, (uint32_t)disk->prd);
+        outb(bm + ATA_BM_STATUS, inb(bm + ATA_BM_STATUS) | ATA_BM_SR_IRQ | ATA_BM_SR_ERR);
+        
+        // 扇区数是范围表的块数，LBA不用；48位的特征寄存器同样先写高字节
+        if (!disk_setup(disk, 0, 1, 1)) {
+            return 0;
+        }
+        outb(disk->base + ATA_FEATURES, 0);
+        outb(disk->base + ATA_FEATURES, ATA_DSM_TRIM);
+        
+        disk_arm(disk);
+        outb(disk->base + ATA_COMMAND, ATA_CMD_DSM);
+        outb(bm + ATA_BM_CMD, ATA_BM_CMD_START);
+        
+        if (!disk_dma_wait(disk)) {
+            return 0;
+        }
+    }
+    
+    return 1;
+}
+
+// 异步命令结束，交还给块设备层
+static void disk_async_done(disk_t* disk, int ok) {
+    disk->state = ATA_STATE_IDLE;
+    blkdev_end_request(&disk->blk, ok);
+}
+
+// 驱动器不支持FUA时，FUA写的数据落到驱动器后接着发送缓存刷新
+static void disk_async_flush(disk_t* disk) {
+    disk->state = ATA_STATE_FLUSH;
+    outb(disk->base + ATA_COMMAND, disk->lba48 ? ATA_CMD_CACHE_FLUSH_EXT : ATA_CMD_CACHE_FLUSH);
+}
+
+// 在IRQ中推进异步命令
+static void disk_async_irq(disk_t* disk) {
+    uint8_t status = disk->irq_status;
+    uint32_t n;
+    
+    switch (disk->state) {
+    case ATA_STATE_DMA:
+    {
+        int ok = disk_dma_finish(disk, status, disk->irq_bm_status);
+        if (ok && disk->xfer_flush) {
+            disk_async_flush(disk);
+        } else {
+            disk_async_done(disk, ok);
+        }
+        break;
+    }
+        
+    case ATA_STATE_PIO_READ:
+        // 每个数据块就绪时产生一次中断，最后一块读完后命令即结束
+        if ((status & (ATA_SR_ERR | ATA_SR_DF)) || !(status & ATA_SR_DRQ)) {
+            disk_async_done(disk, 0);
+            break;
+        }
+        n = disk->xfer_left < disk->xfer_block ? disk->xfer_left : disk->xfer_block;
+        disk_xfer_pio(disk, n, 0);
+        if (disk->xfer_left == 0) {
+            disk_async_done(disk, 1);
+        }
+        break;
+        
+    case ATA_STATE_PIO_WRITE:
+        // 每个块写完产生一次中断，还有数据时继续送下一块
+        if (status & (ATA_SR_ERR | ATA_SR_DF)) {
+            disk_async_done(disk, 0);
+            break;
+        }
+        if (disk->xfer_left == 0) {
+            if (disk->xfer_flush) {
+                disk_async_flush(disk);
+            } else {
+                disk_async_done(disk, 1);
+            }
+            break;
+        }
+        if (!(status & ATA_SR_DRQ)) {
+            disk_async_done(disk, 0);
+            break;
+        }
+        n = disk->xfer_left < disk->xfer_block ? disk->xfer_left : disk->xfer_block;
+        disk_xfer_pio(disk, n, 1);
+        break;
+        
+    case ATA_STATE_FLUSH:
+        disk_async_done(disk, !(status & (ATA_SR_ERR | ATA_SR_DF)));
+        break;
+    }
+}
+
+// 块设备层异步操作: 发出命令后立即返回，由IRQ推进和结束
+// 每个通道同一时刻只有一条命令，tag总是0
+static int disk_blk_start(blkdev_t* dev, int tag, uint64_t lba, const blk_iovec_t* iov, int iovcnt, int flags) {
+    disk_t* disk = (disk_t*)dev->priv;
+    uint16_t base = disk->base;
+    int write = flags & BLK_RW_WRITE;
+    int fua = write && (flags & BLK_RW_FUA);
+    uint32_t count = 0;
+    
+    for (int i = 0; i < iovcnt; i++) {
+        count += iov[i].len / 512;
+    }
+    
+    // 没有中断或一条命令装不下时同步完成
+    if (!disk->use_irq || count > disk_max_sectors(disk)) {
+        int ok;
+        if (iovcnt == 1) {
+            ok = write ? disk_blk_write(dev, lba, count, iov[0].base) : disk_blk_read(dev, lba, count, iov[0].base);
+        } else {
+            ok = write ? disk_writev(disk, lba, iov, iovcnt) : disk_readv(disk, lba, iov, iovcnt);
+        }
+        if (ok && fua) {
+            ok = disk_flush(disk);
+        }
+        blkdev_end_request(dev, ok);
+        return 1;
+    }
+    
+    if (!disk_xfer_init(disk, iov, iovcnt)) {
+        return 0;
+    }
+    
+    disk->xfer_block = disk->multiple ? disk->multiple : 1;
+    disk->cmd_tick = get_tick_count();
+    
+    // 先置状态，命令一发出中断就可能到达
+    if (disk->dma) {
+        disk->state = ATA_STATE_DMA;
+        disk->xfer_flush = fua && !disk_fua_native(disk, 1);
+        int ret = disk_dma_start(disk, lba, count, iov, iovcnt, flags);
+        if (ret > 0) return 1;
+        
+        disk->state = ATA_STATE_IDLE;
+        if (ret == 0) return 0;
+    }
+    
+    int fua_native = fua && disk_fua_native(disk, 0);
+    int lba48 = fua_native || disk_need_lba48(disk, lba, count);
+    disk->xfer_flush = fua && !fua_native;
+    if (!disk_setup(disk, lba, count, lba48)) {
+        return 0;
+    }
+    
+    if (!write) {
+        disk->state = ATA_STATE_PIO_READ;
+        if (lba48) {
+            outb(base + ATA_COMMAND, disk->multiple ? ATA_CMD_READ_MULTIPLE_EXT : ATA_CMD_READ_PIO_EXT);
+        } else {
+            outb(base + ATA_COMMAND, disk->multiple ? ATA_CMD_READ_MULTIPLE : ATA_CMD_READ_PIO);
+        }
+        return 1;
+    }
+    
+    if (fua_native) {
+        outb(base + ATA_COMMAND, ATA_CMD_WRITE_MULTIPLE_FUA_EXT);
+    } else if (lba48) {
+        outb(base + ATA_COMMAND, disk->multiple ? ATA_CMD_WRITE_MULTIPLE_EXT : ATA_CMD_WRITE_PIO_EXT);
+    } else {
+        outb(base + ATA_COMMAND, disk->multiple ? ATA_CMD_WRITE_MULTIPLE : ATA_CMD_WRITE_PIO);
+    }
+    
+    // 第一个数据块之前没有中断，轮询DRQ后送出，其余在IRQ中送
+    if (ata_wait_bsy(base) < 0 || ata_wait_drq(base) < 0) {
+        disk_reset(disk);
+        return 0;
+    }
+    
+    // 送完后设备立即可能中断，游标要在中断处理之前更新好
+    uint32_t eflags = irq_save();
+    disk->state = ATA_STATE_PIO_WRITE;
+    disk_xfer_pio(disk, count < disk->xfer_block ? count : disk->xfer_block, 1);
+    irq_restore(eflags);
+    
+    return 1;
+}
+
+// 等待在途命令: 检查超时，否则hlt直到下一次中断
+static void disk_blk_poll(blkdev_t* dev) {
+    disk_t* disk = (disk_t*)dev->priv;
+    
+    asm volatile("cli");
+    if (disk->state == ATA_STATE_IDLE) {
+        asm volatile("sti");
+        return;
+    }
+    
+    if (get_tick_count() - disk->cmd_tick > ATA_IRQ_TIMEOUT) {
+        disk->state = ATA_STATE_IDLE;
+        disk_reset(disk);
+        asm volatile("sti");
+        blkdev_end_request(dev, 0);
+        return;
+    }
+    
+    asm volatile("sti; hlt");
+}
+
+static const blkdev_ops_t disk_blk_ops = {
+    disk_blk_read,
+    disk_blk_write,
+    disk_blk_flush,
+    disk_blk_start,
+    disk_blk_poll,
+    0,
+    disk_blk_discard
+};
+
+// 块设备接口: 光驱只读，命令走同步路径
+static int atapi_blk_read(blkdev_t* dev, uint64_t lba, uint32_t count, void* buffer) {
+    return atapi_read((disk_t*)dev->priv, (uint32_t)lba, count, buffer);
+}
+
+static const blkdev_ops_t atapi_blk_ops = {
+    atapi_blk_read,
+    0,
+    0,
+    0,
+    0,
+    0,
+    0
+};
+
+// 中断可用时改由IRQ通知命令完成，否则保持轮询
+static void disk_enable_irq(disk_t* disk) {
+    if (irq_register(disk->irq, disk_irq_handler)) {
+        disk->use_irq = 1;
+    }
+    
+    // 丢弃IDENTIFY留下的挂起状态后打开设备中断
+    disk->irq_done = 0;
+    inb(disk->base + ATA_STATUS);
+    outb(disk->ctrl, 0);
+}
+
+// 将检测到的磁盘注册到块设备层
+static void disk_register_blkdev(disk_t* disk, const char* name) {
+    blkdev_t* blk = &disk->blk;
+    
+    strcpy(blk->name, name);
+    if (disk->type == DISK_TYPE_ATAPI) {
+        blk->sector_size = ATAPI_SECTOR_SIZE;
+        blk->ops = &atapi_blk_ops;
+    } else {
+        blk->sector_size = 512;
+        blk->ops = &disk_blk_ops;
+        blk->max_discard = disk->trim ? BLKDEV_DISCARD_RANGES : 0;
+    }
+    blk->capacity = disk->size;
+    blk->priv = disk;
+    
+    // 设备表已满时不交给调用者
+    if (!blkdev_register(blk)) {
+        blk->ops = 0;
+    }
+}
+
+// 探测通道上的设备，找到后打开中断并注册到块设备层
+static void disk_attach(disk_t* disk, const char* channel, const char* name, int* cdrom) {
+    if (!disk_identify(disk)) {
+        return;
+    }
+    
+    char size_str[16];
+    print_string("发现");
+    print_string(channel);
+    
+    if (disk->type == DISK_TYPE_ATAPI) {
+        char cd_name[4] = "cd0";
+        cd_name[2] = '0' + (*cdrom)++;
+        
+        int_to_string((int)(disk->size >> 9), size_str); // 2048字节扇区，显示MB
+        print_string("光驱: ");
+        print_string((char*)disk->model);
+        print_string(", 光盘容量: ");
+        print_string(size_str);
+        print_string("MB");
+        print_newline();
+        
+        disk_enable_irq(disk);
+        disk_register_blkdev(disk, cd_name);
+        return;
+    }
+    
+    int_to_string((int)(disk->size >> 11), size_str); // 显示MB
+    print_string("磁盘: ");
+    print_string((char*)disk->model);
+    print_string(", 容量: ");
+    print_string(size_str);
+    print_string("MB");
+    print_newline();
+    
+    disk_enable_irq(disk);
+    disk_register_blkdev(disk, name);
+    
+    // 读取分区表
+    if (disk_read_partitions(disk)) {
+        print_string("已读取分区表");
+        print_newline();
+    }
+}
+
 // 初始化磁盘驱动
 void disk_init() {
     // 初始化主磁盘结构
     memset(&primary_disk, 0, sizeof(disk_t));
     primary_disk.base = ATA_PRIMARY;
+    primary_disk.ctrl = ATA_PRIMARY_DCR;
     primary_disk.device = ATA_MASTER;
+    primary_disk.irq = IRQ_ATA_PRIMARY;
     
     // 初始化次磁盘结构
     memset(&secondary_disk, 0, sizeof(disk_t));
     secondary_disk.base = ATA_SECONDARY;
+    secondary_disk.ctrl = ATA_SECONDARY_DCR;
     secondary_disk.device = ATA_MASTER;
+    secondary_disk.irq = IRQ_ATA_SECONDARY;
+    
+    // 探测总线主控IDE，两个通道的寄存器相差8
+    uint16_t bmide = disk_dma_probe();
+    if (bmide) {
+        primary_disk.bmide = bmide;
+        primary_disk.prd = primary_prd;
+        secondary_disk.bmide = bmide + 8;
+        secondary_disk.prd = secondary_prd;
+    }
     
     // 检测所有磁盘
     print_string("正在检测磁盘...");
     print_newline();
     
-    // 检测主主磁盘
-    if (disk_identify(&primary_disk)) {
-        char size_str[16];
-        int_to_string(primary_disk.size / 2048, size_str); // 显示MB
-        print_string("发现主IDE磁盘: ");
-        print_string((char*)primary_disk.model);
-        print_string(", 容量: ");
-        print_string(size_str);
-        print_string("MB");
-        print_newline();
-        
-        // 读取主磁盘分区表
-        if (disk_read_partitions(&primary_disk)) {
-            print_string("已读取分区表");
-            print_newline();
-        }
+    // 检测两个通道上的主设备，光驱按发现顺序命名为cd0、cd1
+    int cdrom = 0;
+    disk_attach(&primary_disk, "主IDE", "hda", &cdrom);
+    disk_attach(&secondary_disk, "次IDE", "hdc", &cdrom);
+}
+
+// 从IDENTIFY数据的字27-46提取型号名称
+static void disk_copy_model(disk_t* disk, const uint16_t* buffer) {
+    char* model = (char*)&disk->model;
+    for (int i = 0; i < 40; i += 2) {
+        model[i] = (char)(buffer[27 + i/2] >> 8);
+        model[i+1] = (char)buffer[27 + i/2];
     }
+    model[40] = 0; // 确保以空字符结尾
     
-    // 检测次主磁盘
-    if (disk_identify(&secondary_disk)) {
-        char size_str[16];
-        int_to_string(secondary_disk.size / 2048, size_str); // 显示MB
-        print_string("发现次IDE磁盘: ");
-        print_string((char*)secondary_disk.model);
-        print_string(", 容量: ");
-        print_string(size_str);
-        print_string("MB");
-        print_newline();
-        
-        // 读取次磁盘分区表
-        if (disk_read_partitions(&secondary_disk)) {
-            print_string("已读取分区表");
-            print_newline();
-        }
+    // 处理字符串，移除尾部空格
+    int len = 40;
+    while (len > 0 && model[len-1] == ' ') {
+        model[--len] = 0;
     }
 }
 
@@ -123,8 +851,8 @@ int disk_identify(disk_t* disk) {
     // 1. 选择驱动器
     outb(base + ATA_DEVICE, device);
     
-    // 2. 发送NUL字节到控制寄存器以清除任何挂起的中断
-    outb(base + ATA_PRIMARY_DCR, 0);
+    // 2. 检测期间屏蔽设备中断，IDENTIFY与SET MULTIPLE都用轮询完成
+    outb(disk->ctrl, ATA_CTRL_NIEN);
     
     // 3. 发送IDENTIFY命令
     outb(base + ATA_COMMAND, ATA_CMD_IDENTIFY);
@@ -135,8 +863,11 @@ int disk_identify(disk_t* disk) {
     }
     
     // 5. 等待操作完成
-    ata_wait_bsy(base);
-    if (ata_wait_drq(base) < 0) {
+    if (ata_wait_bsy(base) < 0 || ata_wait_drq(base) < 0) {
+        // ATAPI设备拒绝IDENTIFY并在LBA寄存器中留下签名
+        if (inb(base + ATA_LBA_MID) == ATAPI_SIG_MID && inb(base + ATA_LBA_HIGH) == ATAPI_SIG_HIGH) {
+            return atapi_identify(disk);
+        }
         return 0; // 等待超时或错误
     }
     
@@ -146,37 +877,65 @@ int disk_identify(disk_t* disk) {
     }
     
     // 7. 提取磁盘信息
+    disk->type = DISK_TYPE_ATA;
     disk->signature = buffer[0];
     disk->capabilities = buffer[49];
+    
+    // 字49位8表示支持DMA，且通道有总线主控时启用
+    disk->dma = (disk->bmide && (disk->capabilities & (1 << 8))) ? 1 : 0;
     disk->command_sets = ((uint32_t)buffer[83] << 16) | buffer[82];
     
     // 计算磁盘大小
+    disk->lba48 = 0;
     if (disk->command_sets & (1 << 26)) {
-        // 48位LBA支持，使用扩展扇区数
-        disk->size = ((uint32_t)buffer[103] << 16) | buffer[102];
-        disk->size = ((uint32_t)buffer[101] << 16) | buffer[100];
-    } else {
+        // 48位LBA支持，字100-103是完整的64位扇区数
+        disk->size = ((uint64_t)buffer[103] << 48) | ((uint64_t)buffer[102] << 32) |
+                     ((uint64_t)buffer[101] << 16) | buffer[100];
+        disk->lba48 = disk->size ? 1 : 0;
+    }
+    
+    // 字84位6表示支持WRITE DMA/MULTIPLE FUA EXT，这两条命令都是48位的
+    disk->fua = (disk->lba48 && (buffer[84] & (1 << 6))) ? 1 : 0;
+    
+    // 字169位0表示支持DSM TRIM，这里只用48位DMA方式发送范围表
+    disk->trim = (disk->lba48 && disk->dma && (buffer[169] & 1)) ? 1 : 0;
+    if (!disk->lba48) {
         // 传统28位LBA
         disk->size = ((uint32_t)buffer[61] << 16) | buffer[60];
     }
     
-    // 提取型号名称
-    char* model = (char*)&disk->model;
-    for (int i = 0; i < 40; i += 2) {
-        model[i] = (char)buffer[27 + i/2] >> 8;
-        model[i+1] = (char)buffer[27 + i/2];
-    }
-    model[40] = 0; // 确保以空字符结尾
+    disk_copy_model(disk, buffer);
     
-    // 处理字符串，移除尾部空格
-    int len = 40;
-    while (len > 0 && model[len-1] == ' ') {
-        model[--len] = 0;
+    // 按字47协商多扇区传输
+    disk->multiple = 0;
+    if (buffer[47] & 0xFF) {
+        disk_set_multiple(disk, buffer[47] & 0xFF);
     }
     
     return 1; // 成功
 }
 
+// 设置READ/WRITE MULTIPLE每个DRQ块的扇区数
+static int disk_set_multiple(disk_t* disk, uint8_t sectors) {
+    uint16_t base = disk->base;
+    
+    outb(base + ATA_DEVICE, disk->device);
+    ata_wait_bsy(base);
+    
+    outb(base + ATA_SECTOR_COUNT, sectors);
+    outb(base + ATA_COMMAND, ATA_CMD_SET_MULTIPLE);
+    ata_wait_bsy(base);
+    
+    // 驱动器不接受该值时会置ERR，退回单扇区PIO
+    if (inb(base + ATA_STATUS) & (ATA_SR_ERR | ATA_SR_DF)) {
+        disk->multiple = 0;
+        return 0;
+    }
+    
+    disk->multiple = sectors;
+    return 1;
+}
+
 // 读取分区表
 int disk_read_partitions(disk_t* disk) {
     uint8_t buffer[512];
@@ -229,100 +988,165 @@ int disk_read_partitions(disk_t* disk) {
     return disk->has_partitions;
 }
 
-// 从磁盘读取扇区 (LBA模式)
-int disk_read(disk_t* disk, uint32_t lba, uint8_t sectors, void* buffer) {
+// 单条命令最多可传输的扇区数
+uint32_t disk_max_sectors(disk_t* disk) {
+    return disk->lba48 ? ATA_MAX_SECTORS_LBA48 : ATA_MAX_SECTORS_LBA28;
+}
+
+// 从磁盘读取扇区到分散的缓冲区，每段长度必须是扇区的整数倍
+int disk_readv(disk_t* disk, uint64_t lba, const blk_iovec_t* iov, int iovcnt) {
     uint16_t base = disk->base;
-    uint8_t device = disk->device;
     
     // 检查参数
-    if (sectors == 0) return 0;
+    uint32_t sectors = disk_xfer_init(disk, iov, iovcnt);
+    if (sectors == 0 || sectors > disk_max_sectors(disk)) return 0;
     if (lba + sectors > disk->size) return 0;
     
-    // 选择驱动器和发送相关参数
-    outb(base + ATA_DEVICE, (device & 0xE0) | ((lba >> 24) & 0x0F));
-    
-    // 等待设备就绪
-    ata_wait_bsy(base);
-    
-    // 发送扇区计数
-    outb(base + ATA_SECTOR_COUNT, sectors);
+    // 优先使用总线主控DMA，缓冲区不适合时退回PIO
+    if (disk->dma) {
+        int ret = disk_dma_transfer(disk, lba, sectors, iov, iovcnt, 0);
+        if (ret >= 0) return ret;
+    }
     
-    // 发送LBA地址 (低24位)
-    outb(base + ATA_LBA_LOW, lba & 0xFF);
-    outb(base + ATA_LBA_MID, (lba >> 8) & 0xFF);
-    outb(base + ATA_LBA_HIGH, (lba >> 16) & 0xFF);
+    // 选择驱动器和发送相关参数
+    int lba48 = disk_need_lba48(disk, lba, sectors);
+    if (!disk_setup(disk, lba, sectors, lba48)) {
+        return 0;
+    }
     
-    // 发送读扇区命令
-    outb(base + ATA_COMMAND, ATA_CMD_READ_PIO);
+    // 支持多扇区模式时整个请求只需一条READ MULTIPLE命令
+    uint8_t block = disk->multiple ? disk->multiple : 1;
+    disk_arm(disk);
+    if (lba48) {
+        outb(base + ATA_COMMAND, disk->multiple ? ATA_CMD_READ_MULTIPLE_EXT : ATA_CMD_READ_PIO_EXT);
+    } else {
+        outb(base + ATA_COMMAND, disk->multiple ? ATA_CMD_READ_MULTIPLE : ATA_CMD_READ_PIO);
+    }
     
-    // 读取数据
-    uint16_t* buf = (uint16_t*)buffer;
-    for (int s = 0; s < sectors; s++) {
-        // 等待DRQ标志
-        if (ata_wait_drq(base) < 0) {
-            return 0; // 错误
-        }
+    // 读取数据，每个DRQ块按段用rep insw搬完
+    while (disk->xfer_left > 0) {
+        uint32_t n = disk->xfer_left < block ? disk->xfer_left : block;
         
-        // 读取一个扇区的数据
-        for (int i = 0; i < 256; i++) {
-            buf[i] = inw(base + ATA_DATA);
+        // 每个数据块就绪时设备产生一次中断
+        int status = disk_wait(disk);
+        if (status < 0) {
+            disk_reset(disk);
+            return 0; // 超时
+        }
+        if ((status & (ATA_SR_ERR | ATA_SR_DF)) || !(status & ATA_SR_DRQ)) {
+            return 0; // 错误
         }
         
-        // 更新缓冲区指针
-        buf += 256;
+        disk_arm(disk);
+        disk_xfer_pio(disk, n, 0);
     }
     
     return 1; // 成功
 }
 
-// 向磁盘写入扇区 (LBA模式)
-int disk_write(disk_t* disk, uint32_t lba, uint8_t sectors, const void* buffer) {
+// 把分散的缓冲区写入连续扇区，flags为BLK_RW_*
+// 普通写只进入驱动器的写缓存，FUA写在返回前已落到介质
+static int disk_writev_flags(disk_t* disk, uint64_t lba, const blk_iovec_t* iov, int iovcnt, int flags) {
     uint16_t base = disk->base;
-    uint8_t device = disk->device;
+    int fua = flags & BLK_RW_FUA;
+    int native;                 // 驱动器是否已按FUA执行
+    int ok;
     
     // 检查参数
-    if (sectors == 0) return 0;
+    uint32_t sectors = disk_xfer_init(disk, iov, iovcnt);
+    if (sectors == 0 || sectors > disk_max_sectors(disk)) return 0;
     if (lba + sectors > disk->size) return 0;
     
-    // 选择驱动器和发送相关参数
-    outb(base + ATA_DEVICE, (device & 0xE0) | ((lba >> 24) & 0x0F));
-    
-    // 等待设备就绪
-    ata_wait_bsy(base);
+    // 优先使用总线主控DMA，缓冲区不适合时退回PIO
+    if (disk->dma) {
+        int ret = disk_dma_transfer(disk, lba, sectors, iov, iovcnt, flags | BLK_RW_WRITE);
+        if (ret >= 0) {
+            ok = ret;
+            native = disk_fua_native(disk, 1);
+            goto done;
+        }
+    }
     
-    // 发送扇区计数
-    outb(base + ATA_SECTOR_COUNT, sectors);
+    // 选择驱动器和发送相关参数
+    int fua_native = fua && disk_fua_native(disk, 0);
+    int lba48 = fua_native || disk_need_lba48(disk, lba, sectors);
+    native = fua_native;
+    if (!disk_setup(disk, lba, sectors, lba48)) {
+        return 0;
+    }
     
-    // 发送LBA地址 (低24位)
-    outb(base + ATA_LBA_LOW, lba & 0xFF);
-    outb(base + ATA_LBA_MID, (lba >> 8) & 0xFF);
-    outb(base + ATA_LBA_HIGH, (lba >> 16) & 0xFF);
+    // 支持多扇区模式时整个请求只需一条WRITE MULTIPLE命令
+    uint8_t block = disk->multiple ? disk->multiple : 1;
+    if (fua_native) {
+        outb(base + ATA_COMMAND, ATA_CMD_WRITE_MULTIPLE_FUA_EXT);
+    } else if (lba48) {
+        outb(base + ATA_COMMAND, disk->multiple ? ATA_CMD_WRITE_MULTIPLE_EXT : ATA_CMD_WRITE_PIO_EXT);
+    } else {
+        outb(base + ATA_COMMAND, disk->multiple ? ATA_CMD_WRITE_MULTIPLE : ATA_CMD_WRITE_PIO);
+    }
     
-    // 发送写扇区命令
-    outb(base + ATA_COMMAND, ATA_CMD_WRITE_PIO);
+    // 第一个数据块之前设备不产生中断，只能轮询DRQ
+    if (ata_wait_bsy(base) < 0 || ata_wait_drq(base) < 0) {
+        return 0; // 错误
+    }
     
-    // 写入数据
-    const uint16_t* buf = (const uint16_t*)buffer;
-    for (int s = 0; s < sectors; s++) {
-        // 等待DRQ标志
-        if (ata_wait_drq(base) < 0) {
-            return 0; // 错误
-        }
+    // 写入数据，每个DRQ块按段用rep outsw搬完
+    while (disk->xfer_left > 0) {
+        uint32_t n = disk->xfer_left < block ? disk->xfer_left : block;
         
-        // 写入一个扇区的数据
-        for (int i = 0; i < 256; i++) {
-            outw(base + ATA_DATA, buf[i]);
-        }
+        disk_arm(disk);
+        disk_xfer_pio(disk, n, 1);
         
-        // 更新缓冲区指针
-        buf += 256;
+        // 每个块写完设备产生一次中断，最后一次表示命令完成
+        int status = disk_wait(disk);
+        if (status < 0) {
+            disk_reset(disk);
+            return 0; // 超时
+        }
+        if ((status & (ATA_SR_ERR | ATA_SR_DF)) || (disk->xfer_left && !(status & ATA_SR_DRQ))) {
+            return 0; // 错误
+        }
     }
+    ok = 1;
     
-    // 刷新缓存
-    outb(base + ATA_COMMAND, ATA_CMD_CACHE_FLUSH);
-    ata_wait_bsy(base);
+done:
+    // 驱动器不支持FUA时用一次缓存刷新代替
+    if (ok && fua && !native) {
+        ok = disk_flush(disk);
+    }
+    return ok;
+}
+
+// 把分散的缓冲区写入连续扇区 (写入驱动器缓存，持久化需要disk_flush)
+int disk_writev(disk_t* disk, uint64_t lba, const blk_iovec_t* iov, int iovcnt) {
+    return disk_writev_flags(disk, lba, iov, iovcnt, 0);
+}
+
+// 从磁盘读取扇区 (LBA模式)
+int disk_read(disk_t* disk, uint64_t lba, uint32_t sectors, void* buffer) {
+    blk_iovec_t iov;
     
-    return 1; // 成功
+    iov.base = buffer;
+    iov.len = sectors * 512;
+    return disk_readv(disk, lba, &iov, 1);
+}
+
+// 向磁盘写入扇区 (LBA模式)
+int disk_write(disk_t* disk, uint64_t lba, uint32_t sectors, const void* buffer) {
+    blk_iovec_t iov;
+    
+    iov.base = (void*)buffer;
+    iov.len = sectors * 512;
+    return disk_writev(disk, lba, &iov, 1);
+}
+
+// 以FUA方式写入扇区，返回时数据已在介质上，不需要整盘刷新
+int disk_write_fua(disk_t* disk, uint64_t lba, uint32_t sectors, const void* buffer) {
+    blk_iovec_t iov;
+    
+    iov.base = (void*)buffer;
+    iov.len = sectors * 512;
+    return disk_writev_flags(disk, lba, &iov, 1, BLK_RW_FUA);
 }
 
 // 刷新磁盘缓存
@@ -334,17 +1158,160 @@ int disk_flush(disk_t* disk) {
     outb(base + ATA_DEVICE, device);
     
     // 等待设备就绪
-    ata_wait_bsy(base);
+    if (ata_wait_bsy(base) < 0) {
+        disk_reset(disk);
+        return 0;
+    }
     
     // 发送缓存刷新命令
-    outb(base + ATA_COMMAND, ATA_CMD_CACHE_FLUSH);
+    disk_arm(disk);
+    outb(base + ATA_COMMAND, disk->lba48 ? ATA_CMD_CACHE_FLUSH_EXT : ATA_CMD_CACHE_FLUSH);
     
     // 等待操作完成
-    ata_wait_bsy(base);
+    int status = disk_wait(disk);
+    if (status < 0) {
+        disk_reset(disk);
+        return 0;
+    }
+    if (status & (ATA_SR_ERR | ATA_SR_DF)) {
+        return 0;
+    }
     
     return 1; // 成功
 }
 
+// 发出一条ATAPI命令包，用PIO读取最多bytes字节的数据到buffer
+// 设备每准备好一个DRQ块 (字节数在LBA中/高寄存器) 产生一次中断，数据读完后再以一次中断结束
+static int atapi_packet(disk_t* disk, const uint8_t* packet, void* buffer, uint32_t bytes) {
+    uint16_t base = disk->base;
+    uint8_t* buf = (uint8_t*)buffer;
+    uint32_t left = bytes;
+    
+    outb(base + ATA_DEVICE, disk->device);
+    if (ata_wait_bsy(base) < 0) {
+        disk_reset(disk);
+        return 0;
+    }
+    
+    outb(base + ATA_FEATURES, 0);      // PIO传输
+    outb(base + ATA_LBA_MID, ATAPI_MAX_BYTES & 0xFF);
+    outb(base + ATA_LBA_HIGH, ATAPI_MAX_BYTES >> 8);
+    outb(base + ATA_COMMAND, ATA_CMD_PACKET);
+    
+    // 设备准备好接收命令包时置DRQ，这一步不产生中断
+    for (int i = 0; i < 4; i++) inb(disk->ctrl);   // 等待状态有效 (400纳秒)
+    if (ata_wait_bsy(base) < 0 || ata_wait_drq(base) < 0) {
+        return 0;
+    }
+    
+    disk_arm(disk);
+    outsw(base + ATA_DATA, packet, ATAPI_PACKET_SIZE / 2);
+    
+    for (;;) {
+        for (int i = 0; i < 4; i++) inb(disk->ctrl);
+        int status = disk_wait(disk);
+        if (status < 0) {
+            disk_reset(disk);
+            return 0; // 超时
+        }
+        if (status & (ATA_SR_ERR | ATA_SR_DF)) {
+            return 0; // 检查条件，需要REQUEST SENSE
+        }
+        if (!(status & ATA_SR_DRQ)) {
+            break;    // 命令结束
+        }
+        
+        uint32_t n = inb(base + ATA_LBA_MID) | ((uint32_t)inb(base + ATA_LBA_HIGH) << 8);
+        uint32_t take = n < left ? n : left;
+        
+        disk_arm(disk);
+        insw(base + ATA_DATA, buf, take / 2);
+        for (uint32_t i = take; i < n; i += 2) {
+            inw(base + ATA_DATA);      // 丢弃超出缓冲区的数据
+        }
+        buf += take;
+        left -= take;
+    }
+    
+    return left == 0;
+}
+
+// 读取sense数据，清除换盘后的单元注意状态
+static void atapi_request_sense(disk_t* disk) {
+    uint8_t packet[ATAPI_PACKET_SIZE] = { ATAPI_CMD_REQUEST_SENSE, 0, 0, 0, ATAPI_SENSE_SIZE };
+    uint8_t sense[ATAPI_SENSE_SIZE];
+    
+    atapi_packet(disk, packet, sense, ATAPI_SENSE_SIZE);
+}
+
+// 带重试的命令，失败后读取sense再试
+static int atapi_command(disk_t* disk, const uint8_t* packet, void* buffer, uint32_t bytes) {
+    for (int attempt = 0; attempt < ATAPI_RETRIES; attempt++) {
+        if (atapi_packet(disk, packet, buffer, bytes)) {
+            return 1;
+        }
+        atapi_request_sense(disk);
+    }
+    return 0;
+}
+
+// 读取光盘容量 (2048字节扇区数)，没有光盘时为0
+static void atapi_read_capacity(disk_t* disk) {
+    uint8_t packet[ATAPI_PACKET_SIZE] = { ATAPI_CMD_READ_CAPACITY };
+    uint8_t data[8];
+    
+    disk->size = 0;
+    if (atapi_command(disk, packet, data, sizeof(data))) {
+        // 大端序的最后一个LBA和块长度
+        uint32_t last = ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) |
+                        ((uint32_t)data[2] << 8) | data[3];
+        disk->size = (uint64_t)last + 1;
+    }
+}
+
+// 用IDENTIFY PACKET DEVICE识别ATAPI设备，只支持PIO
+static int atapi_identify(disk_t* disk) {
+    uint16_t base = disk->base;
+    uint16_t buffer[256];
+    
+    outb(base + ATA_DEVICE, disk->device);
+    outb(base + ATA_COMMAND, ATA_CMD_IDENTIFY_PACKET);
+    if (ata_wait_bsy(base) < 0 || ata_wait_drq(base) < 0) {
+        return 0;
+    }
+    insw(base + ATA_DATA, buffer, 256);
+    
+    disk->type = DISK_TYPE_ATAPI;
+    disk->signature = buffer[0];
+    disk->capabilities = buffer[49];
+    disk->command_sets = 0;
+    disk->lba48 = 0;
+    disk->multiple = 0;
+    disk->fua = 0;
+    disk->trim = 0;
+    disk->dma = 0;
+    disk_copy_model(disk, buffer);
+    
+    // 检测期间仍屏蔽中断，命令由轮询完成
+    atapi_read_capacity(disk);
+    return 1;
+}
+
+// 用READ(12)从ATAPI光驱读取2048字节的扇区
+int atapi_read(disk_t* disk, uint32_t lba, uint32_t sectors, void* buffer) {
+    uint8_t packet[ATAPI_PACKET_SIZE] = {
+        ATAPI_CMD_READ_12, 0,
+        (uint8_t)(lba >> 24), (uint8_t)(lba >> 16), (uint8_t)(lba >> 8), (uint8_t)lba,
+        (uint8_t)(sectors >> 24), (uint8_t)(sectors >> 16), (uint8_t)(sectors >> 8), (uint8_t)sectors,
+        0, 0
+    };
+    
+    if (disk->type != DISK_TYPE_ATAPI || sectors == 0) return 0;
+    if ((uint64_t)lba + sectors > disk->size) return 0;
+    
+    return atapi_command(disk, packet, buffer, sectors * ATAPI_SECTOR_SIZE);
+}
+
 // 获取主磁盘
 disk_t* disk_get_primary() {
     return &primary_disk;
@@ -355,6 +1322,14 @@ disk_t* disk_get_secondary() {
     return &secondary_disk;
 }
 
+// 获取磁盘对应的块设备
+blkdev_t* disk_get_blkdev(disk_t* disk) {
+    if (!disk || !disk->blk.ops) {
+        return 0;
+    }
+    return &disk->blk;
+}
+
 // 获取分区所在磁盘和LBA偏移
 int disk_get_partition_info(int partition_index, disk_t** disk, uint32_t* start_lba) {
     // 先检查主磁盘的分区
@@ -2,6 +2,7 @@
 #define DISK_H
 
 #include <stdint.h>
+#include "blkdev.h"
 
 // ATA/IDE驱动定义
 #define ATA_PRIMARY      0x1F0
@@ -21,14 +22,38 @@
 #define ATA_PRIMARY_DCR  0x3F6
 #define ATA_SECONDARY_DCR 0x376
 
+// 设备控制寄存器位
+#define ATA_CTRL_NIEN    0x02     // 禁止设备产生中断
+#define ATA_CTRL_SRST    0x04     // 软件复位
+
+// 超时
+#define ATA_POLL_TIMEOUT 1000000  // 轮询等待的最大循环次数
+#define ATA_IRQ_TIMEOUT  500      // 等待中断的最大滴答数 (100Hz下约5秒)
+
 // ATA命令
 #define ATA_CMD_READ_PIO          0x20
 #define ATA_CMD_READ_PIO_EXT      0x24
+#define ATA_CMD_READ_DMA_EXT      0x25
+#define ATA_CMD_READ_MULTIPLE_EXT 0x29
 #define ATA_CMD_WRITE_PIO         0x30
 #define ATA_CMD_WRITE_PIO_EXT     0x34
+#define ATA_CMD_WRITE_DMA_EXT     0x35
+#define ATA_CMD_WRITE_MULTIPLE_EXT 0x39
+#define ATA_CMD_WRITE_DMA_FUA_EXT 0x3D
+#define ATA_CMD_WRITE_MULTIPLE_FUA_EXT 0xCE
+#define ATA_CMD_READ_FPDMA_QUEUED 0x60
+#define ATA_CMD_WRITE_FPDMA_QUEUED 0x61
+#define ATA_CMD_READ_MULTIPLE     0xC4
+#define ATA_CMD_WRITE_MULTIPLE    0xC5
+#define ATA_CMD_SET_MULTIPLE      0xC6
+#define ATA_CMD_READ_DMA          0xC8
+#define ATA_CMD_WRITE_DMA         0xCA
+#define ATA_CMD_PACKET            0xA0
+#define ATA_CMD_IDENTIFY_PACKET   0xA1
 #define ATA_CMD_IDENTIFY          0xEC
 #define ATA_CMD_CACHE_FLUSH       0xE7
 #define ATA_CMD_CACHE_FLUSH_EXT   0xEA
+#define ATA_CMD_DSM               0x06     // DATA SET MANAGEMENT，特征寄存器位0为TRIM
 
 // ATA状态标志
 #define ATA_SR_BSY     0x80
@@ -40,10 +65,64 @@
 #define ATA_SR_IDX     0x02
 #define ATA_SR_ERR     0x01
 
+// 总线主控IDE (BMIDE) 寄存器偏移，次通道在基址+8
+#define ATA_BM_CMD       0x00
+#define ATA_BM_STATUS    0x02
+#define ATA_BM_PRDT      0x04
+
+#define ATA_BM_CMD_START 0x01     // 启动DMA
+#define ATA_BM_CMD_READ  0x08     // 方向: 设备写入内存
+
+#define ATA_BM_SR_ACTIVE 0x01     // DMA进行中
+#define ATA_BM_SR_ERR    0x02     // DMA错误 (写1清除)
+#define ATA_BM_SR_IRQ    0x04     // 设备已产生中断 (写1清除)
+
+// 每个通道PRD表的最大项数 (足够描述一条LBA48命令的32MB)
+#define ATA_PRD_MAX      512
+
+// 物理区域描述符 (PRD)，每项描述一段不跨64KB边界的连续物理内存
+typedef struct {
+    uint32_t addr;             // 物理地址
+    uint16_t count;            // 字节数 (0表示64KB)
+    uint16_t flags;            // 最高位为表结束标志
+} __attribute__((packed)) ata_prd_t;
+
+#define ATA_PRD_EOT      0x8000
+
+// 单条命令的最大扇区数
+#define ATA_MAX_SECTORS_LBA28  256
+#define ATA_MAX_SECTORS_LBA48  65536
+#define ATA_LBA28_LIMIT        0x10000000   // 28位LBA可寻址的扇区数
+
+// TRIM范围表: 每个512字节块64项，每项低48位为LBA、高16位为扇区数 (0表示空项)
+#define ATA_DSM_TRIM           0x01
+#define ATA_TRIM_ENTRIES       64
+#define ATA_TRIM_MAX_SECTORS   0xFFFF
+
 // 设备/磁头寄存器值
 #define ATA_MASTER     0xA0
 #define ATA_SLAVE      0xB0
 
+// 设备类型
+#define DISK_TYPE_ATA    0
+#define DISK_TYPE_ATAPI  1
+
+// ATAPI设备拒绝IDENTIFY后在LBA中/高寄存器中留下的签名
+#define ATAPI_SIG_MID    0x14
+#define ATAPI_SIG_HIGH   0xEB
+
+// ATAPI (SCSI) 命令包
+#define ATAPI_CMD_TEST_UNIT_READY 0x00
+#define ATAPI_CMD_REQUEST_SENSE   0x03
+#define ATAPI_CMD_READ_CAPACITY   0x25
+#define ATAPI_CMD_READ_12         0xA8
+
+#define ATAPI_PACKET_SIZE   12        // 命令包字节数
+#define ATAPI_SECTOR_SIZE   2048      // 光盘扇区大小
+#define ATAPI_MAX_BYTES     0xF800    // 每个DRQ块最多传输的字节数 (2048的整数倍)
+#define ATAPI_SENSE_SIZE    18
+#define ATAPI_RETRIES       3         // 换盘等单元注意状态会让命令失败，读取sense后重试
+
 // 分区表项结构体
 typedef struct {
     uint8_t bootable;           // 0x80 表示可引导分区
@@ -63,18 +142,48 @@ typedef struct {
     uint16_t signature;         // 0xAA55 MBR签名
 } __attribute__((packed)) mbr_t;
 
+// 异步命令的阶段
+#define ATA_STATE_IDLE       0
+#define ATA_STATE_PIO_READ   1
+#define ATA_STATE_PIO_WRITE  2
+#define ATA_STATE_DMA        3
+#define ATA_STATE_FLUSH      4
+
 // 磁盘设备类型
 typedef struct {
     uint16_t base;             // 基址
+    uint16_t ctrl;             // 设备控制寄存器端口
     uint8_t device;            // 主/从
-    uint8_t type;              // ATA/ATAPI等
+    uint8_t irq;               // 通道的IRQ号
+    uint8_t type;              // DISK_TYPE_ATA或DISK_TYPE_ATAPI
     uint16_t signature;        // 签名
     uint16_t capabilities;     // 能力
     uint32_t command_sets;     // 支持的命令集
-    uint32_t size;             // 扇区数量
+    uint64_t size;             // 扇区数量
+    uint8_t lba48;             // 是否支持48位LBA
+    uint8_t multiple;          // READ/WRITE MULTIPLE每个DRQ块的扇区数 (0表示不支持)
+    uint8_t fua;               // 是否支持FUA写 (WRITE DMA/MULTIPLE FUA EXT)
+    uint8_t trim;              // 是否支持DATA SET MANAGEMENT TRIM (需要48位LBA和DMA)
+    uint16_t bmide;            // 所在通道的总线主控寄存器基址 (0表示无)
+    uint8_t dma;               // 是否使用总线主控DMA
+    ata_prd_t* prd;            // 通道的PRD表
+    uint8_t use_irq;           // 是否由中断通知命令完成
+    volatile uint8_t irq_done;       // 中断已到达
+    volatile uint8_t irq_status;     // 中断时读到的ATA状态
+    volatile uint8_t irq_bm_status;  // 中断时读到的总线主控状态
+    volatile uint8_t state;    // 异步命令阶段，由IRQ推进
+    uint8_t xfer_flush;        // 命令结束后是否还要刷新缓存 (驱动器不支持的FUA写)
+    uint8_t xfer_block;        // 每个DRQ块的扇区数
+    blk_iovec_t xfer_iov[BLKQ_MAX_IOV]; // PIO传输的缓冲区向量
+    int xfer_iovcnt;           // 向量段数
+    int xfer_idx;              // 当前段
+    uint32_t xfer_off;         // 当前段内的偏移
+    uint32_t xfer_left;        // PIO剩余扇区数
+    uint32_t cmd_tick;         // 异步命令开始的滴答，用于超时
     uint8_t model[41];         // 型号字符串
     int has_partitions;        // 是否有分区表
     partition_entry_t partitions[4]; // 分区信息
+    blkdev_t blk;              // 注册到块设备层的设备
 } disk_t;
 
 // 分区类型定义
@@ -96,15 +205,34 @@ void disk_init();
 // 检测磁盘
 int disk_detect(uint16_t base, uint8_t device);
 
-// 读取扇区 (LBA模式)
-int disk_read(disk_t* disk, uint32_t lba, uint8_t sectors, void* buffer);
+// 单条命令最多可传输的扇区数
+uint32_t disk_max_sectors(disk_t* disk);
+
+// 读取扇区 (LBA模式)，sectors不超过disk_max_sectors()
+int disk_read(disk_t* disk, uint64_t lba, uint32_t sectors, void* buffer);
 
 // 写入扇区 (LBA模式)
-int disk_write(disk_t* disk, uint32_t lba, uint8_t sectors, const void* buffer);
+int disk_write(disk_t* disk, uint64_t lba, uint32_t sectors, const void* buffer);
 
-// 获取磁盘信息
+// 向量读写: 一条命令在连续扇区和多段不连续缓冲区之间传输
+// 每段长度必须是512的整数倍，段数不超过BLKQ_MAX_IOV
+int disk_readv(disk_t* disk, uint64_t lba, const blk_iovec_t* iov, int iovcnt);
+int disk_writev(disk_t* disk, uint64_t lba, const blk_iovec_t* iov, int iovcnt);
+
+// 写入默认只进入驱动器的写缓存，在同步点调用disk_flush一次使之持久
+// 只有单个块需要立即持久时使用FUA写，避免整盘刷新
+int disk_write_fua(disk_t* disk, uint64_t lba, uint32_t sectors, const void* buffer);
+
+// 把丢弃范围编码成一个512字节的TRIM范围表，超过65535扇区的范围拆成多项
+// 从ranges[*index]的第*done个扇区继续，填满一块或用完范围为止，返回填入的项数 (AHCI共用)
+int ata_trim_encode(uint64_t* entries, const blk_range_t* ranges, int count, int* index, uint32_t* done);
+
+// 获取磁盘信息，ATAPI设备改用IDENTIFY PACKET DEVICE
 int disk_identify(disk_t* disk);
 
+// 用READ(12)从ATAPI光驱读取2048字节的扇区
+int atapi_read(disk_t* disk, uint32_t lba, uint32_t sectors, void* buffer);
+
 // 读取分区表
 int disk_read_partitions(disk_t* disk);
 
@@ -117,6 +245,9 @@ disk_t* disk_get_primary();
 // 获取次磁盘
 disk_t* disk_get_secondary();
 
+// 获取磁盘对应的块设备
+blkdev_t* disk_get_blkdev(disk_t* disk);
+
 // 获取分区所在磁盘和LBA偏移
 int disk_get_partition_info(int partition_index, disk_t** disk, uint32_t* start_lba);
 
@@ -1,4 +1,5 @@
 #include "fat32.h"
+#include "bcache.h"
 #include "string.h"
 #include "memory.h"
 
@@ -18,6 +19,9 @@ static void fill_sector(uint8_t* buffer, uint8_t value) {
     }
 }
 
+// FAT表和目录扇区都经过缓冲区缓存读写: 反复访问的FAT扇区留在内存中，
+// 修改在fclose、淘汰或刷新时才写回，未命中时按BLK_PRIO_META派发
+
 // 辅助函数: 获取FAT表中指定簇的下一个簇号
 static uint32_t fat32_get_next_cluster(fat32_t* fs, uint32_t cluster) {
     if (cluster < 2) return 0;
@@ -26,16 +30,17 @@ static uint32_t fat32_get_next_cluster(fat32_t* fs, uint32_t cluster) {
     uint32_t fat_sector = fs->fat_start + (fat_offset / 512);
     uint32_t entry_offset = fat_offset % 512;
     
-    // 读取FAT扇区
-    uint8_t buffer[512];
-    if (!disk_read(fs->disk, fs->start_lba + fat_sector, 1, buffer)) {
+    // 在缓存中取得FAT扇区
+    bcache_buf_t* b = bcache_bread(fs->dev, fs->start_lba + fat_sector);
+    if (!b) {
         return 0;
     }
     
     // 获取FAT表项
-    uint32_t next_cluster = *((uint32_t*)&buffer[entry_offset]);
+    uint32_t next_cluster = *((uint32_t*)&b->data[entry_offset]);
     next_cluster &= 0x0FFFFFFF; // FAT32项是28位
     
+    bcache_release(b);
     return next_cluster;
 }
 
@@ -47,31 +52,27 @@ static int fat32_set_next_cluster(fat32_t* fs, uint32_t cluster, uint32_t next_c
     uint32_t fat_sector = fs->fat_start + (fat_offset / 512);
     uint32_t entry_offset = fat_offset % 512;
     
-    // 读取FAT扇区
-    uint8_t buffer[512];
-    if (!disk_read(fs->disk, fs->start_lba + fat_sector, 1, buffer)) {
+    // 在缓存中取得FAT扇区
+    bcache_buf_t* b = bcache_bread(fs->dev, fs->start_lba + fat_sector);
+    if (!b) {
         return 0;
     }
     
     // 设置FAT表项，保留高4位
-    uint32_t* fat_entry = (uint32_t*)&buffer[entry_offset];
+    uint32_t* fat_entry = (uint32_t*)&b->data[entry_offset];
     *fat_entry = (*fat_entry & 0xF0000000) | (next_cluster & 0x0FFFFFFF);
-    
-    // 写回FAT表扇区
-    if (!disk_write(fs->disk, fs->start_lba + fat_sector, 1, buffer)) {
-        return 0;
-    }
+    bcache_mark_dirty(b);
     
     // FAT32文件系统通常有两个相同的FAT表，也需要更新第二个表
+    int ok = 1;
     if (fs->bpb.num_fats > 1) {
         uint32_t fat2_sector = fat_sector + fs->bpb.fat_size_32;
         
-        if (!disk_write(fs->disk, fs->start_lba + fat2_sector, 1, buffer)) {
-            return 0;
-        }
+        ok = bcache_write_meta(fs->dev, fs->start_lba + fat2_sector, 1, b->data);
     }
     
-    return 1;
+    bcache_release(b);
+    return ok;
 }
 
 // 辅助函数: 分配一个新簇
@@ -85,7 +86,7 @@ static uint32_t fat32_allocate_cluster(fat32_t* fs) {
     // 扫描所有FAT表扇区
     for (uint32_t sector = 0; sector < fat_sectors; sector++) {
         // 读取FAT表扇区
-        if (!disk_read(fs->disk, fs->start_lba + fs->fat_start + sector, 1, buffer)) {
+        if (!bcache_read_meta(fs->dev, fs->start_lba + fs->fat_start + sector, 1, buffer)) {
             return 0;
         }
         
@@ -98,14 +99,14 @@ static uint32_t fat32_allocate_cluster(fat32_t* fs) {
                 *(uint32_t*)&buffer[offset] = FAT32_EOC_MARK;
                 
                 // 写回FAT表
-                if (!disk_write(fs->disk, fs->start_lba + fs->fat_start + sector, 1, buffer)) {
+                if (!bcache_write_meta(fs->dev, fs->start_lba + fs->fat_start + sector, 1, buffer)) {
                     return 0;
                 }
                 
                 // 更新第二个FAT
                 if (fs->bpb.num_fats > 1) {
                     uint32_t fat2_sector = fs->fat_start + sector + fs->bpb.fat_size_32;
-                    if (!disk_write(fs->disk, fs->start_lba + fat2_sector, 1, buffer)) {
+                    if (!bcache_write_meta(fs->dev, fs->start_lba + fat2_sector, 1, buffer)) {
                         return 0;
                     }
                 }
@@ -121,10 +122,21 @@ static uint32_t fat32_allocate_cluster(fat32_t* fs) {
     return 0; // 没有空闲簇
 }
 
+static uint32_t cluster_to_sector(fat32_t* fs, uint32_t cluster);
+
+// 辅助函数: 丢弃一段连续的簇
+static void fat32_discard_clusters(fat32_t* fs, uint32_t first, uint32_t count) {
+    bcache_discard(fs->dev, fs->start_lba + cluster_to_sector(fs, first),
+                   count * fs->bpb.sectors_per_cluster);
+}
+
 // 辅助函数: 释放一个簇链
+// 链上连续的簇合并成一段交给块设备层丢弃，在FAT表落盘之后才下发
 static int fat32_free_cluster_chain(fat32_t* fs, uint32_t start_cluster) {
     uint32_t current_cluster = start_cluster;
     uint32_t next_cluster;
+    uint32_t run_start = 0;
+    uint32_t run_length = 0;
     
     while (current_cluster >= 2 && current_cluster < FAT32_EOC_MARK) {
         // 获取下一个簇
@@ -132,13 +144,25 @@ static int fat32_free_cluster_chain(fat32_t* fs, uint32_t start_cluster) {
         
         // 将当前簇标记为空闲
         if (!fat32_set_next_cluster(fs, current_cluster, 0)) {
-            return 0;
+            break;
+        }
+        
+        if (run_length && current_cluster == run_start + run_length) {
+            run_length++;
+        } else {
+            if (run_length) fat32_discard_clusters(fs, run_start, run_length);
+            run_start = current_cluster;
+            run_length = 1;
         }
         
         current_cluster = next_cluster;
     }
     
-    return 1;
+    if (run_length) {
+        fat32_discard_clusters(fs, run_start, run_length);
+    }
+    
+    return current_cluster < 2 || current_cluster >= FAT32_EOC_MARK;
 }
 
 // 辅助函数: 簇转换为扇区号
@@ -146,6 +170,16 @@ static uint32_t cluster_to_sector(fat32_t* fs, uint32_t cluster) {
     return fs->data_start + (cluster - 2) * fs->bpb.sectors_per_cluster;
 }
 
+// 读取整个簇: 缓存中的扇区 (可能还没写回) 直接复制，其余连续的扇区一条命令读入
+int fat32_read_cluster(fat32_t* fs, uint32_t cluster, void* buffer) {
+    if (cluster < 2 || cluster >= FAT32_EOC_MARK) {
+        return 0;
+    }
+    
+    return bcache_read(fs->dev, fs->start_lba + cluster_to_sector(fs, cluster),
+                       fs->bpb.sectors_per_cluster, buffer);
+}
+
 // 辅助函数: 创建时间和日期
 static void fat32_get_current_datetime(uint16_t* date, uint16_t* time) {
     // 在实际系统中会使用RTC
@@ -155,10 +189,10 @@ static void fat32_get_current_datetime(uint16_t* date, uint16_t* time) {
 }
 
 // 初始化FAT32文件系统
-int fat32_init(fat32_t* fs, disk_t* disk, uint32_t start_lba) {
+int fat32_init(fat32_t* fs, blkdev_t* dev, uint32_t start_lba) {
     // 初始化文件系统结构
     memset(fs, 0, sizeof(fat32_t));
-    fs->disk = disk;
+    fs->dev = dev;
     fs->start_lba = start_lba;
     
     // 分配扇区缓冲区
@@ -167,7 +201,7 @@ int fat32_init(fat32_t* fs, disk_t* disk, uint32_t start_lba) {
     fs->buffer_dirty = 0;
     
     // 读取BPB结构
-    if (!disk_read(disk, start_lba, 1, &fs->bpb)) {
+    if (!bcache_read(dev, start_lba, 1, &fs->bpb)) {
         return 0;
     }
     
@@ -194,12 +228,18 @@ int fat32_init(fat32_t* fs, disk_t* disk, uint32_t start_lba) {
 }
 
 // 格式化分区为FAT32
-int fat32_format(disk_t* disk, uint32_t start_lba, uint32_t size_sectors, const char* volume_label) {
+int fat32_format(blkdev_t* dev, uint32_t start_lba, uint32_t size_sectors, const char* volume_label) {
     if (size_sectors < 65536) {
         // 太小的分区不适合格式化为FAT32
         return 0;
     }
     
+    // 下面直接写设备，先写回设备上其他分区的脏扇区，再作废旧的缓存
+    if (!bcache_flush(dev)) {
+        return 0;
+    }
+    bcache_invalidate(dev);
+    
     // 创建BPB
     fat32_bpb_t bpb;
     memset(&bpb, 0, sizeof(fat32_bpb_t));
@@ -247,7 +287,7 @@ int fat32_format(disk_t* disk, uint32_t start_lba, uint32_t size_sectors, const
     bpb.signature = FAT32_BOOT_SIGNATURE;
     
     // 写入引导扇区
-    if (!disk_write(disk, start_lba, 1, &bpb)) {
+    if (!blkdev_write(dev, start_lba, 1, &bpb)) {
         return 0;
     }
     
@@ -260,7 +300,7 @@ int fat32_format(disk_t* disk, uint32_t start_lba, uint32_t size_sectors, const
     *((uint32_t*)&fs_info[492]) = 3;         // FSI_Nxt_Free (下一个空闲簇)
     *((uint16_t*)&fs_info[510]) = 0xAA55;    // 签名
     
-    if (!disk_write(disk, start_lba + 1, 1, fs_info)) {
+    if (!blkdev_write(dev, start_lba + 1, 1, fs_info)) {
         return 0;
     }
     
@@ -275,25 +315,28 @@ int fat32_format(disk_t* disk, uint32_t start_lba, uint32_t size_sectors, const
     fat[2] = 0x0FFFFFFF;  // 根目录的簇标记为结束
     
     // 写入FAT表的第一个扇区
-    if (!disk_write(disk, start_lba + bpb.reserved_sector_count, 1, fat_sector)) {
+    if (!blkdev_write(dev, start_lba + bpb.reserved_sector_count, 1, fat_sector)) {
         return 0;
     }
     
     // 写入第二个FAT表
-    if (!disk_write(disk, start_lba + bpb.reserved_sector_count + bpb.fat_size_32, 1, fat_sector)) {
+    if (!blkdev_write(dev, start_lba + bpb.reserved_sector_count + bpb.fat_size_32, 1, fat_sector)) {
         return 0;
     }
     
-    // 清空剩余的FAT表
+    // 清空剩余的FAT表，异步提交后由请求队列合并成大命令
     memset(fat_sector, 0, 512);
     for (uint32_t i = 1; i < bpb.fat_size_32; i++) {
-        if (!disk_write(disk, start_lba + bpb.reserved_sector_count + i, 1, fat_sector)) {
+        if (!blkdev_write_async(dev, start_lba + bpb.reserved_sector_count + i, 1, fat_sector)) {
             return 0;
         }
-        if (!disk_write(disk, start_lba + bpb.reserved_sector_count + bpb.fat_size_32 + i, 1, fat_sector)) {
+        if (!blkdev_write_async(dev, start_lba + bpb.reserved_sector_count + bpb.fat_size_32 + i, 1, fat_sector)) {
             return 0;
         }
     }
+    if (!blkdev_drain(dev)) {
+        return 0;
+    }
     
     // 创建一个空的根目录
     uint32_t root_dir_sector = start_lba + bpb.reserved_sector_count + (bpb.num_fats * bpb.fat_size_32);
@@ -318,7 +361,7 @@ int fat32_format(disk_t* disk, uint32_t start_lba, uint32_t size_sectors, const
     volume_entry->last_mod_time = create_time;
     
     // 写入根目录
-    if (!disk_write(disk, root_dir_sector, 1, fat_sector)) {
+    if (!blkdev_write(dev, root_dir_sector, 1, fat_sector)) {
         return 0;
     }
     
@@ -336,7 +379,7 @@ int fat32_mount(fat32_t* fs, int partition_index) {
     }
     
     // 初始化文件系统
-    if (!fat32_init(fs, disk, start_lba)) {
+    if (!fat32_init(fs, disk_get_blkdev(disk), start_lba)) {
         return 0;
     }
     
@@ -411,7 +454,7 @@ static int fat32_find_entry(fat32_t* fs, uint32_t dir_cluster, const char* filen
             uint32_t sector = fs->start_lba + first_sector + i;
             
             // 读取扇区
-            if (!disk_read(fs->disk, sector, 1, buffer)) {
+            if (!bcache_read_meta(fs->dev, sector, 1, buffer)) {
                 return 0;
             }
             
@@ -471,7 +514,7 @@ static int fat32_find_free_entry(fat32_t* fs, uint32_t dir_cluster,
             uint32_t sector = fs->start_lba + first_sector + i;
             
             // 读取扇区
-            if (!disk_read(fs->disk, sector, 1, buffer)) {
+            if (!bcache_read_meta(fs->dev, sector, 1, buffer)) {
                 return 0;
             }
             
@@ -505,11 +548,11 @@ static int fat32_find_free_entry(fat32_t* fs, uint32_t dir_cluster,
         return 0;
     }
     
-    // 清空新簇
+    // 清空新簇，写进缓存，随后的目录项写入直接命中
     uint32_t first_sector = cluster_to_sector(fs, new_cluster);
+    fill_sector(buffer, 0);
     for (uint32_t i = 0; i < fs->bpb.sectors_per_cluster; i++) {
-        fill_sector(buffer, 0);
-        if (!disk_write(fs->disk, fs->start_lba + first_sector + i, 1, buffer)) {
+        if (!bcache_write_meta(fs->dev, fs->start_lba + first_sector + i, 1, buffer)) {
             return 0;
         }
     }
@@ -673,13 +716,13 @@ fat32_file_t* fat32_fopen(fat32_t* fs, const char* path, const char* mode) {
         
         // 写入目录项
         uint8_t buffer[512];
-        if (!disk_read(fs->disk, entry_sector, 1, buffer)) {
+        if (!bcache_read_meta(fs->dev, entry_sector, 1, buffer)) {
             return NULL;
         }
         
         memcpy(buffer + entry_offset, &entry, sizeof(fat32_dir_entry_t));
         
-        if (!disk_write(fs->disk, entry_sector, 1, buffer)) {
+        if (!bcache_write_meta(fs->dev, entry_sector, 1, buffer)) {
             return NULL;
         }
     }
@@ -738,14 +781,14 @@ fat32_file_t* fat32_fopen(fat32_t* fs, const char* path, const char* mode) {
         
         // 写入更新后的目录项
         uint8_t buffer[512];
-        if (!disk_read(fs->disk, entry_sector, 1, buffer)) {
+        if (!bcache_read_meta(fs->dev, entry_sector, 1, buffer)) {
             file->fs = NULL;
             return NULL;
         }
         
         memcpy(buffer + entry_offset, &entry, sizeof(fat32_dir_entry_t));
         
-        if (!disk_write(fs->disk, entry_sector, 1, buffer)) {
+        if (!bcache_write_meta(fs->dev, entry_sector, 1, buffer)) {
             file->fs = NULL;
             return NULL;
         }
@@ -763,7 +806,7 @@ int fat32_fclose(fat32_file_t* file) {
     // 更新目录项中的文件大小
     if (file->size != file->entry.file_size) {
         uint8_t buffer[512];
-        if (!disk_read(file->fs->disk, file->dir_entry_sector, 1, buffer)) {
+        if (!bcache_read_meta(file->fs->dev, file->dir_entry_sector, 1, buffer)) {
             return 0;
         }
         
@@ -776,7 +819,11 @@ int fat32_fclose(fat32_file_t* file) {
         entry->last_mod_date = mod_date;
         entry->last_mod_time = mod_time;
         
-        if (!disk_write(file->fs->disk, file->dir_entry_sector, 1, buffer)) {
+        // 缓存中的FAT和文件数据先写回落盘，再用FUA写入引用它们的目录项
+        if (!bcache_flush(file->fs->dev)) {
+            return 0;
+        }
+        if (!bcache_write_fua(file->fs->dev, file->dir_entry_sector, 1, buffer)) {
             return 0;
         }
     }
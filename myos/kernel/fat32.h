@@ -0,0 +1,121 @@
+#ifndef FAT32_H
+#define FAT32_H
+
+#include <stdint.h>
+#include "blkdev.h"
+#include "disk.h"
+
+// FAT32 常量
+#define FAT32_BOOT_SIGNATURE     0xAA55      // 引导扇区签名
+#define FAT32_SIGNATURE          0x29        // 扩展引导签名
+#define FAT32_EOC_MARK           0x0FFFFFF8  // 簇链结束标记
+#define FAT32_MAX_OPEN_FILES     16          // 最多同时打开的文件数
+#define FAT32_MAX_PATH_LEN       256         // 最大路径长度
+#define FAT32_MAX_FILENAME       256         // 最大文件名长度
+
+// 目录项属性
+#define FAT32_ATTR_READ_ONLY     0x01
+#define FAT32_ATTR_HIDDEN        0x02
+#define FAT32_ATTR_SYSTEM        0x04
+#define FAT32_ATTR_VOLUME_ID     0x08
+#define FAT32_ATTR_DIRECTORY     0x10
+#define FAT32_ATTR_ARCHIVE       0x20
+#define FAT32_ATTR_LONG_NAME     0x0F
+#define FAT32_ATTR_LONG_NAME_MASK 0x3F
+
+// BIOS参数块 (引导扇区)
+typedef struct {
+    uint8_t jmp_boot[3];            // 跳转指令
+    uint8_t oem_name[8];            // OEM名称
+    uint16_t bytes_per_sector;      // 每扇区字节数
+    uint8_t sectors_per_cluster;    // 每簇扇区数
+    uint16_t reserved_sector_count; // 保留扇区数
+    uint8_t num_fats;               // FAT表数量
+    uint16_t root_entry_count;      // 根目录项数 (FAT32为0)
+    uint16_t total_sectors_16;      // 总扇区数 (FAT32为0)
+    uint8_t media;                  // 介质描述符
+    uint16_t fat_size_16;           // FAT表扇区数 (FAT32为0)
+    uint16_t sectors_per_track;     // 每磁道扇区数
+    uint16_t num_heads;             // 磁头数
+    uint32_t hidden_sectors;        // 隐藏扇区数
+    uint32_t total_sectors_32;      // 总扇区数
+    uint32_t fat_size_32;           // 每个FAT表扇区数
+    uint16_t ext_flags;             // 扩展标志
+    uint16_t fs_version;            // 文件系统版本
+    uint32_t root_cluster;          // 根目录起始簇号
+    uint16_t fs_info;               // FSInfo扇区号
+    uint16_t backup_boot_sector;    // 备份引导扇区号
+    uint8_t reserved[12];           // 保留
+    uint8_t drive_number;           // 驱动器号
+    uint8_t reserved1;              // 保留
+    uint8_t boot_signature;         // 扩展引导签名 (0x29)
+    uint32_t volume_id;             // 卷序列号
+    uint8_t volume_label[11];       // 卷标
+    uint8_t fs_type[8];             // "FAT32   "
+    uint8_t boot_code[420];         // 引导代码
+    uint16_t signature;             // 0xAA55
+} __attribute__((packed)) fat32_bpb_t;
+
+// 目录项
+typedef struct {
+    uint8_t name[11];               // 8.3格式文件名
+    uint8_t attributes;             // 属性
+    uint8_t reserved;               // 保留
+    uint8_t creation_time_tenth;    // 创建时间 (10毫秒)
+    uint16_t creation_time;         // 创建时间
+    uint16_t creation_date;         // 创建日期
+    uint16_t last_access_date;      // 最后访问日期
+    uint16_t first_cluster_high;    // 起始簇号高16位
+    uint16_t last_mod_time;         // 最后修改时间
+    uint16_t last_mod_date;         // 最后修改日期
+    uint16_t first_cluster_low;     // 起始簇号低16位
+    uint32_t file_size;             // 文件大小
+} __attribute__((packed)) fat32_dir_entry_t;
+
+// FAT32 文件系统实例
+typedef struct {
+    blkdev_t* dev;                  // 所在块设备
+    uint32_t start_lba;             // 分区起始LBA
+    fat32_bpb_t bpb;                // BIOS参数块
+    uint32_t fat_start;             // FAT表起始扇区 (分区内)
+    uint32_t root_dir_first_cluster; // 根目录起始簇号
+    uint32_t data_start;            // 数据区起始扇区 (分区内)
+    uint32_t cluster_size;          // 簇大小 (字节)
+    uint8_t* sector_buffer;         // 扇区缓冲区
+    uint32_t buffer_sector;         // 缓冲区中的扇区号
+    int buffer_dirty;               // 缓冲区脏标志
+} fat32_t;
+
+// FAT32 文件句柄
+typedef struct {
+    fat32_t* fs;                    // 所属文件系统 (NULL表示空闲)
+    uint32_t first_cluster;         // 起始簇号
+    uint32_t current_cluster;       // 当前簇号
+    uint32_t size;                  // 文件大小
+    uint32_t position;              // 当前位置
+    fat32_dir_entry_t entry;        // 目录项副本
+    uint32_t parent_cluster;        // 父目录簇号
+    uint32_t dir_entry_sector;      // 目录项所在扇区
+    uint32_t dir_entry_offset;      // 目录项在扇区内的偏移
+} fat32_file_t;
+
+// 初始化FAT32文件系统
+int fat32_init(fat32_t* fs, blkdev_t* dev, uint32_t start_lba);
+
+// 格式化分区为FAT32
+int fat32_format(blkdev_t* dev, uint32_t start_lba, uint32_t size_sectors, const char* volume_label);
+
+// 挂载FAT32文件系统
+int fat32_mount(fat32_t* fs, int partition_index);
+
+// 读取整个簇，buffer至少为cluster_size字节，成功返回1
+int fat32_read_cluster(fat32_t* fs, uint32_t cluster, void* buffer);
+
+// 文件操作
+fat32_file_t* fat32_fopen(fat32_t* fs, const char* path, const char* mode);
+int fat32_fclose(fat32_file_t* file);
+int fat32_fread(fat32_file_t* file, void* buffer, uint32_t size);
+int fat32_fwrite(fat32_file_t* file, const void* buffer, uint32_t size);
+int fat32_fseek(fat32_file_t* file, int32_t offset, int whence);
+
+#endif // FAT32_H
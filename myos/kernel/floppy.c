@@ -0,0 +1,521 @@
+#include "floppy.h"
+#include "interrupt.h"
+#include "timer.h"
+#include "string.h"
+
+// 外部函数声明
+extern void print_string(const char* str);
+extern void print_newline(void);
+extern void int_to_string(int num, char* str);
+
+// 控制器上的驱动器
+static floppy_t floppies[FLOPPY_MAX_DRIVES];
+static int floppy_num = 0;
+
+// 磁道缓存，两个驱动器共用，按LRU替换
+static floppy_track_t floppy_tracks[FLOPPY_CACHE_TRACKS];
+static unsigned int floppy_use_seq = 0;
+
+// ISA DMA缓冲区: 必须位于16MB以下且不跨64KB边界，按32KB对齐保证一个柱面不会跨界
+static uint8_t floppy_dma_buf[FLOPPY_TRACK_BYTES] __attribute__((aligned(32768)));
+
+// 已经启动的电机，电机启动后保持运转，避免每次访问重新等待转速稳定
+static uint8_t floppy_motors = 0;
+
+// 中断处理函数设置的完成标志
+static volatile int floppy_irq_done = 0;
+
+// 端口读写
+static inline uint8_t inb(uint16_t port) {
+    uint8_t ret;
+    asm volatile("inb %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+static inline void outb(uint16_t port, uint8_t val) {
+    asm volatile("outb %0, %1" : : "a"(val), "Nd"(port));
+}
+
+// 读取CMOS寄存器
+static uint8_t floppy_read_cmos(uint8_t reg) {
+    outb(0x70, reg);
+    return inb(0x71);
+}
+
+// 软盘中断: 命令执行阶段结束或寻道完成
+static void floppy_irq_handler(int irq) {
+    (void)irq;
+    floppy_irq_done = 1;
+}
+
+// 等待控制器中断，超时返回0
+static int floppy_wait_irq() {
+    unsigned int start = get_tick_count();
+
+    // 检查与hlt之间关中断，sti的延迟生效保证不会错过唤醒
+    asm volatile("cli");
+    while (!floppy_irq_done) {
+        if (get_tick_count() - start > FLOPPY_IRQ_TIMEOUT) {
+            asm volatile("sti");
+            return 0;
+        }
+        asm volatile("sti; hlt; cli");
+    }
+    asm volatile("sti");
+
+    floppy_irq_done = 0;
+    return 1;
+}
+
+// 等待若干滴答
+static void floppy_sleep(unsigned int ticks) {
+    unsigned int start = get_tick_count();
+    while (get_tick_count() - start < ticks) {
+        asm volatile("hlt");
+    }
+}
+
+// 向FIFO写入一个命令字节
+static int floppy_send(uint8_t val) {
+    for (int i = 0; i < FLOPPY_FIFO_TIMEOUT; i++) {
+        if ((inb(FDC_MSR) & (FDC_MSR_RQM | FDC_MSR_DIO)) == FDC_MSR_RQM) {
+            outb(FDC_FIFO, val);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// 从FIFO读出一个结果字节，超时返回-1
+static int floppy_recv() {
+    for (int i = 0; i < FLOPPY_FIFO_TIMEOUT; i++) {
+        if ((inb(FDC_MSR) & (FDC_MSR_RQM | FDC_MSR_DIO)) == (FDC_MSR_RQM | FDC_MSR_DIO)) {
+            return inb(FDC_FIFO);
+        }
+    }
+    return -1;
+}
+
+// 发出一条完整的命令
+static int floppy_command(const uint8_t* cmd, int len) {
+    for (int i = 0; i < len; i++) {
+        if (!floppy_send(cmd[i])) return 0;
+    }
+    return 1;
+}
+
+// 读取结果阶段的字节
+static int floppy_result(uint8_t* res, int len) {
+    for (int i = 0; i < len; i++) {
+        int val = floppy_recv();
+        if (val < 0) return 0;
+        res[i] = (uint8_t)val;
+    }
+    return 1;
+}
+
+// 寻道或校准完成后读取中断状态，返回ST0，pcn得到磁头所在柱面
+static int floppy_sense_interrupt(uint8_t* pcn) {
+    uint8_t res[2];
+
+    if (!floppy_send(FDC_CMD_SENSE_INT) || !floppy_result(res, 2)) {
+        return -1;
+    }
+    if (pcn) *pcn = res[1];
+    return res[0];
+}
+
+// 写DOR: 保持已启动的电机并选择驱动器
+static void floppy_write_dor(int drive) {
+    outb(FDC_DOR, (uint8_t)(FDC_DOR_RESET | FDC_DOR_DMA | (drive & 3) | floppy_motors));
+}
+
+// 复位控制器并重新设置数据率和驱动器时序
+static int floppy_reset() {
+    floppy_irq_done = 0;
+    outb(FDC_DOR, 0);
+    floppy_write_dor(0);
+
+    if (!floppy_wait_irq()) {
+        return 0;
+    }
+
+    // 复位后每个驱动器都要读一次中断状态
+    for (int i = 0; i < 4; i++) {
+        floppy_sense_interrupt(0);
+    }
+
+    outb(FDC_CCR, 0);   // 500Kbps，1.44MB软盘
+
+    // 步进8ms、磁头卸载240ms、磁头加载4ms，使用DMA
+    uint8_t specify[3] = { FDC_CMD_SPECIFY, 0xDF, 0x02 };
+    if (!floppy_command(specify, 3)) {
+        return 0;
+    }
+
+    for (int i = 0; i < FLOPPY_MAX_DRIVES; i++) {
+        floppies[i].calibrated = 0;
+        floppies[i].cylinder = -1;
+    }
+    return 1;
+}
+
+// 82077AA: 打开FIFO，关闭隐式寻道和驱动器轮询
+static void floppy_configure() {
+    uint8_t version;
+
+    if (!floppy_send(FDC_CMD_VERSION) || !floppy_result(&version, 1)) return;
+    if (version != FDC_VERSION_82077) return;
+
+    uint8_t configure[4] = { FDC_CMD_CONFIGURE, 0, 0x17, 0 };
+    floppy_command(configure, 4);
+}
+
+// 丢弃某个驱动器的全部缓存磁道
+static void floppy_invalidate(int drive) {
+    for (int i = 0; i < FLOPPY_CACHE_TRACKS; i++) {
+        if (floppy_tracks[i].drive == drive) {
+            floppy_tracks[i].drive = -1;
+        }
+    }
+}
+
+// 磁头移到指定柱面
+static int floppy_seek(floppy_t* fd, int cylinder) {
+    uint8_t pcn;
+
+    if (fd->cylinder == cylinder) {
+        return 1;
+    }
+
+    uint8_t cmd[3] = { FDC_CMD_SEEK, (uint8_t)fd->drive, (uint8_t)cylinder };
+    floppy_irq_done = 0;
+    if (!floppy_command(cmd, 3) || !floppy_wait_irq()) {
+        return 0;
+    }
+
+    int st0 = floppy_sense_interrupt(&pcn);
+    if (st0 < 0 || (st0 & 0xC0) || pcn != cylinder) {
+        fd->cylinder = -1;
+        return 0;
+    }
+
+    fd->cylinder = cylinder;
+    return 1;
+}
+
+// 重新校准: 磁头退回0柱面
+static int floppy_recalibrate(floppy_t* fd) {
+    uint8_t pcn;
+
+    // 80个柱面一次校准可能走不完 (控制器最多步进77次)，需要时再来一次
+    for (int i = 0; i < 2; i++) {
+        uint8_t cmd[2] = { FDC_CMD_RECALIBRATE, (uint8_t)fd->drive };
+        floppy_irq_done = 0;
+        if (!floppy_command(cmd, 2) || !floppy_wait_irq()) {
+            return 0;
+        }
+
+        int st0 = floppy_sense_interrupt(&pcn);
+        if (st0 >= 0 && !(st0 & 0xC0) && pcn == 0) {
+            fd->cylinder = 0;
+            fd->calibrated = 1;
+            return 1;
+        }
+    }
+
+    fd->cylinder = -1;
+    return 0;
+}
+
+// 选择驱动器，电机未启动时启动并等待转速稳定
+// 软盘被换过时丢弃缓存，离开当前柱面的寻道会清除换盘标志
+static int floppy_select(floppy_t* fd) {
+    uint8_t motor = FDC_DOR_MOTOR(fd->drive);
+
+    if (!(floppy_motors & motor)) {
+        floppy_motors |= motor;
+        floppy_write_dor(fd->drive);
+        floppy_sleep(FLOPPY_MOTOR_SPINUP);
+    } else {
+        floppy_write_dor(fd->drive);
+    }
+
+    if (inb(FDC_DIR) & FDC_DIR_CHANGE) {
+        floppy_invalidate(fd->drive);
+        fd->calibrated = 0;
+        if (!floppy_recalibrate(fd) || !floppy_seek(fd, 1)) {
+            return 0;
+        }
+    }
+
+    if (!fd->calibrated) {
+        return floppy_recalibrate(fd);
+    }
+    return 1;
+}
+
+// 设置DMA通道2: 在floppy_dma_buf与控制器之间传送bytes字节
+static void floppy_dma_setup(uint32_t bytes, int write) {
+    uint32_t addr = (uint32_t)floppy_dma_buf;   // 内核未开分页，虚拟地址即物理地址
+    uint32_t count = bytes - 1;
+
+    outb(DMA_MASK_REG, 0x04 | DMA_CHANNEL_FLOPPY);
+    outb(DMA_FLIPFLOP_REG, 0xFF);
+    outb(DMA_CH2_ADDR, addr & 0xFF);
+    outb(DMA_CH2_ADDR, (addr >> 8) & 0xFF);
+    outb(DMA_CH2_PAGE, (addr >> 16) & 0xFF);
+    outb(DMA_FLIPFLOP_REG, 0xFF);
+    outb(DMA_CH2_COUNT, count & 0xFF);
+    outb(DMA_CH2_COUNT, (count >> 8) & 0xFF);
+    outb(DMA_MODE_REG, (write ? DMA_MODE_WRITE : DMA_MODE_READ) | DMA_CHANNEL_FLOPPY);
+    outb(DMA_MASK_REG, DMA_CHANNEL_FLOPPY);
+}
+
+// 在一个柱面内从(head, sector)开始传送count个扇区
+// 使用MT位，磁头0的最后一个扇区之后自动继续磁头1，DMA计数到达时结束
+static int floppy_rw_cylinder(floppy_t* fd, int cylinder, int head, int sector, int count, int write) {
+    uint8_t res[7];
+
+    if (!floppy_seek(fd, cylinder)) {
+        return 0;
+    }
+
+    floppy_dma_setup(count * FLOPPY_SECTOR_SIZE, write);
+
+    uint8_t cmd[9] = {
+        (uint8_t)(FDC_CMD_MT | FDC_CMD_MFM | (write ? FDC_CMD_WRITE_DATA : FDC_CMD_READ_DATA)),
+        (uint8_t)((head << 2) | fd->drive),
+        (uint8_t)cylinder,
+        (uint8_t)head,
+        (uint8_t)sector,
+        FDC_SECTOR_N,
+        FLOPPY_SECTORS,            // 磁道的最后一个扇区号
+        FDC_GAP3_RW,
+        0xFF
+    };
+
+    floppy_irq_done = 0;
+    if (!floppy_command(cmd, 9) || !floppy_wait_irq() || !floppy_result(res, 7)) {
+        return 0;
+    }
+
+    // ST0的中断码为0表示正常结束
+    return (res[0] & 0xC0) == 0;
+}
+
+// 带重试的柱面传送，失败后复位控制器并重新校准
+static int floppy_transfer(floppy_t* fd, int cylinder, int head, int sector, int count, int write) {
+    for (int attempt = 0; attempt < FLOPPY_RETRIES; attempt++) {
+        if (floppy_select(fd) && floppy_rw_cylinder(fd, cylinder, head, sector, count, write)) {
+            return 1;
+        }
+        floppy_reset();
+    }
+    return 0;
+}
+
+// 查找缓存中的柱面
+static floppy_track_t* floppy_find_track(int drive, int cylinder) {
+    for (int i = 0; i < FLOPPY_CACHE_TRACKS; i++) {
+        if (floppy_tracks[i].drive == drive && floppy_tracks[i].cylinder == cylinder) {
+            return &floppy_tracks[i];
+        }
+    }
+    return 0;
+}
+
+// 取得柱面的缓存，不在缓存中时一条命令读入两面共36个扇区
+static floppy_track_t* floppy_get_track(floppy_t* fd, int cylinder) {
+    floppy_track_t* track = floppy_find_track(fd->drive, cylinder);
+
+    if (!track) {
+        // 优先使用空闲项，否则替换最久未用的柱面
+        track = &floppy_tracks[0];
+        for (int i = 0; i < FLOPPY_CACHE_TRACKS; i++) {
+            if (floppy_tracks[i].drive < 0) {
+                track = &floppy_tracks[i];
+                break;
+            }
+            if (floppy_tracks[i].last_use < track->last_use) {
+                track = &floppy_tracks[i];
+            }
+        }
+
+        track->drive = -1;
+        if (!floppy_transfer(fd, cylinder, 0, 1, FLOPPY_TRACK_SECTORS, 0)) {
+            return 0;
+        }
+        memcpy(track->data, floppy_dma_buf, FLOPPY_TRACK_BYTES);
+        track->drive = fd->drive;
+        track->cylinder = cylinder;
+    }
+
+    track->last_use = ++floppy_use_seq;
+    return track;
+}
+
+// 块设备接口: 按柱面从磁道缓存读取
+static int floppy_blk_read(blkdev_t* dev, uint64_t lba, uint32_t count, void* buffer) {
+    floppy_t* fd = (floppy_t*)dev->priv;
+    uint8_t* buf = (uint8_t*)buffer;
+
+    if (lba + count > FLOPPY_TOTAL_SECTORS) {
+        return 0;
+    }
+
+    // 先选择驱动器，换盘后不能再用缓存的数据
+    if (!floppy_select(fd)) {
+        return 0;
+    }
+
+    while (count > 0) {
+        int cylinder = (int)(lba / FLOPPY_TRACK_SECTORS);
+        uint32_t offset = (uint32_t)(lba % FLOPPY_TRACK_SECTORS);
+        uint32_t n = FLOPPY_TRACK_SECTORS - offset;
+        if (n > count) n = count;
+
+        floppy_track_t* track = floppy_get_track(fd, cylinder);
+        if (!track) {
+            return 0;
+        }
+        memcpy(buf, track->data + offset * FLOPPY_SECTOR_SIZE, n * FLOPPY_SECTOR_SIZE);
+
+        lba += n;
+        count -= n;
+        buf += n * FLOPPY_SECTOR_SIZE;
+    }
+
+    return 1;
+}
+
+// 块设备接口: 直写到软盘并更新已缓存的柱面，每个柱面一条命令
+static int floppy_blk_write(blkdev_t* dev, uint64_t lba, uint32_t count, const void* buffer) {
+    floppy_t* fd = (floppy_t*)dev->priv;
+    const uint8_t* buf = (const uint8_t*)buffer;
+
+    if (lba + count > FLOPPY_TOTAL_SECTORS) {
+        return 0;
+    }
+
+    while (count > 0) {
+        int cylinder = (int)(lba / FLOPPY_TRACK_SECTORS);
+        uint32_t offset = (uint32_t)(lba % FLOPPY_TRACK_SECTORS);
+        uint32_t n = FLOPPY_TRACK_SECTORS - offset;
+        if (n > count) n = count;
+
+        memcpy(floppy_dma_buf, buf, n * FLOPPY_SECTOR_SIZE);
+        if (!floppy_transfer(fd, cylinder, offset / FLOPPY_SECTORS, offset % FLOPPY_SECTORS + 1, n, 1)) {
+            // 写失败后缓存内容与软盘不再一致
+            floppy_track_t* track = floppy_find_track(fd->drive, cylinder);
+            if (track) track->drive = -1;
+            return 0;
+        }
+
+        floppy_track_t* track = floppy_find_track(fd->drive, cylinder);
+        if (track) {
+            memcpy(track->data + offset * FLOPPY_SECTOR_SIZE, buf, n * FLOPPY_SECTOR_SIZE);
+        }
+
+        lba += n;
+        count -= n;
+        buf += n * FLOPPY_SECTOR_SIZE;
+    }
+
+    return 1;
+}
+
+// 软盘没有写缓存，不需要flush；命令一次完成，走块设备层的同步路径
+static const blkdev_ops_t floppy_blk_ops = {
+    floppy_blk_read,
+    floppy_blk_write,
+    0,
+    0,
+    0,
+    0,
+    0
+};
+
+// 将软驱注册到块设备层，设备表已满时返回0
+static int floppy_register_blkdev(floppy_t* fd) {
+    blkdev_t* blk = &fd->blk;
+
+    strcpy(blk->name, "fd0");
+    blk->name[2] = '0' + fd->drive;
+    blk->sector_size = FLOPPY_SECTOR_SIZE;
+    blk->capacity = FLOPPY_TOTAL_SECTORS;
+    blk->ops = &floppy_blk_ops;
+    blk->priv = fd;
+
+    return blkdev_register(blk);
+}
+
+// 初始化软盘驱动
+void floppy_init() {
+    uint8_t types = floppy_read_cmos(CMOS_FLOPPY_TYPES);
+
+    floppy_num = 0;
+    floppy_motors = 0;
+    memset(floppies, 0, sizeof(floppies));
+    for (int i = 0; i < FLOPPY_CACHE_TRACKS; i++) {
+        floppy_tracks[i].drive = -1;
+    }
+
+    // CMOS高4位是驱动器0的类型，低4位是驱动器1，只支持1.44MB驱动器
+    floppies[0].present = (types >> 4) == FLOPPY_TYPE_1440K;
+    floppies[1].present = (types & 0x0F) == FLOPPY_TYPE_1440K;
+    if (!floppies[0].present && !floppies[1].present) {
+        return;
+    }
+
+    // DMA缓冲区必须在ISA DMA可达的范围内
+    if ((uint32_t)floppy_dma_buf + FLOPPY_TRACK_BYTES > DMA_LIMIT) {
+        print_string("软盘DMA缓冲区超出16MB，不启用软驱");
+        print_newline();
+        return;
+    }
+
+    // 命令完成只能由中断通知
+    if (!irq_register(IRQ_FLOPPY, floppy_irq_handler)) {
+        return;
+    }
+
+    if (!floppy_reset()) {
+        print_string("软盘控制器复位失败");
+        print_newline();
+        return;
+    }
+    floppy_configure();
+
+    for (int i = 0; i < FLOPPY_MAX_DRIVES; i++) {
+        floppy_t* fd = &floppies[i];
+        fd->drive = i;
+        fd->cylinder = -1;
+        if (!fd->present) continue;
+        if (!floppy_register_blkdev(fd)) {
+            fd->present = 0;
+            continue;
+        }
+
+        char drive_str[16];
+        int_to_string(i, drive_str);
+        print_string("发现1.44MB软驱 fd");
+        print_string(drive_str);
+        print_newline();
+
+        floppy_num++;
+    }
+}
+
+// 已发现的软驱数量
+int floppy_count() {
+    return floppy_num;
+}
+
+// 按驱动器号获取块设备，驱动器不存在时返回NULL
+blkdev_t* floppy_get_blkdev(int drive) {
+    if (drive < 0 || drive >= FLOPPY_MAX_DRIVES || !floppies[drive].present) {
+        return 0;
+    }
+    return &floppies[drive].blk;
+}
@@ -0,0 +1,104 @@
+#ifndef FLOPPY_H
+#define FLOPPY_H
+
+#include <stdint.h>
+#include "blkdev.h"
+
+// 82077AA软盘控制器驱动定义 (1.44MB 3.5英寸软盘)
+#define FLOPPY_MAX_DRIVES     2          // 控制器上最多的驱动器数
+#define FLOPPY_SECTOR_SIZE    512
+#define FLOPPY_SECTORS        18         // 每磁道扇区数
+#define FLOPPY_HEADS          2
+#define FLOPPY_CYLINDERS      80
+#define FLOPPY_TOTAL_SECTORS  (FLOPPY_SECTORS * FLOPPY_HEADS * FLOPPY_CYLINDERS)
+#define FLOPPY_TRACK_SECTORS  (FLOPPY_SECTORS * FLOPPY_HEADS)              // 一条命令读取的扇区数 (同一柱面两面)
+#define FLOPPY_TRACK_BYTES    (FLOPPY_TRACK_SECTORS * FLOPPY_SECTOR_SIZE)
+#define FLOPPY_CACHE_TRACKS   8          // 磁道缓存的柱面数 (两个驱动器共用)
+#define FLOPPY_RETRIES        3          // 读写失败时的重试次数
+
+// 超时 (滴答，100Hz)
+#define FLOPPY_IRQ_TIMEOUT    300        // 等待命令完成的最大滴答数
+#define FLOPPY_MOTOR_SPINUP   30         // 电机启动后等待转速稳定 (约300毫秒)
+#define FLOPPY_FIFO_TIMEOUT   100000     // 等待FIFO就绪的最大循环次数
+
+// 控制器寄存器
+#define FDC_BASE              0x3F0
+#define FDC_DOR               (FDC_BASE + 2)   // 数字输出寄存器
+#define FDC_MSR               (FDC_BASE + 4)   // 主状态寄存器 (读)
+#define FDC_DSR               (FDC_BASE + 4)   // 数据率选择寄存器 (写)
+#define FDC_FIFO              (FDC_BASE + 5)   // 命令/数据FIFO
+#define FDC_DIR               (FDC_BASE + 7)   // 数字输入寄存器 (读)
+#define FDC_CCR               (FDC_BASE + 7)   // 配置控制寄存器 (写)
+
+// DOR位
+#define FDC_DOR_RESET         0x04       // 为0时控制器复位
+#define FDC_DOR_DMA           0x08       // 允许DMA与中断
+#define FDC_DOR_MOTOR(d)      (0x10 << (d))
+
+// MSR位
+#define FDC_MSR_BUSY          0x10
+#define FDC_MSR_DIO           0x40       // 1: 控制器到CPU
+#define FDC_MSR_RQM           0x80       // FIFO可以读写
+
+// DIR位
+#define FDC_DIR_CHANGE        0x80       // 软盘曾被取出
+
+// 命令
+#define FDC_CMD_SPECIFY       0x03
+#define FDC_CMD_WRITE_DATA    0x05
+#define FDC_CMD_READ_DATA     0x06
+#define FDC_CMD_RECALIBRATE   0x07
+#define FDC_CMD_SENSE_INT     0x08
+#define FDC_CMD_SEEK          0x0F
+#define FDC_CMD_VERSION       0x10
+#define FDC_CMD_CONFIGURE     0x13
+#define FDC_CMD_MT            0x80       // 多磁道: 磁头0的最后一个扇区之后继续磁头1
+#define FDC_CMD_MFM           0x40
+
+#define FDC_VERSION_82077     0x90       // VERSION命令对增强型控制器的返回值
+#define FDC_GAP3_RW           0x1B       // 1.44MB软盘读写时的GAP3长度
+#define FDC_SECTOR_N          2          // 扇区长度编码: 128 << 2 = 512
+
+// 8237 DMA控制器，软盘使用通道2
+#define DMA_MASK_REG          0x0A
+#define DMA_MODE_REG          0x0B
+#define DMA_FLIPFLOP_REG      0x0C
+#define DMA_CH2_ADDR          0x04
+#define DMA_CH2_COUNT         0x05
+#define DMA_CH2_PAGE          0x81
+#define DMA_CHANNEL_FLOPPY    2
+#define DMA_MODE_READ         0x44       // 单字节传送，设备写入内存
+#define DMA_MODE_WRITE        0x48       // 单字节传送，从内存读出到设备
+#define DMA_LIMIT             0x1000000  // ISA DMA只能访问16MB以下
+
+// CMOS中的软驱类型
+#define CMOS_FLOPPY_TYPES     0x10
+#define FLOPPY_TYPE_1440K     4
+
+// 磁道缓存项: 一个柱面两面的全部扇区
+typedef struct {
+    int drive;                 // 所属驱动器，-1表示空闲
+    int cylinder;
+    unsigned int last_use;     // 最近使用的序号，用于LRU替换
+    uint8_t data[FLOPPY_TRACK_BYTES];
+} floppy_track_t;
+
+// 软盘驱动器
+typedef struct {
+    int drive;                 // 控制器上的驱动器号
+    int present;               // 是否存在1.44MB驱动器
+    int calibrated;            // 是否已重新校准
+    int cylinder;              // 磁头当前所在柱面，-1表示未知
+    blkdev_t blk;              // 注册到块设备层的设备
+} floppy_t;
+
+// 探测软盘控制器并把驱动器注册为块设备 "fd0"、"fd1"
+void floppy_init();
+
+// 已发现的软驱数量
+int floppy_count();
+
+// 按驱动器号获取块设备，驱动器不存在时返回NULL
+blkdev_t* floppy_get_blkdev(int drive);
+
+#endif // FLOPPY_H
@@ -1,4 +1,5 @@
 #include "fs.h"
+#include "bcache.h"
 #include "memory.h"
 #include "string.h"
 
@@ -6,64 +7,27 @@
 extern void print_string(const char* str);
 extern void print_newline(void);
 extern void int_to_string(int num, char* str);
-extern void outb(unsigned short port, unsigned char data);
-extern unsigned char inb(unsigned short port);
 
 // 前向声明，解决隐式声明问题
 void disk_use_data_storage();
 void disk_use_system_storage();
+int fs_disk_flush();
 
 // 文件系统状态
 static int fs_initialized = 0;
 static int fs_mounted = 0;
 static int fs_persistent_enabled = 0; // 新增：标记是否启用持久化功能
 static filesystem_t fs;
+static blkdev_t* fs_dev = 0;           // 数据盘块设备
 
-// 16位端口输入函数
-unsigned short inw(unsigned short port) {
-    unsigned short result;
-    __asm__("in %%dx, %%ax" : "=a" (result) : "d" (port));
-    return result;
-}
-
-// 16位端口输出函数
-void outw(unsigned short port, unsigned short data) {
-    __asm__("out %%ax, %%dx" : : "a" (data), "d" (port));
-}
-
-// ATA磁盘端口定义 - 使用第二个磁盘 (Secondary ATA)
-#define ATA_DATA            0x170
-#define ATA_ERROR           0x171
-#define ATA_SECTOR_COUNT    0x172
-#define ATA_LBA_LOW         0x173
-#define ATA_LBA_MID         0x174
-#define ATA_LBA_HIGH        0x175
-#define ATA_DRIVE_HEAD      0x176
-#define ATA_STATUS          0x177
-#define ATA_COMMAND         0x177
-#define ATA_CONTROL         0x376
-
-// ATA命令
-#define ATA_CMD_READ_SECTORS     0x20
-#define ATA_CMD_WRITE_SECTORS    0x30
-
-// ATA状态位
-#define ATA_STATUS_ERR  0x01
-#define ATA_STATUS_DRQ  0x08
-#define ATA_STATUS_BSY  0x80
+// 数据盘默认使用次IDE通道上的磁盘，没有时使用第二个软驱 (make run中的数据盘)
+#define FS_DEFAULT_DEVICE   "hdc"
+#define FS_FALLBACK_DEVICE  "fd1"
 
 // 内存磁盘模拟 - 用于系统盘
 #define DISK_SECTORS 1024
 static char disk_image[DISK_SECTORS * SECTOR_SIZE] = {0};
 
-// 磁盘缓存 - 用于数据盘
-#define CACHE_SECTORS 32
-static char sector_cache[CACHE_SECTORS][SECTOR_SIZE] = {0};
-static unsigned int cached_sectors[CACHE_SECTORS] = {0};
-static int cache_valid[CACHE_SECTORS] = {0};
-static int cache_dirty[CACHE_SECTORS] = {0};
-static int next_cache_slot = 0;
-
 // 文件系统布局常量
 #define FS_SUPERBLOCK_SECTOR 1
 #define FS_FILE_TABLE_SECTOR 2
@@ -93,111 +57,43 @@ void fs_enable_persistence() {
     print_newline();
 }
 
-// ATA磁盘等待就绪
-void ata_wait_ready() {
-    // 如果未启用持久化，直接返回
-    if (!fs_persistent_enabled) return;
-    
-    // 等待BSY位清零，但设置超时，防止死循环
-    int timeout = 10000; // 安全超时
-    while ((inb(ATA_STATUS) & ATA_STATUS_BSY) && timeout > 0) {
-        timeout--;
+// 指定数据盘块设备，可以是内存盘 "ram0"
+// 切换前把原设备上的脏缓存写回 (缓冲区缓存按设备区分，不必作废)
+void fs_set_device(blkdev_t* dev) {
+    if (fs_dev && fs_dev != dev) {
+        fs_disk_flush();
     }
+    fs_dev = dev;
 }
 
-// ATA磁盘读取扇区 - 从第二个磁盘读取
-int ata_read_sector(unsigned int lba, void* buffer) {
-    // 如果未启用持久化，直接返回失败
-    if (!fs_persistent_enabled) return 0;
-    
-    // 等待磁盘就绪
-    ata_wait_ready();
-    if (!fs_persistent_enabled) return 0; // 双重检查
-    
-    // 设置要读取的扇区数（1个）
-    outb(ATA_SECTOR_COUNT, 1);
-    
-    // 设置LBA地址
-    outb(ATA_LBA_LOW, lba & 0xFF);
-    outb(ATA_LBA_MID, (lba >> 8) & 0xFF);
-    outb(ATA_LBA_HIGH, (lba >> 16) & 0xFF);
-    
-    // 设置驱动器和LBA模式（第2个磁盘，LBA模式）
-    outb(ATA_DRIVE_HEAD, 0xF0 | ((lba >> 24) & 0x0F));
-    
-    // 发送读扇区命令
-    outb(ATA_COMMAND, ATA_CMD_READ_SECTORS);
-    
-    // 等待数据就绪
-    ata_wait_ready();
-    if (inb(ATA_STATUS) & ATA_STATUS_ERR) {
-        return 0;
+// 获取数据盘块设备，未指定时使用默认设备
+static blkdev_t* fs_get_device() {
+    if (!fs_dev) {
+        fs_dev = blkdev_find(FS_DEFAULT_DEVICE);
     }
-    
-    // 读取数据（每次读取一个字）
-    unsigned short* buf = (unsigned short*)buffer;
-    for (int i = 0; i < SECTOR_SIZE / 2; i++) {
-        buf[i] = inw(ATA_DATA);
+    if (!fs_dev) {
+        fs_dev = blkdev_find(FS_FALLBACK_DEVICE);
     }
-    
-    return 1;
+    return fs_dev;
 }
 
-// ATA磁盘写入扇区 - 写入第二个磁盘
-int ata_write_sector(unsigned int lba, const void* buffer) {
+// 经缓冲区缓存从数据盘读取扇区
+static int data_read_sector(unsigned int lba, void* buffer) {
     // 如果未启用持久化，直接返回失败
     if (!fs_persistent_enabled) return 0;
     
-    // 等待磁盘就绪
-    ata_wait_ready();
-    if (!fs_persistent_enabled) return 0; // 双重检查
-    
-    // 设置要写入的扇区数（1个）
-    outb(ATA_SECTOR_COUNT, 1);
-    
-    // 设置LBA地址
-    outb(ATA_LBA_LOW, lba & 0xFF);
-    outb(ATA_LBA_MID, (lba >> 8) & 0xFF);
-    outb(ATA_LBA_HIGH, (lba >> 16) & 0xFF);
-    
-    // 设置驱动器和LBA模式（第2个磁盘，LBA模式）
-    outb(ATA_DRIVE_HEAD, 0xF0 | ((lba >> 24) & 0x0F));
-    
-    // 发送写扇区命令
-    outb(ATA_COMMAND, ATA_CMD_WRITE_SECTORS);
-    
-    // 等待磁盘准备接收数据
-    ata_wait_ready();
-    if (inb(ATA_STATUS) & ATA_STATUS_ERR) {
-        return 0;
-    }
-    
-    // 写入数据（每次写入一个字）
-    unsigned short* buf = (unsigned short*)buffer;
-    for (int i = 0; i < SECTOR_SIZE / 2; i++) {
-        outw(ATA_DATA, buf[i]);
-    }
-    
-    // 等待写入完成
-    ata_wait_ready();
-    if (inb(ATA_STATUS) & ATA_STATUS_ERR) {
-        return 0;
-    }
-    
-    return 1;
+    return bcache_read(fs_get_device(), lba, 1, buffer);
 }
 
-// 从缓存中查找扇区
-int find_in_cache(unsigned int sector) {
-    for (int i = 0; i < CACHE_SECTORS; i++) {
-        if (cache_valid[i] && cached_sectors[i] == sector) {
-            return i;
-        }
-    }
-    return -1;
+// 写入缓冲区缓存，在fs_disk_flush时落到数据盘
+static int data_write_sector(unsigned int lba, const void* buffer) {
+    // 如果未启用持久化，直接返回失败
+    if (!fs_persistent_enabled) return 0;
+    
+    return bcache_write(fs_get_device(), lba, 1, buffer);
 }
 
-// 磁盘读写操作 - 所有操作首先使用内存，持久化启用后才使用ATA
+// 磁盘读写操作 - 所有操作首先使用内存，持久化启用后才使用数据盘
 int disk_read_sector(unsigned int sector, void* buffer) {
     if (sector >= DISK_SECTORS) {
         return 0;
@@ -212,36 +108,11 @@ int disk_read_sector(unsigned int sector, void* buffer) {
         return 1;
     }
     
-    // 持久化已启用，检查缓存
-    int cache_idx = find_in_cache(sector);
-    if (cache_idx >= 0) {
-        // 从缓存中读取
-        memcpy(buffer, sector_cache[cache_idx], SECTOR_SIZE);
-        return 1;
-    }
-    
-    // 不在缓存中，尝试从ATA读取
-    char ata_buffer[SECTOR_SIZE];
-    if (ata_read_sector(sector, ata_buffer)) {
-        // 添加到缓存
-        cache_idx = next_cache_slot;
-        
-        // 如果当前缓存位置有脏数据，先写回磁盘
-        if (cache_valid[cache_idx] && cache_dirty[cache_idx]) {
-            ata_write_sector(cached_sectors[cache_idx], sector_cache[cache_idx]);
-        }
-        
-        // 更新缓存和内存镜像
-        memcpy(sector_cache[cache_idx], ata_buffer, SECTOR_SIZE);
-        memcpy(&disk_image[offset], ata_buffer, SECTOR_SIZE);
-        memcpy(buffer, ata_buffer, SECTOR_SIZE);
-        
-        cached_sectors[cache_idx] = sector;
-        cache_valid[cache_idx] = 1;
-        cache_dirty[cache_idx] = 0;
-        
-        // 更新下一个缓存位置
-        next_cache_slot = (next_cache_slot + 1) % CACHE_SECTORS;
+    // 持久化已启用，从数据盘 (缓冲区缓存) 读取并更新内存镜像
+    char data_buffer[SECTOR_SIZE];
+    if (data_read_sector(sector, data_buffer)) {
+        memcpy(&disk_image[offset], data_buffer, SECTOR_SIZE);
+        memcpy(buffer, data_buffer, SECTOR_SIZE);
     }
     
     return 1;
@@ -261,32 +132,8 @@ int disk_write_sector(unsigned int sector, const void* buffer) {
         return 1;
     }
     
-    // 持久化已启用，处理缓存
-    int cache_idx = find_in_cache(sector);
-    if (cache_idx < 0) {
-        // 不在缓存中，使用下一个可用的缓存位置
-        cache_idx = next_cache_slot;
-        
-        // 如果当前缓存位置有脏数据，先写回磁盘
-        if (cache_valid[cache_idx] && cache_dirty[cache_idx]) {
-            ata_write_sector(cached_sectors[cache_idx], sector_cache[cache_idx]);
-        }
-        
-        // 更新缓存信息
-        cached_sectors[cache_idx] = sector;
-        cache_valid[cache_idx] = 1;
-    }
-    
-    // 更新缓存内容并标记为脏
-    memcpy(sector_cache[cache_idx], buffer, SECTOR_SIZE);
-    cache_dirty[cache_idx] = 1;
-    
-    // 更新下一个缓存位置
-    if (cache_idx == next_cache_slot) {
-        next_cache_slot = (next_cache_slot + 1) % CACHE_SECTORS;
-    }
-    
-    return 1;
+    // 持久化已启用，写入缓冲区缓存
+    return data_write_sector(sector, buffer);
 }
 
 // 将缓存刷新到磁盘
@@ -296,17 +143,11 @@ int fs_disk_flush() {
         return 1;
     }
     
-    // 将所有脏缓存写回磁盘
-    for (int i = 0; i < CACHE_SECTORS; i++) {
-        if (cache_valid[i] && cache_dirty[i]) {
-            if (!ata_write_sector(cached_sectors[i], sector_cache[i])) {
-                // 写入失败，简单记录错误
-                print_string("Warning: Failed to flush sector cache!");
-                print_newline();
-            } else {
-                cache_dirty[i] = 0;
-            }
-        }
+    // 脏扇区由请求队列排序合并后写回，再让数据盘把写缓存落盘
+    if (!bcache_flush(fs_get_device())) {
+        // 写入失败，缓存保留脏扇区，简单记录错误
+        print_string("Warning: Failed to flush sector cache!");
+        print_newline();
     }
     return 1;
 }
@@ -705,12 +546,37 @@ int fs_write(file_t* file, const void* buffer, unsigned int size) {
         save_fs_metadata();
     }
     
-    // 添加：确保数据刷新到磁盘
-    if (fs_persistent_enabled) {
-        fs_disk_flush();
+    // 数据留在缓冲区缓存中，由定时的后台写回落盘 (同步或卸载时立即写回)
+    return bytes_written;
+}
+
+// 文件占用的扇区数，空文件也占着起始扇区
+static unsigned int file_sector_count(const file_entry_t* entry) {
+    unsigned int sectors = (entry->size + SECTOR_SIZE - 1) / SECTOR_SIZE;
+    return sectors ? sectors : 1;
+}
+
+// 丢弃被删除文件的数据扇区: 缓存中的脏扇区不再写回，块设备层在刷新之后下发丢弃
+// 文件按起始扇区顺序分配，后面的文件可能从这个文件的范围中间开始，只丢弃它之前的部分
+static void fs_discard_file(int file_index) {
+    const file_entry_t* entry = &fs.file_table[file_index];
+    unsigned int start = entry->start_sector;
+    unsigned int end = start + file_sector_count(entry);
+    
+    for (int i = 0; i < MAX_FILES; i++) {
+        const file_entry_t* other = &fs.file_table[i];
+        if (i == file_index || !other->is_used) continue;
+        
+        unsigned int other_end = other->start_sector + file_sector_count(other);
+        if (other->start_sector < end && other_end > start) {
+            if (other->start_sector <= start) return;
+            end = other->start_sector;
+        }
     }
+    if (end > DISK_SECTORS) end = DISK_SECTORS;
+    if (start >= end) return;
     
-    return bytes_written;
+    bcache_discard(fs_get_device(), start, end - start);
 }
 
 // 删除文件
@@ -733,9 +599,9 @@ int fs_delete(const char* filename) {
         return 0;
     }
     
-    // 确保数据刷新到磁盘
+    // 文件表留在缓冲区缓存中由后台写回，数据扇区的丢弃在写回文件表之后才下发
     if (fs_persistent_enabled) {
-        fs_disk_flush();
+        fs_discard_file(file_index);
     }
     
     return 1;
@@ -761,17 +627,8 @@ int fs_rename(const char* oldname, const char* newname) {
     // 更新文件名
     strcpy(fs.file_table[file_index].filename, newname);
     
-    // 保存文件系统元数据
-    if (!save_fs_metadata()) {
-        return 0;
-    }
-    
-    // 确保数据刷新到磁盘
-    if (fs_persistent_enabled) {
-        fs_disk_flush();
-    }
-    
-    return 1;
+    // 保存文件系统元数据，由缓冲区缓存的后台写回落盘
+    return save_fs_metadata();
 }
 
 // 调整文件指针位置
@@ -1,6 +1,8 @@
 #ifndef FS_H
 #define FS_H
 
+#include "blkdev.h"
+
 // 文件系统常量定义
 #define MAX_FILENAME_LENGTH 32
 #define MAX_FILES 16  // 减少为16个文件，确保文件表不超过一个扇区
@@ -45,6 +47,9 @@ int fs_is_mounted();
 // 持久化存储控制
 void fs_enable_persistence();
 
+// 指定数据盘块设备 (默认使用次IDE磁盘 "hdc")，fs_format随后格式化该设备
+void fs_set_device(blkdev_t* dev);
+
 // 文件系统初始化与挂载
 void fs_init();
 int fs_format();
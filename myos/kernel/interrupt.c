@@ -0,0 +1,159 @@
+#include "interrupt.h"
+
+// IDT门描述符
+typedef struct {
+    uint16_t offset_low;       // 处理程序地址低16位
+    uint16_t selector;         // 代码段选择子
+    uint8_t zero;
+    uint8_t type_attr;         // 类型与属性
+    uint16_t offset_high;      // 处理程序地址高16位
+} __attribute__((packed)) idt_entry_t;
+
+// IDTR寄存器内容
+typedef struct {
+    uint16_t limit;
+    uint32_t base;
+} __attribute__((packed)) idt_ptr_t;
+
+// 32位中断门，DPL=0，存在
+#define IDT_INTERRUPT_GATE  0x8E
+
+// isr.asm中的IRQ入口桩
+extern uint32_t irq_stub_table[IRQ_COUNT];
+
+static idt_entry_t idt[IDT_ENTRIES];
+static irq_handler_t irq_handlers[IRQ_COUNT][IRQ_MAX_SHARED];
+static int interrupts_ready = 0;
+
+static inline uint8_t inb(uint16_t port) {
+    uint8_t ret;
+    asm volatile("inb %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+static inline void outb(uint16_t port, uint8_t val) {
+    asm volatile("outb %0, %1" : : "a"(val), "Nd"(port));
+}
+
+// 设置一个IDT门
+static void idt_set_gate(int vector, uint32_t handler, uint16_t selector) {
+    idt[vector].offset_low = handler & 0xFFFF;
+    idt[vector].selector = selector;
+    idt[vector].zero = 0;
+    idt[vector].type_attr = IDT_INTERRUPT_GATE;
+    idt[vector].offset_high = (handler >> 16) & 0xFFFF;
+}
+
+// 把PIC的IRQ0-15重映射到0x20-0x2F，避开CPU异常向量，并屏蔽全部IRQ
+static void pic_remap() {
+    outb(PIC1_COMMAND, 0x11);          // ICW1: 级联，需要ICW4
+    outb(PIC2_COMMAND, 0x11);
+    outb(PIC1_DATA, IRQ_BASE);         // ICW2: 向量基址
+    outb(PIC2_DATA, IRQ_BASE + 8);
+    outb(PIC1_DATA, 0x04);             // ICW3: 从片接在IRQ2
+    outb(PIC2_DATA, 0x02);
+    outb(PIC1_DATA, 0x01);             // ICW4: 8086模式
+    outb(PIC2_DATA, 0x01);
+    
+    // 只保留级联线，其余IRQ在注册处理函数时再打开
+    outb(PIC1_DATA, (uint8_t)~(1 << IRQ_CASCADE));
+    outb(PIC2_DATA, 0xFF);
+}
+
+// 打开一条IRQ线
+static void pic_unmask(int irq) {
+    uint16_t port = irq < 8 ? PIC1_DATA : PIC2_DATA;
+    
+    outb(port, inb(port) & ~(1 << (irq & 7)));
+}
+
+// 读取PIC的正在服务寄存器
+static uint16_t pic_get_isr() {
+    outb(PIC1_COMMAND, 0x0B);
+    outb(PIC2_COMMAND, 0x0B);
+    return ((uint16_t)inb(PIC2_COMMAND) << 8) | inb(PIC1_COMMAND);
+}
+
+// 建立IDT、重映射PIC并开中断
+void interrupt_init() {
+    idt_ptr_t idtr;
+    uint16_t cs;
+    
+    // 沿用当前代码段 (GRUB和自带引导扇区的GDT选择子不同)
+    asm volatile("mov %%cs, %0" : "=r"(cs));
+    
+    for (int i = 0; i < IRQ_COUNT; i++) {
+        for (int j = 0; j < IRQ_MAX_SHARED; j++) {
+            irq_handlers[i][j] = 0;
+        }
+        idt_set_gate(IRQ_BASE + i, irq_stub_table[i], cs);
+    }
+    
+    pic_remap();
+    
+    idtr.limit = sizeof(idt) - 1;
+    idtr.base = (uint32_t)idt;
+    asm volatile("lidt %0" : : "m"(idtr));
+    
+    interrupts_ready = 1;
+    asm volatile("sti");
+}
+
+// 中断是否已经可用
+int interrupt_enabled() {
+    return interrupts_ready;
+}
+
+// 注册IRQ处理函数
+int irq_register(int irq, irq_handler_t handler) {
+    if (!interrupts_ready || irq < 0 || irq >= IRQ_COUNT || !handler) {
+        return 0;
+    }
+    
+    // 追加到该线的处理函数列表，重复注册同一个函数只保留一份
+    int slot = -1;
+    for (int i = 0; i < IRQ_MAX_SHARED; i++) {
+        if (irq_handlers[irq][i] == handler) {
+            slot = i;
+            break;
+        }
+        if (!irq_handlers[irq][i] && slot < 0) {
+            slot = i;
+        }
+    }
+    if (slot < 0) {
+        return 0;
+    }
+    irq_handlers[irq][slot] = handler;
+    pic_unmask(irq);
+    
+    // 从片上的IRQ还需要打开主片的级联线
+    if (irq >= 8) {
+        pic_unmask(IRQ_CASCADE);
+    }
+    
+    return 1;
+}
+
+// IRQ公共分发入口
+void irq_dispatch(uint32_t irq) {
+    // IRQ7/15可能是伪中断，此时正在服务寄存器中没有对应位
+    if ((irq == 7 || irq == 15) && !(pic_get_isr() & (1 << irq))) {
+        if (irq == 15) {
+            outb(PIC1_COMMAND, PIC_EOI);   // 主片仍然需要级联线的EOI
+        }
+        return;
+    }
+    
+    // 共用中断线的设备各自检查自己的中断状态
+    for (int i = 0; i < IRQ_MAX_SHARED; i++) {
+        if (irq_handlers[irq][i]) {
+            irq_handlers[irq][i](irq);
+        }
+    }
+    
+    if (irq >= 8) {
+        outb(PIC2_COMMAND, PIC_EOI);
+    }
+    outb(PIC1_COMMAND, PIC_EOI);
+}
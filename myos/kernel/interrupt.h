@@ -0,0 +1,42 @@
+#ifndef INTERRUPT_H
+#define INTERRUPT_H
+
+#include <stdint.h>
+
+// IDT与8259A PIC定义
+#define IDT_ENTRIES         256
+#define IRQ_COUNT           16
+#define IRQ_MAX_SHARED      4          // 每条IRQ线最多的处理函数数 (PCI设备共用中断线)
+#define IRQ_BASE            0x20       // IRQ0重映射到的中断向量
+
+#define PIC1_COMMAND        0x20
+#define PIC1_DATA           0x21
+#define PIC2_COMMAND        0xA0
+#define PIC2_DATA           0xA1
+#define PIC_EOI             0x20
+
+// 常用IRQ号
+#define IRQ_TIMER           0
+#define IRQ_KEYBOARD        1
+#define IRQ_CASCADE         2
+#define IRQ_FLOPPY          6
+#define IRQ_ATA_PRIMARY     14
+#define IRQ_ATA_SECONDARY   15
+
+// IRQ处理函数
+typedef void (*irq_handler_t)(int irq);
+
+// 建立IDT、重映射PIC并开中断
+void interrupt_init();
+
+// 中断是否已经可用
+int interrupt_enabled();
+
+// 注册IRQ处理函数并打开对应屏蔽位，成功返回1
+// 同一条线可以注册多个处理函数，中断到来时依次调用
+int irq_register(int irq, irq_handler_t handler);
+
+// IRQ公共分发入口 (由isr.asm调用)
+void irq_dispatch(uint32_t irq);
+
+#endif // INTERRUPT_H
@@ -0,0 +1,388 @@
+#include "iso9660.h"
+#include "memory.h"
+#include "string.h"
+
+// 共享的块缓冲区
+static uint8_t iso9660_block[ISO9660_BLOCK_SIZE];
+
+// 读目录时暂存目录项，读完后按实际数量复制到缓存
+static iso9660_entry_t iso9660_scratch[ISO9660_MAX_ENTRIES];
+
+// 小端序字段 (ISO9660的双字节序字段中前一半是小端序)
+static inline uint16_t iso9660_le16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t iso9660_le32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// 读取连续的逻辑块
+static int iso9660_read_blocks(iso9660_t* fs, uint32_t block, uint32_t count, void* buffer) {
+    return blkdev_read(fs->dev, (uint64_t)block * fs->sectors_per_block,
+                       count * fs->sectors_per_block, buffer);
+}
+
+// 读取目录的逻辑块，按元数据优先级派发
+static int iso9660_read_dir_blocks(iso9660_t* fs, uint32_t block, uint32_t count, void* buffer) {
+    return blkdev_read_meta(fs->dev, (uint64_t)block * fs->sectors_per_block,
+                            count * fs->sectors_per_block, buffer);
+}
+
+// 复制文件标识符，去掉版本号 ";1" 和没有扩展名时末尾的 "."
+static void iso9660_copy_name(char* dest, const uint8_t* src, int len) {
+    int n = 0;
+
+    for (int i = 0; i < len && n < ISO9660_NAME_MAX - 1; i++) {
+        if (src[i] == ';') break;
+        dest[n++] = (char)src[i];
+    }
+    if (n > 0 && dest[n - 1] == '.') n--;
+    dest[n] = 0;
+}
+
+static inline char iso9660_lower(char c) {
+    return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+}
+
+// 不区分大小写比较文件名与路径分量
+static int iso9660_name_eq(const char* name, const char* comp, int len) {
+    for (int i = 0; i < len; i++) {
+        if (!name[i] || iso9660_lower(name[i]) != iso9660_lower(comp[i])) {
+            return 0;
+        }
+    }
+    return name[len] == 0;
+}
+
+// 取出下一个路径分量，返回分量起始位置，len为0表示路径已结束
+static const char* iso9660_component(const char** path, int* len) {
+    const char* p = *path;
+
+    while (*p == '/') p++;
+    const char* start = p;
+    while (*p && *p != '/') p++;
+
+    *len = (int)(p - start);
+    *path = p;
+    return start;
+}
+
+// 在路径表索引中查找子目录，返回目录编号，找不到返回-1
+// 路径表按父目录编号排序，但目录数很少，直接线性查找
+static int iso9660_child_dir(iso9660_t* fs, int parent, const char* comp, int len) {
+    for (int i = 1; i < fs->dir_count; i++) {
+        if (fs->dirs[i].parent == parent && iso9660_name_eq(fs->dirs[i].name, comp, len)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// 只用路径表把整条路径解析为目录编号，不读取任何目录记录
+static int iso9660_lookup_dir(iso9660_t* fs, const char* path) {
+    int dir = 0;
+    int len;
+
+    for (;;) {
+        const char* comp = iso9660_component(&path, &len);
+        if (len == 0) return dir;
+        dir = iso9660_child_dir(fs, dir, comp, len);
+        if (dir < 0) return -1;
+    }
+}
+
+// 解析一块中的目录记录，跳过 "." 和 ".."
+static int iso9660_parse_block(const uint8_t* block, int count) {
+    uint32_t off = 0;
+
+    while (off < ISO9660_BLOCK_SIZE) {
+        const uint8_t* rec = block + off;
+        uint8_t len = rec[0];
+
+        // 记录不跨块，长度为0表示本块剩余部分是填充
+        if (len == 0) break;
+        if (len < 34 || off + len > ISO9660_BLOCK_SIZE) break;
+
+        uint8_t name_len = rec[32];
+        const uint8_t* name = rec + 33;
+        off += len;
+
+        if (name_len == 1 && (name[0] == 0 || name[0] == 1)) continue;
+        if (count >= ISO9660_MAX_ENTRIES) return -1;
+
+        iso9660_entry_t* entry = &iso9660_scratch[count++];
+        iso9660_copy_name(entry->name, name, name_len);
+        entry->extent = iso9660_le32(rec + 2);
+        entry->size = iso9660_le32(rec + 10);
+        entry->flags = rec[25];
+    }
+
+    return count;
+}
+
+// 取得目录内容，不在缓存中时一次读入整个目录并解析
+static iso9660_dir_cache_t* iso9660_load_dir(iso9660_t* fs, int dir) {
+    iso9660_dir_cache_t* cache = &fs->cache[0];
+
+    for (int i = 0; i < ISO9660_DIR_CACHE; i++) {
+        if (fs->cache[i].dir == dir) {
+            fs->cache[i].last_use = ++fs->use_seq;
+            return &fs->cache[i];
+        }
+        if (fs->cache[i].last_use < cache->last_use) {
+            cache = &fs->cache[i];
+        }
+    }
+
+    // 替换最久未用的目录
+    if (cache->entries) free(cache->entries);
+    cache->entries = 0;
+    cache->dir = -1;
+    cache->count = 0;
+
+    // 第一块的 "." 记录给出整个目录的长度
+    uint32_t extent = fs->dirs[dir].extent;
+    if (!iso9660_read_dir_blocks(fs, extent, 1, iso9660_block)) {
+        return 0;
+    }
+    uint32_t size = iso9660_le32(iso9660_block + 10);
+    uint32_t blocks = (size + ISO9660_BLOCK_SIZE - 1) / ISO9660_BLOCK_SIZE;
+
+    int count = iso9660_parse_block(iso9660_block, 0);
+
+    // 其余的块用一次读取取回
+    if (count >= 0 && blocks > 1) {
+        uint8_t* rest = (uint8_t*)malloc((blocks - 1) * ISO9660_BLOCK_SIZE);
+        if (!rest) return 0;
+
+        if (!iso9660_read_dir_blocks(fs, extent + 1, blocks - 1, rest)) {
+            free(rest);
+            return 0;
+        }
+        for (uint32_t b = 0; b < blocks - 1 && count >= 0; b++) {
+            count = iso9660_parse_block(rest + b * ISO9660_BLOCK_SIZE, count);
+        }
+        free(rest);
+    }
+    if (count < 0) {
+        return 0;   // 目录项太多
+    }
+
+    if (count > 0) {
+        cache->entries = (iso9660_entry_t*)malloc(count * sizeof(iso9660_entry_t));
+        if (!cache->entries) return 0;
+        memcpy(cache->entries, iso9660_scratch, count * sizeof(iso9660_entry_t));
+    }
+
+    cache->dir = dir;
+    cache->count = count;
+    cache->last_use = ++fs->use_seq;
+    return cache;
+}
+
+// 读取路径表，建立目录索引
+static int iso9660_load_path_table(iso9660_t* fs, uint32_t lba, uint32_t size) {
+    uint32_t blocks = (size + ISO9660_BLOCK_SIZE - 1) / ISO9660_BLOCK_SIZE;
+    uint8_t* table = (uint8_t*)malloc(blocks * ISO9660_BLOCK_SIZE);
+
+    if (!table) return 0;
+    if (!iso9660_read_blocks(fs, lba, blocks, table)) {
+        free(table);
+        return 0;
+    }
+
+    // 每条记录: 名字长度、扩展属性长度、起始块、父目录编号 (从1开始)、名字，按偶数对齐
+    uint32_t off = 0;
+    fs->dir_count = 0;
+    while (off + 8 <= size) {
+        const uint8_t* rec = table + off;
+        uint8_t name_len = rec[0];
+
+        if (name_len == 0 || off + 8 + name_len > size) break;
+        if (fs->dir_count >= ISO9660_MAX_DIRS) {
+            free(table);
+            return 0;
+        }
+
+        iso9660_dir_t* dir = &fs->dirs[fs->dir_count++];
+        dir->extent = iso9660_le32(rec + 2);
+        dir->parent = (uint16_t)(iso9660_le16(rec + 6) - 1);
+        iso9660_copy_name(dir->name, rec + 8, name_len);
+
+        off += 8 + name_len + (name_len & 1);
+    }
+
+    free(table);
+
+    // 第一条记录是根目录，根的名字是一个0字节
+    if (fs->dir_count == 0) return 0;
+    fs->dirs[0].parent = 0;
+    fs->dirs[0].name[0] = 0;
+    return 1;
+}
+
+// 挂载ISO9660文件系统
+int iso9660_mount(iso9660_t* fs, blkdev_t* dev) {
+    if (!fs || !dev || dev->sector_size == 0 || ISO9660_BLOCK_SIZE % dev->sector_size) {
+        return 0;
+    }
+
+    if (fs->mounted) {
+        iso9660_unmount(fs);
+    }
+    memset(fs, 0, sizeof(iso9660_t));
+    fs->dev = dev;
+    fs->sectors_per_block = ISO9660_BLOCK_SIZE / dev->sector_size;
+    for (int i = 0; i < ISO9660_DIR_CACHE; i++) {
+        fs->cache[i].dir = -1;
+    }
+
+    // 查找主卷描述符
+    for (uint32_t lba = ISO9660_PVD_LBA; ; lba++) {
+        if (lba >= ISO9660_PVD_LBA + 32 || !iso9660_read_blocks(fs, lba, 1, iso9660_block)) {
+            return 0;
+        }
+        if (memcmp(iso9660_block + 1, "CD001", 5) != 0) {
+            return 0;
+        }
+        if (iso9660_block[0] == ISO9660_VD_PRIMARY) break;
+        if (iso9660_block[0] == ISO9660_VD_TERMINATOR) return 0;
+    }
+
+    if (iso9660_le16(iso9660_block + 128) != ISO9660_BLOCK_SIZE) {
+        return 0;   // 只支持2048字节的逻辑块
+    }
+    fs->volume_blocks = iso9660_le32(iso9660_block + 80);
+
+    // 卷标，去掉尾部空格
+    memcpy(fs->volume_id, iso9660_block + 40, 32);
+    int len = 32;
+    while (len > 0 && fs->volume_id[len - 1] == ' ') len--;
+    fs->volume_id[len] = 0;
+
+    // 使用小端序的L型路径表
+    uint32_t pt_size = iso9660_le32(iso9660_block + 132);
+    uint32_t pt_lba = iso9660_le32(iso9660_block + 140);
+    if (!iso9660_load_path_table(fs, pt_lba, pt_size)) {
+        return 0;
+    }
+
+    fs->mounted = 1;
+    return 1;
+}
+
+// 卸载文件系统
+void iso9660_unmount(iso9660_t* fs) {
+    for (int i = 0; i < ISO9660_DIR_CACHE; i++) {
+        if (fs->cache[i].entries) free(fs->cache[i].entries);
+        fs->cache[i].entries = 0;
+        fs->cache[i].dir = -1;
+    }
+    fs->mounted = 0;
+}
+
+// 查找路径对应的目录项: 中间各级目录只查路径表，最后一级在父目录的缓存中查找
+int iso9660_find(iso9660_t* fs, const char* path, iso9660_entry_t* entry) {
+    if (!fs || !fs->mounted || !path) return 0;
+
+    // 找出最后一个分量
+    const char* end = path + strlen(path);
+    while (end > path && end[-1] == '/') end--;
+    const char* name = end;
+    while (name > path && name[-1] != '/') name--;
+
+    // 根目录
+    if (name == end) {
+        memset(entry, 0, sizeof(iso9660_entry_t));
+        entry->extent = fs->dirs[0].extent;
+        entry->flags = ISO9660_FLAG_DIR;
+        return 1;
+    }
+
+    // 父目录路径交给路径表解析
+    char parent_path[256];
+    uint32_t parent_len = (uint32_t)(name - path);
+    if (parent_len >= sizeof(parent_path)) return 0;
+    memcpy(parent_path, path, parent_len);
+    parent_path[parent_len] = 0;
+
+    int dir = iso9660_lookup_dir(fs, parent_path);
+    if (dir < 0) return 0;
+
+    iso9660_dir_cache_t* cache = iso9660_load_dir(fs, dir);
+    if (!cache) return 0;
+
+    int name_len = (int)(end - name);
+    for (int i = 0; i < cache->count; i++) {
+        if (iso9660_name_eq(cache->entries[i].name, name, name_len)) {
+            *entry = cache->entries[i];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// 列出目录内容
+int iso9660_list(iso9660_t* fs, const char* path, const iso9660_entry_t** entries, int* count) {
+    if (!fs || !fs->mounted || !path) return 0;
+
+    int dir = iso9660_lookup_dir(fs, path);
+    if (dir < 0) return 0;
+
+    iso9660_dir_cache_t* cache = iso9660_load_dir(fs, dir);
+    if (!cache) return 0;
+
+    *entries = cache->entries;
+    *count = cache->count;
+    return 1;
+}
+
+// 打开文件
+int iso9660_open(iso9660_t* fs, const char* path, iso9660_file_t* file) {
+    iso9660_entry_t entry;
+
+    if (!iso9660_find(fs, path, &entry) || (entry.flags & ISO9660_FLAG_DIR)) {
+        return 0;
+    }
+
+    file->fs = fs;
+    file->extent = entry.extent;
+    file->size = entry.size;
+    file->position = 0;
+    return 1;
+}
+
+// 从当前位置读取: 对齐的整块直接读入调用者的缓冲区，首尾不足一块的部分经块缓冲区中转
+int iso9660_read(iso9660_file_t* file, void* buffer, uint32_t size) {
+    uint8_t* buf = (uint8_t*)buffer;
+    uint32_t done = 0;
+
+    if (!file || !file->fs || !buffer) return -1;
+    if (file->position >= file->size) return 0;
+    if (size > file->size - file->position) size = file->size - file->position;
+
+    while (size > 0) {
+        uint32_t block = file->extent + file->position / ISO9660_BLOCK_SIZE;
+        uint32_t off = file->position % ISO9660_BLOCK_SIZE;
+        uint32_t n;
+
+        if (off == 0 && size >= ISO9660_BLOCK_SIZE) {
+            uint32_t blocks = size / ISO9660_BLOCK_SIZE;
+            if (!iso9660_read_blocks(file->fs, block, blocks, buf)) return -1;
+            n = blocks * ISO9660_BLOCK_SIZE;
+        } else {
+            if (!iso9660_read_blocks(file->fs, block, 1, iso9660_block)) return -1;
+            n = ISO9660_BLOCK_SIZE - off;
+            if (n > size) n = size;
+            memcpy(buf, iso9660_block + off, n);
+        }
+
+        file->position += n;
+        buf += n;
+        done += n;
+        size -= n;
+    }
+
+    return (int)done;
+}
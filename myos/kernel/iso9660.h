@@ -0,0 +1,83 @@
+#ifndef ISO9660_H
+#define ISO9660_H
+
+#include <stdint.h>
+#include "blkdev.h"
+
+// ISO9660 常量
+#define ISO9660_BLOCK_SIZE      2048        // 逻辑块大小
+#define ISO9660_PVD_LBA         16          // 卷描述符从第16块开始
+#define ISO9660_VD_PRIMARY      1           // 主卷描述符
+#define ISO9660_VD_TERMINATOR   255         // 卷描述符结束
+#define ISO9660_MAX_DIRS        512         // 路径表中最多的目录数
+#define ISO9660_MAX_ENTRIES     1024        // 单个目录最多的目录项数
+#define ISO9660_NAME_MAX        32          // 文件名最大长度 (含结尾0)
+#define ISO9660_DIR_CACHE       16          // 缓存内容的目录数
+
+// 目录记录标志
+#define ISO9660_FLAG_HIDDEN     0x01
+#define ISO9660_FLAG_DIR        0x02
+
+// 路径表中的目录，按路径表顺序编号 (0是根目录)
+typedef struct {
+    uint32_t extent;                // 目录数据的起始逻辑块
+    uint16_t parent;                // 父目录的编号，根目录指向自己
+    char name[ISO9660_NAME_MAX];    // 目录名
+} iso9660_dir_t;
+
+// 目录中的一项
+typedef struct {
+    char name[ISO9660_NAME_MAX];    // 去掉版本号 ";1" 后的文件名
+    uint32_t extent;                // 数据的起始逻辑块
+    uint32_t size;                  // 数据长度 (字节)
+    uint8_t flags;                  // ISO9660_FLAG_*
+} iso9660_entry_t;
+
+// 已读入的目录内容
+typedef struct {
+    int dir;                        // 目录编号，-1表示空闲
+    unsigned int last_use;          // 最近使用的序号，用于LRU替换
+    int count;                      // 目录项数
+    iso9660_entry_t* entries;       // 目录项 (malloc分配)
+} iso9660_dir_cache_t;
+
+// ISO9660 文件系统实例
+typedef struct {
+    blkdev_t* dev;                  // 所在块设备
+    uint32_t sectors_per_block;     // 每个逻辑块对应的设备扇区数
+    uint32_t volume_blocks;         // 卷的逻辑块数
+    char volume_id[33];             // 卷标
+    int mounted;                    // 是否已挂载
+    int dir_count;                  // 路径表中的目录数
+    iso9660_dir_t dirs[ISO9660_MAX_DIRS];        // 由路径表建立的目录索引
+    iso9660_dir_cache_t cache[ISO9660_DIR_CACHE]; // 目录内容缓存
+    unsigned int use_seq;           // 缓存使用序号
+} iso9660_t;
+
+// 打开的文件
+typedef struct {
+    iso9660_t* fs;                  // 所属文件系统
+    uint32_t extent;                // 数据的起始逻辑块
+    uint32_t size;                  // 文件大小
+    uint32_t position;              // 当前位置
+} iso9660_file_t;
+
+// 挂载块设备上的ISO9660文件系统，读入路径表建立目录索引，成功返回1
+int iso9660_mount(iso9660_t* fs, blkdev_t* dev);
+
+// 卸载文件系统并释放目录缓存
+void iso9660_unmount(iso9660_t* fs);
+
+// 查找路径对应的目录项，成功返回1
+int iso9660_find(iso9660_t* fs, const char* path, iso9660_entry_t* entry);
+
+// 列出目录内容，entries指向目录缓存，在下一次查找前有效，成功返回1
+int iso9660_list(iso9660_t* fs, const char* path, const iso9660_entry_t** entries, int* count);
+
+// 打开文件，成功返回1
+int iso9660_open(iso9660_t* fs, const char* path, iso9660_file_t* file);
+
+// 从当前位置读取，返回读取的字节数，出错返回-1
+int iso9660_read(iso9660_file_t* file, void* buffer, uint32_t size);
+
+#endif // ISO9660_H
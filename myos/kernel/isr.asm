@@ -0,0 +1,47 @@
+; IRQ入口桩
+; 每个桩压入IRQ号后跳到公共入口，由irq_dispatch完成处理和EOI
+
+section .text
+extern irq_dispatch
+
+%macro IRQ_STUB 1
+irq_stub%1:
+    push dword %1
+    jmp irq_common
+%endmacro
+
+IRQ_STUB 0
+IRQ_STUB 1
+IRQ_STUB 2
+IRQ_STUB 3
+IRQ_STUB 4
+IRQ_STUB 5
+IRQ_STUB 6
+IRQ_STUB 7
+IRQ_STUB 8
+IRQ_STUB 9
+IRQ_STUB 10
+IRQ_STUB 11
+IRQ_STUB 12
+IRQ_STUB 13
+IRQ_STUB 14
+IRQ_STUB 15
+
+irq_common:
+    pushad                   ; 保存通用寄存器
+    cld                      ; C代码假定方向标志清零
+    push dword [esp + 32]    ; IRQ号
+    call irq_dispatch
+    add esp, 4
+    popad
+    add esp, 4               ; 弹出IRQ号
+    iretd
+
+section .data
+global irq_stub_table
+align 4
+irq_stub_table:
+    dd irq_stub0, irq_stub1, irq_stub2, irq_stub3
+    dd irq_stub4, irq_stub5, irq_stub6, irq_stub7
+    dd irq_stub8, irq_stub9, irq_stub10, irq_stub11
+    dd irq_stub12, irq_stub13, irq_stub14, irq_stub15
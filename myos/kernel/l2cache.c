@@ -0,0 +1,444 @@
+#include "l2cache.h"
+#include "memory.h"
+#include "string.h"
+
+static l2cache_t l2cache_devices[L2CACHE_MAX_DEVICES];
+static int l2cache_count = 0;
+
+// 映射表扇区缓冲 (读超级块和格式化时使用)
+static uint8_t l2cache_sector[BLKDEV_SECTOR_SIZE];
+
+// 缓存槽在缓存设备上的起始扇区
+static uint64_t l2cache_slot_lba(l2cache_t* c, uint32_t slot) {
+    return c->data_start + ((uint64_t)slot << L2CACHE_BLOCK_SHIFT);
+}
+
+// 后端块所在组的第一个槽
+static uint32_t l2cache_set_base(l2cache_t* c, uint32_t block) {
+    return (block & (c->sets - 1)) * L2CACHE_WAYS;
+}
+
+// 查找缓存块，命中时更新LRU时间戳并返回槽号，否则返回-1
+static int l2cache_lookup(l2cache_t* c, uint32_t block) {
+    uint32_t base = l2cache_set_base(c, block);
+
+    for (uint32_t i = base; i < base + L2CACHE_WAYS; i++) {
+        if (c->tags[i] == block + 1) {
+            c->stamps[i] = ++c->clock;
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+// 把内存中的映射表扇区写到缓存设备 (不刷新)
+static int l2cache_put_map(l2cache_t* c, uint32_t sector) {
+    uint32_t first = sector * L2CACHE_MAP_PER_SECTOR;
+
+    if (!blkdev_write_meta(c->cache, c->map_start + sector, 1, &c->tags[first])) {
+        return 0;
+    }
+    memcpy(&c->disk_tags[first], &c->tags[first], L2CACHE_MAP_PER_SECTOR * sizeof(uint32_t));
+    c->map_dirty[sector] = 0;
+    return 1;
+}
+
+// 把修改过的映射表写回缓存设备
+// 先刷新缓存设备，保证表项指向的数据已经落盘，再写映射表并刷新
+static int l2cache_sync(l2cache_t* c) {
+    int dirty = 0;
+
+    for (uint32_t i = 0; i < c->map_sectors; i++) {
+        if (c->map_dirty[i]) dirty = 1;
+    }
+    if (!dirty && !c->unflushed) {
+        return 1;
+    }
+
+    if (c->unflushed) {
+        if (!blkdev_flush(c->cache)) return 0;
+        c->unflushed = 0;
+    }
+    for (uint32_t i = 0; i < c->map_sectors; i++) {
+        if (c->map_dirty[i] && !l2cache_put_map(c, i)) return 0;
+    }
+    c->pending = 0;
+    return blkdev_flush(c->cache);
+}
+
+// 后端第0扇区的校验和 (FNV-1a)，用来察觉换盘和重新格式化
+static int l2cache_backing_sum(l2cache_t* c, uint32_t* sum) {
+    if (!blkdev_read_meta(c->backing, 0, 1, l2cache_sector)) {
+        return 0;
+    }
+
+    uint32_t h = 2166136261u;
+    for (uint32_t i = 0; i < BLKDEV_SECTOR_SIZE; i++) {
+        h = (h ^ l2cache_sector[i]) * 16777619u;
+    }
+    *sum = h;
+    return 1;
+}
+
+// 以FUA写超级块，state为L2CACHE_STATE_*
+// 标记干净分离时记下后端第0扇区的校验和，调用者须已刷新后端并写回映射表
+static int l2cache_put_super(l2cache_t* c, uint32_t state) {
+    uint32_t sum = 0;
+
+    if (state == L2CACHE_STATE_CLEAN && !l2cache_backing_sum(c, &sum)) {
+        return 0;
+    }
+
+    memset(l2cache_sector, 0, sizeof(l2cache_sector));
+    l2cache_super_t* sb = (l2cache_super_t*)l2cache_sector;
+    sb->magic = L2CACHE_MAGIC;
+    sb->version = L2CACHE_VERSION;
+    sb->block_sectors = L2CACHE_BLOCK_SECTORS;
+    sb->slots = c->slots;
+    sb->ways = L2CACHE_WAYS;
+    sb->map_start = c->map_start;
+    sb->data_start = c->data_start;
+    sb->state = state;
+    sb->backing_capacity = c->backing->capacity;
+    sb->backing_sum = sum;
+    strcpy(sb->backing_name, c->backing->name);
+
+    if (!blkdev_write_fua(c->cache, 0, 1, l2cache_sector)) {
+        return 0;
+    }
+    c->clean = state == L2CACHE_STATE_CLEAN;
+    return 1;
+}
+
+// 修改槽的表项，记下需要写回的映射表扇区
+static void l2cache_set_tag(l2cache_t* c, uint32_t slot, uint32_t tag) {
+    c->tags[slot] = tag;
+    if (c->tags[slot] != c->disk_tags[slot]) {
+        c->map_dirty[slot / L2CACHE_MAP_PER_SECTOR] = 1;
+    }
+}
+
+// 把刚从后端读出的整块装入缓存
+static void l2cache_admit(l2cache_t* c, uint32_t block, const uint8_t* data) {
+    uint32_t base = l2cache_set_base(c, block);
+    uint32_t victim = base;
+
+    // 优先用空槽，其中又优先用缓存设备上也是空的槽；都满时替换最久未访问的
+    for (uint32_t i = base; i < base + L2CACHE_WAYS; i++) {
+        uint32_t score_i = (c->tags[i] ? 2 : 0) + (c->disk_tags[i] ? 1 : 0);
+        uint32_t score_v = (c->tags[victim] ? 2 : 0) + (c->disk_tags[victim] ? 1 : 0);
+        if (score_i < score_v || (score_i == score_v && c->stamps[i] < c->stamps[victim])) {
+            victim = i;
+        }
+    }
+
+    if (c->tags[victim]) {
+        c->stats.evictions++;
+    }
+
+    // 缓存设备上的表项还指向旧块时，先把作废写下去再覆盖数据，崩溃后不会把新数据当成旧块
+    if (c->disk_tags[victim]) {
+        l2cache_set_tag(c, victim, 0);
+        if (!l2cache_sync(c)) return;
+    }
+
+    if (!blkdev_write(c->cache, l2cache_slot_lba(c, victim), L2CACHE_BLOCK_SECTORS, data)) {
+        l2cache_set_tag(c, victim, 0);
+        return;
+    }
+    c->unflushed = 1;
+    l2cache_set_tag(c, victim, block + 1);
+    c->stamps[victim] = ++c->clock;
+    c->stats.admits++;
+
+    if (++c->pending >= L2CACHE_SYNC_ADMITS) {
+        l2cache_sync(c);
+    }
+}
+
+// 记录一次未命中的整块读取，最近未命中过的块再次被读到时装入缓存
+// 只读一次的块 (顺序扫描、备份) 不会把热点块挤出去
+static void l2cache_reference(l2cache_t* c, uint32_t block, const uint8_t* data) {
+    uint32_t h = (block * 2654435761u) >> (32 - L2CACHE_GHOST_BITS);
+
+    if (c->ghost[h] == block + 1) {
+        c->ghost[h] = 0;
+        l2cache_admit(c, block, data);
+    } else {
+        c->ghost[h] = block + 1;
+    }
+}
+
+// 从后端读取一段连续的未命中扇区，并登记其中完整覆盖的块
+static int l2cache_read_miss(l2cache_t* c, uint64_t lba, uint32_t count, uint8_t* buffer) {
+    if (!blkdev_read(c->backing, lba, count, buffer)) {
+        return 0;
+    }
+
+    uint32_t sector_size = c->blk.sector_size;
+    uint64_t end = lba + count;
+    uint64_t block_lba = (lba + L2CACHE_BLOCK_SECTORS - 1) & ~(uint64_t)(L2CACHE_BLOCK_SECTORS - 1);
+
+    for (; block_lba + L2CACHE_BLOCK_SECTORS <= end; block_lba += L2CACHE_BLOCK_SECTORS) {
+        l2cache_reference(c, (uint32_t)(block_lba >> L2CACHE_BLOCK_SHIFT),
+                          buffer + (uint32_t)(block_lba - lba) * sector_size);
+    }
+    return 1;
+}
+
+// 块设备接口: 逐块查找，命中的从缓存设备读，连续的未命中合并成一次后端读取
+static int l2cache_blk_read(blkdev_t* dev, uint64_t lba, uint32_t count, void* buffer) {
+    l2cache_t* c = (l2cache_t*)dev->priv;
+    uint32_t sector_size = dev->sector_size;
+    uint8_t* buf = (uint8_t*)buffer;
+    uint64_t end = lba + count;
+    uint64_t miss_lba = 0;
+    uint8_t* miss_buf = 0;
+    uint32_t miss_count = 0;
+
+    while (lba < end) {
+        uint32_t block = (uint32_t)(lba >> L2CACHE_BLOCK_SHIFT);
+        uint32_t offset = (uint32_t)lba & (L2CACHE_BLOCK_SECTORS - 1);
+        uint32_t n = L2CACHE_BLOCK_SECTORS - offset;
+        if (n > end - lba) n = (uint32_t)(end - lba);
+
+        int slot = l2cache_lookup(c, block);
+        if (slot >= 0 && !blkdev_read(c->cache, l2cache_slot_lba(c, slot) + offset, n, buf)) {
+            // 缓存设备读失败时丢掉该块，改从后端读取
+            l2cache_set_tag(c, slot, 0);
+            slot = -1;
+        }
+
+        if (slot < 0) {
+            if (miss_count == 0) {
+                miss_lba = lba;
+                miss_buf = buf;
+            }
+            miss_count += n;
+            c->stats.misses++;
+        } else {
+            if (miss_count && !l2cache_read_miss(c, miss_lba, miss_count, miss_buf)) {
+                return 0;
+            }
+            miss_count = 0;
+            c->stats.hits++;
+        }
+
+        lba += n;
+        buf += n * sector_size;
+    }
+
+    if (miss_count) {
+        return l2cache_read_miss(c, miss_lba, miss_count, miss_buf);
+    }
+    return 1;
+}
+
+// 写直达: 先把被覆盖块的缓存项作废并落盘，再写后端
+// 顺序反过来的话，崩溃后缓存设备上可能留下比后端旧的数据
+static int l2cache_blk_write(blkdev_t* dev, uint64_t lba, uint32_t count, const void* buffer) {
+    l2cache_t* c = (l2cache_t*)dev->priv;
+    uint32_t first = (uint32_t)(lba >> L2CACHE_BLOCK_SHIFT);
+    uint32_t last = (uint32_t)((lba + count - 1) >> L2CACHE_BLOCK_SHIFT);
+    int persist = 0;
+
+    // 缓存设备上的表项也要检查: 读缓存设备出错时只在内存中作废过
+    for (uint32_t block = first; block <= last; block++) {
+        uint32_t base = l2cache_set_base(c, block);
+        for (uint32_t i = base; i < base + L2CACHE_WAYS; i++) {
+            if (c->tags[i] == block + 1) {
+                l2cache_set_tag(c, i, 0);
+                c->stats.invalidations++;
+            }
+            if (c->disk_tags[i] == block + 1) persist = 1;
+        }
+    }
+
+    if (persist && !l2cache_sync(c)) {
+        return 0;
+    }
+
+    // 干净分离之后第一次写后端前改回使用中，崩溃后不沿用映射表，下次刷新时重新记录校验和
+    if (c->clean && !l2cache_put_super(c, L2CACHE_STATE_ATTACHED)) {
+        return 0;
+    }
+    return blkdev_write(c->backing, lba, count, buffer);
+}
+
+// 刷新后端的写缓存，并把映射表写回缓存设备
+// 两者都成功后标记为干净分离: 此后关机，下次创建时可以沿用映射表
+static int l2cache_blk_flush(blkdev_t* dev) {
+    l2cache_t* c = (l2cache_t*)dev->priv;
+    int ok = blkdev_flush(c->backing);
+
+    if (!l2cache_sync(c)) ok = 0;
+    if (ok && !c->clean) ok = l2cache_put_super(c, L2CACHE_STATE_CLEAN);
+    return ok;
+}
+
+// 设备本身是同步设备: 后端和缓存设备各自的请求队列负责排队
+static const blkdev_ops_t l2cache_blk_ops = {
+    l2cache_blk_read,
+    l2cache_blk_write,
+    l2cache_blk_flush,
+    0,
+    0,
+    0,
+    0
+};
+
+// 读回缓存设备上的映射表，丢弃不属于所在组或超出后端容量的表项
+static int l2cache_load(l2cache_t* c) {
+    uint32_t blocks = (uint32_t)(c->backing->capacity >> L2CACHE_BLOCK_SHIFT);
+
+    for (uint32_t i = 0; i < c->map_sectors; i++) {
+        if (!blkdev_read_meta(c->cache, c->map_start + i, 1, &c->tags[i * L2CACHE_MAP_PER_SECTOR])) {
+            return 0;
+        }
+    }
+
+    memcpy(c->disk_tags, c->tags, c->slots * sizeof(uint32_t));
+
+    // 修正过的表项下次同步时写回
+    c->loaded = 0;
+    for (uint32_t i = 0; i < c->slots; i++) {
+        uint32_t tag = c->tags[i];
+        if (tag && (tag > blocks || l2cache_set_base(c, tag - 1) != i - i % L2CACHE_WAYS)) {
+            l2cache_set_tag(c, i, 0);
+        }
+        if (c->tags[i]) c->loaded++;
+    }
+    return 1;
+}
+
+// 在缓存设备上建立空映射表和超级块
+static int l2cache_format(l2cache_t* c) {
+    memset(c->tags, 0, c->slots * sizeof(uint32_t));
+    memset(c->disk_tags, 0, c->slots * sizeof(uint32_t));
+    memset(l2cache_sector, 0, sizeof(l2cache_sector));
+
+    for (uint32_t i = 0; i < c->map_sectors; i++) {
+        if (!blkdev_write_meta(c->cache, c->map_start + i, 1, l2cache_sector)) {
+            return 0;
+        }
+    }
+    if (!blkdev_flush(c->cache)) {
+        return 0;
+    }
+
+    c->loaded = 0;
+    return l2cache_put_super(c, L2CACHE_STATE_ATTACHED);
+}
+
+// 超级块与当前的后端设备和布局一致、上次干净分离且后端第0扇区没有变过时才能沿用映射表
+static int l2cache_super_matches(l2cache_t* c, const l2cache_super_t* sb, uint32_t sum) {
+    return sb->magic == L2CACHE_MAGIC &&
+           sb->version == L2CACHE_VERSION &&
+           sb->block_sectors == L2CACHE_BLOCK_SECTORS &&
+           sb->slots == c->slots &&
+           sb->ways == L2CACHE_WAYS &&
+           sb->map_start == c->map_start &&
+           sb->data_start == c->data_start &&
+           sb->state == L2CACHE_STATE_CLEAN &&
+           sb->backing_capacity == c->backing->capacity &&
+           sb->backing_sum == sum &&
+           strncmp(sb->backing_name, c->backing->name, BLKDEV_NAME_LENGTH) == 0;
+}
+
+// 后端和缓存设备必须是不同的可写设备，扇区为512字节，且不在其他二级缓存设备中
+static int l2cache_check_devices(blkdev_t* backing, blkdev_t* cache) {
+    if (!backing || !cache || backing == cache) {
+        return 0;
+    }
+    if (!backing->ops->write || !cache->ops->write) {
+        return 0;
+    }
+    if (backing->sector_size != BLKDEV_SECTOR_SIZE || cache->sector_size != BLKDEV_SECTOR_SIZE) {
+        return 0;
+    }
+    for (int i = 0; i < l2cache_count; i++) {
+        l2cache_t* c = &l2cache_devices[i];
+        if (c->backing == backing || c->cache == backing || &c->blk == backing ||
+            c->backing == cache || c->cache == cache || &c->blk == cache) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// 创建二级缓存设备
+blkdev_t* l2cache_create(blkdev_t* backing, blkdev_t* cache) {
+    if (l2cache_count >= L2CACHE_MAX_DEVICES || !l2cache_check_devices(backing, cache)) {
+        return 0;
+    }
+
+    l2cache_t* c = &l2cache_devices[l2cache_count];
+    memset(c, 0, sizeof(l2cache_t));
+    c->backing = backing;
+    c->cache = cache;
+
+    // 缓存设备放不下时把槽数减半
+    uint32_t slots = L2CACHE_MAX_SLOTS;
+    for (; slots >= L2CACHE_MIN_SLOTS; slots /= 2) {
+        uint32_t map_sectors = slots / L2CACHE_MAP_PER_SECTOR;
+        uint32_t data_start = (1 + map_sectors + L2CACHE_BLOCK_SECTORS - 1) & ~(L2CACHE_BLOCK_SECTORS - 1);
+        if (data_start + ((uint64_t)slots << L2CACHE_BLOCK_SHIFT) <= cache->capacity) {
+            c->map_sectors = map_sectors;
+            c->data_start = data_start;
+            break;
+        }
+    }
+    if (slots < L2CACHE_MIN_SLOTS) {
+        return 0;
+    }
+    c->slots = slots;
+    c->sets = slots / L2CACHE_WAYS;
+    c->map_start = 1;
+
+    uint32_t pages = (3 * slots * sizeof(uint32_t) + 4095) / 4096;
+    uint32_t* arrays = (uint32_t*)memory_alloc_pages(pages);
+    if (!arrays) {
+        return 0;
+    }
+    c->tags = arrays;
+    c->disk_tags = arrays + slots;
+    c->stamps = arrays + 2 * slots;
+    memset(c->stamps, 0, slots * sizeof(uint32_t));
+
+    // 沿用缓存设备上已有的映射表，布局或后端不符、或上次没有干净分离时重建
+    // 沿用时先标记为使用中，直到下一次刷新
+    uint32_t sum;
+    int ok = l2cache_backing_sum(c, &sum) && blkdev_read_meta(cache, 0, 1, l2cache_sector);
+    if (ok && l2cache_super_matches(c, (l2cache_super_t*)l2cache_sector, sum)) {
+        ok = l2cache_load(c) && l2cache_put_super(c, L2CACHE_STATE_ATTACHED);
+    } else if (ok) {
+        ok = l2cache_format(c);
+    }
+    if (!ok) {
+        memory_free_pages(arrays, pages);
+        return 0;
+    }
+
+    blkdev_t* blk = &c->blk;
+    strcpy(blk->name, "l2c0");
+    blk->name[3] = '0' + l2cache_count;
+    blk->sector_size = backing->sector_size;
+    blk->capacity = backing->capacity;
+    blk->ops = &l2cache_blk_ops;
+    blk->priv = c;
+    if (!blkdev_register(blk)) {
+        memory_free_pages(arrays, pages);
+        return 0;
+    }
+
+    l2cache_count++;
+    return blk;
+}
+
+// 获取第index个二级缓存设备
+l2cache_t* l2cache_get(int index) {
+    if (index < 0 || index >= l2cache_count) {
+        return 0;
+    }
+    return &l2cache_devices[index];
+}
@@ -0,0 +1,81 @@
+#ifndef L2CACHE_H
+#define L2CACHE_H
+
+#include <stdint.h>
+#include "blkdev.h"
+
+// 二级缓存设备定义: 把后端设备的热点块保存在另一块更快或更空闲的缓存设备上
+#define L2CACHE_MAX_DEVICES     2
+#define L2CACHE_MAGIC           0x4332434C // "LC2C"
+#define L2CACHE_VERSION         2
+#define L2CACHE_BLOCK_SHIFT     3          // 缓存块为8个扇区 (4KB)
+#define L2CACHE_BLOCK_SECTORS   (1u << L2CACHE_BLOCK_SHIFT)
+#define L2CACHE_WAYS            8          // 组相联的路数
+#define L2CACHE_MIN_SLOTS       64         // 缓存设备至少能放下256KB
+#define L2CACHE_MAX_SLOTS       32768      // 最多128KB缓存块 (128MB)，多余的空间不用
+#define L2CACHE_MAP_PER_SECTOR  128        // 每个映射表扇区的表项数
+#define L2CACHE_MAX_MAP_SECTORS (L2CACHE_MAX_SLOTS / L2CACHE_MAP_PER_SECTOR)
+#define L2CACHE_GHOST_BITS      10         // 未命中记录表1024项
+#define L2CACHE_SYNC_ADMITS     64         // 累计这么多次装入后把映射表写回缓存设备
+#define L2CACHE_STATE_ATTACHED  1          // 使用中: 后端可能有未反映到映射表的写入
+#define L2CACHE_STATE_CLEAN     2          // 刷新后干净分离: 映射表与后端一致
+
+// 缓存设备第0扇区的超级块
+// 之后是映射表 (每个缓存槽一个uint32_t: 后端块号+1，0表示空)，再后面按块对齐是缓存槽
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t block_sectors;                // 缓存块扇区数
+    uint32_t slots;                        // 缓存槽数 (2的幂)
+    uint32_t ways;                         // 组相联路数
+    uint32_t map_start;                    // 映射表起始扇区
+    uint32_t data_start;                   // 第一个缓存槽的起始扇区
+    uint32_t state;                        // L2CACHE_STATE_*，不是干净分离时重建缓存
+    uint64_t backing_capacity;             // 后端设备扇区数，不符时重建缓存
+    uint32_t backing_sum;                  // 干净分离时后端第0扇区的校验和，换盘或重新格式化后不符
+    char backing_name[BLKDEV_NAME_LENGTH]; // 后端设备名
+} __attribute__((packed)) l2cache_super_t;
+
+// 命中统计
+typedef struct {
+    uint32_t hits;                         // 从缓存设备读出的块
+    uint32_t misses;                       // 从后端设备读出的块
+    uint32_t admits;                       // 装入缓存的块
+    uint32_t evictions;                    // 被替换出去的块
+    uint32_t invalidations;                // 因写入后端而作废的块
+} l2cache_stats_t;
+
+// 二级缓存设备
+typedef struct {
+    blkdev_t* backing;                     // 后端设备 (慢)
+    blkdev_t* cache;                       // 缓存设备 (快/空闲)
+    uint32_t slots;                        // 缓存槽数
+    uint32_t sets;                         // 组数 = slots / L2CACHE_WAYS
+    uint32_t map_start;
+    uint32_t data_start;
+    uint32_t map_sectors;                  // 映射表扇区数
+    uint32_t loaded;                       // 创建时从映射表恢复的块数
+    uint32_t* tags;                        // 内存中的映射表
+    uint32_t* disk_tags;                   // 已写到缓存设备上的映射表
+    uint32_t* stamps;                      // 每个槽最近一次访问的时间戳 (LRU)
+    uint32_t clock;                        // 访问时间戳计数器
+    uint32_t pending;                      // 映射表写回前累计的装入次数
+    int unflushed;                         // 缓存设备上有未刷新的数据写入
+    int clean;                             // 缓存设备上的超级块标记为干净分离
+    uint8_t map_dirty[L2CACHE_MAX_MAP_SECTORS]; // 与缓存设备上不一致的映射表扇区
+    uint32_t ghost[1 << L2CACHE_GHOST_BITS];    // 最近未命中的后端块号+1: 再次访问时才装入
+    l2cache_stats_t stats;
+    blkdev_t blk;                          // 注册到块设备层的设备
+} l2cache_t;
+
+// 用cache缓存backing的热点块，注册为 "l2cN" 并返回，容量与后端设备相同
+// 缓存设备上已有同一后端设备的映射表、上次刷新后干净分离且后端第0扇区没有变过时继续使用
+// (缓存跨重启保持)，否则重建；绕过该设备直接写后端其他扇区的改动无法察觉
+// 读未命中的块第二次被读到时装入缓存；写入直接写后端并作废缓存中的旧块
+// 后端设备此后只能通过该设备访问，失败返回NULL
+blkdev_t* l2cache_create(blkdev_t* backing, blkdev_t* cache);
+
+// 获取第index个二级缓存设备，不存在时返回NULL
+l2cache_t* l2cache_get(int index);
+
+#endif // L2CACHE_H
@@ -13,6 +13,16 @@
 static char heap[HEAP_SIZE];
 static memory_block_t* free_list = NULL;
 
+// 物理页: 与simple_memory.c一样假设有16MB内存，内核映像之后的页面可以分配
+#define PAGE_SIZE   4096
+#define MEMORY_SIZE (16 * 1024 * 1024)
+#define PAGE_COUNT  (MEMORY_SIZE / PAGE_SIZE)
+
+extern char _end[];             // 链接脚本给出的内核映像结尾
+
+static unsigned int page_bitmap[PAGE_COUNT / 32];
+static unsigned int free_pages = 0;
+
 // 将int转换为字符串
 void int_to_string(int num, char* str) {
     int i = 0;
@@ -59,12 +69,89 @@ void int_to_string(int num, char* str) {
     }
 }
 
+static inline int page_test(unsigned int page) {
+    return page_bitmap[page / 32] & (1u << (page % 32));
+}
+
+static inline void page_set(unsigned int page) {
+    page_bitmap[page / 32] |= 1u << (page % 32);
+}
+
+static inline void page_clear(unsigned int page) {
+    page_bitmap[page / 32] &= ~(1u << (page % 32));
+}
+
 // 初始化内存管理系统
 void memory_init() {
     free_list = (memory_block_t*)heap;
     free_list->size = HEAP_SIZE - BLOCK_HEADER_SIZE;
     free_list->is_free = 1;
     free_list->next = NULL;
+    
+    // 低端1MB和内核映像所占的页面不可分配
+    unsigned int reserved = ((unsigned int)_end + PAGE_SIZE - 1) / PAGE_SIZE;
+    free_pages = 0;
+    for (unsigned int i = 0; i < PAGE_COUNT; i++) {
+        if (i < reserved) {
+            page_set(i);
+        } else {
+            page_clear(i);
+            free_pages++;
+        }
+    }
+}
+
+// 分配一个物理页
+void* memory_alloc_page() {
+    return memory_alloc_pages(1);
+}
+
+// 释放一个物理页
+void memory_free_page(void* addr) {
+    memory_free_pages(addr, 1);
+}
+
+// 分配连续的物理页，首次适配
+void* memory_alloc_pages(unsigned int count) {
+    unsigned int run = 0;
+    
+    if (count == 0 || count > free_pages) {
+        return NULL;
+    }
+    
+    for (unsigned int i = 0; i < PAGE_COUNT; i++) {
+        if (page_test(i)) {
+            run = 0;
+            continue;
+        }
+        if (++run == count) {
+            unsigned int first = i + 1 - count;
+            for (unsigned int j = first; j <= i; j++) {
+                page_set(j);
+            }
+            free_pages -= count;
+            return (void*)(first * PAGE_SIZE);
+        }
+    }
+    
+    return NULL;
+}
+
+// 释放连续的物理页
+void memory_free_pages(void* addr, unsigned int count) {
+    unsigned int first = (unsigned int)addr / PAGE_SIZE;
+    
+    for (unsigned int i = first; i < first + count && i < PAGE_COUNT; i++) {
+        if (page_test(i)) {
+            page_clear(i);
+            free_pages++;
+        }
+    }
+}
+
+// 空闲物理页数
+unsigned int memory_free_page_count() {
+    return free_pages;
 }
 
 // 分配内存
@@ -14,6 +14,9 @@ typedef struct memory_block {
 void memory_init();
 void* memory_alloc_page();
 void memory_free_page(void* addr);
+void* memory_alloc_pages(unsigned int count);            // 连续的count页，失败返回NULL
+void memory_free_pages(void* addr, unsigned int count);
+unsigned int memory_free_page_count();
 void memory_stats();
 
 // 内存分配
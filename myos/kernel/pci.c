@@ -0,0 +1,129 @@
+#include "pci.h"
+
+// 32位端口读写
+static inline uint32_t inl(uint16_t port) {
+    uint32_t ret;
+    asm volatile("inl %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+static inline void outl(uint16_t port, uint32_t val) {
+    asm volatile("outl %0, %1" : : "a"(val), "Nd"(port));
+}
+
+// 计算配置空间地址
+static uint32_t pci_address(pci_device_t* dev, uint8_t offset) {
+    return 0x80000000 |
+           ((uint32_t)dev->bus << 16) |
+           ((uint32_t)dev->slot << 11) |
+           ((uint32_t)dev->func << 8) |
+           (offset & 0xFC);
+}
+
+// 读32位配置寄存器
+uint32_t pci_read32(pci_device_t* dev, uint8_t offset) {
+    outl(PCI_CONFIG_ADDRESS, pci_address(dev, offset));
+    return inl(PCI_CONFIG_DATA);
+}
+
+// 读16位配置寄存器
+uint16_t pci_read16(pci_device_t* dev, uint8_t offset) {
+    uint32_t value = pci_read32(dev, offset);
+    return (uint16_t)(value >> ((offset & 2) * 8));
+}
+
+// 读8位配置寄存器
+uint8_t pci_read8(pci_device_t* dev, uint8_t offset) {
+    uint32_t value = pci_read32(dev, offset);
+    return (uint8_t)(value >> ((offset & 3) * 8));
+}
+
+// 写32位配置寄存器
+void pci_write32(pci_device_t* dev, uint8_t offset, uint32_t value) {
+    outl(PCI_CONFIG_ADDRESS, pci_address(dev, offset));
+    outl(PCI_CONFIG_DATA, value);
+}
+
+// 写16位配置寄存器 (读-改-写所在的双字)
+void pci_write16(pci_device_t* dev, uint8_t offset, uint16_t value) {
+    uint32_t old = pci_read32(dev, offset);
+    int shift = (offset & 2) * 8;
+
+    old &= ~(0xFFFFu << shift);
+    old |= (uint32_t)value << shift;
+    pci_write32(dev, offset, old);
+}
+
+// 按类别查找设备 (暴力扫描所有总线/插槽/功能)
+int pci_find_class(uint8_t class_code, uint8_t subclass, pci_device_t* dev) {
+    pci_device_t probe;
+
+    for (int bus = 0; bus < 256; bus++) {
+        for (int slot = 0; slot < 32; slot++) {
+            for (int func = 0; func < 8; func++) {
+                probe.bus = bus;
+                probe.slot = slot;
+                probe.func = func;
+
+                if (pci_read16(&probe, PCI_VENDOR_ID) == 0xFFFF) {
+                    // 功能0不存在则整个插槽为空
+                    if (func == 0) break;
+                    continue;
+                }
+
+                if (pci_read8(&probe, PCI_CLASS) == class_code &&
+                    pci_read8(&probe, PCI_SUBCLASS) == subclass) {
+                    *dev = probe;
+                    return 1;
+                }
+
+                // 单功能设备无需检查其余功能
+                if (func == 0 && !(pci_read8(&probe, PCI_HEADER_TYPE) & 0x80)) {
+                    break;
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+// 按厂商和设备ID查找第index个匹配的设备
+int pci_find_device(uint16_t vendor, uint16_t device, int index, pci_device_t* dev) {
+    pci_device_t probe;
+
+    for (int bus = 0; bus < 256; bus++) {
+        for (int slot = 0; slot < 32; slot++) {
+            for (int func = 0; func < 8; func++) {
+                probe.bus = bus;
+                probe.slot = slot;
+                probe.func = func;
+
+                uint16_t id = pci_read16(&probe, PCI_VENDOR_ID);
+                if (id == 0xFFFF) {
+                    if (func == 0) break;
+                    continue;
+                }
+
+                if (id == vendor && pci_read16(&probe, PCI_DEVICE_ID) == device) {
+                    if (index-- == 0) {
+                        *dev = probe;
+                        return 1;
+                    }
+                }
+
+                if (func == 0 && !(pci_read8(&probe, PCI_HEADER_TYPE) & 0x80)) {
+                    break;
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+// 打开总线主控，允许设备发起DMA
+void pci_enable_bus_master(pci_device_t* dev) {
+    uint16_t cmd = pci_read16(dev, PCI_COMMAND);
+    pci_write16(dev, PCI_COMMAND, cmd | PCI_CMD_IO | PCI_CMD_BUS_MASTER);
+}
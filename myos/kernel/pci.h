@@ -0,0 +1,60 @@
+#ifndef PCI_H
+#define PCI_H
+
+#include <stdint.h>
+
+// PCI配置空间端口
+#define PCI_CONFIG_ADDRESS  0xCF8
+#define PCI_CONFIG_DATA     0xCFC
+
+// 配置空间寄存器偏移
+#define PCI_VENDOR_ID       0x00
+#define PCI_DEVICE_ID       0x02
+#define PCI_COMMAND         0x04
+#define PCI_STATUS          0x06
+#define PCI_PROG_IF         0x09
+#define PCI_SUBCLASS        0x0A
+#define PCI_CLASS           0x0B
+#define PCI_HEADER_TYPE     0x0E
+#define PCI_BAR0            0x10
+#define PCI_BAR1            0x14
+#define PCI_BAR2            0x18
+#define PCI_BAR3            0x1C
+#define PCI_BAR4            0x20
+#define PCI_BAR5            0x24
+#define PCI_INTERRUPT_LINE  0x3C
+
+// 命令寄存器位
+#define PCI_CMD_IO          0x0001
+#define PCI_CMD_MEMORY      0x0002
+#define PCI_CMD_BUS_MASTER  0x0004
+
+// 设备类别
+#define PCI_CLASS_STORAGE   0x01
+#define PCI_SUBCLASS_IDE    0x01
+#define PCI_SUBCLASS_SATA   0x06
+
+// PCI设备位置
+typedef struct {
+    uint8_t bus;
+    uint8_t slot;
+    uint8_t func;
+} pci_device_t;
+
+// 读写配置空间
+uint32_t pci_read32(pci_device_t* dev, uint8_t offset);
+uint16_t pci_read16(pci_device_t* dev, uint8_t offset);
+uint8_t pci_read8(pci_device_t* dev, uint8_t offset);
+void pci_write32(pci_device_t* dev, uint8_t offset, uint32_t value);
+void pci_write16(pci_device_t* dev, uint8_t offset, uint16_t value);
+
+// 按类别查找设备，成功返回1
+int pci_find_class(uint8_t class_code, uint8_t subclass, pci_device_t* dev);
+
+// 按厂商和设备ID查找第index个匹配的设备，成功返回1
+int pci_find_device(uint16_t vendor, uint16_t device, int index, pci_device_t* dev);
+
+// 打开总线主控
+void pci_enable_bus_master(pci_device_t* dev);
+
+#endif // PCI_H
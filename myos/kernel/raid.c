@@ -0,0 +1,352 @@
+#include "raid.h"
+#include "string.h"
+
+// 外部函数声明
+extern void print_string(const char* str);
+extern void print_newline(void);
+
+static raid_t raid_volumes[RAID_MAX_VOLUMES];
+static int raid_count = 0;
+
+// RAID-0: 卷上的lba映射到成员和成员上的lba，返回该条带块内剩余的扇区数
+// 卷容量不超过2^32个条带块，条带块号用32位运算，不需要64位除法
+static uint32_t raid0_map(raid_t* r, uint64_t lba, int* member, uint64_t* member_lba) {
+    uint32_t chunk = (uint32_t)(lba >> r->chunk_shift);
+    uint32_t offset = (uint32_t)lba & (r->chunk_sectors - 1);
+    
+    *member = (int)(chunk % (uint32_t)r->members);
+    *member_lba = ((uint64_t)(chunk / (uint32_t)r->members) << r->chunk_shift) + offset;
+    return r->chunk_sectors - offset;
+}
+
+// 把一段I/O按条带块拆成各成员上的请求，每批提交后一起等待
+// 提交期间暂缓成员派发，同一成员上相邻的条带块合并成一条命令；
+// 成员是异步驱动时 (不同的IDE通道、AHCI端口) 各成员的命令同时执行
+static int raid0_rw(blkdev_t* dev, uint64_t lba, uint32_t count, uint8_t* buffer, int write) {
+    raid_t* r = (raid_t*)dev->priv;
+    blk_request_t reqs[RAID_MAX_SEGS];
+    int ok = 1;
+    
+    while (count > 0 && ok) {
+        int n = 0;
+        
+        for (int i = 0; i < r->members; i++) {
+            blkdev_plug(r->member[i]);
+        }
+        while (count > 0 && n < RAID_MAX_SEGS) {
+            int m;
+            uint64_t member_lba;
+            uint32_t len = raid0_map(r, lba, &m, &member_lba);
+            if (len > count) len = count;
+            
+            blk_request_t* req = &reqs[n++];
+            req->dev = r->member[m];
+            req->lba = member_lba;
+            req->count = len;
+            req->buffer = buffer;
+            req->write = write;
+            req->fua = 0;
+            req->prio = BLK_PRIO_SYNC;
+            req->end_io = 0;
+            req->priv = 0;
+            blkdev_submit(req);
+            
+            lba += len;
+            count -= len;
+            buffer += len * dev->sector_size;
+        }
+        for (int i = 0; i < r->members; i++) {
+            blkdev_unplug(r->member[i]);
+        }
+        
+        for (int i = 0; i < n; i++) {
+            if (!blkdev_wait(&reqs[i])) ok = 0;
+        }
+    }
+    return ok;
+}
+
+static int raid0_blk_read(blkdev_t* dev, uint64_t lba, uint32_t count, void* buffer) {
+    return raid0_rw(dev, lba, count, (uint8_t*)buffer, 0);
+}
+
+static int raid0_blk_write(blkdev_t* dev, uint64_t lba, uint32_t count, const void* buffer) {
+    return raid0_rw(dev, lba, count, (uint8_t*)buffer, 1);
+}
+
+// RAID-1: 标记成员出错，之后的读写跳过它
+static void raid1_fail(raid_t* r, int m) {
+    if (r->failed & (1u << m)) {
+        return;
+    }
+    r->failed |= 1u << m;
+    print_string("RAID-1 ");
+    print_string(r->blk.name);
+    print_string(": 成员 ");
+    print_string(r->member[m]->name);
+    print_string(" 出错，卷降级运行");
+    print_newline();
+}
+
+// RAID-1: 为读取选择成员，跳过出错的和exclude位图中的成员
+// 优先选待派发加在途命令最少的；一样多时选上一条命令结束位置离lba最近的 (寻道最短)
+static int raid1_pick(raid_t* r, uint64_t lba, uint32_t exclude) {
+    int best = -1;
+    int best_load = 0;
+    uint64_t best_dist = 0;
+    
+    for (int i = 0; i < r->members; i++) {
+        if ((r->failed | exclude) & (1u << i)) {
+            continue;
+        }
+        blkdev_t* m = r->member[i];
+        int load = m->queue_len + m->busy;
+        uint64_t dist = m->head_pos > lba ? m->head_pos - lba : lba - m->head_pos;
+        if (best < 0 || load < best_load || (load == best_load && dist < best_dist)) {
+            best = i;
+            best_load = load;
+            best_dist = dist;
+        }
+    }
+    return best;
+}
+
+// RAID-1: 同步读取一段，出错时换其他成员重试
+static int raid1_read_retry(raid_t* r, uint64_t lba, uint32_t count, void* buffer, uint32_t tried) {
+    for (;;) {
+        int m = raid1_pick(r, lba, tried);
+        if (m < 0) {
+            return 0;
+        }
+        if (blkdev_read(r->member[m], lba, count, buffer)) {
+            return 1;
+        }
+        raid1_fail(r, m);
+        tried |= 1u << m;
+    }
+}
+
+// RAID-1读取: 小请求整段交给选出的成员；大请求按成员数切成连续的几段，
+// 各段交给不同的成员同时读取，每个成员仍是顺序访问
+static int raid1_blk_read(blkdev_t* dev, uint64_t lba, uint32_t count, void* buffer) {
+    raid_t* r = (raid_t*)dev->priv;
+    blk_request_t reqs[RAID_MAX_MEMBERS];
+    int order[RAID_MAX_MEMBERS];
+    int n = 0;
+    uint32_t used = 0;
+    
+    // 可用成员按选择顺序排列
+    for (int m; (m = raid1_pick(r, lba, used)) >= 0; ) {
+        order[n++] = m;
+        used |= 1u << m;
+    }
+    if (n == 0) {
+        return 0;
+    }
+    if (count < (uint32_t)n * RAID1_SPLIT_SECTORS) {
+        n = 1;
+    }
+    
+    uint32_t part = count / n;
+    uint8_t* buf = (uint8_t*)buffer;
+    for (int i = 0; i < n; i++) {
+        blk_request_t* req = &reqs[i];
+        req->dev = r->member[order[i]];
+        req->lba = lba + (uint64_t)part * i;
+        req->count = i == n - 1 ? count - part * i : part;
+        req->buffer = buf + part * i * dev->sector_size;
+        req->write = 0;
+        req->fua = 0;
+        req->prio = BLK_PRIO_SYNC;
+        req->end_io = 0;
+        req->priv = 0;
+        blkdev_submit(req);
+    }
+    
+    int ok = 1;
+    for (int i = 0; i < n; i++) {
+        if (blkdev_wait(&reqs[i])) {
+            continue;
+        }
+        raid1_fail(r, order[i]);
+        if (!raid1_read_retry(r, reqs[i].lba, reqs[i].count, reqs[i].buffer, 1u << order[i])) {
+            ok = 0;
+        }
+    }
+    return ok;
+}
+
+// RAID-1写入: 同时提交到所有可用成员，至少一个成员写成功即算成功
+static int raid1_blk_write(blkdev_t* dev, uint64_t lba, uint32_t count, const void* buffer) {
+    raid_t* r = (raid_t*)dev->priv;
+    blk_request_t reqs[RAID_MAX_MEMBERS];
+    int ok = 0;
+    
+    for (int i = 0; i < r->members; i++) {
+        reqs[i].status = BLK_REQ_ERROR;
+        if (r->failed & (1u << i)) {
+            continue;
+        }
+        reqs[i].dev = r->member[i];
+        reqs[i].lba = lba;
+        reqs[i].count = count;
+        reqs[i].buffer = (void*)buffer;
+        reqs[i].write = 1;
+        reqs[i].fua = 0;
+        reqs[i].prio = BLK_PRIO_SYNC;
+        reqs[i].end_io = 0;
+        reqs[i].priv = 0;
+        blkdev_submit(&reqs[i]);
+    }
+    
+    for (int i = 0; i < r->members; i++) {
+        if (r->failed & (1u << i)) {
+            continue;
+        }
+        if (blkdev_wait(&reqs[i])) {
+            ok = 1;
+        } else {
+            raid1_fail(r, i);
+        }
+    }
+    return ok;
+}
+
+// 刷新所有成员的写缓存，RAID-1跳过出错的成员
+static int raid_blk_flush(blkdev_t* dev) {
+    raid_t* r = (raid_t*)dev->priv;
+    int ok = 1;
+    
+    for (int i = 0; i < r->members; i++) {
+        if (r->failed & (1u << i)) {
+            continue;
+        }
+        if (!blkdev_flush(r->member[i])) ok = 0;
+    }
+    return ok;
+}
+
+// 卷本身是同步设备: 一条命令在成员上拆成多条并行执行后才返回
+static const blkdev_ops_t raid0_blk_ops = {
+    raid0_blk_read,
+    raid0_blk_write,
+    raid_blk_flush,
+    0,
+    0,
+    0,
+    0
+};
+
+static const blkdev_ops_t raid1_blk_ops = {
+    raid1_blk_read,
+    raid1_blk_write,
+    raid_blk_flush,
+    0,
+    0,
+    0,
+    0
+};
+
+// 检查成员能否组成卷: 可写、扇区大小相同、互不重复且不在其他卷中
+static int raid_check_members(blkdev_t** members, int count) {
+    if (count < 2 || count > RAID_MAX_MEMBERS) {
+        return 0;
+    }
+    
+    for (int i = 0; i < count; i++) {
+        blkdev_t* m = members[i];
+        if (!m || !m->ops->write || m->sector_size != members[0]->sector_size) {
+            return 0;
+        }
+        for (int j = 0; j < i; j++) {
+            if (members[j] == m) return 0;
+        }
+        for (int v = 0; v < raid_count; v++) {
+            if (&raid_volumes[v].blk == m) return 0;
+            for (int j = 0; j < raid_volumes[v].members; j++) {
+                if (raid_volumes[v].member[j] == m) return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+// 填写下一个卷并注册为 "mdN"
+static raid_t* raid_register(int level, blkdev_t** members, int count, uint64_t capacity, const blkdev_ops_t* ops) {
+    raid_t* r = &raid_volumes[raid_count];
+    memset(r, 0, sizeof(raid_t));
+    r->level = level;
+    r->members = count;
+    for (int i = 0; i < count; i++) {
+        r->member[i] = members[i];
+    }
+    
+    blkdev_t* blk = &r->blk;
+    strcpy(blk->name, "md0");
+    blk->name[2] = '0' + raid_count;
+    blk->sector_size = members[0]->sector_size;
+    blk->capacity = capacity;
+    blk->ops = ops;
+    blk->priv = r;
+    if (!blkdev_register(blk)) {
+        return 0;
+    }
+    
+    raid_count++;
+    return r;
+}
+
+// 创建RAID-0条带卷
+blkdev_t* raid0_create(blkdev_t** members, int count, uint32_t chunk_kb) {
+    if (raid_count >= RAID_MAX_VOLUMES || !raid_check_members(members, count)) {
+        return 0;
+    }
+    
+    if (chunk_kb == 0) {
+        chunk_kb = RAID_DEFAULT_CHUNK_KB;
+    }
+    uint32_t sector_size = members[0]->sector_size;
+    uint32_t chunk_sectors = chunk_kb * 1024 / sector_size;
+    if (chunk_sectors == 0 || (chunk_sectors & (chunk_sectors - 1))) {
+        return 0;
+    }
+    
+    uint32_t shift = 0;
+    while ((1u << shift) < chunk_sectors) shift++;
+    
+    // 每个成员贡献相同数量的条带块
+    uint64_t min_capacity = members[0]->capacity;
+    for (int i = 1; i < count; i++) {
+        if (members[i]->capacity < min_capacity) min_capacity = members[i]->capacity;
+    }
+    uint64_t chunks = (min_capacity >> shift) * (uint64_t)count;
+    if (chunks > 0xFFFFFFFF) {
+        chunks = 0xFFFFFFFF - 0xFFFFFFFF % (uint32_t)count;
+    }
+    if (chunks == 0) {
+        return 0;
+    }
+    
+    raid_t* r = raid_register(0, members, count, chunks << shift, &raid0_blk_ops);
+    if (!r) {
+        return 0;
+    }
+    r->chunk_sectors = chunk_sectors;
+    r->chunk_shift = shift;
+    return &r->blk;
+}
+
+// 创建RAID-1镜像卷
+blkdev_t* raid1_create(blkdev_t** members, int count) {
+    if (raid_count >= RAID_MAX_VOLUMES || !raid_check_members(members, count)) {
+        return 0;
+    }
+    
+    uint64_t capacity = members[0]->capacity;
+    for (int i = 1; i < count; i++) {
+        if (members[i]->capacity < capacity) capacity = members[i]->capacity;
+    }
+    
+    raid_t* r = raid_register(1, members, count, capacity, &raid1_blk_ops);
+    return r ? &r->blk : 0;
+}
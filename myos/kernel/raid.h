@@ -0,0 +1,35 @@
+#ifndef RAID_H
+#define RAID_H
+
+#include <stdint.h>
+#include "blkdev.h"
+
+// 软件RAID卷定义
+#define RAID_MAX_VOLUMES      4          // 最多创建的卷数 (md0 - md3)
+#define RAID_MAX_MEMBERS      4          // 单个卷的最多成员数
+#define RAID_DEFAULT_CHUNK_KB 64         // 默认条带块大小
+#define RAID_MAX_SEGS         16         // 一批同时提交给成员的请求数
+#define RAID1_SPLIT_SECTORS   64         // RAID-1读请求达到每个成员这么多扇区时拆给所有成员并行读
+
+// RAID卷
+typedef struct {
+    int level;                           // RAID级别
+    int members;                         // 成员数
+    blkdev_t* member[RAID_MAX_MEMBERS];  // 成员设备
+    uint32_t chunk_sectors;              // 条带块扇区数 (2的幂)
+    uint32_t chunk_shift;                // log2(chunk_sectors)
+    uint32_t failed;                     // RAID-1中已出错的成员 (位图)，不再读写
+    blkdev_t blk;                        // 注册到块设备层的设备
+} raid_t;
+
+// 把count个块设备组成RAID-0条带卷，注册为 "mdN" 并返回
+// 卷上第i个条带块位于成员i % count，chunk_kb为0时使用默认值 (必须是2的幂)
+// 容量为最小成员容量 (按条带块向下取整) 乘以成员数，失败返回NULL
+blkdev_t* raid0_create(blkdev_t** members, int count, uint32_t chunk_kb);
+
+// 把count个块设备组成RAID-1镜像卷，注册为 "mdN" 并返回
+// 写入所有成员；读取交给队列最空闲、磁头离目标最近的成员，大块读拆给所有成员并行执行
+// 成员出错后卷降级运行，容量为最小成员容量，失败返回NULL
+blkdev_t* raid1_create(blkdev_t** members, int count);
+
+#endif // RAID_H
@@ -0,0 +1,101 @@
+#include "ramdisk.h"
+#include "memory.h"
+#include "string.h"
+
+// 外部函数声明
+extern void print_string(const char* str);
+extern void print_newline(void);
+extern void int_to_string(int num, char* str);
+
+static ramdisk_t ramdisk;
+
+// 块设备接口: 直接在内存中复制，没有延迟
+static int ramdisk_blk_read(blkdev_t* dev, uint64_t lba, uint32_t count, void* buffer) {
+    ramdisk_t* rd = (ramdisk_t*)dev->priv;
+
+    memcpy(buffer, rd->base + (uint32_t)lba * RAMDISK_SECTOR_SIZE, count * RAMDISK_SECTOR_SIZE);
+    return 1;
+}
+
+static int ramdisk_blk_write(blkdev_t* dev, uint64_t lba, uint32_t count, const void* buffer) {
+    ramdisk_t* rd = (ramdisk_t*)dev->priv;
+
+    memcpy(rd->base + (uint32_t)lba * RAMDISK_SECTOR_SIZE, buffer, count * RAMDISK_SECTOR_SIZE);
+    return 1;
+}
+
+// 内存盘没有写缓存，命令同步完成
+static const blkdev_ops_t ramdisk_blk_ops = {
+    ramdisk_blk_read,
+    ramdisk_blk_write,
+    0,
+    0,
+    0,
+    0,
+    0
+};
+
+// 按空闲页数决定大小: 留出RAMDISK_RESERVE_PAGES后取一半
+static uint32_t ramdisk_auto_pages() {
+    uint32_t free_pages = memory_free_page_count();
+
+    if (free_pages <= RAMDISK_RESERVE_PAGES) {
+        return 0;
+    }
+
+    uint32_t pages = (free_pages - RAMDISK_RESERVE_PAGES) / 2;
+    if (pages > RAMDISK_MAX_PAGES) pages = RAMDISK_MAX_PAGES;
+    return pages;
+}
+
+// 创建内存盘
+int ramdisk_init(uint32_t pages) {
+    if (ramdisk.base) {
+        return 1;   // 已创建
+    }
+
+    if (pages == 0) {
+        pages = ramdisk_auto_pages();
+    }
+
+    // 连续页不够时减半重试
+    uint8_t* base = 0;
+    while (pages >= RAMDISK_MIN_PAGES) {
+        base = (uint8_t*)memory_alloc_pages(pages);
+        if (base) break;
+        pages /= 2;
+    }
+    if (!base) {
+        return 0;
+    }
+
+    memset(base, 0, pages * RAMDISK_PAGE_SIZE);
+    ramdisk.base = base;
+    ramdisk.pages = pages;
+    ramdisk.sectors = (uint64_t)pages * (RAMDISK_PAGE_SIZE / RAMDISK_SECTOR_SIZE);
+
+    blkdev_t* blk = &ramdisk.blk;
+    strcpy(blk->name, "ram0");
+    blk->sector_size = RAMDISK_SECTOR_SIZE;
+    blk->capacity = ramdisk.sectors;
+    blk->ops = &ramdisk_blk_ops;
+    blk->priv = &ramdisk;
+    if (!blkdev_register(blk)) {
+        memory_free_pages(base, pages);
+        ramdisk.base = 0;
+        return 0;
+    }
+
+    char size_str[16];
+    int_to_string((int)(pages * RAMDISK_PAGE_SIZE / 1024), size_str);
+    print_string("已创建内存盘 ram0, 容量: ");
+    print_string(size_str);
+    print_string("KB");
+    print_newline();
+    return 1;
+}
+
+// 获取内存盘对应的块设备
+blkdev_t* ramdisk_get_blkdev() {
+    return ramdisk.base ? &ramdisk.blk : 0;
+}
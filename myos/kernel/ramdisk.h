@@ -0,0 +1,29 @@
+#ifndef RAMDISK_H
+#define RAMDISK_H
+
+#include <stdint.h>
+#include "blkdev.h"
+
+// 内存盘定义
+#define RAMDISK_PAGE_SIZE     4096
+#define RAMDISK_SECTOR_SIZE   512
+#define RAMDISK_MIN_PAGES     64         // 小于256KB时不创建内存盘
+#define RAMDISK_MAX_PAGES     2048       // 最大8MB
+#define RAMDISK_RESERVE_PAGES 512        // 给其他页分配留下的页数 (2MB)
+
+// 内存盘
+typedef struct {
+    uint8_t* base;             // 连续的物理页
+    uint32_t pages;            // 页数
+    uint64_t sectors;          // 扇区数量
+    blkdev_t blk;              // 注册到块设备层的设备
+} ramdisk_t;
+
+// 从空闲物理页中分配内存盘并注册为块设备 "ram0"
+// pages为0时按空闲页数自动决定大小
+int ramdisk_init(uint32_t pages);
+
+// 获取内存盘对应的块设备，未创建时返回NULL
+blkdev_t* ramdisk_get_blkdev();
+
+#endif // RAMDISK_H
@@ -147,6 +147,7 @@ static void cmd_help(int argc, char** args) {
     print_string("可用命令:\n");
     print_string("  help                  - 显示此帮助\n");
     print_string("  clear                 - 清屏\n");
+    print_string("  zfs_dev <设备>         - 指定ZFS所在的块设备 (如ram0)\n");
     print_string("  zfs_format <扇区> <大小> [卷标] - 格式化ZFS文件系统\n");
     print_string("  zfs_mount             - 挂载ZFS文件系统\n");
     print_string("  zfs_unmount           - 卸载ZFS文件系统\n");
@@ -164,6 +165,26 @@ static void cmd_clear(int argc, char** args) {
     update_cursor();
 }
 
+static void cmd_zfs_dev(int argc, char** args) {
+    if (argc < 2) {
+        print_string("用法: zfs_dev <设备>\n");
+        return;
+    }
+    
+    blkdev_t* dev = blkdev_find(args[1]);
+    if (!dev) {
+        print_string("找不到设备: ");
+        print_string(args[1]);
+        print_newline();
+        return;
+    }
+    
+    zfs_set_device(dev);
+    print_string("ZFS设备: ");
+    print_string(args[1]);
+    print_newline();
+}
+
 static void cmd_zfs_format(int argc, char** args) {
     if (argc < 3) {
         print_string("用法: zfs_format <扇区> <大小> [卷标]\n");
@@ -326,6 +347,8 @@ void kernel_main(void) {
                 cmd_help(argc, args);
             } else if (strcmp(args[0], "clear") == 0) {
                 cmd_clear(argc, args);
+            } else if (strcmp(args[0], "zfs_dev") == 0) {
+                cmd_zfs_dev(argc, args);
             } else if (strcmp(args[0], "zfs_format") == 0) {
                 cmd_zfs_format(argc, args);
             } else if (strcmp(args[0], "zfs_mount") == 0) {
@@ -5,8 +5,19 @@
 #include <stddef.h>  // 添加这个，为了NULL定义
 #include "memory.h"
 #include "timer.h"
+#include "interrupt.h"
 #include "string.h"
 #include "ntfs.h" // 添加NTFS支持
+#include "disk.h" // 块设备层需要先探测磁盘
+#include "ahci.h"
+#include "virtio_blk.h"
+#include "floppy.h"
+#include "ramdisk.h"
+#include "raid.h"
+#include "l2cache.h"
+#include "cow.h"
+#include "bcache.h"
+#include "iso9660.h" // 光盘上的ISO9660文件系统
 
 // 声明get_ntfs_fs函数 - 必须在第一次使用前声明，避免隐式声明
 extern ntfs_fs_t* get_ntfs_fs(void);
@@ -285,6 +296,9 @@ void read_input() {
     while(!input_ready) {
         handle_keyboard();
         
+        // 空闲时写回到期的脏扇区
+        bcache_writeback_run();
+        
         // 简单的CPU降低使用率
         for(int i = 0; i < 1000000; i++) {
             __asm__("nop");
@@ -425,7 +439,12 @@ void list_files() {
 
 // 保存文件系统到磁盘（模拟）
 void sync_filesystem() {
-    // 这里只是模拟，实际实现会涉及到ATA驱动和文件系统
+    // 写回缓冲区缓存中所有设备的脏扇区并刷新设备写缓存
+    for(int i = 0; i < blkdev_count(); i++) {
+        bcache_flush(blkdev_get(i));
+    }
+    
+    // 内存文件表只是模拟，实际实现会涉及到ATA驱动和文件系统
     print_string("Filesystem synchronized to disk (simulated).\n");
 }
 
@@ -445,6 +464,11 @@ void cmd_help() {
     print_string("  shutdown  - 关闭系统 (QEMU环境)\n");
     print_string("  restart   - 重启系统 (QEMU环境)\n");
     print_string("  sync      - 将文件系统数据刷新到磁盘\n");
+    print_string("  iostat    - 块设备I/O统计 (iostat [设备|reset])\n");
+    print_string("  raid0     - 创建RAID-0条带卷 (raid0 <设备1> <设备2> [条带KB])\n");
+    print_string("  raid1     - 创建RAID-1镜像卷 (raid1 <设备1> <设备2>)\n");
+    print_string("  l2cache   - 用第二块盘做读缓存 (l2cache [<后端设备> <缓存设备>])\n");
+    print_string("  cow       - 写时复制覆盖设备 (cow <基础设备> [增量设备] | cow reset|commit <cowN>)\n");
     
     set_text_color(BLUE_ON_BLACK);
     print_string("文件系统命令（内存中）:\n");
@@ -467,6 +491,13 @@ void cmd_help() {
     print_string("  ntfs_cat      - 显示NTFS文件内容\n");
     print_string("  ntfs_write    - 写入NTFS文件\n");
     print_string("  ntfs_rm       - 删除NTFS文件\n");
+    
+    set_text_color(BLUE_ON_BLACK);
+    print_string("ISO9660光盘命令（只读）:\n");
+    set_text_color(WHITE_ON_BLACK);
+    print_string("  iso_mount     - 挂载光盘 (默认cd0)\n");
+    print_string("  iso_ls        - 列出光盘目录内容\n");
+    print_string("  iso_cat       - 显示光盘文件内容\n");
 }
 
 // 命令: 关于
@@ -971,6 +1002,585 @@ void cmd_ntfs_rm(const char* filename) {
     }
 }
 
+// ISO9660文件系统实例
+static iso9660_t iso_fs;
+
+void cmd_iso_mount(const char* device) {
+    // 默认挂载第一个光驱
+    if(strlen(device) == 0) {
+        device = "cd0";
+    }
+    
+    blkdev_t* dev = blkdev_find(device);
+    if(!dev) {
+        set_text_color(RED_ON_BLACK);
+        print_string("错误: 找不到设备 ");
+        print_string(device);
+        print_newline();
+        set_text_color(WHITE_ON_BLACK);
+        return;
+    }
+    
+    if(!iso9660_mount(&iso_fs, dev)) {
+        set_text_color(RED_ON_BLACK);
+        print_string("错误: 设备上没有ISO9660文件系统\n");
+        set_text_color(WHITE_ON_BLACK);
+        return;
+    }
+    
+    print_string("ISO9660已挂载, 卷标: ");
+    print_string(iso_fs.volume_id);
+    print_string(", 目录数: ");
+    print_int(iso_fs.dir_count);
+    print_newline();
+}
+
+void cmd_iso_ls(const char* path) {
+    if(!iso_fs.mounted) {
+        set_text_color(RED_ON_BLACK);
+        print_string("错误: 光盘未挂载\n");
+        set_text_color(WHITE_ON_BLACK);
+        return;
+    }
+    
+    // 如果没有指定路径，使用根目录
+    if(strlen(path) == 0) {
+        path = "/";
+    }
+    
+    const iso9660_entry_t* entries = NULL;
+    int count = 0;
+    if(!iso9660_list(&iso_fs, path, &entries, &count)) {
+        set_text_color(RED_ON_BLACK);
+        print_string("错误: 目录不存在\n");
+        set_text_color(WHITE_ON_BLACK);
+        return;
+    }
+    
+    for(int i = 0; i < count; i++) {
+        if(entries[i].flags & ISO9660_FLAG_DIR) {
+            set_text_color(BLUE_ON_BLACK);
+            print_string("[DIR] ");
+            print_string(entries[i].name);
+        } else {
+            set_text_color(WHITE_ON_BLACK);
+            print_string("[FILE] ");
+            print_string(entries[i].name);
+            print_string(" (");
+            print_int(entries[i].size);
+            print_string(" bytes)");
+        }
+        print_newline();
+    }
+    
+    set_text_color(WHITE_ON_BLACK);
+}
+
+void cmd_iso_cat(const char* path) {
+    if(strlen(path) == 0) {
+        set_text_color(RED_ON_BLACK);
+        print_string("错误: 缺少文件名\n");
+        set_text_color(WHITE_ON_BLACK);
+        print_string("用法: iso_cat <路径>\n");
+        return;
+    }
+    
+    if(!iso_fs.mounted) {
+        set_text_color(RED_ON_BLACK);
+        print_string("错误: 光盘未挂载\n");
+        set_text_color(WHITE_ON_BLACK);
+        return;
+    }
+    
+    iso9660_file_t file;
+    if(!iso9660_open(&iso_fs, path, &file)) {
+        set_text_color(RED_ON_BLACK);
+        print_string("错误: 文件未找到\n");
+        set_text_color(WHITE_ON_BLACK);
+        return;
+    }
+    
+    // 分配缓冲区
+    char* buffer = (char*)malloc(file.size + 1);
+    if(!buffer) {
+        set_text_color(RED_ON_BLACK);
+        print_string("错误: 内存分配失败\n");
+        set_text_color(WHITE_ON_BLACK);
+        return;
+    }
+    
+    int result = iso9660_read(&file, buffer, file.size);
+    if(result < 0) {
+        set_text_color(RED_ON_BLACK);
+        print_string("读取文件失败\n");
+        set_text_color(WHITE_ON_BLACK);
+        free(buffer);
+        return;
+    }
+    
+    buffer[result] = '\0';
+    print_string(buffer);
+    print_newline();
+    
+    free(buffer);
+}
+
+// 按列宽输出，不足补空格
+static void print_column(const char* str, int width) {
+    int len = strlen(str);
+    print_string(str);
+    while(len++ < width) {
+        print_char(' ');
+    }
+}
+
+static void print_column_int(unsigned int value, int width) {
+    char buf[16];
+    int_to_string((int)value, buf);
+    print_column(buf, width);
+}
+
+// TSC每微秒的周期数，第一次使用时按定时器滴答 (10ms) 校准
+static uint32_t tsc_per_us = 0;
+
+static uint32_t iostat_tsc_per_us() {
+    if(tsc_per_us == 0) {
+        uint32_t lo0, lo1, hi;
+        unsigned int t = get_tick_count();
+        while(get_tick_count() == t);
+        t = get_tick_count();
+        asm volatile("rdtsc" : "=a"(lo0), "=d"(hi));
+        while(get_tick_count() == t);
+        asm volatile("rdtsc" : "=a"(lo1), "=d"(hi));
+        tsc_per_us = (lo1 - lo0) / 10000;
+        if(tsc_per_us == 0) {
+            tsc_per_us = 1;
+        }
+    }
+    return tsc_per_us;
+}
+
+// 2^shift个TSC周期对应的微秒数
+static uint32_t iostat_cycles_to_us(int shift) {
+    uint32_t per_us = iostat_tsc_per_us();
+    if(shift < 32) {
+        return (1U << shift) / per_us;
+    }
+    return ((1U << (shift - 16)) / per_us) << 16;
+}
+
+// 输出一个设备的统计行
+static void iostat_print_device(blkdev_t* dev, const blkdev_stats_t* st) {
+    print_column(dev->name, 8);
+    print_column_int(st->reads, 8);
+    print_column_int(st->writes, 8);
+    print_column_int((uint32_t)(st->read_sectors * dev->sector_size >> 10), 9);
+    print_column_int((uint32_t)(st->write_sectors * dev->sector_size >> 10), 9);
+    print_column_int(st->read_merges + st->write_merges, 7);
+    
+    // 平均队列深度保留一位小数
+    uint32_t avg10 = st->depth_samples ? st->depth_sum * 10 / st->depth_samples : 0;
+    char buf[16];
+    int_to_string((int)(avg10 / 10), buf);
+    int len = strlen(buf);
+    buf[len++] = '.';
+    buf[len++] = '0' + avg10 % 10;
+    buf[len] = '\0';
+    print_column(buf, 9);
+    
+    print_column_int(st->max_depth, 5);
+    print_int(st->errors);
+    print_newline();
+}
+
+// 输出一个设备的延迟直方图
+static void iostat_print_latency(const blkdev_stats_t* st) {
+    uint32_t max = 0;
+    for(int i = 0; i < BLKDEV_LAT_BUCKETS; i++) {
+        if(st->latency[i] > max) {
+            max = st->latency[i];
+        }
+    }
+    
+    print_string("命令延迟 (派发到完成):\n");
+    if(max == 0) {
+        print_string("  还没有完成的命令\n");
+        return;
+    }
+    
+    for(int i = 0; i < BLKDEV_LAT_BUCKETS; i++) {
+        if(st->latency[i] == 0) {
+            continue;
+        }
+        print_string("  < ");
+        char buf[16];
+        int_to_string((int)iostat_cycles_to_us(i + 1), buf);
+        strcpy(buf + strlen(buf), " us");
+        print_column(buf, 12);
+        print_column_int(st->latency[i], 8);
+        
+        // 按最大的桶缩放到40列 (避免64位除法)
+        int bar = max > 100000000 ? (int)(st->latency[i] / (max / 40)) : (int)(st->latency[i] * 40 / max);
+        if(bar == 0) {
+            bar = 1;
+        }
+        while(bar--) {
+            print_char('#');
+        }
+        print_newline();
+    }
+}
+
+// 命令: 块设备I/O统计
+// iostat          所有设备的汇总和缓冲区缓存统计
+// iostat <设备>   单个设备的汇总和延迟直方图
+// iostat reset    清零所有设备的统计
+void cmd_iostat(const char* args) {
+    blkdev_stats_t st;
+    
+    if(blkdev_count() == 0) {
+        print_string("没有注册的块设备\n");
+        return;
+    }
+    
+    if(strcmp(args, "reset") == 0) {
+        for(int i = 0; i < blkdev_count(); i++) {
+            blkdev_reset_stats(blkdev_get(i));
+        }
+        print_string("已清零所有设备的I/O统计\n");
+        return;
+    }
+    
+    blkdev_t* only = NULL;
+    if(strlen(args) > 0) {
+        only = blkdev_find(args);
+        if(!only) {
+            set_text_color(RED_ON_BLACK);
+            print_string("错误: 找不到设备 ");
+            print_string(args);
+            print_newline();
+            set_text_color(WHITE_ON_BLACK);
+            return;
+        }
+    }
+    
+    set_text_color(BLUE_ON_BLACK);
+    print_string("设备    读      写      读KB     写KB     合并   平均深度 峰值 错误\n");
+    set_text_color(WHITE_ON_BLACK);
+    
+    if(only) {
+        blkdev_get_stats(only, &st);
+        iostat_print_device(only, &st);
+        print_string("  刷新: ");
+        print_int(st.flushes);
+        print_string("  丢弃: ");
+        print_int(st.discards);
+        print_string(" 批 ");
+        print_int((int)(st.discard_sectors >> 1));
+        print_string("KB");
+        print_newline();
+        iostat_print_latency(&st);
+        return;
+    }
+    
+    for(int i = 0; i < blkdev_count(); i++) {
+        blkdev_t* dev = blkdev_get(i);
+        blkdev_get_stats(dev, &st);
+        iostat_print_device(dev, &st);
+    }
+    
+    bcache_stats_t bc;
+    bcache_get_stats(&bc);
+    print_string("缓冲区缓存: 已用 ");
+    print_int(bc.used);
+    print_char('/');
+    print_int(bc.buffers);
+    print_string("  脏 ");
+    print_int(bc.dirty);
+    print_string("  命中 ");
+    print_int(bc.hits);
+    print_string("  未命中 ");
+    print_int(bc.misses);
+    print_string("  替换 ");
+    print_int(bc.evictions);
+    print_string("  写回 ");
+    print_int(bc.writebacks);
+    print_string(" (到期 ");
+    print_int(bc.expired);
+    print_string(" 超限 ");
+    print_int(bc.throttled);
+    print_char(')');
+    print_string("  预读 ");
+    print_int(bc.readahead);
+    print_string(" (用到 ");
+    print_int(bc.ra_hits);
+    print_char(')');
+    print_newline();
+}
+
+// 解析命令参数中的两个块设备名，其后的数字 (如有) 存入number
+// 成功返回1，失败时打印用法或错误信息并返回0
+static int parse_device_pair(const char* args, blkdev_t** devs, uint32_t* number, const char* usage) {
+    char names[2][BLKDEV_NAME_LENGTH];
+    const char* p = args;
+    
+    for(int i = 0; i < 2; i++) {
+        int n = 0;
+        while(*p == ' ') p++;
+        while(*p && *p != ' ' && n < BLKDEV_NAME_LENGTH - 1) {
+            names[i][n++] = *p++;
+        }
+        names[i][n] = '\0';
+    }
+    while(*p == ' ') p++;
+    *number = 0;
+    while(*p >= '0' && *p <= '9') {
+        *number = *number * 10 + (*p++ - '0');
+    }
+    
+    if(names[1][0] == '\0') {
+        print_string(usage);
+        return 0;
+    }
+    
+    for(int i = 0; i < 2; i++) {
+        devs[i] = blkdev_find(names[i]);
+        if(!devs[i]) {
+            set_text_color(RED_ON_BLACK);
+            print_string("错误: 找不到设备 ");
+            print_string(names[i]);
+            print_newline();
+            set_text_color(WHITE_ON_BLACK);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// 命令: 用两个块设备创建RAID-0条带卷 mdN
+// raid0 <设备1> <设备2> [条带KB]
+void cmd_raid0(const char* args) {
+    blkdev_t* members[2];
+    uint32_t chunk_kb;
+    
+    if(!parse_device_pair(args, members, &chunk_kb, "用法: raid0 <设备1> <设备2> [条带KB]\n")) {
+        return;
+    }
+    
+    blkdev_t* md = raid0_create(members, 2, chunk_kb);
+    if(!md) {
+        set_text_color(RED_ON_BLACK);
+        print_string("错误: 无法创建RAID-0卷 (成员须为可写的不同设备且不在其他卷中，条带大小须为2的幂)\n");
+        set_text_color(WHITE_ON_BLACK);
+        return;
+    }
+    
+    raid_t* r = (raid_t*)md->priv;
+    set_text_color(GREEN_ON_BLACK);
+    print_string("已创建RAID-0卷 ");
+    print_string(md->name);
+    print_string(" (");
+    print_string(members[0]->name);
+    print_string(" + ");
+    print_string(members[1]->name);
+    print_string("), 条带: ");
+    print_int((int)(r->chunk_sectors * md->sector_size / 1024));
+    print_string("KB, 容量: ");
+    print_int((int)(md->capacity * md->sector_size >> 20));
+    print_string("MB");
+    print_newline();
+    set_text_color(WHITE_ON_BLACK);
+}
+
+// 命令: 用两个块设备创建RAID-1镜像卷 mdN
+// raid1 <设备1> <设备2>
+void cmd_raid1(const char* args) {
+    blkdev_t* members[2];
+    uint32_t unused;
+    
+    if(!parse_device_pair(args, members, &unused, "用法: raid1 <设备1> <设备2>\n")) {
+        return;
+    }
+    
+    blkdev_t* md = raid1_create(members, 2);
+    if(!md) {
+        set_text_color(RED_ON_BLACK);
+        print_string("错误: 无法创建RAID-1卷 (成员须为可写的不同设备且不在其他卷中)\n");
+        set_text_color(WHITE_ON_BLACK);
+        return;
+    }
+    
+    set_text_color(GREEN_ON_BLACK);
+    print_string("已创建RAID-1卷 ");
+    print_string(md->name);
+    print_string(" (");
+    print_string(members[0]->name);
+    print_string(" + ");
+    print_string(members[1]->name);
+    print_string("), 容量: ");
+    print_int((int)(md->capacity * md->sector_size >> 20));
+    print_string("MB");
+    print_newline();
+    set_text_color(WHITE_ON_BLACK);
+}
+
+// 命令: 用缓存设备缓存后端设备的热点块，不带参数时显示命中统计
+// l2cache [<后端设备> <缓存设备>]
+void cmd_l2cache(const char* args) {
+    while(*args == ' ') args++;
+    
+    if(*args == '\0') {
+        if(!l2cache_get(0)) {
+            print_string("没有二级缓存设备 (用法: l2cache <后端设备> <缓存设备>)\n");
+            return;
+        }
+        print_string("设备    后端    缓存    缓存块  命中    未命中  命中% 装入    替换\n");
+        for(int i = 0; l2cache_get(i); i++) {
+            l2cache_t* c = l2cache_get(i);
+            l2cache_stats_t* st = &c->stats;
+            uint32_t total = st->hits + st->misses;
+            print_column(c->blk.name, 8);
+            print_column(c->backing->name, 8);
+            print_column(c->cache->name, 8);
+            print_column_int(c->slots, 8);
+            print_column_int(st->hits, 8);
+            print_column_int(st->misses, 8);
+            print_column_int(total ? st->hits * 100 / total : 0, 6);
+            print_column_int(st->admits, 8);
+            print_int(st->evictions);
+            print_newline();
+        }
+        return;
+    }
+    
+    blkdev_t* devs[2];
+    uint32_t unused;
+    if(!parse_device_pair(args, devs, &unused, "用法: l2cache <后端设备> <缓存设备>\n")) {
+        return;
+    }
+    
+    blkdev_t* dev = l2cache_create(devs[0], devs[1]);
+    if(!dev) {
+        set_text_color(RED_ON_BLACK);
+        print_string("错误: 无法创建二级缓存设备 (须为不同的可写设备，扇区512字节且未被缓存，缓存设备至少256KB)\n");
+        set_text_color(WHITE_ON_BLACK);
+        return;
+    }
+    
+    l2cache_t* c = (l2cache_t*)dev->priv;
+    set_text_color(GREEN_ON_BLACK);
+    print_string("已创建二级缓存设备 ");
+    print_string(dev->name);
+    print_string(" (");
+    print_string(devs[0]->name);
+    print_string(" 缓存在 ");
+    print_string(devs[1]->name);
+    print_string("), 缓存: ");
+    print_int((int)(c->slots * L2CACHE_BLOCK_SECTORS * dev->sector_size >> 10));
+    print_string("KB, 恢复缓存块: ");
+    print_int(c->loaded);
+    print_newline();
+    set_text_color(WHITE_ON_BLACK);
+}
+
+// 命令: 写时复制覆盖设备，不带参数时列出已有的覆盖设备
+// cow <基础设备> [增量设备] | cow reset <cowN> | cow commit <cowN>
+void cmd_cow(const char* args) {
+    char words[2][BLKDEV_NAME_LENGTH];
+    const char* p = args;
+    
+    while(*p == ' ') p++;
+    if(*p == '\0') {
+        if(!cow_get(0)) {
+            print_string("没有写时复制覆盖设备 (用法: cow <基础设备> [增量设备])\n");
+            return;
+        }
+        set_text_color(BLUE_ON_BLACK);
+        print_string("设备    基础    增量    已用KB  总KB    复制块\n");
+        set_text_color(WHITE_ON_BLACK);
+        for(int i = 0; cow_get(i); i++) {
+            cow_t* c = cow_get(i);
+            print_column(c->blk.name, 8);
+            print_column(c->base->name, 8);
+            print_column(c->delta ? c->delta->name : "(内存)", 8);
+            print_column_int(c->used * (COW_CHUNK_SIZE / 1024), 8);
+            print_column_int(c->slots * (COW_CHUNK_SIZE / 1024), 8);
+            print_int(c->copyups);
+            print_newline();
+        }
+        return;
+    }
+    
+    // reset/commit后面是覆盖设备名，否则是基础设备名和可选的增量设备名
+    int is_reset = strncmp(p, "reset ", 6) == 0;
+    int is_commit = strncmp(p, "commit ", 7) == 0;
+    if(is_reset || is_commit) {
+        p += is_reset ? 6 : 7;
+    }
+    for(int i = 0; i < 2; i++) {
+        int n = 0;
+        while(*p == ' ') p++;
+        while(*p && *p != ' ' && n < BLKDEV_NAME_LENGTH - 1) {
+            words[i][n++] = *p++;
+        }
+        words[i][n] = '\0';
+    }
+    if(words[0][0] == '\0') {
+        print_string("用法: cow <基础设备> [增量设备] | cow reset <cowN> | cow commit <cowN>\n");
+        return;
+    }
+    
+    blkdev_t* devs[2] = { NULL, NULL };
+    for(int i = 0; i < 2 && words[i][0]; i++) {
+        devs[i] = blkdev_find(words[i]);
+        if(!devs[i]) {
+            set_text_color(RED_ON_BLACK);
+            print_string("错误: 找不到设备 ");
+            print_string(words[i]);
+            print_newline();
+            set_text_color(WHITE_ON_BLACK);
+            return;
+        }
+    }
+    
+    if(is_reset || is_commit) {
+        if(is_reset ? !cow_discard(devs[0]) : !cow_commit(devs[0])) {
+            set_text_color(RED_ON_BLACK);
+            print_string(is_reset ? "错误: 无法丢弃增量\n" : "错误: 提交失败，修改仍保留在覆盖设备中\n");
+            set_text_color(WHITE_ON_BLACK);
+            return;
+        }
+        set_text_color(GREEN_ON_BLACK);
+        print_string(is_reset ? "已丢弃全部修改: " : "已把修改提交到基础设备: ");
+        print_string(devs[0]->name);
+        print_newline();
+        set_text_color(WHITE_ON_BLACK);
+        return;
+    }
+    
+    blkdev_t* dev = cow_create(devs[0], devs[1], 0);
+    if(!dev) {
+        set_text_color(RED_ON_BLACK);
+        print_string("错误: 无法创建覆盖设备 (基础设备扇区须为512字节，增量设备须为不同的可写设备，或内存不足)\n");
+        set_text_color(WHITE_ON_BLACK);
+        return;
+    }
+    
+    cow_t* c = (cow_t*)dev->priv;
+    set_text_color(GREEN_ON_BLACK);
+    print_string("已创建写时复制覆盖设备 ");
+    print_string(dev->name);
+    print_string(" (基础 ");
+    print_string(devs[0]->name);
+    print_string(", 增量 ");
+    print_string(devs[1] ? devs[1]->name : "(内存)");
+    print_string("), 增量容量: ");
+    print_int((int)(c->slots * (COW_CHUNK_SIZE / 1024)));
+    print_string("KB");
+    print_newline();
+    set_text_color(WHITE_ON_BLACK);
+}
+
 // 解析输入命令
 void parse_command(char* command) {
     // 跳过开头的空格
@@ -1034,6 +1644,16 @@ void parse_command(char* command) {
         cmd_mount();
     } else if(strcmp(cmd_name, "sync") == 0) {
         sync_filesystem();
+    } else if(strcmp(cmd_name, "iostat") == 0) {
+        cmd_iostat(args);
+    } else if(strcmp(cmd_name, "raid0") == 0) {
+        cmd_raid0(args);
+    } else if(strcmp(cmd_name, "raid1") == 0) {
+        cmd_raid1(args);
+    } else if(strcmp(cmd_name, "l2cache") == 0) {
+        cmd_l2cache(args);
+    } else if(strcmp(cmd_name, "cow") == 0) {
+        cmd_cow(args);
     } 
     // NTFS相关命令
     else if(strcmp(cmd_name, "ntfs_format") == 0) {
@@ -1050,6 +1670,14 @@ void parse_command(char* command) {
         cmd_ntfs_write(args);
     } else if(strcmp(cmd_name, "ntfs_rm") == 0) {
         cmd_ntfs_rm(args);
+    }
+    // ISO9660光盘命令
+    else if(strcmp(cmd_name, "iso_mount") == 0) {
+        cmd_iso_mount(args);
+    } else if(strcmp(cmd_name, "iso_ls") == 0) {
+        cmd_iso_ls(args);
+    } else if(strcmp(cmd_name, "iso_cat") == 0) {
+        cmd_iso_cat(args);
     } else if(cmd_name[0] == '\0') {
         // 空命令，不做任何事
     } else {
@@ -1067,9 +1695,30 @@ void kernel_main(void) {
     // 初始化内存管理系统
     memory_init();
     
+    // 建立中断描述符表，之后驱动可以注册IRQ
+    interrupt_init();
+    
     // 初始化定时器（100Hz）
     init_timer(100);
     
+    // 缓冲区缓存的后台写回由时钟滴答计时
+    timer_register(bcache_timer_tick);
+    
+    // 探测ATA磁盘并注册到块设备层
+    disk_init();
+    
+    // 探测AHCI控制器上的SATA磁盘
+    ahci_init();
+    
+    // 探测QEMU的virtio-blk半虚拟化磁盘
+    virtio_blk_init();
+    
+    // 探测软驱 (系统盘与数据盘)
+    floppy_init();
+    
+    // 用空闲物理页创建内存盘，供文件系统测试和临时数据使用
+    ramdisk_init(0);
+    
     // 初始化文件系统
     init_filesystem();
     
@@ -1,4 +1,5 @@
 #include "timer.h"
+#include "interrupt.h"
 
 // 外部函数
 extern void outb(unsigned short port, unsigned char data);
@@ -7,6 +8,15 @@ extern unsigned char inb(unsigned short port);
 // 时钟中断频率
 unsigned int tick = 0;
 
+// 滴答回调
+static timer_callback_t timer_callbacks[TIMER_MAX_CALLBACKS];
+static int timer_callback_count = 0;
+
+// IRQ0处理函数
+static void timer_irq(int irq) {
+    timer_tick();
+}
+
 // 初始化定时器
 void init_timer(unsigned int freq) {
     // 将系统时钟分配给定的频率
@@ -18,6 +28,31 @@ void init_timer(unsigned int freq) {
     // 发送分频因子
     outb(0x40, divisor & 0xFF);
     outb(0x40, (divisor >> 8) & 0xFF);
+    
+    // 中断已建立时由IRQ0驱动计数
+    irq_register(IRQ_TIMER, timer_irq);
+}
+
+// 更新时钟计数
+void timer_tick() {
+    tick++;
+    for (int i = 0; i < timer_callback_count; i++) {
+        timer_callbacks[i]();
+    }
+}
+
+// 注册滴答回调
+int timer_register(timer_callback_t callback) {
+    if (!callback || timer_callback_count >= TIMER_MAX_CALLBACKS) {
+        return 0;
+    }
+    timer_callbacks[timer_callback_count++] = callback;
+    return 1;
+}
+
+// 开机以来的滴答数
+unsigned int get_tick_count() {
+    return tick;
 }
 
 // 获取当前时钟计数
@@ -1,4 +1,5 @@
 #include "timer.h"
+#include "interrupt.h"
 
 // 外部函数声明
 extern void outb(unsigned short port, unsigned char data);
@@ -16,8 +17,14 @@ extern unsigned char inb(unsigned short port);
 // 系统开机以来的滴答计数
 static volatile unsigned int tick_count = 0;
 
-// 中断处理程序的声明（在boot.asm中）
-extern void isr_timer();
+// 滴答回调
+static timer_callback_t timer_callbacks[TIMER_MAX_CALLBACKS];
+static int timer_callback_count = 0;
+
+// IRQ0处理函数
+static void timer_irq(int irq) {
+    timer_tick();
+}
 
 // 初始化PIT
 void init_timer(unsigned int frequency) {
@@ -30,11 +37,26 @@ void init_timer(unsigned int frequency) {
     // 设置分频值（低8位和高8位）
     outb(PIT_CHANNEL0_DATA, divisor & 0xFF);
     outb(PIT_CHANNEL0_DATA, (divisor >> 8) & 0xFF);
+    
+    // 中断已建立时由IRQ0驱动滴答计数
+    irq_register(IRQ_TIMER, timer_irq);
 }
 
 // 更新滴答计数（由中断处理程序调用）
 void timer_tick() {
     tick_count++;
+    for (int i = 0; i < timer_callback_count; i++) {
+        timer_callbacks[i]();
+    }
+}
+
+// 注册滴答回调
+int timer_register(timer_callback_t callback) {
+    if (!callback || timer_callback_count >= TIMER_MAX_CALLBACKS) {
+        return 0;
+    }
+    timer_callbacks[timer_callback_count++] = callback;
+    return 1;
 }
 
 // 获取滴答计数
@@ -7,4 +7,17 @@ void init_timer(unsigned int freq);
 // 获取当前时钟计数
 unsigned int get_tick();
 
+// 更新滴答计数 (IRQ0)
+void timer_tick();
+
+// 开机以来的滴答数
+unsigned int get_tick_count();
+
+// 每个滴答调用的回调 (在中断中执行，只能做很少的工作)
+#define TIMER_MAX_CALLBACKS 4
+typedef void (*timer_callback_t)();
+
+// 注册滴答回调，已满时返回0
+int timer_register(timer_callback_t callback);
+
 #endif // TIMER_H
@@ -0,0 +1,516 @@
+#include "virtio_blk.h"
+#include "pci.h"
+#include "interrupt.h"
+#include "string.h"
+
+// 外部函数声明
+extern void print_string(const char* str);
+extern void print_newline(void);
+extern void int_to_string(int num, char* str);
+
+// 已发现的virtio磁盘
+static virtio_blk_t virtio_blks[VIRTIO_BLK_MAX];
+static int virtio_blk_num = 0;
+
+// 每个设备一个虚拟队列，legacy接口要求页对齐
+static uint8_t virtio_rings[VIRTIO_BLK_MAX][VIRTIO_RING_BYTES] __attribute__((aligned(VIRTIO_PAGE_SIZE)));
+
+// 端口读写
+static inline uint8_t inb(uint16_t port) {
+    uint8_t ret;
+    asm volatile("inb %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+static inline uint16_t inw(uint16_t port) {
+    uint16_t ret;
+    asm volatile("inw %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+static inline uint32_t inl(uint16_t port) {
+    uint32_t ret;
+    asm volatile("inl %1, %0" : "=a"(ret) : "Nd"(port));
+    return ret;
+}
+
+static inline void outb(uint16_t port, uint8_t val) {
+    asm volatile("outb %0, %1" : : "a"(val), "Nd"(port));
+}
+
+static inline void outw(uint16_t port, uint16_t val) {
+    asm volatile("outw %0, %1" : : "a"(val), "Nd"(port));
+}
+
+static inline void outl(uint16_t port, uint32_t val) {
+    asm volatile("outl %0, %1" : : "a"(val), "Nd"(port));
+}
+
+// 关中断并返回原来的标志
+static inline uint32_t irq_save() {
+    uint32_t flags;
+    asm volatile("pushf; pop %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+static inline void irq_restore(uint32_t flags) {
+    if (flags & 0x200) {
+        asm volatile("sti" : : : "memory");
+    }
+}
+
+// 发布可用环之后读取设备的通知抑制字段，x86上只有写后读需要mfence
+static inline void virtio_mb() {
+    asm volatile("mfence" : : : "memory");
+}
+
+// 可用环ring之后的used_event与已用环ring之后的avail_event (EVENT_IDX)
+static inline volatile uint16_t* vring_used_event(virtio_blk_t* vblk) {
+    return (volatile uint16_t*)&vblk->avail->ring[vblk->qsize];
+}
+
+static inline volatile uint16_t* vring_avail_event(virtio_blk_t* vblk) {
+    return (volatile uint16_t*)&vblk->used->ring[vblk->qsize];
+}
+
+// 可用环从old推进到new时是否越过了设备要求通知的位置
+static inline int vring_need_event(uint16_t event, uint16_t new_idx, uint16_t old_idx) {
+    return (uint16_t)(new_idx - event - 1) < (uint16_t)(new_idx - old_idx);
+}
+
+// 在可用环中放入tag对应的请求 (尚未发布)，调用时已关中断
+// 有间接描述符时每个请求只占环中一项，否则每个tag固定占用VIRTIO_BLK_SEGS项
+static void virtio_blk_queue(virtio_blk_t* vblk, int tag, uint32_t type, uint64_t lba, const blk_iovec_t* iov, int iovcnt) {
+    virtio_blk_slot_t* slot = &vblk->slots[tag];
+    int indirect = (vblk->features & VIRTIO_RING_F_INDIRECT_DESC) != 0;
+    uint16_t base = indirect ? 0 : (uint16_t)(tag * VIRTIO_BLK_SEGS);
+    vring_desc_t* d = indirect ? slot->indirect : &vblk->desc[base];
+    uint16_t data_flags = VRING_DESC_F_NEXT | (type == VIRTIO_BLK_T_IN ? VRING_DESC_F_WRITE : 0);
+    int n = 0;
+
+    slot->hdr.type = type;
+    slot->hdr.reserved = 0;
+    slot->hdr.sector = lba;
+    slot->status = 0xFF;
+
+    // 请求头、各数据段、状态字节依次链接
+    d[n].addr = (uint32_t)&slot->hdr;
+    d[n].len = sizeof(virtio_blk_req_hdr_t);
+    d[n].flags = VRING_DESC_F_NEXT;
+    d[n].next = base + n + 1;
+    n++;
+
+    for (int i = 0; i < iovcnt; i++) {
+        d[n].addr = (uint32_t)iov[i].base;   // 内核未开分页，虚拟地址即物理地址
+        d[n].len = iov[i].len;
+        d[n].flags = data_flags;
+        d[n].next = base + n + 1;
+        n++;
+    }
+
+    d[n].addr = (uint32_t)&slot->status;
+    d[n].len = 1;
+    d[n].flags = VRING_DESC_F_WRITE;
+    d[n].next = 0;
+    n++;
+
+    uint16_t head = base;
+    if (indirect) {
+        head = (uint16_t)tag;
+        vblk->desc[head].addr = (uint32_t)slot->indirect;
+        vblk->desc[head].len = n * sizeof(vring_desc_t);
+        vblk->desc[head].flags = VRING_DESC_F_INDIRECT;
+        vblk->desc[head].next = 0;
+    }
+
+    vblk->avail->ring[vblk->avail_idx % vblk->qsize] = head;
+    vblk->avail_idx++;
+    vblk->active |= 1u << tag;
+}
+
+// 发布可用环中新放入的请求，需要时通知设备
+// 一轮派发的多个请求只通知一次，设备正在处理或未要求通知时不通知
+static void virtio_blk_kick(virtio_blk_t* vblk) {
+    uint16_t old_idx = vblk->avail->idx;
+    uint16_t new_idx = vblk->avail_idx;
+
+    if (old_idx == new_idx) {
+        return;
+    }
+
+    // 描述符必须在发布之前写好
+    asm volatile("" : : : "memory");
+    vblk->avail->idx = new_idx;
+    virtio_mb();
+
+    int notify;
+    if (vblk->features & VIRTIO_RING_F_EVENT_IDX) {
+        notify = vring_need_event(*vring_avail_event(vblk), new_idx, old_idx);
+    } else {
+        notify = !(vblk->used->flags & VRING_USED_F_NO_NOTIFY);
+    }
+
+    if (notify) {
+        outw(vblk->iobase + VIRTIO_REG_QUEUE_NOTIFY, 0);
+    }
+}
+
+// 处理已用环中的完成请求，调用时已关中断
+static void virtio_blk_complete(virtio_blk_t* vblk) {
+    int indirect = (vblk->features & VIRTIO_RING_F_INDIRECT_DESC) != 0;
+    int requeued = 0;
+
+    while (vblk->used_idx != vblk->used->idx) {
+        asm volatile("" : : : "memory");
+        vring_used_elem_t* elem = &vblk->used->ring[vblk->used_idx % vblk->qsize];
+        int tag = indirect ? (int)elem->id : (int)(elem->id / VIRTIO_BLK_SEGS);
+        virtio_blk_slot_t* slot = &vblk->slots[tag];
+        vblk->used_idx++;
+
+        vblk->active &= ~(1u << tag);
+        int ok = slot->status == VIRTIO_BLK_S_OK;
+
+        // FUA写的数据已完成，在同一tag上接着刷新
+        if (ok && slot->flush) {
+            slot->flush = 0;
+            virtio_blk_queue(vblk, tag, VIRTIO_BLK_T_FLUSH, 0, 0, 0);
+            requeued = 1;
+            continue;
+        }
+        slot->flush = 0;
+
+        if (slot->sync) {
+            slot->sync = 0;
+            continue;
+        }
+
+        // 可能在这里派发下一条请求并重新占用该tag
+        blkdev_end_tag(&vblk->blk, tag, ok);
+    }
+
+    // 要求设备在下一个请求完成时再中断
+    if (vblk->features & VIRTIO_RING_F_EVENT_IDX) {
+        *vring_used_event(vblk) = vblk->used_idx;
+    }
+
+    if (requeued) {
+        virtio_blk_kick(vblk);
+    }
+}
+
+// 中断处理: 读ISR应答设备，再处理共用这条中断线的所有设备的完成请求
+static void virtio_blk_irq_handler(int irq) {
+    for (int i = 0; i < virtio_blk_num; i++) {
+        virtio_blk_t* vblk = &virtio_blks[i];
+        if (vblk->irq != irq) continue;
+
+        if (inb(vblk->iobase + VIRTIO_REG_ISR) & 1) {
+            virtio_blk_complete(vblk);
+        }
+    }
+}
+
+// 等待在途请求: 处理已完成的请求，有中断时hlt直到下一次中断
+static void virtio_blk_poll(blkdev_t* dev) {
+    virtio_blk_t* vblk = (virtio_blk_t*)dev->priv;
+
+    asm volatile("cli");
+    virtio_blk_complete(vblk);
+    if (!vblk->active) {
+        asm volatile("sti");
+        return;
+    }
+
+    if (vblk->use_irq) {
+        asm volatile("sti; hlt");
+    } else {
+        asm volatile("sti");
+    }
+}
+
+// 块设备层异步操作: 放入可用环后立即返回，由commit统一通知设备
+static int virtio_blk_start(blkdev_t* dev, int tag, uint64_t lba, const blk_iovec_t* iov, int iovcnt, int flags) {
+    virtio_blk_t* vblk = (virtio_blk_t*)dev->priv;
+    int write = flags & BLK_RW_WRITE;
+
+    if (iovcnt <= 0 || (uint32_t)iovcnt > vblk->seg_max) {
+        return 0;
+    }
+
+    uint32_t eflags = irq_save();
+    vblk->slots[tag].sync = 0;
+    vblk->slots[tag].flush = write && (flags & BLK_RW_FUA) && (vblk->features & VIRTIO_BLK_F_FLUSH);
+    virtio_blk_queue(vblk, tag, write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN, lba, iov, iovcnt);
+    irq_restore(eflags);
+
+    return 1;
+}
+
+// 一轮派发结束，一次性发布并通知
+static void virtio_blk_commit(blkdev_t* dev) {
+    virtio_blk_t* vblk = (virtio_blk_t*)dev->priv;
+
+    uint32_t eflags = irq_save();
+    virtio_blk_kick(vblk);
+    irq_restore(eflags);
+}
+
+// 等待全部异步请求完成后在tag 0上同步执行一个请求
+static int virtio_blk_exec(virtio_blk_t* vblk, uint32_t type, uint64_t lba, const blk_iovec_t* iov, int iovcnt) {
+    while (vblk->active) {
+        virtio_blk_poll(&vblk->blk);
+    }
+
+    uint32_t eflags = irq_save();
+    vblk->slots[0].sync = 1;
+    vblk->slots[0].flush = 0;
+    virtio_blk_queue(vblk, 0, type, lba, iov, iovcnt);
+    virtio_blk_kick(vblk);
+    irq_restore(eflags);
+
+    while (vblk->active & 1) {
+        virtio_blk_poll(&vblk->blk);
+    }
+
+    return vblk->slots[0].status == VIRTIO_BLK_S_OK;
+}
+
+// 同步读写，按单条请求的上限拆分
+static int virtio_blk_rw(blkdev_t* dev, uint64_t lba, uint32_t count, void* buffer, int write) {
+    virtio_blk_t* vblk = (virtio_blk_t*)dev->priv;
+    uint8_t* buf = (uint8_t*)buffer;
+
+    while (count > 0) {
+        uint32_t n = count > VIRTIO_MAX_SECTORS ? VIRTIO_MAX_SECTORS : count;
+        blk_iovec_t iov;
+
+        iov.base = buf;
+        iov.len = n * 512;
+        if (!virtio_blk_exec(vblk, write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN, lba, &iov, 1)) {
+            return 0;
+        }
+
+        lba += n;
+        count -= n;
+        buf += n * 512;
+    }
+
+    return 1;
+}
+
+// 块设备层读操作
+static int virtio_blk_read(blkdev_t* dev, uint64_t lba, uint32_t count, void* buffer) {
+    return virtio_blk_rw(dev, lba, count, buffer, 0);
+}
+
+// 块设备层写操作
+static int virtio_blk_write(blkdev_t* dev, uint64_t lba, uint32_t count, const void* buffer) {
+    return virtio_blk_rw(dev, lba, count, (void*)buffer, 1);
+}
+
+// 块设备层刷新操作，设备不支持FLUSH时为直写缓存，无需刷新
+static int virtio_blk_flush(blkdev_t* dev) {
+    virtio_blk_t* vblk = (virtio_blk_t*)dev->priv;
+
+    if (!(vblk->features & VIRTIO_BLK_F_FLUSH)) {
+        return 1;
+    }
+    return virtio_blk_exec(vblk, VIRTIO_BLK_T_FLUSH, 0, 0, 0);
+}
+
+// 块设备层丢弃操作，超过设备上限的范围拆成多段，段表满了就先发出一个请求
+static int virtio_blk_discard(blkdev_t* dev, const blk_range_t* ranges, int count) {
+    virtio_blk_t* vblk = (virtio_blk_t*)dev->priv;
+    uint32_t segs = 0;
+    blk_iovec_t iov;
+
+    iov.base = vblk->discard;
+    for (int i = 0; i < count; i++) {
+        uint64_t lba = ranges[i].lba;
+        uint32_t left = ranges[i].count;
+
+        while (left > 0) {
+            uint32_t n = left > vblk->max_discard_sectors ? vblk->max_discard_sectors : left;
+
+            vblk->discard[segs].sector = lba;
+            vblk->discard[segs].num_sectors = n;
+            vblk->discard[segs].flags = 0;
+            segs++;
+            lba += n;
+            left -= n;
+
+            if (segs == vblk->max_discard_seg || (left == 0 && i == count - 1)) {
+                iov.len = segs * sizeof(virtio_blk_discard_t);
+                if (!virtio_blk_exec(vblk, VIRTIO_BLK_T_DISCARD, 0, &iov, 1)) {
+                    return 0;
+                }
+                segs = 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+static const blkdev_ops_t virtio_blk_ops = {
+    virtio_blk_read,
+    virtio_blk_write,
+    virtio_blk_flush,
+    virtio_blk_start,
+    virtio_blk_poll,
+    virtio_blk_commit,
+    virtio_blk_discard
+};
+
+// 复位设备、协商特性并设置队列0，成功返回1
+static int virtio_blk_setup(virtio_blk_t* vblk, int n) {
+    uint16_t io = vblk->iobase;
+
+    outb(io + VIRTIO_REG_STATUS, 0);
+    outb(io + VIRTIO_REG_STATUS, VIRTIO_STATUS_ACK);
+    outb(io + VIRTIO_REG_STATUS, VIRTIO_STATUS_ACK | VIRTIO_STATUS_DRIVER);
+
+    uint32_t wanted = VIRTIO_BLK_F_SEG_MAX | VIRTIO_BLK_F_FLUSH | VIRTIO_BLK_F_DISCARD |
+                      VIRTIO_RING_F_INDIRECT_DESC | VIRTIO_RING_F_EVENT_IDX;
+    vblk->features = inl(io + VIRTIO_REG_HOST_FEATURES) & wanted;
+    outl(io + VIRTIO_REG_GUEST_FEATURES, vblk->features);
+
+    outw(io + VIRTIO_REG_QUEUE_SELECT, 0);
+    vblk->qsize = inw(io + VIRTIO_REG_QUEUE_SIZE);
+    if (vblk->qsize == 0 || vblk->qsize > VIRTIO_QUEUE_MAX) {
+        outb(io + VIRTIO_REG_STATUS, VIRTIO_STATUS_FAILED);
+        return 0;
+    }
+
+    // legacy布局: 描述符表、可用环，下一页开始是已用环
+    uint8_t* ring = virtio_rings[n];
+    uint32_t avail_off = vblk->qsize * sizeof(vring_desc_t);
+    uint32_t used_off = avail_off + 6 + 2 * vblk->qsize;
+    used_off = (used_off + VIRTIO_PAGE_SIZE - 1) & ~(VIRTIO_PAGE_SIZE - 1);
+
+    memset(ring, 0, VIRTIO_RING_BYTES);
+    vblk->desc = (vring_desc_t*)ring;
+    vblk->avail = (vring_avail_t*)(ring + avail_off);
+    vblk->used = (vring_used_t*)(ring + used_off);
+    vblk->avail_idx = 0;
+    vblk->used_idx = 0;
+    vblk->active = 0;
+
+    outl(io + VIRTIO_REG_QUEUE_PFN, (uint32_t)ring / VIRTIO_PAGE_SIZE);
+
+    // 容量和段数上限
+    uint16_t cfg = io + VIRTIO_REG_CONFIG;
+    vblk->capacity = ((uint64_t)inl(cfg + VIRTIO_BLK_CFG_CAPACITY + 4) << 32) |
+                     inl(cfg + VIRTIO_BLK_CFG_CAPACITY);
+    vblk->seg_max = BLKQ_MAX_IOV;
+    if (vblk->features & VIRTIO_BLK_F_SEG_MAX) {
+        uint32_t seg_max = inl(cfg + VIRTIO_BLK_CFG_SEG_MAX);
+        if (seg_max && seg_max < vblk->seg_max) vblk->seg_max = seg_max;
+    }
+
+    // 丢弃的段数不超过块设备层一批的范围数，每段扇区数没有给出时按32位上限
+    vblk->max_discard_seg = 0;
+    if (vblk->features & VIRTIO_BLK_F_DISCARD) {
+        uint32_t max_seg = inl(cfg + VIRTIO_BLK_CFG_MAX_DISCARD_SEG);
+        vblk->max_discard_sectors = inl(cfg + VIRTIO_BLK_CFG_MAX_DISCARD_SECTORS);
+        if (vblk->max_discard_sectors == 0) vblk->max_discard_sectors = 0xFFFFFFFF;
+        vblk->max_discard_seg = max_seg < BLKDEV_DISCARD_RANGES ? max_seg : BLKDEV_DISCARD_RANGES;
+    }
+
+    // 有间接描述符时每个请求占环中一项，否则占VIRTIO_BLK_SEGS项
+    if (vblk->features & VIRTIO_RING_F_INDIRECT_DESC) {
+        vblk->depth = vblk->qsize;
+    } else {
+        vblk->depth = vblk->qsize / VIRTIO_BLK_SEGS;
+    }
+    if (vblk->depth > BLKQ_MAX_TAGS) vblk->depth = BLKQ_MAX_TAGS;
+    if (vblk->depth < 1) {
+        outb(io + VIRTIO_REG_STATUS, VIRTIO_STATUS_FAILED);
+        return 0;
+    }
+
+    outb(io + VIRTIO_REG_STATUS, VIRTIO_STATUS_ACK | VIRTIO_STATUS_DRIVER | VIRTIO_STATUS_DRIVER_OK);
+    return 1;
+}
+
+// 将virtio磁盘注册到块设备层，设备表已满时返回0
+static int virtio_blk_register_blkdev(virtio_blk_t* vblk, int n) {
+    blkdev_t* blk = &vblk->blk;
+
+    strcpy(blk->name, "vda");
+    blk->name[2] = 'a' + n;
+    blk->sector_size = 512;
+    blk->capacity = vblk->capacity;
+    blk->ops = &virtio_blk_ops;
+    blk->priv = vblk;
+    blk->depth = vblk->depth;
+    blk->max_discard = vblk->max_discard_seg ? BLKDEV_DISCARD_RANGES : 0;
+
+    return blkdev_register(blk);
+}
+
+// 中断可用时由设备中断通知完成，否则关闭设备中断并在poll中轮询
+// 传统IDE的IRQ14/15已由disk.c使用，不与之共用
+static void virtio_blk_enable_irq(virtio_blk_t* vblk) {
+    int irq = vblk->irq;
+
+    if (irq < IRQ_COUNT && irq != IRQ_ATA_PRIMARY && irq != IRQ_ATA_SECONDARY &&
+        irq_register(irq, virtio_blk_irq_handler)) {
+        vblk->use_irq = 1;
+        return;
+    }
+
+    vblk->avail->flags = VRING_AVAIL_F_NO_INTERRUPT;
+}
+
+// 初始化virtio-blk驱动
+void virtio_blk_init() {
+    pci_device_t pdev;
+
+    virtio_blk_num = 0;
+
+    for (int i = 0; virtio_blk_num < VIRTIO_BLK_MAX &&
+                    pci_find_device(VIRTIO_PCI_VENDOR, VIRTIO_PCI_DEVICE_BLK, i, &pdev); i++) {
+        // legacy接口的寄存器在I/O空间的BAR0
+        uint32_t bar0 = pci_read32(&pdev, PCI_BAR0);
+        if (!(bar0 & 1)) continue;
+
+        virtio_blk_t* vblk = &virtio_blks[virtio_blk_num];
+        memset(vblk, 0, sizeof(virtio_blk_t));
+        vblk->iobase = (uint16_t)(bar0 & 0xFFFC);
+        vblk->irq = pci_read8(&pdev, PCI_INTERRUPT_LINE);
+
+        pci_enable_bus_master(&pdev);
+        if (!virtio_blk_setup(vblk, virtio_blk_num)) continue;
+        if (!virtio_blk_register_blkdev(vblk, virtio_blk_num)) {
+            outb(vblk->iobase + VIRTIO_REG_STATUS, 0);     // 复位设备，放弃这块盘
+            continue;
+        }
+
+        char size_str[16];
+        char depth_str[16];
+        int_to_string((int)(vblk->capacity >> 11), size_str); // 显示MB
+        int_to_string(vblk->depth, depth_str);
+        print_string("发现virtio磁盘, 容量: ");
+        print_string(size_str);
+        print_string("MB, 队列深度: ");
+        print_string(depth_str);
+        print_newline();
+
+        virtio_blk_num++;
+        virtio_blk_enable_irq(vblk);
+    }
+}
+
+// 已发现的virtio磁盘数量
+int virtio_blk_count() {
+    return virtio_blk_num;
+}
+
+// 按发现顺序获取virtio磁盘对应的块设备
+blkdev_t* virtio_blk_get_blkdev(int index) {
+    if (index < 0 || index >= virtio_blk_num) {
+        return 0;
+    }
+    return &virtio_blks[index].blk;
+}
@@ -0,0 +1,146 @@
+#ifndef VIRTIO_BLK_H
+#define VIRTIO_BLK_H
+
+#include <stdint.h>
+#include "blkdev.h"
+
+// virtio-blk驱动定义 (legacy PCI接口)
+#define VIRTIO_PCI_VENDOR        0x1AF4
+#define VIRTIO_PCI_DEVICE_BLK    0x1001     // 过渡设备ID，同时提供legacy接口
+
+#define VIRTIO_BLK_MAX           4          // 最多驱动的virtio磁盘数
+#define VIRTIO_QUEUE_MAX         256        // 支持的最大队列长度 (QEMU默认256)
+#define VIRTIO_PAGE_SIZE         4096       // legacy队列地址以页为单位
+#define VIRTIO_RING_BYTES        (3 * VIRTIO_PAGE_SIZE) // 长度256的队列所需内存
+#define VIRTIO_BLK_SEGS          (BLKQ_MAX_IOV + 2)     // 一个请求的描述符数: 头 + 数据段 + 状态
+#define VIRTIO_MAX_SECTORS       8192       // 同步读写时单条请求的扇区数
+
+// legacy I/O寄存器 (BAR0)
+#define VIRTIO_REG_HOST_FEATURES  0x00
+#define VIRTIO_REG_GUEST_FEATURES 0x04
+#define VIRTIO_REG_QUEUE_PFN      0x08
+#define VIRTIO_REG_QUEUE_SIZE     0x0C
+#define VIRTIO_REG_QUEUE_SELECT   0x0E
+#define VIRTIO_REG_QUEUE_NOTIFY   0x10
+#define VIRTIO_REG_STATUS         0x12
+#define VIRTIO_REG_ISR            0x13      // 读出即清除
+#define VIRTIO_REG_CONFIG         0x14      // 设备配置 (未启用MSI-X时)
+
+// 设备配置中的字段偏移
+#define VIRTIO_BLK_CFG_CAPACITY   0x00      // 64位，以512字节扇区为单位
+#define VIRTIO_BLK_CFG_SEG_MAX    0x0C      // 单个请求的最大数据段数
+#define VIRTIO_BLK_CFG_MAX_DISCARD_SECTORS 0x24 // 单个丢弃段的最大扇区数
+#define VIRTIO_BLK_CFG_MAX_DISCARD_SEG     0x28 // 单个丢弃请求的最大段数
+
+// 设备状态
+#define VIRTIO_STATUS_ACK         0x01
+#define VIRTIO_STATUS_DRIVER      0x02
+#define VIRTIO_STATUS_DRIVER_OK   0x04
+#define VIRTIO_STATUS_FAILED      0x80
+
+// 特性位
+#define VIRTIO_BLK_F_SEG_MAX      (1u << 2)
+#define VIRTIO_BLK_F_FLUSH        (1u << 9)
+#define VIRTIO_BLK_F_DISCARD      (1u << 13)
+#define VIRTIO_RING_F_INDIRECT_DESC (1u << 28)
+#define VIRTIO_RING_F_EVENT_IDX   (1u << 29)
+
+// 描述符标志
+#define VRING_DESC_F_NEXT         1
+#define VRING_DESC_F_WRITE        2         // 设备写入 (读请求的数据和状态)
+#define VRING_DESC_F_INDIRECT     4
+
+// 通知抑制标志
+#define VRING_AVAIL_F_NO_INTERRUPT 1
+#define VRING_USED_F_NO_NOTIFY    1
+
+// 请求类型与状态
+#define VIRTIO_BLK_T_IN           0
+#define VIRTIO_BLK_T_OUT          1
+#define VIRTIO_BLK_T_FLUSH        4
+#define VIRTIO_BLK_T_DISCARD      11
+#define VIRTIO_BLK_S_OK           0
+
+// 描述符
+typedef struct {
+    uint64_t addr;             // 物理地址
+    uint32_t len;
+    uint16_t flags;
+    uint16_t next;
+} __attribute__((packed)) vring_desc_t;
+
+// 驱动发布的可用环，ring之后是used_event
+typedef struct {
+    uint16_t flags;
+    volatile uint16_t idx;
+    uint16_t ring[];
+} vring_avail_t;
+
+typedef struct {
+    uint32_t id;               // 描述符链的头
+    uint32_t len;
+} __attribute__((packed)) vring_used_elem_t;
+
+// 设备返回的已用环，ring之后是avail_event
+typedef struct {
+    volatile uint16_t flags;
+    volatile uint16_t idx;
+    vring_used_elem_t ring[];
+} vring_used_t;
+
+// 请求头
+typedef struct {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t sector;
+} __attribute__((packed)) virtio_blk_req_hdr_t;
+
+// 丢弃请求的数据段，每段一个范围
+typedef struct {
+    uint64_t sector;
+    uint32_t num_sectors;
+    uint32_t flags;
+} __attribute__((packed)) virtio_blk_discard_t;
+
+// 每个tag的固定资源，请求头、状态和间接描述符表都在这里
+typedef struct {
+    virtio_blk_req_hdr_t hdr;
+    volatile uint8_t status;
+    uint8_t flush;             // 数据完成后还要发出FLUSH (FUA写)
+    uint8_t sync;              // 同步请求，由等待者检查结果
+    vring_desc_t indirect[VIRTIO_BLK_SEGS] __attribute__((aligned(16)));
+} virtio_blk_slot_t;
+
+// virtio磁盘
+typedef struct {
+    uint16_t iobase;           // legacy I/O基址
+    uint8_t irq;               // PCI中断线
+    uint8_t use_irq;           // 是否由中断通知请求完成
+    uint32_t features;         // 协商后的特性
+    uint64_t capacity;         // 扇区数量
+    uint32_t seg_max;          // 单个请求的最大数据段数
+    uint32_t max_discard_sectors; // 单个丢弃段的最大扇区数
+    uint32_t max_discard_seg;  // 单个丢弃请求的最大段数，0表示不支持丢弃
+    uint16_t qsize;            // 队列长度
+    vring_desc_t* desc;        // 描述符表
+    vring_avail_t* avail;      // 可用环
+    vring_used_t* used;        // 已用环
+    uint16_t avail_idx;        // 已填入可用环但可能尚未发布的位置
+    uint16_t used_idx;         // 已处理到的已用环位置
+    volatile uint32_t active;  // 在途tag的掩码
+    int depth;                 // 可同时在途的请求数
+    virtio_blk_slot_t slots[BLKQ_MAX_TAGS];
+    virtio_blk_discard_t discard[BLKDEV_DISCARD_RANGES]; // 同步丢弃请求的范围表
+    blkdev_t blk;              // 注册到块设备层的设备
+} virtio_blk_t;
+
+// 探测virtio-blk设备并注册为块设备 "vda"、"vdb"...
+void virtio_blk_init();
+
+// 已发现的virtio磁盘数量
+int virtio_blk_count();
+
+// 按发现顺序获取virtio磁盘对应的块设备
+blkdev_t* virtio_blk_get_blkdev(int index);
+
+#endif // VIRTIO_BLK_H